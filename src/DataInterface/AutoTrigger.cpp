@@ -0,0 +1,114 @@
+/*
+ * AutoTrigger.cpp - Types the Measurement Once the Reading Settles
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "AutoTrigger.h"
+
+
+// Wider than any reading, so the reading after a unit change counts as closed onto
+static constexpr int32_t WIDEST_AFTER_UNIT_CHANGE = 0x7FFFFFFF;
+
+
+/**
+ * Auto trigger constructor.
+ */
+AutoTrigger::AutoTrigger() {
+    this->begin(0, 0);
+}
+
+
+/**
+ * Sets the debounce thresholds and resets the trigger.
+ *
+ * @param settleTime milliseconds the reading has to be stable for, the
+ *                   stable tolerance is set on the caliper history
+ * @param rearmChange counts the reading has to move away from the last
+ *                    triggered value before triggering again
+ */
+void AutoTrigger::begin(uint32_t settleTime, uint16_t rearmChange) {
+    this->settleTime = settleTime;
+    this->rearmChange = rearmChange;
+
+    this->reset();
+}
+
+/**
+ * Waits for the reading to move before triggering again.
+ * The next reading is used as the starting point.
+ */
+void AutoTrigger::reset() {
+    this->armed = false;
+    this->hasLastValue = false;
+    this->lastValue = 0;
+    this->lastUnit = MILLIMETERS;
+    this->widestValue = 0;
+}
+
+
+/**
+ * Returns true when the settled reading should be typed.
+ * Should be called once after each refershData() with new data.
+ *
+ * @param caliper caliper with refreshed data and history
+ * @return true if the measurement should be typed now
+ */
+bool AutoTrigger::update(ClockwiseCaliper &caliper) {
+    MeasurementHistory<HISTORY_SIZE> &history = caliper.getHistory();
+    int32_t value = caliper.getFixedMeasurement();
+    uint8_t unit = caliper.getUnit();
+
+    if (!this->hasLastValue) {
+        this->hasLastValue = true;
+        this->lastValue = value;
+        this->lastUnit = unit;
+        this->widestValue = value;
+    }
+
+    int32_t change = value - this->lastValue;
+
+    if (unit != this->lastUnit) {
+        // Values in different units can't be compared, type it again as is
+        this->armed = true;
+        this->lastUnit = unit;
+        this->widestValue = WIDEST_AFTER_UNIT_CHANGE;
+    } else if (change > this->rearmChange || change < -(int32_t)this->rearmChange) {
+        this->armed = true;
+    }
+
+    if (value > this->widestValue) {
+        this->widestValue = value;
+    }
+
+    if (!this->armed || history.getStableCount() == 0 || history.getStableTime() < this->settleTime) {
+        return false;
+    }
+
+    int32_t stableValue = history.getStableValue();
+
+    // Jaws at rest: parked open, closed, or set down
+    if ((int64_t)this->widestValue - stableValue <= this->rearmChange
+        || (stableValue <= this->rearmChange && stableValue >= -(int32_t)this->rearmChange)) {
+        return false;
+    }
+
+    this->armed = false;
+    this->lastValue = stableValue;
+    this->widestValue = stableValue;
+
+    return true;
+}
@@ -0,0 +1,62 @@
+/*
+ * AutoTrigger.h - Types the Measurement Once the Reading Settles (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Watches the stable run in the caliper history and triggers once the
+// reading has been stable for settleTime. After triggering it waits until
+// the reading moves more than rearmChange counts away from the value it
+// triggered on (or the unit changes) before it can trigger again, so a
+// part is typed once no matter how long it stays in the jaws, and the
+// next part is typed even if it measures the same.
+//
+// Nothing is typed for the reading at power on, until it first moves.
+//
+// The jaws also come to rest without a part in them, and those readings
+// are stable too. So a reading is only typed when the jaws closed onto
+// it, at least rearmChange counts from the widest they were opened since
+// the last trigger, which skips the jaws parked open after a part. A
+// reading within rearmChange of zero is never typed, which skips the jaws
+// closed and the caliper set down. A part at the zero set on a reference
+// part has to be typed with the button. Changing the unit types the
+// reading again in the new unit wherever the jaws are.
+
+
+#pragma once
+
+#include <stdint.h>
+#include "ClockwiseCaliper.h"
+
+
+class AutoTrigger {
+public:
+    AutoTrigger();
+
+    void begin(uint32_t settleTime, uint16_t rearmChange); // Sets the debounce thresholds and resets the trigger.
+    void reset(); // Waits for the reading to move before triggering again.
+
+    bool update(ClockwiseCaliper &caliper); // Returns true when the settled reading should be typed.
+
+private:
+    uint32_t settleTime;  // Milliseconds the reading has to be stable for
+    uint16_t rearmChange; // Counts the reading has to move to trigger again
+
+    bool armed;          // The reading moved since the last trigger
+    bool hasLastValue;   // lastValue, lastUnit and widestValue are set
+    int32_t lastValue;   // Value of the last trigger, or the first reading
+    uint8_t lastUnit;    // Unit of lastValue
+    int32_t widestValue; // Widest reading since the last trigger, WIDEST_AFTER_UNIT_CHANGE after a unit change
+};
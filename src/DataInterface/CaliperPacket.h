@@ -0,0 +1,209 @@
+/*
+ * CaliperPacket.h - Portable Decoding of the 24-bit Caliper Packet
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// The packet is handled as a 24-bit integer, bit 0 is the first bit the
+// caliper sends:
+//   bits  0-19  measurement, hundredths of a millimeter or 1/2
+//               thousandths of an inch
+//   bit   20    sign (caliper_sign_t)
+//   bits 21-22  unknown, always 0 from a working caliper
+//   bit   23    unit (caliper_unit_t)
+//
+// Every field is taken out with shifts and masks, never with bitfields or
+// by reading the bytes of an integer, so the results are the same on AVR
+// and on any host whatever its byte order. The functions are constexpr,
+// so constant packets decode at compile time.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef enum : uint8_t {
+    MILLIMETERS = 0,
+    INCHES = 1
+} caliper_unit_t;
+
+typedef enum : uint8_t {
+    POSITIVE = 0,
+    NEGATIVE = 1
+} caliper_sign_t;
+
+const uint32_t CALIPER_PACKET_MASK = 0xFFFFFF;             // All 24 bits
+const uint32_t CALIPER_PACKET_MEASUREMENT_MASK = 0x0FFFFF; // Bits 0 to 19
+const uint8_t CALIPER_PACKET_SIGN_BIT = 20;
+const uint8_t CALIPER_PACKET_UNKNOWN_SHIFT = 21;           // Bits 21 and 22
+const uint8_t CALIPER_PACKET_UNIT_BIT = 23;
+
+/**
+ * A 24-bit caliper data packet as bytes, least significant byte first.
+ */
+typedef struct {
+    uint8_t array[3];
+} caliper_data_t;
+
+/**
+ * Every field of a packet.
+ */
+typedef struct {
+    uint32_t measurement; // Absolute measurement
+    caliper_sign_t sign;
+    uint8_t unknown;      // Bits 21 and 22, as bits 0 and 1
+    caliper_unit_t unit;
+} caliper_packet_fields_t;
+
+
+/**
+ * Returns the packet made of three bytes.
+ *
+ * @param lsb least significant byte
+ * @param mb middle byte
+ * @param msb most significant byte
+ * @return the 24-bit packet
+ */
+constexpr uint32_t caliperPacketFromBytes(uint8_t lsb, uint8_t mb, uint8_t msb) {
+    return (uint32_t)lsb | ((uint32_t)mb << 8) | ((uint32_t)msb << 16);
+}
+
+/**
+ * Returns one byte of a packet.
+ *
+ * @param packet 24-bit packet
+ * @param index 0 for the least significant byte, up to 2
+ * @return the byte
+ */
+constexpr uint8_t caliperPacketByte(uint32_t packet, uint8_t index) {
+    return (uint8_t)(packet >> (index * 8));
+}
+
+/**
+ * Returns the absolute, unconverted 20-bit measurement.
+ *
+ * @param packet 24-bit packet
+ * @return the measurement
+ */
+constexpr uint32_t caliperPacketMeasurement(uint32_t packet) {
+    return packet & CALIPER_PACKET_MEASUREMENT_MASK;
+}
+
+/**
+ * Returns the sign.
+ *
+ * @param packet 24-bit packet
+ * @return the sign
+ */
+constexpr caliper_sign_t caliperPacketSign(uint32_t packet) {
+    return (caliper_sign_t)((packet >> CALIPER_PACKET_SIGN_BIT) & 1);
+}
+
+/**
+ * Returns the two unknown bits, which a working caliper always sends as 0.
+ *
+ * @param packet 24-bit packet
+ * @return bit 21 as bit 0 and bit 22 as bit 1
+ */
+constexpr uint8_t caliperPacketUnknownBits(uint32_t packet) {
+    return (packet >> CALIPER_PACKET_UNKNOWN_SHIFT) & 3;
+}
+
+/**
+ * Returns the unit.
+ *
+ * @param packet 24-bit packet
+ * @return the unit
+ */
+constexpr caliper_unit_t caliperPacketUnit(uint32_t packet) {
+    return (caliper_unit_t)((packet >> CALIPER_PACKET_UNIT_BIT) & 1);
+}
+
+/**
+ * Returns the signed measurement in the caliper's own steps. Without
+ * branches, so loops over many packets vectorize.
+ *
+ * @param packet 24-bit packet
+ * @return the measurement, negated when the sign bit is set
+ */
+constexpr int32_t caliperPacketValue(uint32_t packet) {
+    // x ^ -1 + 1 negates x, x ^ 0 - 0 leaves it
+    return ((int32_t)caliperPacketMeasurement(packet) ^ -(int32_t)caliperPacketSign(packet))
+         + (int32_t)caliperPacketSign(packet);
+}
+
+/**
+ * Returns every field of a packet.
+ *
+ * @param packet 24-bit packet
+ * @return the fields
+ */
+constexpr caliper_packet_fields_t decodeCaliperPacket(uint32_t packet) {
+    return {caliperPacketMeasurement(packet),
+            caliperPacketSign(packet),
+            caliperPacketUnknownBits(packet),
+            caliperPacketUnit(packet)};
+}
+
+/**
+ * Returns the packet for a signed measurement. 0 is always positive, and
+ * the unknown bits are 0.
+ *
+ * @param value signed measurement, the magnitude must fit in 20 bits
+ * @param unit unit of the measurement
+ * @return the 24-bit packet
+ */
+constexpr uint32_t encodeCaliperPacket(int32_t value, caliper_unit_t unit) {
+    return ((value < 0 ? (uint32_t)-value : (uint32_t)value) & CALIPER_PACKET_MEASUREMENT_MASK)
+         | ((uint32_t)(value < 0 ? NEGATIVE : POSITIVE) << CALIPER_PACKET_SIGN_BIT)
+         | ((uint32_t)unit << CALIPER_PACKET_UNIT_BIT);
+}
+
+/**
+ * Returns the packet held in bytes.
+ *
+ * @param data packet bytes
+ * @return the 24-bit packet
+ */
+constexpr uint32_t caliperDataToPacket(const caliper_data_t &data) {
+    return caliperPacketFromBytes(data.array[0], data.array[1], data.array[2]);
+}
+
+/**
+ * Returns the bytes of a packet.
+ *
+ * @param packet 24-bit packet
+ * @return the packet bytes
+ */
+constexpr caliper_data_t caliperPacketToData(uint32_t packet) {
+    return {{caliperPacketByte(packet, 0), caliperPacketByte(packet, 1), caliperPacketByte(packet, 2)}};
+}
+
+
+/**
+ * Decodes the signed measurement of many packets, for processing logs.
+ * The loop has no branches, so compilers vectorize it.
+ *
+ * @param packets 24-bit packets
+ * @param values array of count values to fill
+ * @param count number of packets
+ */
+inline void decodeCaliperPacketValues(const uint32_t *packets, int32_t *values, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        values[i] = caliperPacketValue(packets[i]);
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * CaptureConfig.h - Selects How the Caliper Data is Captured
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// At most one of these can be defined, with none the caliper is captured
+// by StaticSoftSPISlave on CLK_PIN and DATA_PIN.
+//
+// They are here rather than in the sketch so every file sees the same
+// setting. The Arduino IDE compiles every .cpp in the sketch folder, and
+// each capture backend only claims its interrupt vectors and timers when
+// it is the one selected, so they stay free for other libraries.
+
+
+#pragma once
+
+#include <stdint.h>
+
+// Capture the caliper data with the hardware SPI peripheral instead of in
+// software. Requires rewiring, see HardwareSPISlave.h
+// #define HARDWARE_SPI_CAPTURE
+
+// Timestamp the caliper clock with the Timer1 input capture unit, which
+// detects missed bits within one bit time. Requires the clock on the ICP1
+// pin, see InputCaptureSPISlave.h
+// #define INPUT_CAPTURE
+
+// Capture several calipers at once (e.g. X/Y/Z on a fixture) with one pin
+// change interrupt, and type them as one row. Requires rewiring, see
+// PinChangeSPISlave.h
+// #define MULTI_CALIPER
+
+#if (defined(HARDWARE_SPI_CAPTURE) + defined(INPUT_CAPTURE) + defined(MULTI_CALIPER)) > 1
+    #error "Only one of HARDWARE_SPI_CAPTURE, INPUT_CAPTURE, and MULTI_CALIPER can be defined"
+#endif
+
+
+/**
+ * Returns true if pin is one of the pins in pins.
+ *
+ * @param pin pin to look for
+ * @param pins pins to look in
+ * @param count number of pins in pins
+ * @return true if pin was found
+ */
+constexpr bool pinInList(int16_t pin, const int16_t *pins, uint8_t count) {
+    return count > 0 && (pins[0] == pin || pinInList(pin, pins + 1, count - 1));
+}
+
+/**
+ * Returns true if any pin of one list is also in the other, so the sketch
+ * can check at compile time that no capture pin is used for anything else.
+ *
+ * @param pins first list of pins
+ * @param count number of pins in pins
+ * @param other second list of pins
+ * @param otherCount number of pins in other
+ * @return true if the lists share a pin
+ */
+constexpr bool pinsOverlap(const int16_t *pins, uint8_t count, const int16_t *other, uint8_t otherCount) {
+    return count > 0 && (pinInList(pins[0], other, otherCount) || pinsOverlap(pins + 1, count - 1, other, otherCount));
+}
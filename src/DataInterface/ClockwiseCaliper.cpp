@@ -20,13 +20,37 @@
 #include "ClockwiseCaliper.h"
 
 
+// Ten-thousandths of the unit per measurement step, indexed by caliper_unit_t
+static constexpr uint8_t TEN_THOUSANDTHS_PER_STEP[] = {
+    100, // Hundredths of a millimeter
+    5    // 1/2 thousandths of an inch
+};
+
+// Place value of each digit formatMeasurement() can write, in ten-thousandths
+static constexpr uint32_t DIGIT_PLACES[] = {
+    100000000, 10000000, 1000000, 100000, 10000, // Whole part
+    1000, 100, 10, 1                              // Decimal part
+};
+
+const uint8_t DIGIT_COUNT = sizeof(DIGIT_PLACES) / sizeof(DIGIT_PLACES[0]);
+const uint8_t FIRST_DECIMAL_DIGIT = DIGIT_COUNT - MEASUREMENT_DECIMALS;
+
+
+#if defined(CLOCKWISE_CALIPER_TEST_HOOKS)
+void (*ClockwiseCaliper::readHook)(uint8_t index) = nullptr;
+#endif
+
+
 /**
  * Clockwise Caliper constructor.
  */
 ClockwiseCaliper::ClockwiseCaliper() {
-    this->newData = false;
-    this->pWriteCaliperData = &this->caliperDataA;
-    this->pReadCaliperData = &this->caliperDataB;
+    this->writeData = caliperPacketToData(0);
+    this->publishedData = caliperPacketToData(0);
+    this->readPacket = 0;
+    this->sequence = 0;
+    this->readSequence = 0;
+    this->historyUnit = MILLIMETERS;
 }
 
 
@@ -36,7 +60,7 @@ ClockwiseCaliper::ClockwiseCaliper() {
  * @param msb most significant byte
  */
 void ClockwiseCaliper::updateMsb(uint8_t msb) {
-    this->pWriteCaliperData->bytes.msb = msb;
+    this->writeData.array[2] = msb;
 }
 
 /**
@@ -45,7 +69,7 @@ void ClockwiseCaliper::updateMsb(uint8_t msb) {
  * @param mb middle byte
  */
 void ClockwiseCaliper::updateMb(uint8_t mb) {
-    this->pWriteCaliperData->bytes.mb = mb;
+    this->writeData.array[1] = mb;
 }
 
 /**
@@ -54,7 +78,7 @@ void ClockwiseCaliper::updateMb(uint8_t mb) {
  * @param lsb least significant byte
  */
 void ClockwiseCaliper::updateLsb(uint8_t lsb) {
-    this->pWriteCaliperData->bytes.lsb = lsb;
+    this->writeData.array[0] = lsb;
 }
 
 /**
@@ -66,7 +90,7 @@ void ClockwiseCaliper::updateLsb(uint8_t lsb) {
  * @param index index to place it in
  */
 void ClockwiseCaliper::updateByte(uint8_t byte, uint8_t index) {
-    this->pWriteCaliperData->array[index] = byte;
+    this->writeData.array[index] = byte;
 }
 
 /**
@@ -76,32 +100,130 @@ void ClockwiseCaliper::updateByte(uint8_t byte, uint8_t index) {
  * @param msb most significant byte
  */
 void ClockwiseCaliper::updateDataBytes(uint8_t msb, uint8_t mb, uint8_t lsb) {
-    this->pWriteCaliperData->bytes.msb = msb;
-    this->pWriteCaliperData->bytes.mb = mb;
-    this->pWriteCaliperData->bytes.lsb = lsb;
+    this->writeData.array[2] = msb;
+    this->writeData.array[1] = mb;
+    this->writeData.array[0] = lsb;
     this->setNewData();
 }
 
+/**
+ * Updates all bytes of data from a full 24-bit packet.
+ * The first bit received is bit 0 of the packet. Also sets the newData
+ * flag.
+ *
+ * @param packet packet data, bits above the 24th are ignored
+ */
+void ClockwiseCaliper::updatePacket(uint32_t packet) {
+    this->updateDataBytes(caliperPacketByte(packet, 2), caliperPacketByte(packet, 1), caliperPacketByte(packet, 0));
+}
+
+/**
+ * Updates all bytes of data from a full 24-bit packet and adds it to the
+ * history. The history starts over when the unit changes, since values
+ * in different units can't be compared. Also sets the
+ * newData flag.
+ * Unlike the other update functions this is not interrupt safe: the
+ * history isn't published under the sequence count, so only call it from
+ * the context that reads the history and the settled data (loop()).
+ *
+ * @param packet packet data, bits above the 24th are ignored
+ * @param time milliseconds when the packet was received
+ */
+void ClockwiseCaliper::updatePacket(uint32_t packet, uint32_t time) {
+    this->updatePacket(packet);
+
+    packet &= CALIPER_PACKET_MASK;
+
+    if (caliperPacketUnit(packet) != this->historyUnit) {
+        this->historyUnit = caliperPacketUnit(packet);
+        this->history.clear();
+    }
+
+    this->history.add(packet, time);
+}
+
 
 /**
  * Updates the readable data with the most recent data.
  * Should be called just before reading data.
- * Data is guaranteed to be consistent between calls to refershData().
- * Also clears the newData flag.
+ * Data is guaranteed to be consistent between calls to refershData(),
+ * even when the producer runs in an interrupt. Also clears the newData
+ * flag.
  */
 void ClockwiseCaliper::refershData() {
-    this->clearNewData();
-    this->swapReadWrite();
+    caliper_data_t data;
+    uint8_t start;
+
+    // Copy again if the producer published meanwhile
+    do {
+        start = __atomic_load_n(&this->sequence, __ATOMIC_ACQUIRE);
+
+        for (uint8_t i = 0; i < sizeof(data.array); i++) {
+            data.array[i] = __atomic_load_n(&this->publishedData.array[i], __ATOMIC_RELAXED);
+#if defined(CLOCKWISE_CALIPER_TEST_HOOKS)
+            if (readHook != nullptr) {
+                readHook(i);
+            }
+#endif
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((start & 1) != 0 || start != __atomic_load_n(&this->sequence, __ATOMIC_RELAXED));
+
+    this->readPacket = caliperDataToPacket(data);
+    this->readSequence = start;
+}
+
+/**
+ * Updates the readable data with the settled reading from the history.
+ * The settled reading is the mean of the stable run, see
+ * MeasurementHistory.h. Should be called after refershData(), the
+ * readable data is left alone when the reading has not been stable for
+ * long enough.
+ *
+ * @param minStableTime milliseconds the reading has to be stable for
+ * @return true if the readable data was replaced with the settled reading
+ */
+bool ClockwiseCaliper::refreshSettledData(uint32_t minStableTime) {
+    if (this->history.getStableCount() == 0 || this->history.getStableTime() < minStableTime) {
+        return false;
+    }
+
+    this->readPacket = encodeCaliperPacket(this->history.getStableValue(), this->historyUnit);
+
+    return true;
 }
 
 
+/**
+ * Returns the history of timestamped packets.
+ * Only packets given to updatePacket() with a time are added.
+ *
+ * @return the history
+ */
+MeasurementHistory<HISTORY_SIZE> &ClockwiseCaliper::getHistory() {
+    return this->history;
+}
+
+
+/**
+ * Returns the current 24-bit packet, decode it with the functions in
+ * CaliperPacket.h. After refreshSettledData() it is the settled reading,
+ * with the unknown bits 0.
+ *
+ * @return the current packet
+ */
+uint32_t ClockwiseCaliper::getPacket() {
+    return this->readPacket;
+}
+
 /**
  * Returns the current absolute, unconverted 20-bit measurement.
  *
  * @return the current raw measurement data
  */
 uint32_t ClockwiseCaliper::getRawMeasurement() {
-    return this->pReadCaliperData->data.measurement;
+    return caliperPacketMeasurement(this->readPacket);
 }
 
 /**
@@ -135,13 +257,69 @@ float ClockwiseCaliper::getMeasurement() {
 }
 
 
+/**
+ * Returns the signed measurement without converting it.
+ * The value is in hundredths of a millimeter or 1/2 thousandths of an
+ * inch, depending on getUnit(), so it is exact unlike getMeasurement().
+ *
+ * @return the signed measurement in the caliper's own steps
+ */
+int32_t ClockwiseCaliper::getFixedMeasurement() {
+    return caliperPacketValue(this->readPacket);
+}
+
+/**
+ * Writes the measurement as decimal text to buffer.
+ * Always has MEASUREMENT_DECIMALS decimal places, the same as printing
+ * getMeasurement() with 4 digits, but exact and without floating point.
+ * A measurement of 0 is never written with a minus sign.
+ *
+ * @param buffer buffer of at least MEASUREMENT_STR_SIZE characters
+ * @return the length of the text written, not including the terminator
+ */
+uint8_t ClockwiseCaliper::formatMeasurement(char *buffer) {
+    uint32_t value = this->getRawMeasurement() * TEN_THOUSANDTHS_PER_STEP[this->getUnit()];
+    char *pChar = buffer;
+    bool leadingZero = true;
+
+    if (this->getSign() == NEGATIVE && value > 0) {
+        *pChar++ = '-';
+    }
+
+    for (uint8_t i = 0; i < DIGIT_COUNT; i++) {
+        uint32_t place = DIGIT_PLACES[i];
+        char digit = '0';
+
+        // At most 9 subtractions, cheaper than a 32-bit divide on AVR
+        while (value >= place) {
+            value -= place;
+            digit++;
+        }
+
+        if (i == FIRST_DECIMAL_DIGIT) {
+            *pChar++ = '.';
+        }
+
+        // Skip leading zeros, but keep the one before the decimal point
+        if (digit != '0' || !leadingZero || i >= FIRST_DECIMAL_DIGIT - 1) {
+            *pChar++ = digit;
+            leadingZero = false;
+        }
+    }
+
+    *pChar = '\0';
+
+    return pChar - buffer;
+}
+
+
 /**
  * Returns the current measurement unit.
  *
  * @return the current measurement unit
  */
 caliper_unit_t ClockwiseCaliper::getUnit() {
-    return this->pReadCaliperData->data.unit;
+    return caliperPacketUnit(this->readPacket);
 }
 
 /**
@@ -149,8 +327,8 @@ caliper_unit_t ClockwiseCaliper::getUnit() {
  *
  * @return the current measurement unit as a pointer to a C string
  */
-char* ClockwiseCaliper::getUnitString() {
-    char *unitString = EMPTY_STR;
+const char* ClockwiseCaliper::getUnitString() {
+    const char *unitString = EMPTY_STR;
 
     switch (this->getUnit()) {
         case MILLIMETERS:
@@ -171,7 +349,7 @@ char* ClockwiseCaliper::getUnitString() {
  * @return the current measurement sign
  */
 caliper_sign_t ClockwiseCaliper::getSign() {
-    return this->pReadCaliperData->data.sign;
+    return caliperPacketSign(this->readPacket);
 }
 
 /**
@@ -179,8 +357,8 @@ caliper_sign_t ClockwiseCaliper::getSign() {
  *
  * @return the current measurement sign as a pointer to a C string
  */
-char* ClockwiseCaliper::getSignString() {
-    char *signString = POSITIVE_STR;
+const char* ClockwiseCaliper::getSignString() {
+    const char *signString = POSITIVE_STR;
 
     if (this->getSign() == NEGATIVE) {
         signString = NEGATIVE_STR;
@@ -191,28 +369,40 @@ char* ClockwiseCaliper::getSignString() {
 
 
 /**
- * Sets the newData flag.
+ * Publishes the data written so far and sets the newData flag.
+ * Only called by the producer, which may be an interrupt.
  */
 void ClockwiseCaliper::setNewData() {
-    this->newData = true;
+    uint8_t sequence = this->sequence;
+
+    // Odd while the copy is in progress
+    __atomic_store_n(&this->sequence, (uint8_t)(sequence + 1), __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (uint8_t i = 0; i < sizeof(this->writeData.array); i++) {
+        __atomic_store_n(&this->publishedData.array[i], this->writeData.array[i], __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&this->sequence, (uint8_t)(sequence + 2), __ATOMIC_RELEASE);
 }
 
 /**
  * Clears the newData flag.
+ * Only called by the reader.
  */
 void ClockwiseCaliper::clearNewData() {
-    this->newData = false;
+    this->readSequence = __atomic_load_n(&this->sequence, __ATOMIC_ACQUIRE) & ~1;
 }
 
 /**
  * Returns the status of the newData flag.
- * The newData flag is used to indicate that the data has been updated
- * since it was last read.
+ * The newData flag is used to indicate that the data has been published
+ * since it was last read. Only called by the reader.
  *
  * @return true if set, false otherwise
  */
 bool ClockwiseCaliper::isNewData() {
-    return this->newData;
+    return __atomic_load_n(&this->sequence, __ATOMIC_ACQUIRE) != this->readSequence;
 }
 
 /**
@@ -224,13 +414,3 @@ bool ClockwiseCaliper::isNewData() {
 uint8_t ClockwiseCaliper::getPacketLength() const {
     return 3;
 }
-
-
-/**
- * Swaps the caliper data read and write pointers.
- */
-void ClockwiseCaliper::swapReadWrite() {
-    caliper_data_t *pTemp = this->pReadCaliperData;
-    this->pReadCaliperData = this->pWriteCaliperData;
-    this->pWriteCaliperData = pTemp;
-}
@@ -17,8 +17,24 @@
  */
 
 
+// Decoded data goes through three copies, so a packet can be written in an
+// interrupt and read in loop() without either side disabling interrupts:
+//   - write:     only touched by the producer (updateByte() and friends).
+//   - published: setNewData() copies the write data here under a sequence
+//                count, which is odd while the copy is in progress.
+//   - read:      refershData() copies the published data here, and starts
+//                over if the sequence count was odd or changed meanwhile.
+// The producer is never interrupted by the reader, so only the reader
+// ever retries. There must be only one producer context, and one reader.
+// The history is not published this way: updatePacket(packet, time) adds
+// to it directly, so that overload is not interrupt safe and must be called
+// from the context that reads the history, as the sketch does in loop().
+
+
 #pragma once
 #include <stdint.h>
+#include "CaliperPacket.h"
+#include "MeasurementHistory.h"
 
 
 constexpr char EMPTY_STR[] = "";
@@ -27,38 +43,9 @@ constexpr char INCHES_STR[] = "in";
 constexpr char POSITIVE_STR[] = "+";
 constexpr char NEGATIVE_STR[] = "-";
 
-/**
- * Union representation of the a 24-bit caliper data packet.
- */
-typedef union {
-    uint32_t integer; // Representation as a 32-bit integer
-
-    uint8_t array[3]; // Representation as an array of 3 8-bit integers
-
-    struct {
-        uint8_t lsb; // Least significant
-        uint8_t mb;  // Middle byte
-        uint8_t msb; // Most significant
-    } bytes; // Representation in bytes (8-bits) format
-
-    struct {
-        uint32_t measurement:20;    // Measurement data (hundredths of a millimeter, or 1/2 thousandths of an inch)
-        uint8_t sign:1;             // Measurement sign (0: positive, 1: negative)
-        uint8_t :1;                 // Unknown use
-        uint8_t :1;                 // Unknown use
-        uint8_t unit:1;             // Measurement unit (0: millimeters, 1: inches)
-    } data;
-} caliper_data_t;
-
-typedef enum : uint8_t {
-    MILLIMETERS = 0,
-    INCHES = 1
-} caliper_unit_t;
-
-typedef enum : uint8_t {
-    POSITIVE = 0,
-    NEGATIVE = 1
-} caliper_sign_t;
+const uint8_t MEASUREMENT_DECIMALS = 4;  // Decimal places written by formatMeasurement()
+const uint8_t MEASUREMENT_STR_SIZE = 12; // Longest formatted measurement ("-10485.7500") plus the terminator
+const uint8_t HISTORY_SIZE = 16;         // Timestamped packets kept, about 2.4 seconds of readings
 
 
 class ClockwiseCaliper {
@@ -70,30 +57,43 @@ public:
     void updateLsb(uint8_t lsb); // Updates the least significant byte of data.
     void updateByte(uint8_t byte, uint8_t index); // Updates the byte at the given index.
     void updateDataBytes(uint8_t msb, uint8_t mb, uint8_t lsb); // Updates the most significant, middle, and least significant bytes of data.
+    void updatePacket(uint32_t packet); // Updates all bytes of data from a full 24-bit packet.
+    void updatePacket(uint32_t packet, uint32_t time); // Updates all bytes of data from a full 24-bit packet and adds it to the history. Not interrupt safe, call from loop().
 
     void refershData(); // Updates the readable data with the most recent data.
+    bool refreshSettledData(uint32_t minStableTime); // Updates the readable data with the settled reading from the history.
 
+    MeasurementHistory<HISTORY_SIZE> &getHistory(); // Returns the history of timestamped packets.
+
+    uint32_t getPacket();         // Returns the current 24-bit packet.
     uint32_t getRawMeasurement(); // Returns the current absolute, unconverted 20-bit measurement.
     float getMeasurement();       // Returns the converted measurement.
+    int32_t getFixedMeasurement(); // Returns the signed measurement in hundredths of a millimeter or 1/2 thousandths of an inch.
+    uint8_t formatMeasurement(char *buffer); // Writes the measurement as decimal text to buffer.
 
-    caliper_unit_t getUnit(); // Returns the current measurement unit.
-    char* getUnitString();    // Returns the current measurement unit as a string.
-    caliper_sign_t getSign(); // Returns the current measurement sign.
-    char* getSignString();    // Returns the current measurement sign as a string.
+    caliper_unit_t getUnit();    // Returns the current measurement unit.
+    const char* getUnitString(); // Returns the current measurement unit as a string.
+    caliper_sign_t getSign();    // Returns the current measurement sign.
+    const char* getSignString(); // Returns the current measurement sign as a string.
 
-    void setNewData();   // Sets the newData flag.
+    void setNewData();   // Publishes the data written so far and sets the newData flag.
     void clearNewData(); // Clears the newData flag.
     bool isNewData();    // Returns the status of the newData flag.
 
     uint8_t getPacketLength() const; // Returns the length of a full data packet in bytes.
 
+#if defined(CLOCKWISE_CALIPER_TEST_HOOKS)
+    static void (*readHook)(uint8_t index); // Test builds only, called after refershData() loads each byte so a test can publish mid read
+#endif
+
 private:
-    void swapReadWrite(); // Swaps the caliper data read and write pointers.
+    caliper_data_t writeData;     // Data being received, only used by the producer
+    caliper_data_t publishedData; // Last complete data, shared
+    uint32_t readPacket;          // Packet being read, only used by the reader
 
-    bool newData; // Data was changed in *pWriteCaliperData
+    uint8_t sequence;     // Incremented before and after publishing, shared
+    uint8_t readSequence; // Sequence of readData, newData is clear when it matches
 
-    caliper_data_t *pWriteCaliperData; // Points to structure to use for new data
-    caliper_data_t *pReadCaliperData;  // Points to structure to use for getting data
-    caliper_data_t caliperDataA;
-    caliper_data_t caliperDataB;
+    MeasurementHistory<HISTORY_SIZE> history;
+    caliper_unit_t historyUnit; // Unit of the values in the history
 };
@@ -26,34 +26,97 @@
  */
 
 
+#include "AutoTrigger.h"
+#include "CaptureConfig.h"
 #include "ClockwiseCaliper.h"
-#include "SoftSPISlave.h"
+#include "HardwareSPISlave.h"
+#include "InputCaptureSPISlave.h"
+#include "KeySequence.h"
+#include "MeasurementTyping.h"
+#include "OutputScheduler.h"
+#include "PacketFilter.h"
+#include "PacketStream.h"
+#include "PerfCounters.h"
+#include "PinChangeSPISlave.h"
+#include "StaticSoftSPISlave.h"
+#include "TraceRing.h"
 #include <HID-Project.h>
 
-// #define DEBUG_SERIAL
+#if defined(ARDUINO_ARCH_AVR)
+    #include <avr/sleep.h>
+#endif
 
-#ifdef DEBUG_SERIAL
-    #define debug_println(...) Serial.println(__VA_ARGS__)
-    #define debug_print(...) Serial.print(__VA_ARGS__)
-#else
-    #define debug_println(...)
-    #define debug_print(...)
+// Stream every packet from the calipers over the USB serial port, for
+// logging with tools/stream-reader.cpp. Typing still works as usual
+// #define STREAM_SERIAL
+
+// Keep the CPU running between events instead of idle sleeping
+// #define NO_IDLE_SLEEP
+
+// The hardware SPI, input capture, and multiple caliper capture are
+// selected in CaptureConfig.h
+
+// Debug tracing over the USB serial port is turned on with DEBUG_TRACE in
+// TraceRing.h, and read with tools/trace-reader.cpp
+
+// Each of these uses the serial port on its own, the perf counters print
+// text and read commands, which would break up the binary frames of the
+// others and take their bytes
+#if defined(TRACE_ENABLED) && defined(STREAM_SERIAL)
+    #error "DEBUG_TRACE and STREAM_SERIAL both use the serial port"
+#endif
+
+#if defined(PERF_ENABLED) && defined(TRACE_ENABLED)
+    #error "PERF_COUNTERS and DEBUG_TRACE both use the serial port"
+#endif
+
+#if defined(PERF_ENABLED) && defined(STREAM_SERIAL)
+    #error "PERF_COUNTERS and STREAM_SERIAL both use the serial port"
 #endif
 
 
 // Caliper SPI like data
-const uint8_t CLK_PIN = 3; // Serial clock pin (must support interrupts)
+const uint8_t CLK_PIN = 3; // Serial clock pin (must support interrupts, INPUT_CAPTURE uses INPUT_CAPTURE_CLK_PIN instead)
 const uint8_t DATA_PIN = 2; // Serial data pin (must support interrupts)
 const uint32_t BIT_MAX_DELAY = 10; // Milliseconds - Maximum time between spi clock pulses
-const uint32_t PACKET_MAX_DELAY = 10; // Milliseconds - Maximum time between 8 bit packets
+const uint8_t SS_GATE_PIN = 9; // Drives the hardware SPI SS pin (only used with HARDWARE_SPI_CAPTURE)
+const uint32_t CAPTURE_BIT_MAX_DELAY = 600; // Microseconds - Maximum time between spi clock pulses (only used with INPUT_CAPTURE)
+
+// Data line noise filtering, see SoftSPISampler.h (only used with the default capture)
+const uint8_t DATA_SAMPLES = 1; // Reads of the data line per bit, majority wins, odd up to 15
+const uint8_t DATA_SAMPLE_SPACING = 0; // Microseconds - Wait before each read of the data line
+const uint16_t CLK_MIN_TIME = 0; // Microseconds - Sampling edges closer than this to the previous one are ignored, 0 to disable
+
+// Multiple calipers (only used with MULTI_CALIPER)
+const uint8_t MULTI_CALIPER_COUNT = 3; // Calipers to capture, up to 4
+constexpr int16_t MULTI_CLK_PINS[MULTI_CALIPER_COUNT] = {8, 9, 10}; // Serial clock pin of each caliper (must be on port B)
+constexpr int16_t MULTI_DATA_PINS[MULTI_CALIPER_COUNT] = {14, 15, 16}; // Serial data pin of each caliper (must be on port B)
+const KeyboardKeycode MULTI_CALIPER_SEPARATOR = KEY_TAB; // Typed between the measurements of a row
+
+// Packet filter, see PacketFilter.h
+const uint32_t FILTER_MAX_JUMP = 2000; // Counts - Largest change between packets accepted without the next packet confirming it
+const uint8_t FILTER_MEDIAN_SIZE = 3; // Packets - Median of this many packets is used, 1 to turn the median off
 
 // DIP switch control pins
-const uint8_t DIP_CTRL_A_PIN = 16; // Type CTRL+A before the measurement
-const uint8_t DIP_UNITS_PIN = 14; // Type the units after the measurement
-const uint8_t DIP_NEWLINE_PIN = 15; // Type a newline after the measurement
+#if defined(MULTI_CALIPER)
+    // Port B is taken by the calipers, the switches have to be rewired to these, see PinChangeSPISlave.h
+    const uint8_t DIP_CTRL_A_PIN = 2; // Type CTRL+A before the measurement
+    const uint8_t DIP_UNITS_PIN = 3; // Type the units after the measurement
+    const uint8_t DIP_NEWLINE_PIN = 4; // Type a newline after the measurement
+#elif defined(HARDWARE_SPI_CAPTURE)
+    // 14 to 16 are the SPI pins, the switches have to be rewired to these, see HardwareSPISlave.h
+    const uint8_t DIP_CTRL_A_PIN = 4; // Type CTRL+A before the measurement
+    const uint8_t DIP_UNITS_PIN = 5; // Type the units after the measurement
+    const uint8_t DIP_NEWLINE_PIN = 8; // Type a newline after the measurement
+#else
+    const uint8_t DIP_CTRL_A_PIN = 16; // Type CTRL+A before the measurement
+    const uint8_t DIP_UNITS_PIN = 14; // Type the units after the measurement
+    const uint8_t DIP_NEWLINE_PIN = 15; // Type a newline after the measurement
+#endif
 const uint8_t DIP_TAB_PIN = A0; // Type a tab after the measurement
 const uint8_t DIP_COMMA_PIN = A1; // Type a comma after the measurement
 const uint8_t DIP_SPACE_PIN = A2; // Type a space after the measurement
+const uint8_t DIP_AUTO_TRIGGER_PIN = 6; // Type the measurement by itself once it settles (not on the PCB, wire an extra switch)
 // Any of newline, tab, comma, and space can be combined to in that order
 const bool DIP_ON_STATE = LOW; // Switch is active when it is in this state
 
@@ -64,37 +127,160 @@ const uint8_t TRIGGER_PIN_INT_MODE = FALLING; // When to trigger the interrupt (
 const uint8_t DATA_LED_PIN = A3; // LED to blink when data is r * <one line to give the program's name and a brief idea of what it does.>
 const bool DATA_LED_ACTIVE_STATE = HIGH; // State to use when data LED is ON
 
-const uint8_t BUZZER_PIN = 10; // Passive buzzer to sound when data is typed (must support pwm)
+#if defined(MULTI_CALIPER)
+    const uint8_t BUZZER_PIN = 5; // Passive buzzer to sound when data is typed (must support pwm, 10 is a caliper clock)
+#else
+    const uint8_t BUZZER_PIN = 10; // Passive buzzer to sound when data is typed (must support pwm)
+#endif
 const uint16_t BUZZER_FREQ = 4000; // Hz - Frequency of buzzer
 const uint16_t BUZZER_DURATION = 10; // Milliseconds - Time to sound the buzzer for
 
+// Pins the sketch reads or drives itself, checked against the capture pins below
+constexpr int16_t SKETCH_PINS[] = {DIP_CTRL_A_PIN, DIP_UNITS_PIN, DIP_NEWLINE_PIN, DIP_TAB_PIN, DIP_COMMA_PIN, DIP_SPACE_PIN,
+                                   DIP_AUTO_TRIGGER_PIN, TRIGGER_PIN, DATA_LED_PIN, BUZZER_PIN};
+const uint8_t SKETCH_PIN_COUNT = sizeof(SKETCH_PINS) / sizeof(SKETCH_PINS[0]);
+
+#if defined(MULTI_CALIPER)
+    static_assert(!pinsOverlap(SKETCH_PINS, SKETCH_PIN_COUNT, MULTI_CLK_PINS, MULTI_CALIPER_COUNT)
+                  && !pinsOverlap(SKETCH_PINS, SKETCH_PIN_COUNT, MULTI_DATA_PINS, MULTI_CALIPER_COUNT),
+                  "A DIP switch, trigger, LED, or buzzer pin is one of the caliper pins");
+#elif defined(HARDWARE_SPI_CAPTURE)
+    static_assert(!pinsOverlap(SKETCH_PINS, SKETCH_PIN_COUNT, HARDWARE_SPI_PINS, HARDWARE_SPI_PIN_COUNT),
+                  "A DIP switch, trigger, LED, or buzzer pin is one of the hardware SPI pins");
+#elif defined(INPUT_CAPTURE)
+    static_assert(!pinInList(INPUT_CAPTURE_CLK_PIN, SKETCH_PINS, SKETCH_PIN_COUNT),
+                  "A DIP switch, trigger, LED, or buzzer pin is the input capture clock pin");
+#endif
+
+// Typing, see OutputScheduler.h
+const uint32_t OUTPUT_STALL_TIMEOUT = 1000; // Milliseconds - Give up typing a measurement when the host takes no report for this long
+
+// Settled readings
+const uint16_t STABLE_TOLERANCE = 1; // Counts - Readings within this of the middle of the stable readings are the same reading
+const uint32_t STABLE_TIME = 450; // Milliseconds - Type the mean of the readings when they have been stable this long, 0 to always type the latest
+const uint32_t AUTO_TRIGGER_SETTLE_TIME = 300; // Milliseconds - Stable time before auto trigger types the measurement, and the stable time of the reading it types
+const uint16_t AUTO_TRIGGER_REARM_CHANGE = 10; // Counts - How far the reading has to move before auto trigger types again, and how close to zero is at rest
+
+
+volatile uint8_t triggerCount = 0; // Trigger presses not yet queued in outputScheduler
+volatile uint32_t triggerTime = 0; // Microseconds - First of the presses in triggerCount
+
+// Idle sleep statistics, since the last awake trace event
+uint32_t sleepTime = 0; // Microseconds spent in idleSleep()
+uint32_t wakeCount = 0; // Times the CPU woke from sleep
+uint32_t statsStartTime = 0; // Microseconds when the statistics were reset
+
+#if defined(MULTI_CALIPER)
+    const uint8_t CALIPER_COUNT = MULTI_CALIPER_COUNT;
+#else
+    const uint8_t CALIPER_COUNT = 1;
+#endif
+
+ClockwiseCaliper calipers[CALIPER_COUNT];
+PacketFilter<FILTER_MEDIAN_SIZE> packetFilters[CALIPER_COUNT];
+ClockwiseCaliper &caliper = calipers[0]; // First caliper, used for auto trigger and the debug output
+PacketFilter<FILTER_MEDIAN_SIZE> &packetFilter = packetFilters[0];
+AutoTrigger autoTrigger;
+OutputScheduler outputScheduler;
+
+#ifdef PERF_ENABLED
+    // Typing latency, see PerfCounters.h
+    uint32_t perfTriggerTime = 0;     // Microseconds - Trigger of the sequence being typed
+    bool perfTriggerPending = false;  // The trigger's latency is counted at the first report
+    uint32_t perfFirstReportTime = 0; // Microseconds - First report of the sequence
+    uint32_t perfLastReportTime = 0;  // Microseconds - Latest report of the sequence
+    bool perfSequenceActive = false;  // Reports of the sequence are being sent
+#endif
+
+#ifdef TRACE_ENABLED
+    // Sequence being typed, for its TRACE_EVENT_TYPED
+    bool traceTyping = false;      // A sequence is being typed
+    uint16_t traceReportCount = 0; // Reports sent of the sequence
+    uint16_t traceStallCount = 0;  // outputScheduler.getStallCount() when it started
+#endif
+
+// Packet stream
+uint8_t streamSequence[CALIPER_COUNT]; // Packets of each caliper, including ones that could not be sent
+bool streamLost = false; // Packets were lost since the last frame sent
+
+#if defined(MULTI_CALIPER)
+    // MODE1, LSB first, one channel per caliper
+    PinChangeSPISlave<SSPI_MODE1, SSPI_LSB_FIRST, MULTI_CALIPER_COUNT> caliperSpi(MULTI_CLK_PINS, MULTI_DATA_PINS);
+#elif defined(HARDWARE_SPI_CAPTURE)
+    HardwareSPISlave caliperSpi(CLK_PIN, SS_GATE_PIN);
+#elif defined(INPUT_CAPTURE)
+    InputCaptureSPISlave caliperSpi(DATA_PIN);
+#else
+    // MODE1, LSB first, RX only, no slave select
+    StaticSoftSPISlave<SSPI_MODE1, SSPI_LSB_FIRST, false, true, false, DATA_SAMPLES> caliperSpi(CLK_PIN, -1, DATA_PIN, -1);
+#endif
 
-uint8_t resyncCounter = 0;
-volatile bool triggerFlag = false;
 
-ClockwiseCaliper caliper;
-SoftSPISlave softSpi(CLK_PIN, -1, DATA_PIN, -1);
+#if defined(ARDUINO_ARCH_AVR)
+    // HID-Project keeps the endpoint it was given protected, this only reads it
+    class BootKeyboardEndpoint : public BootKeyboard_ {
+    public:
+        static uint8_t get() {
+            return BootKeyboard.*(&BootKeyboardEndpoint::pluggedEndpoint);
+        }
+    };
+#endif
 
 
 void triggerIsr() {
-    triggerFlag = true;
+    if (triggerCount == 0) {
+        triggerTime = micros();
+    }
+
+    if (triggerCount < 255) {
+        triggerCount++;
+    }
+
+    TRACE_EVENT(TRACE_EVENT_TRIGGER, TRACE_TRIGGER_BUTTON, triggerCount);
 }
 
 
 void setup() {
-    #ifdef DEBUG_SERIAL
-        Serial.begin(115200);
+    #ifdef TRACE_ENABLED
+        Serial.begin(115200); // Events wait in the ring until a host opens the port
+    #endif
 
-        while (!Serial && millis() < 2000) {
-            ; // Wait for serial port to connect, or 2 seconds. Needed for native USB
-        }
+    #ifdef STREAM_SERIAL
+        Serial.begin(115200); // Nothing is sent until a host opens the port
+    #endif
+
+    #ifdef PERF_ENABLED
+        Serial.begin(115200); // Only for the dump command
+    #endif
+
+    // Frame each full caliper packet in the ISR
+    #if defined(HARDWARE_SPI_CAPTURE)
+        caliperSpi.begin(SSPI_MODE1, SSPI_LSB_FIRST, BIT_MAX_DELAY, caliper.getPacketLength() * 8);
+    #elif defined(INPUT_CAPTURE)
+        caliperSpi.begin(SSPI_MODE1, SSPI_LSB_FIRST, CAPTURE_BIT_MAX_DELAY, caliper.getPacketLength() * 8);
+    #elif defined(MULTI_CALIPER)
+        caliperSpi.begin(BIT_MAX_DELAY, caliper.getPacketLength() * 8);
+    #else
+        caliperSpi.begin(false, BIT_MAX_DELAY, caliper.getPacketLength() * 8, CLK_MIN_TIME, DATA_SAMPLE_SPACING);
     #endif
 
-    softSpi.begin(false, SSPI_MODE1, SSPI_LSB_FIRST, BIT_MAX_DELAY);
+    #ifdef PERF_ENABLED
+        perfCounters.begin(); // After the capture, which may already run Timer1
+    #endif
 
-    // Override pinMode from softSpi to enable pullups
-    pinMode(CLK_PIN, INPUT_PULLUP);
-    pinMode(DATA_PIN, INPUT_PULLUP);
+    // Override pinMode from caliperSpi to enable pullups
+    #if defined(MULTI_CALIPER)
+        for (uint8_t i = 0; i < MULTI_CALIPER_COUNT; i++) {
+            pinMode(MULTI_CLK_PINS[i], INPUT_PULLUP);
+            pinMode(MULTI_DATA_PINS[i], INPUT_PULLUP);
+        }
+    #elif defined(INPUT_CAPTURE)
+        pinMode(INPUT_CAPTURE_CLK_PIN, INPUT_PULLUP);
+        pinMode(DATA_PIN, INPUT_PULLUP);
+    #else
+        pinMode(CLK_PIN, INPUT_PULLUP);
+        pinMode(DATA_PIN, INPUT_PULLUP);
+    #endif
 
     pinMode(DIP_CTRL_A_PIN, INPUT_PULLUP);
     pinMode(DIP_UNITS_PIN, INPUT_PULLUP);
@@ -102,6 +288,7 @@ void setup() {
     pinMode(DIP_TAB_PIN, INPUT_PULLUP);
     pinMode(DIP_COMMA_PIN, INPUT_PULLUP);
     pinMode(DIP_SPACE_PIN, INPUT_PULLUP);
+    pinMode(DIP_AUTO_TRIGGER_PIN, INPUT_PULLUP);
 
     pinMode(TRIGGER_PIN, INPUT_PULLUP);
 
@@ -110,9 +297,17 @@ void setup() {
 
     digitalWrite(DATA_LED_PIN, !DATA_LED_ACTIVE_STATE);
 
+    for (uint8_t i = 0; i < CALIPER_COUNT; i++) {
+        packetFilters[i].begin(FILTER_MAX_JUMP);
+        calipers[i].getHistory().setTolerance(STABLE_TOLERANCE);
+    }
+
+    autoTrigger.begin(AUTO_TRIGGER_SETTLE_TIME, AUTO_TRIGGER_REARM_CHANGE);
+    outputScheduler.begin(OUTPUT_STALL_TIMEOUT);
+
     BootKeyboard.begin();
 
-    debug_println("Starting...");
+    TRACE_EVENT(TRACE_EVENT_BOOT, 0, 0);
 
     tone(BUZZER_PIN, BUZZER_FREQ, BUZZER_DURATION);
     delay(200);
@@ -123,102 +318,317 @@ void setup() {
 }
 
 
-void emptySoftSpiBuffer() {
-    // Empty RX buffer, we don't know which byte is which
-    while (softSpi.rxBytesAvailable() > 0) {
-        softSpi.read();
+void recievePacket(uint8_t channel, uint32_t frame) {
+    uint32_t packet = ~ frame; // Invert all bits
+
+    // Toggle so the LED blinks with each packet
+    digitalWrite(DATA_LED_PIN, !digitalRead(DATA_LED_PIN));
+
+    uint32_t rawPacket = packet;
+    uint32_t time = millis();
+
+    // Corrupted packets are dropped, the caliper keeps the previous data
+    bool accepted = packetFilters[channel].filter(packet);
+
+    if (accepted) {
+        calipers[channel].updatePacket(packet, time);
     }
+
+    PERF_PACKET(accepted);
+    TRACE_EVENT(TRACE_EVENT_PACKET, channel, (rawPacket & 0xFFFFFF) | (accepted ? 0 : TRACE_PACKET_REJECTED));
+
+    streamPacket(channel, rawPacket, time, accepted);
+}
+
+
+void streamPacket(uint8_t channel, uint32_t packet, uint32_t time, bool accepted) {
+    #ifdef STREAM_SERIAL
+        packet_stream_record_t record;
+        uint8_t frame[PACKET_STREAM_FRAME_SIZE];
+
+        record.channel = channel;
+        record.flags = (accepted ? 0 : PACKET_STREAM_FLAG_REJECTED) | (streamLost ? PACKET_STREAM_FLAG_LOST : 0);
+        record.packet = packet & 0xFFFFFF;
+        record.time = time;
+        record.sequence = streamSequence[channel]++;
+        record.resyncCount = caliperSpi.getResyncCount();
+
+        // Only while a host has the port open, and never waiting for room,
+        // so a slow host drops frames (seen as sequence gaps) instead of packets
+        if (Serial.dtr() && Serial.availableForWrite() >= PACKET_STREAM_FRAME_SIZE) {
+            PacketStream::encode(record, frame);
+            Serial.write(frame, PACKET_STREAM_FRAME_SIZE);
+            streamLost = false;
+        }
+    #else
+        // Only streamed with STREAM_SERIAL
+        (void)channel;
+        (void)packet;
+        (void)time;
+        (void)accepted;
+    #endif
 }
 
 
-void recievePacket() {
-    static uint8_t spiDataIndex = 0;
-    static uint32_t lastSpiDataTime = 0;
+bool hasWork() {
+    // Keeps running while typing, the endpoint frees up without an interrupt
+    return triggerCount > 0 || caliperSpi.rxHasData() || outputScheduler.isBusy();
+}
 
-    uint8_t spiData = ~ softSpi.read(); // Invert all bits
-    uint32_t currentTime = millis();
 
-    digitalWrite(DATA_LED_PIN, DATA_LED_ACTIVE_STATE);
+void idleSleep() {
+    #if defined(ARDUINO_ARCH_AVR) && !defined(NO_IDLE_SLEEP)
+        uint32_t startTime = micros();
 
-    if (spiDataIndex > 0 && currentTime - lastSpiDataTime >= PACKET_MAX_DELAY) {
-        // Time between packets was too long, resync
-        resyncCounter++;
-        spiDataIndex = 0;
-    }
+        // Idle keeps the timers, pin change, external and USB interrupts running
+        set_sleep_mode(SLEEP_MODE_IDLE);
 
-    caliper.updateByte(spiData, spiDataIndex);
-    spiDataIndex++;
-    lastSpiDataTime = currentTime;
+        // Checked with interrupts off, so an ISR can't add work between the check and sleeping
+        noInterrupts();
+
+        if (!hasWork()) {
+            sleep_enable();
+            interrupts(); // The instruction after sei always runs, so nothing can wake the CPU before it sleeps
+            sleep_cpu();
+            sleep_disable();
+            wakeCount++;
+        }
+
+        interrupts();
+
+        sleepTime += micros() - startTime;
+    #endif
+}
 
-    if (spiDataIndex >= caliper.getPacketLength()) {
-        // Completed packet, reset and update
-        spiDataIndex = 0;
 
-        caliper.setNewData();
-        digitalWrite(DATA_LED_PIN, !DATA_LED_ACTIVE_STATE);
+uint8_t readTypingOptions() {
+    const uint8_t pins[] = {DIP_CTRL_A_PIN, DIP_UNITS_PIN, DIP_NEWLINE_PIN, DIP_TAB_PIN, DIP_COMMA_PIN, DIP_SPACE_PIN};
+    uint8_t options = 0;
+
+    // In the order of the TYPING_* bits
+    for (uint8_t i = 0; i < sizeof(pins); i++) {
+        if (digitalRead(pins[i]) == DIP_ON_STATE) {
+            options |= 1 << i;
+        }
     }
+
+    return options;
+}
+
+
+bool keyboardEndpointFree() {
+    #if defined(ARDUINO_ARCH_AVR)
+        // USB_SendSpace() is 0 until the host has taken the previous report
+        return USBDevice.configured() && USB_SendSpace(BootKeyboardEndpoint::get()) >= sizeof(HID_KeyboardReport_Data_t);
+    #else
+        return true; // Sending may wait for the host
+    #endif
 }
 
 
-void typeIfPin(KeyboardKeycode key, uint8_t pin) {
-    if (digitalRead(pin) == DIP_ON_STATE) {
-        BootKeyboard.write(key);
+void sendReport(const key_report_t &report) {
+    // Each report holds the previous keys and presses one more, see KeySequence.h
+    BootKeyboard.removeAll();
+
+    if (report.modifier != 0) {
+        BootKeyboard.add((KeyboardKeycode)report.modifier);
+    }
+
+    for (uint8_t i = 0; i < report.keyCount; i++) {
+        BootKeyboard.add((KeyboardKeycode)report.keys[i]);
     }
+
+    BootKeyboard.send();
+}
+
+
+void queueTriggers(uint8_t count, uint32_t time, bool autoTriggered) {
+    #ifdef PERF_ENABLED
+        // Only the latency of triggers typed straight away, not ones waiting behind another sequence
+        if (count > 0 && !outputScheduler.isBusy()) {
+            perfTriggerTime = time;
+            perfTriggerPending = true;
+        }
+    #else
+        // Only timed with PERF_ENABLED
+        (void)time;
+    #endif
+
+    outputScheduler.addTriggers(count, autoTriggered);
 }
 
 
-void typeMeasurement() {
-    // CTRL + A
-    if (digitalRead(DIP_CTRL_A_PIN) == DIP_ON_STATE) {
-        BootKeyboard.press(KEY_LEFT_CTRL);
-        BootKeyboard.press(KEY_A);
-        BootKeyboard.releaseAll();
+void typeMeasurements() {
+    static const measurement_format_t format = {calipers, CALIPER_COUNT, STABLE_TIME, AUTO_TRIGGER_SETTLE_TIME, MULTI_CALIPER_SEPARATOR, readTypingOptions};
+    key_report_t report;
+
+    // Taken with interrupts off, so no press is lost between reading and clearing
+    noInterrupts();
+    uint8_t triggers = triggerCount;
+    uint32_t time = triggerTime;
+    triggerCount = 0;
+    interrupts();
+
+    queueTriggers(triggers, time, false);
+
+    // At most one report per loop, so packets are read in between
+    uint8_t typing = typeMeasurementStep(outputScheduler, format, keyboardEndpointFree(), millis(), report);
+
+    if (typing & TYPING_STARTED) {
+        tone(BUZZER_PIN, BUZZER_FREQ, BUZZER_DURATION);
+        TRACE_EVENT(TRACE_EVENT_TYPING, 0, outputScheduler.getQueuedTriggers());
+
+        #ifdef TRACE_ENABLED
+            traceTyping = true;
+            traceReportCount = 0;
+            traceStallCount = outputScheduler.getStallCount();
+        #endif
     }
 
-    // Type measurement
-    BootKeyboard.print(caliper.getMeasurement(), 4);
+    if (typing & TYPING_REPORT) {
+        sendReport(report);
 
-    // Units
-    if (digitalRead(DIP_UNITS_PIN) == DIP_ON_STATE) {
-        BootKeyboard.print(caliper.getUnitString());
+        #ifdef TRACE_ENABLED
+            traceReportCount++;
+        #endif
+
+        #ifdef PERF_ENABLED
+            perfLastReportTime = micros();
+
+            if (!perfSequenceActive) {
+                perfSequenceActive = true;
+                perfFirstReportTime = perfLastReportTime;
+            }
+
+            if (perfTriggerPending) {
+                perfTriggerPending = false;
+                perfCounters.addTriggerLatency(perfLastReportTime - perfTriggerTime);
+            }
+        #endif
     }
 
-    typeIfPin(KEY_ENTER, DIP_NEWLINE_PIN); // Newline
-    typeIfPin(KEY_TAB, DIP_TAB_PIN);       // Tab
-    typeIfPin(KEY_COMMA, DIP_COMMA_PIN);   // Comma
-    typeIfPin(KEY_SPACE, DIP_SPACE_PIN);   // Space
+    #ifdef PERF_ENABLED
+        if (perfSequenceActive && !outputScheduler.isTyping()) {
+            perfSequenceActive = false;
+            perfCounters.addSequenceDuration(perfLastReportTime - perfFirstReportTime);
+        }
+    #endif
+
+    #ifdef TRACE_ENABLED
+        if (traceTyping && !outputScheduler.isTyping()) {
+            bool stalled = outputScheduler.getStallCount() != traceStallCount;
 
-    tone(BUZZER_PIN, BUZZER_FREQ, BUZZER_DURATION);
+            traceTyping = false;
+            TRACE_EVENT(TRACE_EVENT_TYPED, 0, traceReportCount | (stalled ? TRACE_TYPED_STALLED : 0));
+        }
+    #endif
+}
+
+
+void handlePerfCommands() {
+    #ifdef PERF_ENABLED
+        while (Serial.available() > 0) {
+            int command = Serial.read();
+
+            if (command == PERF_DUMP_COMMAND) {
+                perfCounters.dump(Serial);
+
+                // Why packets were rejected
+                for (uint8_t i = 0; i < CALIPER_COUNT; i++) {
+                    Serial.print("filter_"); Serial.print(i); Serial.print("_unknown: "); Serial.println(packetFilters[i].getUnknownBitsCount());
+                    Serial.print("filter_"); Serial.print(i); Serial.print("_unit: ");    Serial.println(packetFilters[i].getUnitCount());
+                    Serial.print("filter_"); Serial.print(i); Serial.print("_spike: ");   Serial.println(packetFilters[i].getSpikeCount());
+                    Serial.print("filter_"); Serial.print(i); Serial.print("_forced: ");  Serial.println(packetFilters[i].getForcedCount());
+                }
+
+            } else if (command == PERF_CLEAR_COMMAND) {
+                perfCounters.clear();
+
+                for (uint8_t i = 0; i < CALIPER_COUNT; i++) {
+                    packetFilters[i].clearCounts();
+                }
+            }
+        }
+    #endif
+}
+
+
+void drainTrace() {
+    #ifdef TRACE_ENABLED
+        // Only while a host has the port open, the ring keeps the events until then
+        if (Serial.dtr()) {
+            traceRing.drain(Serial, micros());
+        }
+    #endif
 }
 
 
 void loop() {
-    if (softSpi.rxHasLostData()) {
-        emptySoftSpiBuffer();
-        debug_println("Lost data, buffer emptied");
+    if (caliperSpi.rxHasLostData()) {
+        // Packets are only lost whole, the remaining ones are still aligned
+        streamLost = true;
     }
 
-    while (softSpi.rxHasData()) {
-        recievePacket();
+    #if defined(MULTI_CALIPER)
+        for (uint8_t i = 0; i < CALIPER_COUNT; i++) {
+            PERF_QUEUE_DEPTH(caliperSpi.rxFramesAvailable(i));
+
+            while (caliperSpi.rxHasData(i)) {
+                recievePacket(i, caliperSpi.read(i));
+            }
+        }
+    #else
+        PERF_QUEUE_DEPTH(caliperSpi.rxFramesAvailable());
+
+        while (caliperSpi.rxHasData()) {
+            recievePacket(0, caliperSpi.read());
+        }
+    #endif
+
+    // Always maintain most recent data, the first caliper is refreshed below
+    for (uint8_t i = 1; i < CALIPER_COUNT; i++) {
+        if (calipers[i].isNewData()) {
+            calipers[i].refershData();
+        }
     }
 
     if (caliper.isNewData()) {
         // Always maintain most recent data
         caliper.refershData();
 
-        debug_print("resync: ");     debug_print(resyncCounter);            debug_print(", ");
-        debug_print("spi_resync: "); debug_print(softSpi.getResyncCount()); debug_print(", ");
+        #ifdef TRACE_ENABLED
+            uint32_t statsTime = micros() - statsStartTime;
+
+            // Time in ISRs while asleep counts as asleep. Integer math, so tracing keeps the release timing
+            uint32_t awakePermille = statsTime > 0 ? (uint64_t)(statsTime - sleepTime) * 1000 / statsTime : 1000;
+            uint32_t wakes = wakeCount < 0xFFFF ? wakeCount : 0xFFFF;
+
+            TRACE_EVENT(TRACE_EVENT_AWAKE, 0, awakePermille | (wakes << 16));
+            TRACE_EVENT(TRACE_EVENT_SETTLE, 0, caliper.getHistory().getStableTime());
 
-        debug_print("unit: "); debug_print(caliper.getUnitString());     debug_print(", ");
-        debug_print("sign: "); debug_print(caliper.getSignString());     debug_print(", ");
-        debug_print("raw: ");  debug_print(caliper.getRawMeasurement()); debug_print(", ");
+            #ifdef INPUT_CAPTURE
+                TRACE_EVENT(TRACE_EVENT_BIT_TIMING, 0, caliperSpi.getBitPeriod() | ((uint32_t)caliperSpi.getMaxBitPeriod() << 16));
+            #endif
 
-        debug_print("measurement: "); debug_print(caliper.getMeasurement(), 4); debug_println();
+            sleepTime = 0;
+            wakeCount = 0;
+            statsStartTime += statsTime;
+        #endif
+
+        if (digitalRead(DIP_AUTO_TRIGGER_PIN) == DIP_ON_STATE && autoTrigger.update(caliper)) {
+            queueTriggers(1, micros(), true);
+            TRACE_EVENT(TRACE_EVENT_TRIGGER, TRACE_TRIGGER_AUTO, 1);
+        }
     }
 
-    if (triggerFlag) {
-        triggerFlag = false;
-        typeMeasurement();
-        debug_println("Typed measurement");
+    typeMeasurements();
+    handlePerfCommands();
+
+    // Only once everything else is done, so sending never delays packets or typing
+    if (!hasWork()) {
+        drainTrace();
     }
+
+    // Until the next packet or trigger, waking up only shortly for other interrupts
+    idleSleep();
 }
\ No newline at end of file
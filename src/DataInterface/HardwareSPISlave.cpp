@@ -0,0 +1,310 @@
+/*
+ * HardwareSPISlave.cpp - Frame Receiver Using the Hardware SPI Peripheral
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "HardwareSPISlave.h"
+
+#if defined(SPDR) // Only for boards with an AVR SPI peripheral
+
+
+HardwareSPISlave *HardwareSPISlave::instance = nullptr;
+
+
+/**
+ * Hardware SPI frame receiver constructor.
+ * The CLK pin must be an interrupt capable pin, wired to the same signal
+ * as the hardware SCK pin. The SS gate pin is driven as an output and
+ * must be wired to the hardware SS pin.
+ *
+ * @param clkPin serial clock pin
+ * @param ssGatePin pin driving the hardware slave select input
+ */
+HardwareSPISlave::HardwareSPISlave(int16_t clkPin,
+                                   int16_t ssGatePin) {
+    this->clkPin = clkPin;
+    this->ssGatePin = ssGatePin;
+
+    this->lastClkTime = 0;
+    this->byteIndex = 0;
+    this->rxData = 0;
+    this->resyncCount = 0;
+    this->rxDataLost = false;
+}
+
+
+/**
+ * Starts receiving data on the SPI bus.
+ * maxClkTime defines the maximum time between bytes in the middle of a
+ * frame. If the time elapses, the current frame is dropped and the next
+ * frame is waited for. A new frame is only started on a clock edge that
+ * comes after at least maxClkTime of idle clock.
+ * There can only be one HardwareSPISlave running at a time.
+ *
+ * @param spiMode the SPI clock polarity and phase to use, must be MODE1 or MODE3
+ * @param spiDataOrder whether the LSB or MSB is first
+ * @param maxClkTime milliseconds to wait for another byte before
+ *                   resetting. A value of 0 disables this
+ * @param frameLength bits in each received frame, a multiple of 8 up to 32
+ */
+void HardwareSPISlave::begin(softspi_mode_t spiMode,
+                             softspi_data_order_t spiDataOrder,
+                             uint32_t maxClkTime,
+                             uint8_t frameLength) {
+    bool spiCPHA = spiMode & 0b01;
+    bool spiCPOL = spiMode & 0b10;
+
+    if (!spiCPHA // Would miss the first bit, see the header
+            || digitalPinToInterrupt(this->clkPin) < 0 // CLK pin is not set, or not an interrupt capable pin
+            || this->ssGatePin < 0
+            || frameLength < 8 || frameLength > 32 || frameLength % 8 != 0) {
+        return;
+    }
+
+    HardwareSPISlave::instance = this;
+
+    this->spiDataOrder = spiDataOrder;
+    this->clkIntMode = spiCPOL ? FALLING : RISING;
+    this->maxClkTime = maxClkTime;
+    this->frameBytes = frameLength / 8;
+
+    this->ssGatePinReg = SoftSPIPin::resolve(this->ssGatePin);
+
+    pinMode(this->clkPin, INPUT);
+    // Pulled up, the level shifters only pull the lines LOW
+    pinMode(SCK, INPUT_PULLUP);
+    pinMode(MOSI, INPUT_PULLUP);
+    pinMode(SS, INPUT);
+
+    // Start deselected
+    digitalWrite(this->ssGatePin, HIGH);
+    pinMode(this->ssGatePin, OUTPUT);
+
+    // Slave mode, with the transfer complete interrupt enabled
+    SPCR = _BV(SPE)
+         | _BV(SPIE)
+         | (spiDataOrder == SSPI_LSB_FIRST ? _BV(DORD) : 0)
+         | (spiCPOL ? _BV(CPOL) : 0)
+         | _BV(CPHA);
+
+    noInterrupts();
+    // Started part way through a frame the first frame is only selected
+    // after maxClkTime without a clock edge, like after a resync
+    this->lastClkTime = millis();
+    this->deselect();
+    interrupts();
+}
+
+/**
+ * Stops receiving data on the SPI bus.
+ */
+void HardwareSPISlave::end() {
+    detachInterrupt(digitalPinToInterrupt(this->clkPin));
+
+    SPCR = 0;
+
+    pinMode(this->ssGatePin, INPUT);
+
+    HardwareSPISlave::instance = nullptr;
+}
+
+
+/**
+ * Returns the number of frames that can be read.
+ *
+ * @return the number of frames that can be read
+ */
+uint8_t HardwareSPISlave::rxFramesAvailable() {
+    return this->rxBuff.size();
+}
+
+/**
+ * Returns the remaining number of frames that can be received before
+ * data is lost.
+ *
+ * @return the remaining space in the RX buffer
+ */
+uint8_t HardwareSPISlave::rxFramesRemaining() {
+    return this->rxBuff.available();
+}
+
+/**
+ * Returns true if data is available to be read.
+ *
+ * @return true if data is available to be read
+ */
+bool HardwareSPISlave::rxHasData() {
+    return !this->rxBuff.isEmpty();
+}
+
+/**
+ * Returns true if data has been lost since the last time this was
+ * called. Frames are only ever lost whole, so the frames that remain
+ * are still aligned.
+ *
+ * @return true if data has been lost
+ */
+bool HardwareSPISlave::rxHasLostData() {
+    bool retVal = this->rxDataLost;
+
+    this->rxDataLost = false;
+
+    return retVal;
+}
+
+/**
+ * Reads a frame from the receive buffer.
+ * The first received byte is the most significant byte of the frame when
+ * MSB first, or the least significant byte when LSB first.
+ *
+ * @return a frame from the receive buffer, or 0 if it is empty
+ */
+uint32_t HardwareSPISlave::read() {
+    uint32_t frame = 0;
+
+    this->rxBuff.pop(frame);
+
+    return frame;
+}
+
+/**
+ * Reads a frame from the receive buffer without removing it.
+ *
+ * @return a frame from the receive buffer
+ */
+uint32_t HardwareSPISlave::peek() {
+    return this->rxBuff.peek();
+}
+
+/**
+ * Returns the count of timeouts due to maxClkTime.
+ * NOTE: the count wraps at 255.
+ *
+ * @return the count of timeouts due to maxClkTime
+ */
+uint8_t HardwareSPISlave::getResyncCount() {
+    return this->resyncCount;
+}
+
+
+/**
+ * Interrupt Service Routine ran when the SPI peripheral has received a byte.
+ * Adds the byte to the current frame, and deselects the peripheral once
+ * the frame is complete.
+ */
+void HardwareSPISlave::spiIsr() {
+    PERF_ISR_TIMER();
+
+    uint8_t rxByte = SPDR;
+    uint32_t currentTime = SoftSPIPin::isrMillis();
+
+    // Bits were missed somewhere in this frame, the peripheral is out of
+    // alignment. Drop the frame and wait for the clock to go idle
+    if (this->maxClkTime > 0 && currentTime - this->lastClkTime > this->maxClkTime) {
+        this->resyncCount++;
+        PERF_RESYNC(PERF_RESYNC_CLOCK_GAP);
+        TRACE_RESYNC(PERF_RESYNC_CLOCK_GAP);
+
+        // The clock is still running, the next frame is only selected
+        // after maxClkTime without an edge from now. The clock interrupt
+        // flag may already be pending when it is attached again
+        this->lastClkTime = currentTime;
+        this->deselect();
+        return;
+    }
+
+    this->lastClkTime = currentTime;
+
+    if (this->spiDataOrder == SSPI_MSB_FIRST) {
+        this->rxData = (this->rxData << 8) | rxByte;
+    } else {
+        this->rxData |= (uint32_t)rxByte << (this->byteIndex * 8);
+    }
+
+    this->byteIndex++;
+
+    if (this->byteIndex >= this->frameBytes) {
+        // .push() returns false if the buffer was full
+        if (!this->rxBuff.push(this->rxData)) {
+            this->rxDataLost = true;
+            PERF_LOST_FRAME();
+            TRACE_LOST_FRAME();
+        }
+
+        this->deselect();
+    }
+}
+
+/**
+ * Interrupt Service Routine ran on the leading clock edge while waiting for a frame.
+ * Selects the peripheral if the clock has been idle long enough for this
+ * to be the first edge of a frame.
+ */
+void HardwareSPISlave::clkIsr() {
+    PERF_ISR_TIMER();
+
+    uint32_t currentTime = SoftSPIPin::isrMillis();
+    bool idle = currentTime - this->lastClkTime > this->maxClkTime;
+
+    this->lastClkTime = currentTime;
+
+    if (this->maxClkTime == 0 || idle) {
+        this->select();
+    }
+}
+
+/**
+ * Passes the clock interrupt to instance.
+ * The interrupt is attached and detached once per frame, so a static
+ * function is used instead of allocating a BindArg gate each time.
+ */
+void HardwareSPISlave::clkIsrGate() {
+    HardwareSPISlave::instance->clkIsr();
+}
+
+
+/**
+ * Selects the SPI peripheral for a new frame.
+ * The clock interrupt is no longer needed until the frame is complete.
+ */
+void HardwareSPISlave::select() {
+    detachInterrupt(digitalPinToInterrupt(this->clkPin));
+
+    this->byteIndex = 0;
+    this->rxData = 0;
+
+    SoftSPIPin::write(this->ssGatePinReg, LOW);
+}
+
+/**
+ * Deselects the SPI peripheral and waits for the next frame.
+ * Deselecting resets the bit counter of the peripheral.
+ */
+void HardwareSPISlave::deselect() {
+    SoftSPIPin::write(this->ssGatePinReg, HIGH);
+
+    attachInterrupt(digitalPinToInterrupt(this->clkPin), HardwareSPISlave::clkIsrGate, this->clkIntMode);
+}
+
+
+#if defined(HARDWARE_SPI_CAPTURE)
+ISR(SPI_STC_vect) {
+    HardwareSPISlave::instance->spiIsr();
+}
+#endif
+
+#endif // SPDR
@@ -0,0 +1,116 @@
+/*
+ * HardwareSPISlave.h - Frame Receiver Using the Hardware SPI Peripheral (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Receives the same frames as StaticSoftSPISlave, but the bits are shifted
+// in by the SPI peripheral, so there is one interrupt per byte instead of
+// one per clock edge.
+//
+// The master does not drive slave select, so the hardware SS input is
+// driven from another output pin (the SS gate). The clock is also wired to
+// an external interrupt pin, which selects the peripheral on the first
+// clock edge of a frame. The peripheral is deselected again after the
+// last byte, which resets its bit counter so every frame starts aligned.
+//
+// Wiring (ATmega32U4 / ATmega328P):
+//   - Clock to the hardware SCK pin and to clkPin (interrupt capable).
+//   - Data to the hardware MOSI pin.
+//   - ssGatePin to the hardware SS pin.
+// SCK and MOSI are pulled up in begin(), like the sketch pulls up CLK_PIN
+// and DATA_PIN, as the level shifters only pull the lines LOW.
+// On the ATmega32U4 SCK, MOSI, MISO, and SS are digital pins 15, 16, 14,
+// and 17. The default sketch wiring has the DIP switches on 14 to 16, which
+// would short them to the caliper lines, so with HARDWARE_SPI_CAPTURE the
+// sketch moves them and checks that none of its pins is an SPI pin.
+//
+// The SPI interrupt vector is only defined when HARDWARE_SPI_CAPTURE is
+// selected in CaptureConfig.h, so it stays free for other SPI users.
+//
+// Only SPI modes with CPHA set (MODE1, MODE3) can be used, since the
+// peripheral is selected on the first clock edge and would miss the
+// first bit if it was sampled on that edge.
+
+
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "CaptureConfig.h"
+#include "PerfCounters.h"
+#include "SoftSPIFrameQueue.h"
+#include "SoftSPIPin.h"
+#include "SoftSPITypes.h"
+#include "TraceRing.h"
+
+
+#if defined(SPDR)
+    constexpr int16_t HARDWARE_SPI_PINS[] = {SCK, MOSI, MISO, SS}; // Pins taken by the SPI peripheral
+    const uint8_t HARDWARE_SPI_PIN_COUNT = sizeof(HARDWARE_SPI_PINS) / sizeof(HARDWARE_SPI_PINS[0]);
+#endif
+
+class HardwareSPISlave {
+public:
+    HardwareSPISlave(int16_t clkPin,
+                     int16_t ssGatePin);
+
+    void begin(softspi_mode_t spiMode,
+               softspi_data_order_t spiDataOrder,
+               uint32_t maxClkTime,
+               uint8_t frameLength); // Starts receiving data on the SPI bus.
+    void end();                      // Stops receiving data on the SPI bus.
+
+    // RX
+    uint8_t rxFramesAvailable(); // Returns the number of frames that can be read.
+    uint8_t rxFramesRemaining(); // Returns the remaining number of frames that can be received before data is lost.
+    bool rxHasData();            // Returns true if data is available to be read.
+    bool rxHasLostData();        // Returns true if data has been lost since the last time this was called.
+    uint32_t read();             // Reads a frame from the receive buffer.
+    uint32_t peek();             // Reads a frame from the receive buffer without removing it.
+
+    uint8_t getResyncCount(); // Returns the count of timeouts due to maxClkTime.
+
+    void spiIsr(); // Interrupt Service Routine ran when the SPI peripheral has received a byte.
+
+    static HardwareSPISlave *instance; // The instance the SPI peripheral interrupt is passed to.
+
+private:
+    int16_t clkPin;    // Serial clock, also wired to SCK.
+    int16_t ssGatePin; // Output wired to the hardware SS input.
+
+    softspi_pin_t ssGatePinReg; // Resolved SS gate pin, set in begin().
+
+    softspi_data_order_t spiDataOrder;
+    uint8_t clkIntMode; // Leading clock edge of the SPI mode.
+
+    uint32_t maxClkTime;  // Max time between clock pulses, disabled when 0.
+    uint32_t lastClkTime; // Time of the last leading clock edge or received byte.
+    uint8_t frameBytes;   // Bytes in a full frame.
+    uint8_t byteIndex;    // Bytes received in the current frame.
+    uint32_t rxData;      // Frame currently being received.
+
+    SoftSPIFrameQueue<uint32_t, RECEIVE_FRAME_BUF_SIZE> rxBuff;
+
+    volatile uint8_t resyncCount;
+    volatile bool rxDataLost;
+
+    void clkIsr(); // Interrupt Service Routine ran on the leading clock edge while waiting for a frame.
+
+    static void clkIsrGate(); // Passes the clock interrupt to instance, without allocating a new gate each frame.
+
+    void select();   // Selects the SPI peripheral for a new frame.
+    void deselect(); // Deselects the SPI peripheral and waits for the next frame.
+};
@@ -0,0 +1,373 @@
+/*
+ * InputCaptureSPISlave.cpp - Frame Receiver Using Timer1 Input Capture
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "InputCaptureSPISlave.h"
+
+#if defined(ICR1) // Only for boards with an AVR Timer1 input capture unit
+
+
+const uint8_t TIMER1_PRESCALER = 8; // 0.5 us per tick at 16 MHz
+
+
+InputCaptureSPISlave *InputCaptureSPISlave::instance = nullptr;
+
+
+/**
+ * Input capture frame receiver constructor.
+ * The clock is always the ICP1 pin, so only the data pin is given.
+ *
+ * @param dataPin master out, slave in pin
+ */
+InputCaptureSPISlave::InputCaptureSPISlave(int16_t dataPin) {
+    this->dataPin = dataPin;
+
+    this->timerHigh = 0;
+    this->edgesLost = false;
+
+    this->lastEdgeTime = 0;
+    this->frameStartTime = 0;
+    this->maxBitTicks = 0;
+    this->bitIndex = 0;
+    this->rxData = 0;
+
+    this->bitPeriod = 0;
+    this->maxBitPeriod = 0;
+    this->packetGap = 0;
+
+    this->resyncCount = 0;
+    this->rxDataLost = false;
+}
+
+
+/**
+ * Starts receiving data on the SPI bus.
+ * maxClkTime defines the maximum time to wait for the next sampling edge
+ * while in the middle of a frame. If the time elapses, the current frame
+ * is reset to the start. Setting it to a little over one bit time detects
+ * a missed bit within the next bit.
+ * There can only be one InputCaptureSPISlave running at a time.
+ *
+ * @param spiMode the SPI clock polarity and phase to use
+ * @param spiDataOrder whether the LSB or MSB is first
+ * @param maxClkTime microseconds to wait for another clock before
+ *                   resetting. A value of 0 disables this
+ * @param frameLength bits in each received frame, from 1 to 32
+ */
+void InputCaptureSPISlave::begin(softspi_mode_t spiMode,
+                                 softspi_data_order_t spiDataOrder,
+                                 uint32_t maxClkTime,
+                                 uint8_t frameLength) {
+    bool spiCPHA = spiMode & 0b01;
+    bool spiCPOL = spiMode & 0b10;
+
+    if (this->dataPin < 0 || frameLength < 1 || frameLength > 32) {
+        return;
+    }
+
+    InputCaptureSPISlave::instance = this;
+
+    this->spiDataOrder = spiDataOrder;
+    this->maxClkTicks = maxClkTime * (F_CPU / TIMER1_PRESCALER / 1000000UL);
+    this->frameLength = frameLength;
+    this->frameTopBit = (uint32_t)1 << (frameLength - 1);
+
+    this->dataPinReg = SoftSPIPin::resolve(this->dataPin);
+
+    pinMode(this->dataPin, INPUT);
+
+    #if defined(INPUT_CAPTURE_CLK_PIN)
+        pinMode(INPUT_CAPTURE_CLK_PIN, INPUT);
+    #endif
+
+    noInterrupts();
+
+    // Normal mode, noise canceler on, capture on the sampling edge
+    // Sampling when going HIGH to LOW (MODE1, MODE2)
+    TCCR1A = 0;
+    TCCR1B = _BV(ICNC1)
+           | (spiCPHA != spiCPOL ? 0 : _BV(ICES1))
+           | _BV(CS11); // Clock / 8
+    TCNT1 = 0;
+    TIFR1 = _BV(ICF1) | _BV(TOV1);
+    TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+
+    interrupts();
+}
+
+/**
+ * Stops receiving data on the SPI bus.
+ */
+void InputCaptureSPISlave::end() {
+    TIMSK1 = 0;
+    TCCR1B = 0;
+
+    InputCaptureSPISlave::instance = nullptr;
+}
+
+
+/**
+ * Returns the number of frames that can be read.
+ * Decodes any captured edges first.
+ *
+ * @return the number of frames that can be read
+ */
+uint8_t InputCaptureSPISlave::rxFramesAvailable() {
+    this->decodeEdges();
+
+    return this->rxBuff.size();
+}
+
+/**
+ * Returns the remaining number of frames that can be received before
+ * data is lost.
+ *
+ * @return the remaining space in the RX buffer
+ */
+uint8_t InputCaptureSPISlave::rxFramesRemaining() {
+    return this->rxBuff.available();
+}
+
+/**
+ * Returns true if data is available to be read.
+ * Decodes any captured edges first.
+ *
+ * @return true if data is available to be read
+ */
+bool InputCaptureSPISlave::rxHasData() {
+    this->decodeEdges();
+
+    return !this->rxBuff.isEmpty();
+}
+
+/**
+ * Returns true if data has been lost since the last time this was
+ * called. Either whole frames were dropped, or edges were dropped and
+ * the frame they were part of was discarded.
+ *
+ * @return true if data has been lost
+ */
+bool InputCaptureSPISlave::rxHasLostData() {
+    bool retVal = this->rxDataLost;
+
+    this->rxDataLost = false;
+
+    return retVal;
+}
+
+/**
+ * Reads a frame from the receive buffer.
+ * The first received bit is the most significant bit of the frame when
+ * MSB first, or the least significant bit when LSB first.
+ *
+ * @return a frame from the receive buffer, or 0 if it is empty
+ */
+uint32_t InputCaptureSPISlave::read() {
+    uint32_t frame = 0;
+
+    this->rxBuff.pop(frame);
+
+    return frame;
+}
+
+/**
+ * Reads a frame from the receive buffer without removing it.
+ *
+ * @return a frame from the receive buffer
+ */
+uint32_t InputCaptureSPISlave::peek() {
+    return this->rxBuff.peek();
+}
+
+/**
+ * Returns the count of timeouts due to maxClkTime.
+ * NOTE: the count wraps at 255.
+ *
+ * @return the count of timeouts due to maxClkTime
+ */
+uint8_t InputCaptureSPISlave::getResyncCount() {
+    return this->resyncCount;
+}
+
+
+/**
+ * Returns the average time between bits of the last frame.
+ *
+ * @return the bit period in microseconds
+ */
+uint16_t InputCaptureSPISlave::getBitPeriod() {
+    return this->bitPeriod;
+}
+
+/**
+ * Returns the longest time between two bits of the last frame.
+ * Compared to getBitPeriod() this shows how much the clock jitters.
+ *
+ * @return the longest bit period in microseconds
+ */
+uint16_t InputCaptureSPISlave::getMaxBitPeriod() {
+    return this->maxBitPeriod;
+}
+
+/**
+ * Returns the time between the last bit of the previous frame and the
+ * first bit of the last frame.
+ *
+ * @return the gap between packets in microseconds
+ */
+uint32_t InputCaptureSPISlave::getPacketGap() {
+    return this->packetGap;
+}
+
+
+/**
+ * Interrupt Service Routine ran when Timer1 captures a clock edge.
+ * Only stores the timestamp and the state of the data pin, decoding is
+ * done later from loop().
+ */
+void InputCaptureSPISlave::captureIsr() {
+    PERF_ISR_TIMER();
+
+    uint16_t low = ICR1;
+    uint16_t high = this->timerHigh;
+    bool dataState = SoftSPIPin::read(this->dataPinReg);
+
+    // The timer overflowed before this edge, but overflowIsr() has not
+    // ran yet since this interrupt has priority
+    if ((TIFR1 & _BV(TOV1)) && low < 0x8000) {
+        high++;
+    }
+
+    uint32_t edge = ((((uint32_t)high << 16) | low) << 1) | dataState;
+
+    if (!this->edgeBuff.push(edge)) {
+        this->edgesLost = true;
+    }
+}
+
+/**
+ * Interrupt Service Routine ran when Timer1 overflows.
+ * Extends the 16-bit timer to 32 bits.
+ */
+void InputCaptureSPISlave::overflowIsr() {
+    this->timerHigh++;
+}
+
+
+/**
+ * Decodes the captured edges into frames.
+ * Each edge is one bit, a frame is reset whenever the time between two
+ * edges is longer than maxClkTime.
+ */
+void InputCaptureSPISlave::decodeEdges() {
+    uint32_t edge;
+
+    if (this->edgesLost) {
+        // Don't know which bits are missing, start over
+        this->edgesLost = false;
+        this->rxDataLost = true;
+        PERF_RESYNC(PERF_RESYNC_EDGES_LOST);
+        TRACE_RESYNC(PERF_RESYNC_EDGES_LOST);
+        this->bitIndex = 0;
+        this->rxData = 0;
+    }
+
+    while (this->edgeBuff.pop(edge)) {
+        uint32_t edgeTime = edge >> 1;
+        bool dataState = edge & 1;
+
+        // Timestamps are 31 bits, keep the difference in 31 bits
+        uint32_t delta = (edgeTime - this->lastEdgeTime) & 0x7FFFFFFF;
+
+        this->lastEdgeTime = edgeTime;
+
+        // Reset if the time between clock pulses was too long
+        if (this->bitIndex > 0 && this->maxClkTicks > 0 && delta > this->maxClkTicks) {
+            this->bitIndex = 0;
+            this->rxData = 0;
+            this->resyncCount++;
+            PERF_RESYNC(PERF_RESYNC_CLOCK_GAP);
+            TRACE_RESYNC(PERF_RESYNC_CLOCK_GAP);
+        }
+
+        if (this->bitIndex == 0) {
+            this->packetGap = InputCaptureSPISlave::ticksToMicros(delta);
+            this->frameStartTime = edgeTime;
+            this->maxBitTicks = 0;
+
+        } else if (delta > this->maxBitTicks) {
+            this->maxBitTicks = delta;
+        }
+
+        // Shift the frame along one bit, see StaticSoftSPISlave::clkIsr()
+        if (this->spiDataOrder == SSPI_MSB_FIRST) {
+            this->rxData = (this->rxData << 1) | dataState;
+
+        } else {
+            this->rxData >>= 1;
+
+            if (dataState) {
+                this->rxData |= this->frameTopBit;
+            }
+        }
+
+        this->bitIndex++;
+
+        if (this->bitIndex >= this->frameLength) {
+            if (this->frameLength > 1) {
+                uint32_t frameTicks = (edgeTime - this->frameStartTime) & 0x7FFFFFFF;
+
+                this->bitPeriod = InputCaptureSPISlave::ticksToMicros(frameTicks / (this->frameLength - 1));
+                this->maxBitPeriod = InputCaptureSPISlave::ticksToMicros(this->maxBitTicks);
+            }
+
+            if (!this->rxBuff.push(this->rxData)) {
+                this->rxDataLost = true;
+                PERF_LOST_FRAME();
+                TRACE_LOST_FRAME();
+            }
+
+            this->bitIndex = 0;
+            this->rxData = 0;
+        }
+    }
+}
+
+
+/**
+ * Converts Timer1 ticks to microseconds.
+ *
+ * @param ticks Timer1 ticks
+ * @return microseconds
+ */
+uint32_t InputCaptureSPISlave::ticksToMicros(uint32_t ticks) {
+    return ticks / (F_CPU / TIMER1_PRESCALER / 1000000UL);
+}
+
+
+#if defined(INPUT_CAPTURE)
+ISR(TIMER1_CAPT_vect) {
+    InputCaptureSPISlave::instance->captureIsr();
+}
+
+ISR(TIMER1_OVF_vect) {
+    InputCaptureSPISlave::instance->overflowIsr();
+}
+#endif
+
+#endif // ICR1
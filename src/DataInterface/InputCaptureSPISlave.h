@@ -0,0 +1,123 @@
+/*
+ * InputCaptureSPISlave.h - Frame Receiver Using Timer1 Input Capture (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Receives the same frames as StaticSoftSPISlave, but every sampling clock
+// edge is timestamped by the Timer1 input capture unit with sub microsecond
+// resolution. The capture ISR only stores the timestamp and data bit in a
+// ring, the bits are decoded into frames in loop().
+//
+// Since the clock gap is measured in microseconds instead of milliseconds,
+// a missed bit is detected within about one bit time, and the bit period
+// and gap between packets of the last frame can be read back.
+//
+// The clock must be wired to the ICP1 pin (digital pin 4 on the ATmega32U4,
+// digital pin 8 on the ATmega328P). Timer1 is used exclusively, so PWM on
+// the Timer1 pins is not available.
+//
+// The Timer1 interrupt vectors are only defined when INPUT_CAPTURE is
+// selected in CaptureConfig.h, so other Timer1 users (Servo, TimerOne)
+// still link in the other builds.
+
+
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "CaptureConfig.h"
+#include "PerfCounters.h"
+#include "SoftSPIFrameQueue.h"
+#include "SoftSPIPin.h"
+#include "SoftSPITypes.h"
+#include "TraceRing.h"
+
+
+const uint8_t CAPTURE_EDGE_BUF_SIZE = 32; // Must be a power of 2
+
+#if defined(__AVR_ATmega32U4__)
+    const uint8_t INPUT_CAPTURE_CLK_PIN = 4; // ICP1, the clock has to be wired here
+#elif defined(__AVR_ATmega328P__)
+    const uint8_t INPUT_CAPTURE_CLK_PIN = 8; // ICP1, the clock has to be wired here
+#endif
+
+
+class InputCaptureSPISlave {
+public:
+    InputCaptureSPISlave(int16_t dataPin);
+
+    void begin(softspi_mode_t spiMode,
+               softspi_data_order_t spiDataOrder,
+               uint32_t maxClkTime,
+               uint8_t frameLength); // Starts receiving data on the SPI bus.
+    void end();                      // Stops receiving data on the SPI bus.
+
+    // RX
+    uint8_t rxFramesAvailable(); // Returns the number of frames that can be read.
+    uint8_t rxFramesRemaining(); // Returns the remaining number of frames that can be received before data is lost.
+    bool rxHasData();            // Returns true if data is available to be read.
+    bool rxHasLostData();        // Returns true if data has been lost since the last time this was called.
+    uint32_t read();             // Reads a frame from the receive buffer.
+    uint32_t peek();             // Reads a frame from the receive buffer without removing it.
+
+    uint8_t getResyncCount(); // Returns the count of timeouts due to maxClkTime.
+
+    // Timing of the last received frame
+    uint16_t getBitPeriod();    // Returns the average time between bits in microseconds.
+    uint16_t getMaxBitPeriod(); // Returns the longest time between bits in microseconds.
+    uint32_t getPacketGap();    // Returns the time between the previous frame and the first bit in microseconds.
+
+    void captureIsr();  // Interrupt Service Routine ran when Timer1 captures a clock edge.
+    void overflowIsr(); // Interrupt Service Routine ran when Timer1 overflows.
+
+    static InputCaptureSPISlave *instance; // The instance the Timer1 interrupts are passed to.
+
+private:
+    int16_t dataPin; // Serial data slave in.
+
+    softspi_pin_t dataPinReg; // Resolved data pin, set in begin().
+
+    softspi_data_order_t spiDataOrder;
+
+    uint32_t maxClkTicks;  // Max time between clock pulses in timer ticks, disabled when 0.
+    uint8_t frameLength;   // Bits in a full frame.
+    uint32_t frameTopBit;  // Bit the first received bit ends up in when LSB first.
+
+    // Capture side, written from the ISRs
+    volatile uint16_t timerHigh; // Upper 16 bits of the 32-bit timestamp, counted by overflowIsr().
+    volatile bool edgesLost;     // The edge buffer was full when an edge was captured.
+    SoftSPIFrameQueue<uint32_t, CAPTURE_EDGE_BUF_SIZE> edgeBuff; // Timestamp << 1 | data bit of each sampling edge.
+
+    // Decode side, only used from loop()
+    uint32_t lastEdgeTime;   // Timestamp of the previous decoded edge.
+    uint32_t frameStartTime; // Timestamp of the first bit of the current frame.
+    uint32_t maxBitTicks;    // Longest time between bits of the current frame.
+    uint8_t bitIndex;        // Bits received in the current frame.
+    uint32_t rxData;         // Frame currently being received.
+
+    uint16_t bitPeriod;    // Average bit period of the last frame in microseconds.
+    uint16_t maxBitPeriod; // Longest bit period of the last frame in microseconds.
+    uint32_t packetGap;    // Gap before the last frame in microseconds.
+
+    SoftSPIFrameQueue<uint32_t, RECEIVE_FRAME_BUF_SIZE> rxBuff;
+
+    uint8_t resyncCount;
+    bool rxDataLost;
+
+    void decodeEdges(); // Decodes the captured edges into frames.
+
+    static uint32_t ticksToMicros(uint32_t ticks); // Converts Timer1 ticks to microseconds.
+};
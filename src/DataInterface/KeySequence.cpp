@@ -0,0 +1,187 @@
+/*
+ * KeySequence.cpp - Keystrokes Packed Into Keyboard Reports
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "KeySequence.h"
+
+
+/**
+ * Key sequence constructor.
+ */
+KeySequence::KeySequence() {
+    this->clear();
+}
+
+
+/**
+ * Removes all keys from the sequence.
+ */
+void KeySequence::clear() {
+    this->length = 0;
+
+    this->rewind();
+}
+
+
+/**
+ * Adds a key to the end of the sequence.
+ *
+ * @param key usage ID of the key
+ * @param modifier usage ID of a modifier key to hold with it, 0 for none
+ * @return false if the sequence is full
+ */
+bool KeySequence::add(uint8_t key, uint8_t modifier) {
+    if (this->length >= KEY_SEQUENCE_SIZE) {
+        return false;
+    }
+
+    this->keys[this->length] = key;
+    this->modifiers[this->length] = modifier;
+    this->length++;
+
+    return true;
+}
+
+/**
+ * Adds the keys to type text to the end of the sequence.
+ * Only the characters of a measurement, lowercase letters, and
+ * whitespace are supported, since none of them need shift.
+ *
+ * @param text C string to type
+ * @return false if the sequence is full or a character is not supported,
+ *         the keys up to it are still added
+ */
+bool KeySequence::addText(const char *text) {
+    for (; *text != '\0'; text++) {
+        uint8_t key = KeySequence::charToKey(*text);
+
+        if (key == 0 || !this->add(key)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * Returns the number of keys in the sequence.
+ *
+ * @return the number of keys in the sequence
+ */
+uint8_t KeySequence::getLength() {
+    return this->length;
+}
+
+
+/**
+ * Starts generating reports from the first key again.
+ */
+void KeySequence::rewind() {
+    this->groupStart = 0;
+    this->nextKey = 0;
+}
+
+/**
+ * Generates the next report to send.
+ * Each report presses one more key while holding the earlier keys of the
+ * group, until the group has to be released. The last report always
+ * releases everything.
+ *
+ * @param report set to the report to send
+ * @return false when there are no more reports
+ */
+bool KeySequence::nextReport(key_report_t &report) {
+    uint8_t held = this->nextKey - this->groupStart;
+    bool canPress = this->nextKey < this->length && held < KEY_REPORT_KEYS;
+
+    if (canPress && held > 0) {
+        uint8_t key = this->keys[this->nextKey];
+
+        // A modifier change or repeated key needs a release first
+        canPress = this->modifiers[this->nextKey] == this->modifiers[this->groupStart];
+
+        for (uint8_t i = this->groupStart; canPress && i < this->nextKey; i++) {
+            canPress = this->keys[i] != key;
+        }
+    }
+
+    if (canPress) {
+        this->nextKey++;
+        held++;
+
+    } else if (held > 0) {
+        this->groupStart = this->nextKey;
+        held = 0;
+
+    } else {
+        return false; // All keys typed and released
+    }
+
+    report.modifier = held > 0 ? this->modifiers[this->groupStart] : 0;
+    report.keyCount = held;
+
+    for (uint8_t i = 0; i < held; i++) {
+        report.keys[i] = this->keys[this->groupStart + i];
+    }
+
+    return true;
+}
+
+
+/**
+ * Returns the usage ID to type c.
+ *
+ * @param c character to type
+ * @return the usage ID of the key, or 0 if it can't be typed without shift
+ */
+uint8_t KeySequence::charToKey(char c) {
+    if (c >= 'a' && c <= 'z') {
+        return KEY_USAGE_A + (c - 'a');
+    }
+
+    if (c >= '1' && c <= '9') {
+        return KEY_USAGE_1 + (c - '1');
+    }
+
+    switch (c) {
+        case '0':
+            return KEY_USAGE_0;
+
+        case '\n':
+            return KEY_USAGE_ENTER;
+
+        case '\t':
+            return KEY_USAGE_TAB;
+
+        case ' ':
+            return KEY_USAGE_SPACE;
+
+        case '-':
+            return KEY_USAGE_MINUS;
+
+        case ',':
+            return KEY_USAGE_COMMA;
+
+        case '.':
+            return KEY_USAGE_PERIOD;
+
+        default:
+            return 0;
+    }
+}
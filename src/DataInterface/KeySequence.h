@@ -0,0 +1,87 @@
+/*
+ * KeySequence.h - Keystrokes Packed Into Keyboard Reports (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Typing each character with its own press and release report takes two
+// USB polling intervals per character. Instead, keys are pressed one after
+// another without releasing in between (rollover), so the host still sees
+// them go down in order, and everything is released once per group:
+//
+//   "12.3"  ->  {1} {1,2} {1,2,.} {1,2,.,3} {}
+//
+// A group ends when the 6 key boot report is full, when a key would repeat
+// (it has to be released to be typed again), or when the modifier changes.
+// Typing n keys takes n + groups reports instead of 2n.
+//
+// Keys are HID usage IDs, so this has no HID-Project dependency and can be
+// used by the host tools.
+
+
+#pragma once
+
+#include <stdint.h>
+
+
+const uint8_t KEY_SEQUENCE_SIZE = 64; // Keys in a sequence, enough for CTRL+A, 4 measurements with units and separators, and all suffixes
+const uint8_t KEY_REPORT_KEYS = 6;    // Keys in a boot keyboard report
+
+// HID usage IDs used by addText() and MeasurementTyping.cpp
+const uint8_t KEY_USAGE_A = 0x04;
+const uint8_t KEY_USAGE_1 = 0x1E;
+const uint8_t KEY_USAGE_0 = 0x27;
+const uint8_t KEY_USAGE_ENTER = 0x28;
+const uint8_t KEY_USAGE_TAB = 0x2B;
+const uint8_t KEY_USAGE_SPACE = 0x2C;
+const uint8_t KEY_USAGE_MINUS = 0x2D;
+const uint8_t KEY_USAGE_COMMA = 0x36;
+const uint8_t KEY_USAGE_PERIOD = 0x37;
+const uint8_t KEY_USAGE_LEFT_CTRL = 0xE0;
+
+/**
+ * One keyboard report, the keys held down at the same time.
+ */
+typedef struct {
+    uint8_t modifier;              // Modifier key usage ID held with the keys, 0 for none
+    uint8_t keys[KEY_REPORT_KEYS]; // Key usage IDs in the order they were pressed
+    uint8_t keyCount;              // Keys held, 0 releases everything
+} key_report_t;
+
+
+class KeySequence {
+public:
+    KeySequence();
+
+    void clear(); // Removes all keys from the sequence.
+
+    bool add(uint8_t key, uint8_t modifier = 0); // Adds a key to the end of the sequence.
+    bool addText(const char *text);              // Adds the keys to type text to the end of the sequence.
+
+    uint8_t getLength(); // Returns the number of keys in the sequence.
+
+    void rewind();                         // Starts generating reports from the first key again.
+    bool nextReport(key_report_t &report); // Generates the next report to send.
+
+private:
+    uint8_t keys[KEY_SEQUENCE_SIZE];      // Key usage IDs
+    uint8_t modifiers[KEY_SEQUENCE_SIZE]; // Modifier usage ID for each key
+    uint8_t length;
+
+    uint8_t groupStart; // First key held down.
+    uint8_t nextKey;    // Next key to press.
+
+    static uint8_t charToKey(char c); // Returns the usage ID to type c, or 0 if there is none.
+};
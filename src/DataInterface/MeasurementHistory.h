@@ -0,0 +1,333 @@
+/*
+ * MeasurementHistory.h - Timestamped Measurement History With Running Statistics
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Keeps the last Size packets with the time they were received, and
+// updates statistics with every packet without looking back through the
+// history:
+//   - the sum and sum of squares of the values of the packets kept, so the
+//     mean and variance of the window are read without a pass over it.
+//     The packet that falls out of the window is subtracted again. Adding
+//     a packet is integer only, so no soft-float runs per packet on AVR.
+//     The min and max are not kept up to date: getMin() and getMax() look
+//     through the kept packets, O(Size) on every read instead of O(1).
+//     Nothing reads them per packet.
+//   - the stable run, the packets since the values last spread more than
+//     2 * tolerance counts (within +/- tolerance of their middle). A value
+//     outside of that starts a new run with just itself.
+//
+// Values are signed measurements in the caliper's own steps, decoded from
+// the packets, so the caller clears the history when the unit changes.
+
+
+#pragma once
+
+#include <stdint.h>
+#include "CaliperPacket.h"
+
+
+/**
+ * A packet and the time it was received.
+ */
+typedef struct {
+    uint32_t time;   // Milliseconds
+    uint32_t packet; // 24-bit packet
+} measurement_record_t;
+
+
+template <uint8_t Size>
+class MeasurementHistory {
+    static_assert(Size > 0 && Size <= 128 && (Size & (Size - 1)) == 0, "Size must be a power of 2, up to 128");
+
+public:
+    MeasurementHistory();
+
+    void clear(); // Removes all packets and clears the statistics.
+
+    void add(uint32_t packet, uint32_t time); // Adds a packet and updates the statistics.
+
+    uint8_t getCount();                             // Returns the number of packets kept.
+    measurement_record_t getRecord(uint8_t index); // Returns a kept packet, 0 is the newest.
+
+    void setTolerance(uint16_t tolerance); // Sets how many counts the stable run may vary from its middle.
+
+    int32_t getMin();          // Returns the smallest value of the packets kept, O(Size).
+    int32_t getMax();          // Returns the largest value of the packets kept, O(Size).
+    int64_t getSum();          // Returns the sum of the values of the packets kept.
+    float getMean();           // Returns the mean of the values of the packets kept.
+    float getVariance();       // Returns the population variance of the values of the packets kept.
+
+    uint32_t getStableTime();  // Returns the milliseconds between the first and newest packet of the stable run.
+    uint32_t getStableCount(); // Returns the number of packets in the stable run.
+    int32_t getStableValue();  // Returns the mean of the stable run, rounded to the nearest count.
+
+private:
+    measurement_record_t records[Size];
+    uint8_t head;  // Free running count of added packets.
+    uint8_t count; // Packets kept, up to Size.
+
+    uint16_t tolerance;
+
+    // Of the packets kept, 64 bits hold Size values of up to 2^23 squared
+    int64_t sum;
+    int64_t sumOfSquares;
+
+    // Stable run
+    uint32_t stableStart; // Time of the first packet
+    uint32_t stableEnd;   // Time of the newest packet
+    uint32_t stableCount;
+    int32_t stableMin;
+    int32_t stableMax;
+    int64_t stableSum;
+
+    static constexpr uint8_t INDEX_MASK = Size - 1;
+};
+
+
+/**
+ * Measurement history constructor.
+ */
+template <uint8_t Size>
+MeasurementHistory<Size>::MeasurementHistory() {
+    this->tolerance = 0;
+    this->clear();
+}
+
+
+/**
+ * Removes all packets and clears the statistics and the stable run.
+ */
+template <uint8_t Size>
+void MeasurementHistory<Size>::clear() {
+    this->head = 0;
+    this->count = 0;
+
+    this->sum = 0;
+    this->sumOfSquares = 0;
+
+    this->stableStart = 0;
+    this->stableEnd = 0;
+    this->stableCount = 0;
+    this->stableMin = 0;
+    this->stableMax = 0;
+    this->stableSum = 0;
+}
+
+
+/**
+ * Adds a packet and updates the statistics.
+ * The oldest packet is overwritten once Size packets are kept, and taken
+ * out of the statistics.
+ *
+ * @param packet 24-bit packet
+ * @param time milliseconds when the packet was received
+ */
+template <uint8_t Size>
+void MeasurementHistory<Size>::add(uint32_t packet, uint32_t time) {
+    measurement_record_t &record = this->records[this->head & INDEX_MASK];
+    int32_t value = caliperPacketValue(packet);
+
+    if (this->count < Size) {
+        this->count++;
+    } else {
+        int32_t oldValue = caliperPacketValue(record.packet);
+
+        this->sum -= oldValue;
+        this->sumOfSquares -= (int64_t)oldValue * oldValue;
+    }
+
+    record.time = time;
+    record.packet = packet;
+    this->head++;
+
+    // Statistics
+    this->sum += value;
+    this->sumOfSquares += (int64_t)value * value;
+
+    // Stable run, restarted when value spreads it too far
+    int32_t runMin = value < this->stableMin ? value : this->stableMin;
+    int32_t runMax = value > this->stableMax ? value : this->stableMax;
+
+    if (this->stableCount == 0 || (uint32_t)(runMax - runMin) > 2 * (uint32_t)this->tolerance) {
+        this->stableStart = time;
+        this->stableCount = 0;
+        this->stableSum = 0;
+        runMin = value;
+        runMax = value;
+    }
+
+    this->stableEnd = time;
+    this->stableCount++;
+    this->stableSum += value;
+    this->stableMin = runMin;
+    this->stableMax = runMax;
+}
+
+
+/**
+ * Returns the number of packets kept.
+ *
+ * @return the number of packets kept, up to Size
+ */
+template <uint8_t Size>
+uint8_t MeasurementHistory<Size>::getCount() {
+    return this->count;
+}
+
+/**
+ * Returns a kept packet.
+ * Must not be called with an index of getCount() or more.
+ *
+ * @param index 0 for the newest packet, up to getCount() - 1 for the oldest
+ * @return the packet and the time it was received
+ */
+template <uint8_t Size>
+measurement_record_t MeasurementHistory<Size>::getRecord(uint8_t index) {
+    return this->records[(uint8_t)(this->head - 1 - index) & INDEX_MASK];
+}
+
+
+/**
+ * Sets how many counts the stable run may vary from its middle.
+ * Takes effect from the next packet.
+ *
+ * @param tolerance counts above or below the middle of the run
+ */
+template <uint8_t Size>
+void MeasurementHistory<Size>::setTolerance(uint16_t tolerance) {
+    this->tolerance = tolerance;
+}
+
+
+/**
+ * Returns the smallest value of the packets kept, looking through them.
+ *
+ * @return the smallest value, or 0 if there are none
+ */
+template <uint8_t Size>
+int32_t MeasurementHistory<Size>::getMin() {
+    int32_t min = 0;
+
+    for (uint8_t i = 0; i < this->count; i++) {
+        int32_t value = caliperPacketValue(this->getRecord(i).packet);
+
+        if (i == 0 || value < min) {
+            min = value;
+        }
+    }
+
+    return min;
+}
+
+/**
+ * Returns the largest value of the packets kept, looking through them.
+ *
+ * @return the largest value, or 0 if there are none
+ */
+template <uint8_t Size>
+int32_t MeasurementHistory<Size>::getMax() {
+    int32_t max = 0;
+
+    for (uint8_t i = 0; i < this->count; i++) {
+        int32_t value = caliperPacketValue(this->getRecord(i).packet);
+
+        if (i == 0 || value > max) {
+            max = value;
+        }
+    }
+
+    return max;
+}
+
+/**
+ * Returns the sum of the values of the packets kept, for integer math on
+ * the window without getMean().
+ *
+ * @return the sum, or 0 if there are no packets
+ */
+template <uint8_t Size>
+int64_t MeasurementHistory<Size>::getSum() {
+    return this->sum;
+}
+
+/**
+ * Returns the mean of the values of the packets kept. Only the division
+ * is done in floating point.
+ *
+ * @return the mean, or 0 if there are no packets
+ */
+template <uint8_t Size>
+float MeasurementHistory<Size>::getMean() {
+    return this->count > 0 ? (float)this->sum / this->count : 0;
+}
+
+/**
+ * Returns the population variance of the values of the packets kept,
+ * (n * sum of squares - sum^2) / n^2 with the numerator in integers.
+ *
+ * @return the variance in counts squared, or 0 if there are no packets
+ */
+template <uint8_t Size>
+float MeasurementHistory<Size>::getVariance() {
+    if (this->count == 0) {
+        return 0;
+    }
+
+    int64_t numerator = this->count * this->sumOfSquares - this->sum * this->sum;
+
+    return (float)numerator / ((uint16_t)this->count * this->count);
+}
+
+
+/**
+ * Returns the milliseconds between the first and newest packet of the
+ * stable run. A reading is stable for N ms once this reaches N.
+ *
+ * @return the length of the stable run in milliseconds
+ */
+template <uint8_t Size>
+uint32_t MeasurementHistory<Size>::getStableTime() {
+    return this->stableEnd - this->stableStart;
+}
+
+/**
+ * Returns the number of packets in the stable run.
+ *
+ * @return the number of packets, 0 if the statistics were just cleared
+ */
+template <uint8_t Size>
+uint32_t MeasurementHistory<Size>::getStableCount() {
+    return this->stableCount;
+}
+
+/**
+ * Returns the mean of the stable run, rounded to the nearest count with
+ * halves rounded away from zero.
+ *
+ * @return the settled value, or 0 if there is no stable run
+ */
+template <uint8_t Size>
+int32_t MeasurementHistory<Size>::getStableValue() {
+    if (this->stableCount == 0) {
+        return 0;
+    }
+
+    int64_t half = this->stableCount / 2;
+    int64_t sum = this->stableSum < 0 ? this->stableSum - half : this->stableSum + half;
+
+    return sum / (int64_t)this->stableCount;
+}
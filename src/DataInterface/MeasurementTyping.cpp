@@ -0,0 +1,111 @@
+/*
+ * MeasurementTyping.cpp - Builds and Types the Measurement Key Sequences
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "MeasurementTyping.h"
+
+
+// Suffix keys, in the order they are typed
+static const uint8_t SUFFIX_OPTIONS[] = {TYPING_NEWLINE, TYPING_TAB, TYPING_COMMA, TYPING_SPACE};
+static const uint8_t SUFFIX_KEYS[] = {KEY_USAGE_ENTER, KEY_USAGE_TAB, KEY_USAGE_COMMA, KEY_USAGE_SPACE};
+
+
+/**
+ * Adds the keys of one row to sequence.
+ * When the stable time is set, each caliper is refreshed with its
+ * settled reading if it has one, and keeps the latest reading otherwise.
+ *
+ * @param sequence sequence to add to
+ * @param format what to type
+ * @param autoTriggered true to use format.autoStableTime instead of
+ *                      format.stableTime
+ */
+void buildMeasurementSequence(KeySequence &sequence,
+                              const measurement_format_t &format,
+                              bool autoTriggered) {
+    char measurementStr[MEASUREMENT_STR_SIZE];
+    uint8_t options = format.readOptions();
+    uint32_t stableTime = autoTriggered ? format.autoStableTime : format.stableTime;
+
+    // CTRL + A
+    if (options & TYPING_CTRL_A) {
+        sequence.add(KEY_USAGE_A, KEY_USAGE_LEFT_CTRL);
+    }
+
+    // One measurement per caliper
+    for (uint8_t i = 0; i < format.caliperCount; i++) {
+        ClockwiseCaliper &caliper = format.calipers[i];
+
+        if (i > 0) {
+            sequence.add(format.separator);
+        }
+
+        // Settled reading, or the latest one if it is still changing
+        if (stableTime > 0) {
+            caliper.refreshSettledData(stableTime);
+        }
+
+        // Measurement
+        caliper.formatMeasurement(measurementStr);
+        sequence.addText(measurementStr);
+
+        // Units
+        if (options & TYPING_UNITS) {
+            sequence.addText(caliper.getUnitString());
+        }
+    }
+
+    for (uint8_t i = 0; i < sizeof(SUFFIX_KEYS); i++) {
+        if (options & SUFFIX_OPTIONS[i]) {
+            sequence.add(SUFFIX_KEYS[i]);
+        }
+    }
+}
+
+
+/**
+ * Starts the next queued row and gets the next report to send.
+ * Called once per loop(), after the triggers are added to scheduler, so
+ * at most one report is sent per pass and packets are read in between.
+ *
+ * @param scheduler queued triggers and the row being typed
+ * @param format what to type
+ * @param endpointFree true if the host has taken the previous report
+ * @param currentTime milliseconds
+ * @param report set to the report to send when TYPING_REPORT is returned
+ * @return TYPING_STARTED if a row was started, ORed with TYPING_REPORT if
+ *         report should be sent
+ */
+uint8_t typeMeasurementStep(OutputScheduler &scheduler,
+                            const measurement_format_t &format,
+                            bool endpointFree,
+                            uint32_t currentTime,
+                            key_report_t &report) {
+    uint8_t typing = 0;
+
+    if (scheduler.startSequence(currentTime)) {
+        buildMeasurementSequence(scheduler.getSequence(), format, scheduler.isAutoTriggered());
+        typing |= TYPING_STARTED;
+    }
+
+    if (scheduler.nextReport(endpointFree, currentTime, report)) {
+        typing |= TYPING_REPORT;
+    }
+
+    return typing;
+}
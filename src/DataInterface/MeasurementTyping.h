@@ -0,0 +1,75 @@
+/*
+ * MeasurementTyping.h - Builds and Types the Measurement Key Sequences (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// The part of loop() that turns triggers into typing, without the pins or
+// USB: the sketch passes in the DIP switch reader and whether the keyboard
+// endpoint is free, and sends the report it gets back. The host tools run
+// the same code against a simulated host.
+//
+// A row is the measurement of every caliper, with the separator between
+// them, CTRL+A before the row if enabled, and the units after each
+// measurement and the suffix keys after the row if enabled.
+//
+// A row for an auto trigger is typed with the reading settled for the
+// trigger's settle time, which already waited for it, instead of waiting
+// for stableTime again.
+
+
+#pragma once
+
+#include <stdint.h>
+#include "ClockwiseCaliper.h"
+#include "KeySequence.h"
+#include "OutputScheduler.h"
+
+
+// Typing options, the DIP switches in the sketch
+const uint8_t TYPING_CTRL_A = 0x01;  // Type CTRL+A before the row
+const uint8_t TYPING_UNITS = 0x02;   // Type the units after each measurement
+const uint8_t TYPING_NEWLINE = 0x04; // Type a newline after the row
+const uint8_t TYPING_TAB = 0x08;     // Type a tab after the row
+const uint8_t TYPING_COMMA = 0x10;   // Type a comma after the row
+const uint8_t TYPING_SPACE = 0x20;   // Type a space after the row
+const uint8_t TYPING_OPTIONS = 0x40; // Number of option combinations
+
+// What typeMeasurementStep() did
+const uint8_t TYPING_STARTED = 0x01; // Started typing a row
+const uint8_t TYPING_REPORT = 0x02;  // Set the report to send
+
+/**
+ * What to type, and where it comes from.
+ */
+typedef struct {
+    ClockwiseCaliper *calipers; // Calipers of the row, with refreshed data
+    uint8_t caliperCount;
+    uint32_t stableTime;        // Milliseconds stable before the settled reading is typed, 0 to always type the latest
+    uint32_t autoStableTime;    // stableTime of rows for an auto trigger, its settle time
+    uint8_t separator;          // Key usage ID typed between the measurements of a row
+    uint8_t (*readOptions)();   // Returns the TYPING_* options, read once per row
+} measurement_format_t;
+
+
+void buildMeasurementSequence(KeySequence &sequence,
+                              const measurement_format_t &format,
+                              bool autoTriggered); // Adds the keys of one row to sequence.
+
+uint8_t typeMeasurementStep(OutputScheduler &scheduler,
+                            const measurement_format_t &format,
+                            bool endpointFree,
+                            uint32_t currentTime,
+                            key_report_t &report); // Starts the next queued row and gets the next report to send, once per loop().
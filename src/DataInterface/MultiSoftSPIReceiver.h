@@ -0,0 +1,166 @@
+/*
+ * MultiSoftSPIReceiver.h - Decodes Several Software SPI Channels on One Port
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// The CLK and DATA lines of every channel are bits of the same 8-bit
+// port. update() is given the port value each time any of the pins
+// changed, compares it to the previous value to find the clock lines that
+// had a sampling edge, and passes those channels' data bits to their own
+// SoftSPIReceiver. All of the receiver state is per channel, so the
+// channels decode independently even when their clocks change at the
+// same time.
+//
+// Like SoftSPIReceiver it has no pin or timer access, so the same
+// decoding runs in the host tools.
+
+
+#pragma once
+
+#include <stdint.h>
+#include "SoftSPIReceiver.h"
+#include "SoftSPITypes.h"
+
+
+template <softspi_data_order_t Order, uint8_t Channels>
+class MultiSoftSPIReceiver {
+    static_assert(Channels > 0 && Channels <= 4, "Channels must be 1 to 4, each one uses 2 pins of the port");
+
+public:
+    MultiSoftSPIReceiver();
+
+    void begin(bool sampleFalling,
+               const uint8_t *clkMasks,
+               const uint8_t *dataMasks,
+               uint32_t maxClkTime,
+               uint8_t frameLength,
+               uint8_t port); // Sets the pins of each channel, and resets every channel.
+
+    inline void update(uint8_t port, uint32_t currentTime); // Samples the channels whose clock had a sampling edge.
+
+    SoftSPIReceiver<Order> &channel(uint8_t index); // Returns the receiver of a channel.
+
+    uint8_t getClkMask(); // Returns the clock pins of every channel.
+
+private:
+    SoftSPIReceiver<Order> receivers[Channels];
+
+    uint8_t clkMasks[Channels];  // Bit of each channel's clock in the port
+    uint8_t dataMasks[Channels]; // Bit of each channel's data in the port
+    uint8_t clkMask;             // All clock bits
+    bool sampleFalling;          // Sample on the falling edge instead of the rising edge
+    uint8_t lastPort;            // Port value at the previous update
+};
+
+
+/**
+ * Multi channel receiver constructor.
+ */
+template <softspi_data_order_t Order, uint8_t Channels>
+MultiSoftSPIReceiver<Order, Channels>::MultiSoftSPIReceiver() {
+    for (uint8_t i = 0; i < Channels; i++) {
+        this->clkMasks[i] = 0;
+        this->dataMasks[i] = 0;
+    }
+
+    this->clkMask = 0;
+    this->sampleFalling = true;
+    this->lastPort = 0;
+}
+
+
+/**
+ * Sets the pins of each channel, and resets every channel.
+ *
+ * @param sampleFalling true to sample on the falling clock edge (MODE1,
+ *                      MODE2), false for the rising edge (MODE0, MODE3)
+ * @param clkMasks bit of each channel's clock in the port
+ * @param dataMasks bit of each channel's data in the port
+ * @param maxClkTime time to wait for another bit before resetting a
+ *                   channel's frame, see SoftSPIReceiver::begin()
+ * @param frameLength bits in each frame, from 1 to 32
+ * @param port current port value, so the first update only sees real edges
+ */
+template <softspi_data_order_t Order, uint8_t Channels>
+void MultiSoftSPIReceiver<Order, Channels>::begin(bool sampleFalling,
+                                                  const uint8_t *clkMasks,
+                                                  const uint8_t *dataMasks,
+                                                  uint32_t maxClkTime,
+                                                  uint8_t frameLength,
+                                                  uint8_t port) {
+    this->clkMask = 0;
+
+    for (uint8_t i = 0; i < Channels; i++) {
+        this->clkMasks[i] = clkMasks[i];
+        this->dataMasks[i] = dataMasks[i];
+        this->clkMask |= clkMasks[i];
+
+        this->receivers[i].begin(maxClkTime, frameLength);
+    }
+
+    this->sampleFalling = sampleFalling;
+    this->lastPort = port;
+}
+
+
+/**
+ * Samples the channels whose clock had a sampling edge since the last
+ * update. Called from interrupt context whenever any pin changes.
+ * Two edges on the same clock between updates cancel out, so updates
+ * must come at least twice per clock period.
+ *
+ * @param port current port value
+ * @param currentTime time of the change
+ */
+template <softspi_data_order_t Order, uint8_t Channels>
+inline void MultiSoftSPIReceiver<Order, Channels>::update(uint8_t port, uint32_t currentTime) {
+    uint8_t changed = (port ^ this->lastPort) & this->clkMask;
+    uint8_t edges = changed & (this->sampleFalling ? this->lastPort : port);
+
+    this->lastPort = port;
+
+    if (edges == 0) {
+        return; // Shift out edges, or a data line changed
+    }
+
+    for (uint8_t i = 0; i < Channels; i++) {
+        if (edges & this->clkMasks[i]) {
+            this->receivers[i].sample(port & this->dataMasks[i], currentTime);
+        }
+    }
+}
+
+
+/**
+ * Returns the receiver of a channel, to read its frames.
+ *
+ * @param index channel, from 0 to Channels - 1
+ * @return the receiver
+ */
+template <softspi_data_order_t Order, uint8_t Channels>
+SoftSPIReceiver<Order> &MultiSoftSPIReceiver<Order, Channels>::channel(uint8_t index) {
+    return this->receivers[index];
+}
+
+/**
+ * Returns the clock pins of every channel.
+ *
+ * @return the clock bits in the port
+ */
+template <softspi_data_order_t Order, uint8_t Channels>
+uint8_t MultiSoftSPIReceiver<Order, Channels>::getClkMask() {
+    return this->clkMask;
+}
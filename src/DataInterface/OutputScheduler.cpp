@@ -0,0 +1,226 @@
+/*
+ * OutputScheduler.cpp - Non-Blocking Typing of Queued Triggers
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "OutputScheduler.h"
+
+
+static_assert(OUTPUT_MAX_TRIGGERS <= 16, "OutputScheduler::autoTriggers has one bit per queued trigger");
+
+/**
+ * Output scheduler constructor.
+ * Defaults to never giving up on the host.
+ */
+OutputScheduler::OutputScheduler() {
+    this->droppedTriggers = 0;
+    this->stallCount = 0;
+
+    this->begin(0);
+}
+
+
+/**
+ * Sets how long to wait for the host, and clears everything queued.
+ *
+ * @param stallTimeout milliseconds without the host taking a report
+ *                     before the rest of the sequence is given up, 0 to
+ *                     wait forever
+ */
+void OutputScheduler::begin(uint32_t stallTimeout) {
+    this->stallTimeout = stallTimeout;
+    this->lastReportTime = 0;
+
+    this->queuedTriggers = 0;
+    this->autoTriggers = 0;
+    this->sequenceAuto = false;
+    this->typing = false;
+    this->hasPendingReport = false;
+    this->keysHeld = false;
+    this->releasePending = false;
+
+    this->sequence.clear();
+}
+
+
+/**
+ * Queues triggers to be typed.
+ * Beyond OUTPUT_MAX_TRIGGERS the triggers are dropped and counted.
+ *
+ * @param count number of triggers
+ * @param autoTriggered true if they come from auto trigger, not the button
+ */
+void OutputScheduler::addTriggers(uint8_t count, bool autoTriggered) {
+    uint8_t room = OUTPUT_MAX_TRIGGERS - this->queuedTriggers;
+
+    if (count > room) {
+        this->droppedTriggers += count - room;
+        count = room;
+    }
+
+    if (autoTriggered && count > 0) {
+        this->autoTriggers |= (((uint32_t)1 << count) - 1) << this->queuedTriggers;
+    }
+
+    this->queuedTriggers += count;
+}
+
+
+/**
+ * Starts typing the next queued trigger, if nothing is being typed.
+ * When this returns true, the caller fills getSequence() with the keys to
+ * type before the next call to nextReport().
+ *
+ * @param currentTime time in milliseconds
+ * @return true if a trigger was taken off the queue
+ */
+bool OutputScheduler::startSequence(uint32_t currentTime) {
+    if (this->typing || this->releasePending || this->queuedTriggers == 0) {
+        return false;
+    }
+
+    this->queuedTriggers--;
+    this->sequenceAuto = this->autoTriggers & 1;
+    this->autoTriggers >>= 1;
+    this->typing = true;
+    this->hasPendingReport = false;
+    this->lastReportTime = currentTime;
+
+    this->sequence.clear();
+
+    return true;
+}
+
+/**
+ * Returns the sequence being typed.
+ *
+ * @return the sequence
+ */
+KeySequence &OutputScheduler::getSequence() {
+    return this->sequence;
+}
+
+/**
+ * Returns true if the sequence being typed, or the last one typed, is for
+ * an auto trigger.
+ *
+ * @return true if it was auto triggered
+ */
+bool OutputScheduler::isAutoTriggered() {
+    return this->sequenceAuto;
+}
+
+
+/**
+ * Returns the next report to send, when the endpoint is free.
+ * Never waits: if the endpoint is busy, returns false and the same report
+ * is returned by a later call. Call once per loop, the caller must send
+ * the report right away.
+ *
+ * @param endpointFree true if the keyboard endpoint can take a report
+ *                     without waiting
+ * @param currentTime time in milliseconds
+ * @param report set to the report to send
+ * @return true if report should be sent
+ */
+bool OutputScheduler::nextReport(bool endpointFree, uint32_t currentTime, key_report_t &report) {
+    // Generated ahead, so typing ends as soon as the last report is sent
+    if (this->typing && !this->hasPendingReport) {
+        this->hasPendingReport = this->sequence.nextReport(this->pendingReport);
+        this->typing = this->hasPendingReport;
+    }
+
+    if (!endpointFree) {
+        if (this->typing && this->stallTimeout > 0 && currentTime - this->lastReportTime > this->stallTimeout) {
+            // Give up on the rest, keys held down still have to be released
+            this->typing = false;
+            this->hasPendingReport = false;
+            this->releasePending = this->keysHeld;
+            this->stallCount++;
+        }
+
+        return false;
+    }
+
+    if (this->releasePending) {
+        this->releasePending = false;
+        this->keysHeld = false;
+
+        report.modifier = 0;
+        report.keyCount = 0;
+
+        return true;
+    }
+
+    if (!this->typing) {
+        return false;
+    }
+
+    report = this->pendingReport;
+    this->hasPendingReport = false;
+    this->keysHeld = report.keyCount > 0;
+    this->lastReportTime = currentTime;
+
+    return true;
+}
+
+
+/**
+ * Returns true while typing, or triggers are queued.
+ *
+ * @return true if there is output left to send
+ */
+bool OutputScheduler::isBusy() {
+    return this->typing || this->releasePending || this->queuedTriggers > 0;
+}
+
+/**
+ * Returns true while a sequence has reports left to send. Becomes false
+ * on the first nextReport() call after the last report was handed over.
+ *
+ * @return true while typing
+ */
+bool OutputScheduler::isTyping() {
+    return this->typing;
+}
+
+/**
+ * Returns the number of triggers waiting to be typed.
+ *
+ * @return the number of queued triggers
+ */
+uint8_t OutputScheduler::getQueuedTriggers() {
+    return this->queuedTriggers;
+}
+
+/**
+ * Returns the count of triggers dropped because the queue was full.
+ *
+ * @return the count of dropped triggers
+ */
+uint16_t OutputScheduler::getDroppedTriggers() {
+    return this->droppedTriggers;
+}
+
+/**
+ * Returns the count of sequences given up because the host stalled.
+ *
+ * @return the count of stalled sequences
+ */
+uint16_t OutputScheduler::getStallCount() {
+    return this->stallCount;
+}
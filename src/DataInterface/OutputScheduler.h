@@ -0,0 +1,86 @@
+/*
+ * OutputScheduler.h - Non-Blocking Typing of Queued Triggers (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Types one key sequence per trigger without ever waiting on the USB host.
+// loop() hands over one report at a time, and only once the keyboard
+// endpoint has room for it, so packets keep being read between reports
+// even while the host is slow to poll.
+//
+// Triggers that come in while a sequence is being typed are counted, and
+// each one is typed in turn after it, instead of being merged into one.
+// The sequence for a trigger is built when it starts being typed, so it
+// has the latest reading. Auto triggers are queued in order with the
+// button presses, so the caller can tell which kind started a sequence.
+//
+// If the host takes no report for stallTimeout (unplugged, suspended),
+// the rest of the sequence is given up, and any keys held down are
+// released once the host polls again.
+//
+// Has no Arduino dependency, so it is also used by the host tools.
+
+
+#pragma once
+
+#include <stdint.h>
+#include "KeySequence.h"
+
+
+const uint8_t OUTPUT_MAX_TRIGGERS = 16; // Triggers queued while typing, more are dropped
+
+
+class OutputScheduler {
+public:
+    OutputScheduler();
+
+    void begin(uint32_t stallTimeout); // Sets how long to wait for the host, and clears everything queued.
+
+    void addTriggers(uint8_t count,
+                     bool autoTriggered); // Queues triggers to be typed.
+
+    bool startSequence(uint32_t currentTime); // Starts typing the next queued trigger, if nothing is being typed.
+    KeySequence &getSequence();               // Returns the sequence being typed.
+    bool isAutoTriggered();                   // Returns true if the sequence being typed is for an auto trigger.
+
+    bool nextReport(bool endpointFree,
+                    uint32_t currentTime,
+                    key_report_t &report); // Returns the next report to send, when the endpoint is free.
+
+    bool isBusy();                 // Returns true while typing, or triggers are queued.
+    bool isTyping();               // Returns true while a sequence has reports left to send.
+    uint8_t getQueuedTriggers();   // Returns the number of triggers waiting to be typed.
+    uint16_t getDroppedTriggers(); // Returns the count of triggers dropped because the queue was full.
+    uint16_t getStallCount();      // Returns the count of sequences given up because the host stalled.
+
+private:
+    KeySequence sequence;
+    key_report_t pendingReport; // Next report of sequence, generated before the endpoint is free
+
+    uint32_t stallTimeout;     // Milliseconds without the host taking a report before giving up
+    uint32_t lastReportTime;   // Time the last report was handed over, or typing started
+
+    uint8_t queuedTriggers;
+    uint16_t autoTriggers;     // Bit n is set if queued trigger n, oldest first, is an auto trigger
+    bool sequenceAuto;         // sequence is for an auto trigger
+    bool typing;               // sequence is being typed
+    bool hasPendingReport;     // pendingReport is set
+    bool keysHeld;             // The last report handed over holds keys down
+    bool releasePending;       // A release report is owed after giving up on a sequence
+
+    uint16_t droppedTriggers;
+    uint16_t stallCount;
+};
@@ -0,0 +1,293 @@
+/*
+ * PacketFilter.h - Rejects Corrupted Caliper Packets Before They Are Used
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Sits between the SPI slave and ClockwiseCaliper. Each packet goes
+// through these checks in order, any of which can reject it:
+//   1. Unknown bits: bits 21 and 22 are always 0 from a working caliper,
+//      so a packet with either set was corrupted or misaligned.
+//   2. Unit: a unit change is only accepted once the next packet agrees,
+//      so a single flipped unit bit is rejected.
+//   3. Spike: a value more than maxJump counts from the last accepted
+//      value is only accepted once the next packet is within maxJump of
+//      it. Fast moves are delayed by one packet, single corrupted packets
+//      are rejected. After PACKET_FILTER_MAX_REJECT_STREAK rejections in a
+//      row the next packet is accepted anyway, so the filter can't lock up.
+//   4. Median: accepted values go through a median of the last MedianSize
+//      values, started over after a unit change or a confirmed jump. A
+//      MedianSize of 1 turns this off.
+// Each step is constant time for a given MedianSize.
+
+
+#pragma once
+
+#include <stdint.h>
+#include "ClockwiseCaliper.h"
+
+
+const uint8_t PACKET_FILTER_MAX_REJECT_STREAK = 3; // Rejections in a row before a packet is accepted anyway
+
+
+template <uint8_t MedianSize>
+class PacketFilter {
+    static_assert(MedianSize > 0 && MedianSize <= 15 && (MedianSize & 1) == 1, "MedianSize must be odd, up to 15");
+
+public:
+    PacketFilter();
+
+    void begin(uint32_t maxJump); // Sets the spike threshold and resets the filter.
+    void reset();                 // Forgets the previous packets.
+
+    bool filter(uint32_t &packet); // Checks a packet, and replaces it with the filtered packet.
+
+    uint32_t getUnknownBitsCount(); // Returns the number of packets rejected for the unknown bits.
+    uint32_t getUnitCount();        // Returns the number of packets rejected for an unconfirmed unit change.
+    uint32_t getSpikeCount();       // Returns the number of packets rejected as spikes.
+    uint32_t getForcedCount();      // Returns the number of packets accepted after too many rejections.
+    void clearCounts();             // Clears the rejection counts.
+
+private:
+    uint32_t maxJump; // Counts between packets before a value is a spike
+
+    bool hasLast;        // A packet has been accepted since reset()
+    int32_t lastValue;   // Last accepted value
+    uint8_t lastUnit;    // Unit of the last accepted value
+    bool hasPending;     // The previous packet was rejected, and may be confirmed
+    int32_t pendingValue;
+    uint8_t pendingUnit;
+    uint8_t rejectStreak;
+
+    int32_t window[MedianSize]; // Accepted values, oldest overwritten first
+    uint8_t windowIndex;
+    uint8_t windowCount;
+
+    uint32_t unknownBitsCount;
+    uint32_t unitCount;
+    uint32_t spikeCount;
+    uint32_t forcedCount;
+
+    bool isNear(int32_t a, int32_t b); // Returns true if a and b are within maxJump.
+    int32_t median();                  // Returns the median of the window.
+};
+
+
+/**
+ * Packet filter constructor.
+ */
+template <uint8_t MedianSize>
+PacketFilter<MedianSize>::PacketFilter() {
+    this->clearCounts();
+    this->begin(0xFFFFF);
+}
+
+
+/**
+ * Sets the spike threshold and resets the filter.
+ *
+ * @param maxJump counts a value may change between packets before it
+ *                needs the next packet to confirm it
+ */
+template <uint8_t MedianSize>
+void PacketFilter<MedianSize>::begin(uint32_t maxJump) {
+    this->maxJump = maxJump;
+
+    this->reset();
+}
+
+/**
+ * Forgets the previous packets. The next packet with the unknown bits
+ * clear is accepted as is.
+ */
+template <uint8_t MedianSize>
+void PacketFilter<MedianSize>::reset() {
+    this->hasLast = false;
+    this->lastValue = 0;
+    this->lastUnit = MILLIMETERS;
+    this->hasPending = false;
+    this->pendingValue = 0;
+    this->pendingUnit = MILLIMETERS;
+    this->rejectStreak = 0;
+
+    this->windowIndex = 0;
+    this->windowCount = 0;
+}
+
+
+/**
+ * Checks a packet, and replaces it with the filtered packet.
+ *
+ * @param packet 24-bit packet as passed to ClockwiseCaliper::updatePacket(),
+ *               set to the filtered packet when it is accepted
+ * @return false if the packet was rejected and should not be used
+ */
+template <uint8_t MedianSize>
+bool PacketFilter<MedianSize>::filter(uint32_t &packet) {
+    if (caliperPacketUnknownBits(packet) != 0) {
+        this->unknownBitsCount++;
+        return false;
+    }
+
+    int32_t value = caliperPacketValue(packet);
+    uint8_t unit = caliperPacketUnit(packet);
+
+    if (this->hasLast && this->rejectStreak < PACKET_FILTER_MAX_REJECT_STREAK) {
+        bool confirmed = this->hasPending && unit == this->pendingUnit && this->isNear(value, this->pendingValue);
+
+        if (unit != this->lastUnit && !confirmed) {
+            this->unitCount++;
+        } else if (unit == this->lastUnit && !this->isNear(value, this->lastValue) && !confirmed) {
+            this->spikeCount++;
+        } else {
+            confirmed = true;
+        }
+
+        if (!confirmed) {
+            this->hasPending = true;
+            this->pendingValue = value;
+            this->pendingUnit = unit;
+            this->rejectStreak++;
+
+            return false;
+        }
+
+    } else if (this->hasLast) {
+        this->forcedCount++;
+    }
+
+    // Values in different units, or from before a jump, aren't the same reading
+    if (this->hasLast && (unit != this->lastUnit || !this->isNear(value, this->lastValue))) {
+        this->windowIndex = 0;
+        this->windowCount = 0;
+    }
+
+    this->hasLast = true;
+    this->lastValue = value;
+    this->lastUnit = unit;
+    this->hasPending = false;
+    this->rejectStreak = 0;
+
+    // Median
+    this->window[this->windowIndex] = value;
+    this->windowIndex = this->windowIndex + 1 < MedianSize ? this->windowIndex + 1 : 0;
+
+    if (this->windowCount < MedianSize) {
+        this->windowCount++;
+    }
+
+    value = this->median();
+
+    packet = encodeCaliperPacket(value, (caliper_unit_t)unit);
+
+    return true;
+}
+
+
+/**
+ * Returns the number of packets rejected because bit 21 or 22 was set.
+ *
+ * @return the number of packets
+ */
+template <uint8_t MedianSize>
+uint32_t PacketFilter<MedianSize>::getUnknownBitsCount() {
+    return this->unknownBitsCount;
+}
+
+/**
+ * Returns the number of packets rejected for a unit change the next
+ * packet did not confirm.
+ *
+ * @return the number of packets
+ */
+template <uint8_t MedianSize>
+uint32_t PacketFilter<MedianSize>::getUnitCount() {
+    return this->unitCount;
+}
+
+/**
+ * Returns the number of packets rejected as spikes.
+ * A fast move also counts one packet here, before it is confirmed.
+ *
+ * @return the number of packets
+ */
+template <uint8_t MedianSize>
+uint32_t PacketFilter<MedianSize>::getSpikeCount() {
+    return this->spikeCount;
+}
+
+/**
+ * Returns the number of packets accepted without checking, after
+ * PACKET_FILTER_MAX_REJECT_STREAK rejections in a row.
+ *
+ * @return the number of packets
+ */
+template <uint8_t MedianSize>
+uint32_t PacketFilter<MedianSize>::getForcedCount() {
+    return this->forcedCount;
+}
+
+/**
+ * Clears the rejection counts.
+ */
+template <uint8_t MedianSize>
+void PacketFilter<MedianSize>::clearCounts() {
+    this->unknownBitsCount = 0;
+    this->unitCount = 0;
+    this->spikeCount = 0;
+    this->forcedCount = 0;
+}
+
+
+/**
+ * Returns true if a and b are within maxJump.
+ *
+ * @param a first value
+ * @param b second value
+ * @return true if the difference is maxJump or less
+ */
+template <uint8_t MedianSize>
+bool PacketFilter<MedianSize>::isNear(int32_t a, int32_t b) {
+    uint32_t difference = a > b ? a - b : b - a;
+
+    return difference <= this->maxJump;
+}
+
+/**
+ * Returns the median of the window.
+ * Until the window is full, the median of the values so far, the upper
+ * one when there are an even number.
+ *
+ * @return the median value
+ */
+template <uint8_t MedianSize>
+int32_t PacketFilter<MedianSize>::median() {
+    int32_t sorted[MedianSize];
+    uint8_t count = this->windowCount;
+
+    // Insertion sort, at most MedianSize^2 / 2 steps
+    for (uint8_t i = 0; i < count; i++) {
+        int32_t value = this->window[i];
+        uint8_t j = i;
+
+        for (; j > 0 && sorted[j - 1] > value; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+
+        sorted[j] = value;
+    }
+
+    return sorted[count / 2];
+}
@@ -0,0 +1,174 @@
+/*
+ * PacketStream.cpp - Binary Framing for Streaming Caliper Packets
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "PacketStream.h"
+
+
+/**
+ * Writes the frame for a record.
+ *
+ * @param record packet and its details
+ * @param frame array of PACKET_STREAM_FRAME_SIZE bytes to fill
+ */
+void PacketStream::encode(const packet_stream_record_t &record,
+                          uint8_t *frame) {
+    frame[0] = PACKET_STREAM_SYNC;
+    frame[1] = (record.channel & PACKET_STREAM_CHANNEL_MASK) | (record.flags & 0xF0);
+    frame[2] = record.packet;
+    frame[3] = record.packet >> 8;
+    frame[4] = record.packet >> 16;
+    frame[5] = record.time;
+    frame[6] = record.time >> 8;
+    frame[7] = record.time >> 16;
+    frame[8] = record.time >> 24;
+    frame[9] = record.sequence;
+    frame[10] = record.resyncCount;
+
+    uint16_t crc = PacketStream::crc16(frame, PACKET_STREAM_FRAME_SIZE - 2);
+
+    frame[11] = crc;
+    frame[12] = crc >> 8;
+}
+
+
+/**
+ * Packet stream reader constructor.
+ */
+PacketStream::PacketStream() {
+    this->record = {0, 0, 0, 0, 0, 0};
+    this->skippedCount = 0;
+
+    this->reset();
+}
+
+
+/**
+ * Discards any partly received frame.
+ */
+void PacketStream::reset() {
+    this->length = 0;
+}
+
+
+/**
+ * Adds a received byte. Bytes before a sync byte, and frames with a bad
+ * CRC, are skipped.
+ *
+ * @param byte next byte of the stream
+ * @return true if a frame was completed, read it with getRecord()
+ */
+bool PacketStream::push(uint8_t byte) {
+    this->frame[this->length++] = byte;
+
+    if (this->frame[0] != PACKET_STREAM_SYNC) {
+        this->skip();
+        return false;
+    }
+
+    if (this->length < PACKET_STREAM_FRAME_SIZE) {
+        return false;
+    }
+
+    uint16_t crc = this->frame[11] | ((uint16_t)this->frame[12] << 8);
+
+    if ((this->frame[1] & PACKET_STREAM_RESERVED_MASK) != 0
+        || PacketStream::crc16(this->frame, PACKET_STREAM_FRAME_SIZE - 2) != crc) {
+        this->skip();
+        return false;
+    }
+
+    this->record.channel = this->frame[1] & PACKET_STREAM_CHANNEL_MASK;
+    this->record.flags = this->frame[1] & 0xF0;
+    this->record.packet = this->frame[2]
+                        | ((uint32_t)this->frame[3] << 8)
+                        | ((uint32_t)this->frame[4] << 16);
+    this->record.time = this->frame[5]
+                      | ((uint32_t)this->frame[6] << 8)
+                      | ((uint32_t)this->frame[7] << 16)
+                      | ((uint32_t)this->frame[8] << 24);
+    this->record.sequence = this->frame[9];
+    this->record.resyncCount = this->frame[10];
+
+    this->length = 0;
+
+    return true;
+}
+
+/**
+ * Returns the last complete frame.
+ *
+ * @return the record of the frame
+ */
+packet_stream_record_t PacketStream::getRecord() {
+    return this->record;
+}
+
+
+/**
+ * Returns the number of bytes skipped to find frames, from lost bytes or
+ * starting partway through a frame.
+ *
+ * @return the number of bytes
+ */
+uint32_t PacketStream::getSkippedCount() {
+    return this->skippedCount;
+}
+
+
+/**
+ * Returns the CRC-16/CCITT-FALSE of bytes, polynomial 0x1021 with an
+ * initial value of 0xFFFF. Bitwise, there is only one frame per packet.
+ *
+ * @param bytes bytes to check
+ * @param length number of bytes
+ * @return the CRC
+ */
+uint16_t PacketStream::crc16(const uint8_t *bytes, uint8_t length) {
+    uint16_t crc = 0xFFFF;
+
+    for (uint8_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)bytes[i] << 8;
+
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * Drops the first byte of frame, and shifts the rest down to the next sync
+ * byte so a frame starting inside a bad one is still found.
+ */
+void PacketStream::skip() {
+    uint8_t start = 1;
+
+    while (start < this->length && this->frame[start] != PACKET_STREAM_SYNC) {
+        start++;
+    }
+
+    this->skippedCount += start;
+
+    for (uint8_t i = start; i < this->length; i++) {
+        this->frame[i - start] = this->frame[i];
+    }
+
+    this->length -= start;
+}
@@ -0,0 +1,91 @@
+/*
+ * PacketStream.h - Binary Framing for Streaming Caliper Packets (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Every packet received from a caliper is sent as one fixed size frame,
+// multi-byte fields little endian:
+//
+//   byte  0      sync, PACKET_STREAM_SYNC
+//   byte  1      bits 0-1 channel (caliper), bits 2-3 always 0,
+//                bits 4-7 PACKET_STREAM_FLAG_*
+//   bytes 2-4    24-bit packet as the caliper sent it, before the filter
+//   bytes 5-8    milliseconds when it was received
+//   byte  9      sequence, counts every packet of the channel, even ones
+//                that could not be sent, so gaps show dropped frames
+//   byte  10     resync count of the SPI slave (wraps at 255)
+//   bytes 11-12  CRC-16/CCITT-FALSE of bytes 0 to 10
+//
+// A reader that loses its place looks for the next sync byte followed by
+// a frame with a valid CRC. The 16-bit CRC keeps the chance of a false
+// frame found partway through a corrupted one to about 1 in 65536.
+//
+// Units, sign and measurement are all in the packet, see
+// ClockwiseCaliper.h.
+//
+// No Arduino dependency, the host tools use the same code to read the
+// stream.
+
+
+#pragma once
+
+#include <stdint.h>
+
+
+const uint8_t PACKET_STREAM_SYNC = 0xCA;
+const uint8_t PACKET_STREAM_FRAME_SIZE = 13;
+
+const uint8_t PACKET_STREAM_CHANNEL_MASK = 0x03;
+const uint8_t PACKET_STREAM_RESERVED_MASK = 0x0C;
+const uint8_t PACKET_STREAM_FLAG_REJECTED = 0x10; // The packet filter rejected the packet
+const uint8_t PACKET_STREAM_FLAG_LOST = 0x20;     // The SPI slave lost packets since the previous frame
+
+/**
+ * The contents of one frame.
+ */
+typedef struct {
+    uint8_t channel;     // Caliper, 0 to 3
+    uint8_t flags;       // PACKET_STREAM_FLAG_*
+    uint32_t packet;     // 24-bit packet
+    uint32_t time;       // Milliseconds
+    uint8_t sequence;    // Packets of the channel, wraps at 255
+    uint8_t resyncCount; // SPI slave resyncs, wraps at 255
+} packet_stream_record_t;
+
+
+class PacketStream {
+public:
+    static void encode(const packet_stream_record_t &record,
+                       uint8_t *frame); // Writes the frame for a record.
+
+    PacketStream();
+
+    void reset();              // Discards any partly received frame.
+    bool push(uint8_t byte);   // Adds a received byte, returns true when a frame is complete.
+    packet_stream_record_t getRecord(); // Returns the last complete frame.
+
+    uint32_t getSkippedCount(); // Returns the number of bytes skipped to find frames.
+
+    static uint16_t crc16(const uint8_t *bytes, uint8_t length); // Returns the CRC-16 of bytes.
+
+private:
+    uint8_t frame[PACKET_STREAM_FRAME_SIZE]; // Bytes received of the current frame
+    uint8_t length;                          // Bytes in frame
+    packet_stream_record_t record;           // Last complete frame
+    uint32_t skippedCount;
+
+    void skip(); // Drops the first byte of frame and looks for the next sync.
+};
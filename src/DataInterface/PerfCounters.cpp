@@ -0,0 +1,200 @@
+/*
+ * PerfCounters.cpp - Performance Counters and Latency Histograms
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "PerfCounters.h"
+
+
+#if defined(PERF_ENABLED)
+    PerfCounters perfCounters;
+#endif
+
+
+/**
+ * Performance counters constructor.
+ */
+PerfCounters::PerfCounters() {
+    this->tickShift = 0;
+
+    this->clear();
+}
+
+
+/**
+ * Starts Timer1 if nothing else runs it, and clears the counters.
+ * If Timer1 is already free running (INPUT_CAPTURE), it is left as it is
+ * and its prescaler is taken into account. Otherwise it is set to count
+ * every CPU cycle, which takes it away from analogWrite() on its pins.
+ * Call after the capture has begun.
+ */
+void PerfCounters::begin() {
+    #if defined(PERF_ENABLED)
+        const uint8_t prescalerShifts[] = {0, 0, 3, 6, 8, 10}; // Indexed by the clock select bits
+
+        uint8_t clockSelect = TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10));
+        bool normalMode = (TCCR1A & (_BV(WGM11) | _BV(WGM10))) == 0
+                       && (TCCR1B & (_BV(WGM13) | _BV(WGM12))) == 0;
+
+        // Stopped, PWM (how the Arduino core leaves it), or an external clock
+        if (!normalMode || clockSelect == 0 || clockSelect > 5) {
+            TCCR1A = 0;
+            TCCR1B = _BV(CS10); // No prescaler
+            clockSelect = 1;
+        }
+
+        this->tickShift = prescalerShifts[clockSelect];
+    #endif
+
+    this->clear();
+}
+
+/**
+ * Clears the counters.
+ */
+void PerfCounters::clear() {
+    #if defined(PERF_ENABLED)
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    #endif
+    {
+        this->isrCycles.clear();
+        this->queueHighWater = 0;
+        this->packetsDecoded = 0;
+        this->packetsRejected = 0;
+        this->framesLost = 0;
+
+        for (uint8_t i = 0; i < PERF_RESYNC_REASONS; i++) {
+            this->resyncs[i] = 0;
+        }
+
+        this->triggerLatency.clear();
+        this->sequenceDuration.clear();
+    }
+}
+
+
+/**
+ * Counts one ISR run, in Timer1 ticks.
+ * Called from interrupt context.
+ *
+ * @param ticks Timer1 ticks from the start of the ISR to the end
+ */
+void PerfCounters::addIsrTicks(uint16_t ticks) {
+    this->isrCycles.add((uint32_t)ticks << this->tickShift);
+}
+
+/**
+ * Updates the receive queue high water mark.
+ * Called from loop() before reading the queue, when it is fullest.
+ *
+ * @param frames frames waiting in the queue
+ */
+void PerfCounters::addQueueDepth(uint8_t frames) {
+    if (frames > this->queueHighWater) {
+        this->queueHighWater = frames;
+    }
+}
+
+/**
+ * Counts a decoded packet.
+ *
+ * @param accepted false if the packet filter rejected it
+ */
+void PerfCounters::addPacket(bool accepted) {
+    this->packetsDecoded++;
+
+    if (!accepted) {
+        this->packetsRejected++;
+    }
+}
+
+/**
+ * Counts a frame dropped because the queue was full.
+ * Called from interrupt context.
+ */
+void PerfCounters::addLostFrame() {
+    this->framesLost++;
+}
+
+/**
+ * Counts a resync.
+ * May be called from interrupt context.
+ *
+ * @param reason why the frame was restarted
+ */
+void PerfCounters::addResync(perf_resync_reason_t reason) {
+    this->resyncs[reason]++;
+}
+
+/**
+ * Counts the time from a trigger to its first report.
+ *
+ * @param micros microseconds
+ */
+void PerfCounters::addTriggerLatency(uint32_t micros) {
+    this->triggerLatency.add(micros);
+}
+
+/**
+ * Counts the time from the first report of a sequence to the last.
+ *
+ * @param micros microseconds
+ */
+void PerfCounters::addSequenceDuration(uint32_t micros) {
+    this->sequenceDuration.add(micros);
+}
+
+
+/**
+ * Reads a counter an ISR may be writing, with interrupts disabled so the
+ * four bytes are from the same count.
+ *
+ * @param value counter to read
+ * @return the count
+ */
+uint32_t PerfCounters::load(const volatile uint32_t &value) {
+    uint32_t copy;
+
+    #if defined(PERF_ENABLED)
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    #endif
+    {
+        copy = value;
+    }
+
+    return copy;
+}
+
+/**
+ * Reads a histogram bin an ISR may be writing, see load().
+ *
+ * @param histogram histogram to read
+ * @param bin bin index
+ * @return the count of the bin
+ */
+uint32_t PerfCounters::loadBin(const Log2Histogram &histogram, uint8_t bin) {
+    uint32_t copy;
+
+    #if defined(PERF_ENABLED)
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    #endif
+    {
+        copy = histogram.getCount(bin);
+    }
+
+    return copy;
+}
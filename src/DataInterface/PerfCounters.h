@@ -0,0 +1,279 @@
+/*
+ * PerfCounters.h - Performance Counters and Latency Histograms (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Counts what each stage of the capture pipeline does, so a unit in the
+// field can tell which stage is the bottleneck:
+//   - cycles spent in the capture ISRs, timed with Timer1.
+//   - the most frames waiting in the receive queue when loop() got to them.
+//   - packets decoded, rejected by the packet filter, and lost because the
+//     queue was full.
+//   - resyncs, by reason.
+//   - microseconds from a trigger to its first keyboard report, and from
+//     the first report to the last one of the sequence.
+// Counts are 32 bits, durations go into log2 histograms: bin n counts the
+// values from 2^(n-1) to 2^n - 1, bin 0 counts zeros, and the last bin
+// also counts everything larger.
+//
+// Only compiled in when PERF_COUNTERS is defined below (it is here rather
+// than in the sketch so every file sees the same setting). The PERF_*
+// macros used by the capture code are empty otherwise. They are also empty
+// in the host tools, the timing only means something on the board.
+
+
+#pragma once
+
+#include <stdint.h>
+
+// #define PERF_COUNTERS
+
+#if defined(PERF_COUNTERS) && defined(ARDUINO_ARCH_AVR)
+    #define PERF_ENABLED
+    #include <avr/io.h>
+    #include <util/atomic.h>
+#endif
+
+
+const uint8_t LOG2_HISTOGRAM_BINS = 24; // Up to 2^23 - 1, the last bin counts everything larger
+const char PERF_DUMP_COMMAND = 'p';     // Serial command that prints the counters
+const char PERF_CLEAR_COMMAND = 'c';    // Serial command that clears the counters
+
+typedef enum : uint8_t {
+    PERF_RESYNC_CLOCK_GAP = 0,  // No clock edge for maxClkTime in the middle of a frame
+    PERF_RESYNC_EDGES_LOST = 1, // Captured clock edges were dropped before they were decoded
+    PERF_RESYNC_REASONS = 2
+} perf_resync_reason_t;
+
+constexpr const char *PERF_RESYNC_NAMES[PERF_RESYNC_REASONS] = {"clock_gap", "edges_lost"};
+
+
+/**
+ * Counts of values by their number of significant bits.
+ */
+class Log2Histogram {
+public:
+    /**
+     * Log2 histogram constructor.
+     */
+    Log2Histogram() {
+        this->clear();
+    }
+
+    /**
+     * Removes every value.
+     */
+    void clear() {
+        for (uint8_t i = 0; i < LOG2_HISTOGRAM_BINS; i++) {
+            this->counts[i] = 0;
+        }
+    }
+
+    /**
+     * Counts a value in its bin.
+     *
+     * @param value value to count
+     */
+    void add(uint32_t value) {
+        this->counts[Log2Histogram::binOf(value)]++;
+    }
+
+    /**
+     * Returns the count of a bin.
+     *
+     * @param bin bin index, less than LOG2_HISTOGRAM_BINS
+     * @return the count of values in the bin
+     */
+    uint32_t getCount(uint8_t bin) const {
+        return this->counts[bin];
+    }
+
+    /**
+     * Returns the bin a value is counted in, its number of significant
+     * bits.
+     *
+     * @param value value to count
+     * @return the bin index
+     */
+    static uint8_t binOf(uint32_t value) {
+        uint8_t bin = 0;
+
+        // Whole bytes first, so large values take a few steps on AVR
+        while (value > 0xFF) {
+            value >>= 8;
+            bin += 8;
+        }
+
+        while (value > 0) {
+            value >>= 1;
+            bin++;
+        }
+
+        return bin < LOG2_HISTOGRAM_BINS ? bin : LOG2_HISTOGRAM_BINS - 1;
+    }
+
+    /**
+     * Returns the smallest value counted in a bin.
+     *
+     * @param bin bin index
+     * @return the lower bound of the bin
+     */
+    static uint32_t binStart(uint8_t bin) {
+        return bin == 0 ? 0 : (uint32_t)1 << (bin - 1);
+    }
+
+private:
+    uint32_t counts[LOG2_HISTOGRAM_BINS];
+};
+
+
+class PerfCounters {
+public:
+    PerfCounters();
+
+    void begin(); // Starts Timer1 if nothing else runs it, and clears the counters.
+    void clear(); // Clears the counters.
+
+    void addIsrTicks(uint16_t ticks);            // Counts one ISR run, in Timer1 ticks.
+    void addQueueDepth(uint8_t frames);          // Updates the receive queue high water mark.
+    void addPacket(bool accepted);               // Counts a decoded packet.
+    void addLostFrame();                         // Counts a frame dropped because the queue was full.
+    void addResync(perf_resync_reason_t reason); // Counts a resync.
+    void addTriggerLatency(uint32_t micros);     // Counts the time from a trigger to its first report.
+    void addSequenceDuration(uint32_t micros);   // Counts the time from the first report to the last.
+
+    template <typename Output>
+    void dump(Output &out); // Prints every counter and histogram.
+
+    /**
+     * Returns the Timer1 count, for timing ISRs.
+     *
+     * @return the 16-bit timer count, 0 when not on AVR
+     */
+    static inline uint16_t timerTicks() {
+        #if defined(PERF_ENABLED)
+            return TCNT1;
+        #else
+            return 0;
+        #endif
+    }
+
+private:
+    uint8_t tickShift; // log2 of the Timer1 prescaler, ticks << tickShift is cycles
+
+    Log2Histogram isrCycles;
+    uint8_t queueHighWater;
+    uint32_t packetsDecoded;
+    uint32_t packetsRejected;
+    volatile uint32_t framesLost;
+    volatile uint32_t resyncs[PERF_RESYNC_REASONS];
+    Log2Histogram triggerLatency;
+    Log2Histogram sequenceDuration;
+
+    static uint32_t load(const volatile uint32_t &value);                 // Reads a counter an ISR may be writing.
+    static uint32_t loadBin(const Log2Histogram &histogram, uint8_t bin); // Reads a histogram bin an ISR may be writing.
+
+    template <typename Output>
+    static void dumpHistogram(Output &out,
+                              const char *name,
+                              const Log2Histogram &histogram); // Prints the bins of a histogram that are not empty.
+};
+
+
+/**
+ * Prints every counter and histogram, one "name: value" per line.
+ * Histogram bins that are not empty are printed as "start+: count",
+ * start being the smallest value in the bin.
+ *
+ * @param out anything with print() and println(), such as Serial
+ */
+template <typename Output>
+void PerfCounters::dump(Output &out) {
+    PerfCounters::dumpHistogram(out, "perf_isr_cycles", this->isrCycles);
+    out.print("perf_queue_high_water: "); out.println(this->queueHighWater);
+    out.print("perf_packets_decoded: ");  out.println(this->packetsDecoded);
+    out.print("perf_packets_rejected: "); out.println(this->packetsRejected);
+    out.print("perf_frames_lost: ");      out.println(PerfCounters::load(this->framesLost));
+
+    for (uint8_t i = 0; i < PERF_RESYNC_REASONS; i++) {
+        out.print("perf_resync_"); out.print(PERF_RESYNC_NAMES[i]); out.print(": ");
+        out.println(PerfCounters::load(this->resyncs[i]));
+    }
+
+    PerfCounters::dumpHistogram(out, "perf_trigger_latency_us", this->triggerLatency);
+    PerfCounters::dumpHistogram(out, "perf_sequence_duration_us", this->sequenceDuration);
+}
+
+/**
+ * Prints the bins of a histogram that are not empty.
+ *
+ * @param out anything with print() and println()
+ * @param name name printed before the bins
+ * @param histogram histogram to print
+ */
+template <typename Output>
+void PerfCounters::dumpHistogram(Output &out, const char *name, const Log2Histogram &histogram) {
+    bool first = true;
+
+    out.print(name);
+    out.print(":");
+
+    for (uint8_t i = 0; i < LOG2_HISTOGRAM_BINS; i++) {
+        uint32_t count = PerfCounters::loadBin(histogram, i);
+
+        if (count == 0) {
+            continue;
+        }
+
+        out.print(first ? " " : ", ");
+        out.print(Log2Histogram::binStart(i));
+        out.print("+: ");
+        out.print(count);
+        first = false;
+    }
+
+    out.println();
+}
+
+
+#if defined(PERF_ENABLED)
+    extern PerfCounters perfCounters;
+
+    /**
+     * Counts the Timer1 ticks until it goes out of scope, for timing an
+     * ISR with all of its return paths.
+     */
+    class PerfIsrTimer {
+    public:
+        PerfIsrTimer() : start(PerfCounters::timerTicks()) {}
+        ~PerfIsrTimer() { perfCounters.addIsrTicks(PerfCounters::timerTicks() - this->start); }
+
+    private:
+        uint16_t start;
+    };
+
+    #define PERF_ISR_TIMER() PerfIsrTimer perfIsrTimer
+    #define PERF_LOST_FRAME() perfCounters.addLostFrame()
+    #define PERF_RESYNC(reason) perfCounters.addResync(reason)
+    #define PERF_QUEUE_DEPTH(frames) perfCounters.addQueueDepth(frames)
+    #define PERF_PACKET(accepted) perfCounters.addPacket(accepted)
+#else
+    #define PERF_ISR_TIMER()
+    #define PERF_LOST_FRAME()
+    #define PERF_RESYNC(reason)
+    #define PERF_QUEUE_DEPTH(frames)
+    #define PERF_PACKET(accepted)
+#endif
@@ -0,0 +1,37 @@
+/*
+ * PinChangeSPISlave.cpp - Several Caliper Receivers on One Pin Change Interrupt
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "PinChangeSPISlave.h"
+
+
+void (*pinChangeSPIIsr)() = nullptr;
+
+
+#if defined(MULTI_CALIPER)
+/**
+ * Passes the pin change interrupt of port B to the running
+ * PinChangeSPISlave. PinChangeSPISlave is a template, so the vector
+ * lives here and calls it through pinChangeSPIIsr.
+ */
+ISR(PCINT0_vect) {
+    if (pinChangeSPIIsr != nullptr) {
+        pinChangeSPIIsr();
+    }
+}
+#endif
@@ -0,0 +1,278 @@
+/*
+ * PinChangeSPISlave.h - Several Caliper Receivers on One Pin Change Interrupt (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Receives up to 4 RX only SPI channels, one per caliper, with the single
+// PCINT0 pin change interrupt. Every CLK and DATA pin must be on port B,
+// which is the port PCINT0 covers on both the ATmega32U4 (digital pins 8
+// to 11 and 14 to 17) and the ATmega328P (digital pins 8 to 13). Only the
+// clock pins trigger the interrupt, which reads the port once and decodes
+// every channel with MultiSoftSPIReceiver.
+//
+// The default sketch wiring uses some of these pins for the DIP switches
+// and buzzer, so MULTI_CALIPER requires rewiring: with it the sketch moves
+// the CTRL+A, units, and newline switches to digital pins 2 to 4 and the
+// buzzer to pin 5, and checks that none of its pins is a caliper pin.
+//
+// The PCINT0 vector is only defined when MULTI_CALIPER is selected in
+// CaptureConfig.h, so it stays free for other pin change users.
+//
+// There can only be one PinChangeSPISlave running at a time.
+
+
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "CaptureConfig.h"
+#include "MultiSoftSPIReceiver.h"
+#include "PerfCounters.h"
+#include "SoftSPIPin.h"
+#include "SoftSPITypes.h"
+
+
+extern void (*pinChangeSPIIsr)(); // Called from the PCINT0 vector, set by PinChangeSPISlave::begin()
+
+
+template <softspi_mode_t Mode,
+          softspi_data_order_t Order,
+          uint8_t Channels>
+class PinChangeSPISlave {
+public:
+    PinChangeSPISlave(const int16_t *clkPins,
+                      const int16_t *dataPins);
+
+    void begin(uint32_t maxClkTime,
+               uint8_t frameLength); // Starts receiving data on every channel.
+    void end();                      // Stops receiving data.
+
+    // RX
+    uint8_t rxFramesAvailable(uint8_t channel); // Returns the number of frames of a channel that can be read.
+    bool rxHasData();                           // Returns true if any channel has data to be read.
+    bool rxHasData(uint8_t channel);            // Returns true if a channel has data to be read.
+    bool rxHasLostData();                       // Returns true if any channel lost data since the last time this was called.
+    uint32_t read(uint8_t channel);             // Reads a frame from the receive buffer of a channel.
+
+    uint8_t getResyncCount(); // Returns the count of timeouts due to maxClkTime on all channels.
+
+    static void pinChangeIsr(); // Interrupt Service Routine ran when a clock pin changes.
+
+    static PinChangeSPISlave *instance; // The instance the pin change interrupt is passed to.
+
+private:
+    static constexpr bool SPI_CPHA = (Mode & 0b01) != 0;
+    static constexpr bool SPI_CPOL = (Mode & 0b10) != 0;
+    static constexpr bool SAMPLE_FALLING = SPI_CPHA != SPI_CPOL; // Sampling when going HIGH to LOW (MODE1, MODE2)
+
+    int16_t clkPins[Channels];  // Serial clock of each channel.
+    int16_t dataPins[Channels]; // Serial data in of each channel.
+
+    volatile uint8_t *portReg; // Input register of port B, set in begin().
+
+    MultiSoftSPIReceiver<Order, Channels> receiver;
+};
+
+
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+PinChangeSPISlave<Mode, Order, Channels> *PinChangeSPISlave<Mode, Order, Channels>::instance = nullptr;
+
+
+/**
+ * Pin change SPI slave constructor.
+ *
+ * @param clkPins serial clock pin of each channel, all on port B
+ * @param dataPins serial data pin of each channel, all on port B
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+PinChangeSPISlave<Mode, Order, Channels>::PinChangeSPISlave(const int16_t *clkPins,
+                                                            const int16_t *dataPins) {
+    for (uint8_t i = 0; i < Channels; i++) {
+        this->clkPins[i] = clkPins[i];
+        this->dataPins[i] = dataPins[i];
+    }
+
+    this->portReg = nullptr;
+}
+
+
+/**
+ * Starts receiving data on every channel.
+ * Does nothing if any of the pins is not on port B.
+ *
+ * @param maxClkTime milliseconds to wait for another clock before
+ *                   resetting a channel. A value of 0 disables this
+ * @param frameLength bits in each received frame, from 1 to 32
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+void PinChangeSPISlave<Mode, Order, Channels>::begin(uint32_t maxClkTime,
+                                                     uint8_t frameLength) {
+    uint8_t clkMasks[Channels];
+    uint8_t dataMasks[Channels];
+
+    if (frameLength < 1 || frameLength > 32) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < Channels; i++) {
+        int16_t clkPin = this->clkPins[i];
+        int16_t dataPin = this->dataPins[i];
+
+        if (clkPin < 0 || dataPin < 0
+                || digitalPinToPort(clkPin) != PB || digitalPinToPort(dataPin) != PB
+                || digitalPinToPCICR(clkPin) == nullptr || digitalPinToPCICRbit(clkPin) != PCIE0) {
+            return;
+        }
+
+        clkMasks[i] = digitalPinToBitMask(clkPin);
+        dataMasks[i] = digitalPinToBitMask(dataPin);
+
+        pinMode(clkPin, INPUT);
+        pinMode(dataPin, INPUT);
+    }
+
+    PinChangeSPISlave::instance = this;
+    pinChangeSPIIsr = &PinChangeSPISlave::pinChangeIsr;
+
+    this->portReg = portInputRegister(PB);
+
+    noInterrupts();
+
+    this->receiver.begin(SAMPLE_FALLING, clkMasks, dataMasks, maxClkTime, frameLength, *this->portReg);
+
+    // On port B the PCINT bits are the port bits, only the clocks interrupt
+    PCMSK0 |= this->receiver.getClkMask();
+    PCIFR = _BV(PCIF0);
+    PCICR |= _BV(PCIE0);
+
+    interrupts();
+}
+
+/**
+ * Stops receiving data.
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+void PinChangeSPISlave<Mode, Order, Channels>::end() {
+    PCMSK0 &= ~this->receiver.getClkMask();
+
+    if (PCMSK0 == 0) {
+        PCICR &= ~_BV(PCIE0);
+    }
+
+    pinChangeSPIIsr = nullptr;
+    PinChangeSPISlave::instance = nullptr;
+}
+
+
+/**
+ * Returns the number of frames of a channel that can be read.
+ *
+ * @param channel channel, from 0 to Channels - 1
+ * @return the number of frames that can be read
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+uint8_t PinChangeSPISlave<Mode, Order, Channels>::rxFramesAvailable(uint8_t channel) {
+    return this->receiver.channel(channel).framesAvailable();
+}
+
+/**
+ * Returns true if any channel has data to be read.
+ *
+ * @return true if data is available to be read
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+bool PinChangeSPISlave<Mode, Order, Channels>::rxHasData() {
+    for (uint8_t i = 0; i < Channels; i++) {
+        if (this->receiver.channel(i).hasData()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Returns true if a channel has data to be read.
+ *
+ * @param channel channel, from 0 to Channels - 1
+ * @return true if data is available to be read
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+bool PinChangeSPISlave<Mode, Order, Channels>::rxHasData(uint8_t channel) {
+    return this->receiver.channel(channel).hasData();
+}
+
+/**
+ * Returns true if any channel lost data since the last time this was
+ * called. Frames are only ever lost whole, so the frames that remain
+ * are still aligned.
+ *
+ * @return true if data was lost
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+bool PinChangeSPISlave<Mode, Order, Channels>::rxHasLostData() {
+    bool lost = false;
+
+    // Check every channel, so each one's flag is cleared
+    for (uint8_t i = 0; i < Channels; i++) {
+        lost |= this->receiver.channel(i).hasLostData();
+    }
+
+    return lost;
+}
+
+/**
+ * Reads a frame from the receive buffer of a channel.
+ *
+ * @param channel channel, from 0 to Channels - 1
+ * @return the oldest frame, or 0 if there are none
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+uint32_t PinChangeSPISlave<Mode, Order, Channels>::read(uint8_t channel) {
+    return this->receiver.channel(channel).read();
+}
+
+
+/**
+ * Returns the count of timeouts due to maxClkTime on all channels.
+ * NOTE: the count wraps at 255.
+ *
+ * @return the count of timeouts due to maxClkTime
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+uint8_t PinChangeSPISlave<Mode, Order, Channels>::getResyncCount() {
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < Channels; i++) {
+        count += this->receiver.channel(i).getResyncCount();
+    }
+
+    return count;
+}
+
+
+/**
+ * Interrupt Service Routine ran when a clock pin changes.
+ * Reads port B once and passes it to the receiver of every channel.
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, uint8_t Channels>
+void PinChangeSPISlave<Mode, Order, Channels>::pinChangeIsr() {
+    PERF_ISR_TIMER();
+
+    PinChangeSPISlave *slave = PinChangeSPISlave::instance;
+
+    slave->receiver.update(*slave->portReg, SoftSPIPin::isrMillis());
+}
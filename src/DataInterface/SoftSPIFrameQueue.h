@@ -0,0 +1,145 @@
+/*
+ * SoftSPIFrameQueue.h - Lock-Free Single Producer, Single Consumer Frame Queue
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// The producer (an ISR) only ever writes head, and the consumer (loop())
+// only ever writes tail. Both are single bytes, so reading and writing
+// them is atomic on AVR and neither side has to disable interrupts.
+
+
+#pragma once
+
+#include <stdint.h>
+
+
+template <typename T, uint8_t Size>
+class SoftSPIFrameQueue {
+    static_assert(Size > 0 && Size <= 128 && (Size & (Size - 1)) == 0, "Size must be a power of 2, up to 128");
+
+public:
+    SoftSPIFrameQueue();
+
+    bool push(const T &item); // Adds an item to the queue, only called by the producer.
+    bool pop(T &item);        // Removes the oldest item from the queue, only called by the consumer.
+    T peek();                 // Returns the oldest item without removing it, only called by the consumer.
+
+    uint8_t size();      // Returns the number of items in the queue.
+    uint8_t available(); // Returns the number of items that can be added before the queue is full.
+    bool isEmpty();      // Returns true if the queue is empty.
+
+private:
+    static constexpr uint8_t INDEX_MASK = Size - 1;
+
+    volatile T buffer[Size];
+    volatile uint8_t head; // Free running count of pushed items, written by the producer.
+    volatile uint8_t tail; // Free running count of popped items, written by the consumer.
+};
+
+
+/**
+ * Frame queue constructor.
+ */
+template <typename T, uint8_t Size>
+SoftSPIFrameQueue<T, Size>::SoftSPIFrameQueue() {
+    this->head = 0;
+    this->tail = 0;
+}
+
+
+/**
+ * Adds an item to the queue, only called by the producer.
+ * If the queue is full the item is dropped, rather than overwriting the
+ * oldest item which the consumer may be reading.
+ *
+ * @param item item to add
+ * @return false if the queue was full and the item was dropped
+ */
+template <typename T, uint8_t Size>
+bool SoftSPIFrameQueue<T, Size>::push(const T &item) {
+    uint8_t head = this->head;
+
+    if ((uint8_t)(head - this->tail) >= Size) {
+        return false;
+    }
+
+    this->buffer[head & INDEX_MASK] = item;
+    this->head = head + 1; // Publish only after the item is written
+
+    return true;
+}
+
+/**
+ * Removes the oldest item from the queue, only called by the consumer.
+ *
+ * @param item set to the removed item
+ * @return false if the queue was empty and item was not changed
+ */
+template <typename T, uint8_t Size>
+bool SoftSPIFrameQueue<T, Size>::pop(T &item) {
+    uint8_t tail = this->tail;
+
+    if (tail == this->head) {
+        return false;
+    }
+
+    item = this->buffer[tail & INDEX_MASK];
+    this->tail = tail + 1; // Release the slot only after the item is read
+
+    return true;
+}
+
+/**
+ * Returns the oldest item without removing it, only called by the
+ * consumer. Must not be called when the queue is empty.
+ *
+ * @return the oldest item
+ */
+template <typename T, uint8_t Size>
+T SoftSPIFrameQueue<T, Size>::peek() {
+    return this->buffer[this->tail & INDEX_MASK];
+}
+
+
+/**
+ * Returns the number of items in the queue.
+ *
+ * @return the number of items in the queue
+ */
+template <typename T, uint8_t Size>
+uint8_t SoftSPIFrameQueue<T, Size>::size() {
+    return this->head - this->tail;
+}
+
+/**
+ * Returns the number of items that can be added before the queue is full.
+ *
+ * @return the remaining space in the queue
+ */
+template <typename T, uint8_t Size>
+uint8_t SoftSPIFrameQueue<T, Size>::available() {
+    return Size - this->size();
+}
+
+/**
+ * Returns true if the queue is empty.
+ *
+ * @return true if the queue is empty
+ */
+template <typename T, uint8_t Size>
+bool SoftSPIFrameQueue<T, Size>::isEmpty() {
+    return this->head == this->tail;
+}
@@ -0,0 +1,138 @@
+/*
+ * SoftSPIPin.h - Direct Port Access Helpers for the Software SPI Slaves
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <Arduino.h>
+
+
+#if defined(ARDUINO_ARCH_AVR)
+extern volatile unsigned long timer0_millis;         // Millisecond count kept by the Arduino core (wiring.c)
+extern volatile unsigned long timer0_overflow_count; // Timer 0 overflow count kept by the Arduino core (wiring.c)
+#endif
+
+// Type of the port registers, the simulated board of the host tools
+// replaces it with one counting the accesses, see tools/mock/Arduino.h
+#if !defined(SOFTSPI_PORT_REGISTER)
+    #define SOFTSPI_PORT_REGISTER volatile uint8_t
+#endif
+
+
+/**
+ * Port registers and bit mask of a digital pin, resolved once in begin()
+ * so the ISRs can access the pin without going through digitalRead().
+ */
+typedef struct {
+    SOFTSPI_PORT_REGISTER *inReg;  // Port input register (PINx)
+    SOFTSPI_PORT_REGISTER *outReg; // Port output register (PORTx)
+    uint8_t bitMask;          // Bit of the pin within the port
+} softspi_pin_t;
+
+
+class SoftSPIPin {
+public:
+    /**
+     * Looks up the port registers and bit mask of a pin.
+     * An undefined pin (less than 0) resolves to null registers, and must
+     * not be passed to read() or write().
+     *
+     * @param pin digital pin number
+     * @return the resolved pin
+     */
+    static softspi_pin_t resolve(int16_t pin) {
+        softspi_pin_t pinReg = {nullptr, nullptr, 0};
+
+        if (pin >= 0) {
+            uint8_t port = digitalPinToPort(pin);
+
+            pinReg.inReg = portInputRegister(port);
+            pinReg.outReg = portOutputRegister(port);
+            pinReg.bitMask = digitalPinToBitMask(pin);
+        }
+
+        return pinReg;
+    }
+
+    /**
+     * Reads the state of a resolved pin.
+     * Equivalent to digitalRead(), but without the pin table lookups and
+     * PWM timer checks.
+     *
+     * @param pin resolved pin
+     * @return state of the pin
+     */
+    static inline bool read(const softspi_pin_t &pin) {
+        return (*pin.inReg & pin.bitMask) != 0;
+    }
+
+    /**
+     * Sets the state of a resolved pin.
+     * Only called from interrupt context, so the read-modify-write of the
+     * port register can not be interrupted.
+     *
+     * @param pin resolved pin
+     * @param x new state of the pin
+     */
+    static inline void write(const softspi_pin_t &pin, bool x) {
+        if (x) {
+            *pin.outReg |= pin.bitMask;
+        } else {
+            *pin.outReg &= ~pin.bitMask;
+        }
+    }
+
+    /**
+     * Returns millis(), only valid inside an ISR.
+     * Interrupts are already disabled inside an ISR, so the millisecond
+     * count can be read directly instead of saving SREG and disabling
+     * interrupts again like millis() does.
+     *
+     * @return milliseconds since the program started
+     */
+    static inline uint32_t isrMillis() {
+#if defined(ARDUINO_ARCH_AVR)
+        return timer0_millis;
+#else
+        return millis();
+#endif
+    }
+
+    /**
+     * Returns micros(), only valid inside an ISR.
+     * Same as micros() without saving SREG and disabling interrupts again.
+     *
+     * @return microseconds since the program started
+     */
+    static inline uint32_t isrMicros() {
+#if defined(ARDUINO_ARCH_AVR)
+        uint32_t overflows = timer0_overflow_count;
+        uint8_t count = TCNT0;
+
+        // An overflow not yet counted by its ISR
+        if ((TIFR0 & _BV(TOV0)) && count < 255) {
+            overflows++;
+        }
+
+        return ((overflows << 8) + count) * (64 / clockCyclesPerMicrosecond());
+#else
+        return micros();
+#endif
+    }
+};
@@ -0,0 +1,244 @@
+/*
+ * SoftSPIReceiver.h - Bit to Frame Decoding Shared by the Software SPI Slaves
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Everything StaticSoftSPISlave does with a bit once it has been sampled:
+// the clock gap resync, shifting bits into frames, and queueing finished
+// frames. It has no pin or timer access, the caller passes in the sampled
+// bit and the time, so the exact same decoding runs in the host tools.
+
+
+#pragma once
+
+#include <stdint.h>
+#include "PerfCounters.h"
+#include "SoftSPIFrameQueue.h"
+#include "SoftSPITypes.h"
+#include "TraceRing.h"
+
+
+template <softspi_data_order_t Order>
+class SoftSPIReceiver {
+public:
+    SoftSPIReceiver();
+
+    void begin(uint32_t maxClkTime,
+               uint8_t frameLength); // Sets the resync time and frame length, and resets the current frame.
+
+    inline void sample(bool dataState, uint32_t currentTime); // Adds a bit sampled at currentTime to the current frame.
+    inline void restartFrame();                               // Discards the bits of the current frame.
+
+    uint8_t framesAvailable(); // Returns the number of frames that can be read.
+    uint8_t framesRemaining(); // Returns the remaining number of frames that can be received before data is lost.
+    bool hasData();            // Returns true if data is available to be read.
+    bool hasLostData();        // Returns true if data has been lost since the last time this was called.
+    uint32_t read();           // Reads a frame from the receive buffer.
+    uint32_t peek();           // Reads a frame from the receive buffer without removing it.
+
+    uint8_t getResyncCount(); // Returns the count of timeouts due to maxClkTime.
+
+private:
+    uint32_t maxClkTime;  // Max time between sampled bits, disabled when 0.
+    uint32_t lastClkTime; // Time of the previous sampled bit.
+    uint8_t frameLength;  // Bits in a full frame.
+    uint32_t frameTopBit; // Bit the first received bit ends up in when LSB first.
+    uint8_t bitIndex;     // Bits received in the current frame.
+    uint32_t rxData;      // Frame currently being received.
+
+    SoftSPIFrameQueue<uint32_t, RECEIVE_FRAME_BUF_SIZE> rxBuff;
+
+    volatile uint8_t resyncCount;
+    volatile bool rxDataLost;
+};
+
+
+/**
+ * Software SPI receiver constructor.
+ * Defaults to 8-bit frames with the resync disabled.
+ */
+template <softspi_data_order_t Order>
+SoftSPIReceiver<Order>::SoftSPIReceiver() {
+    this->lastClkTime = 0;
+    this->resyncCount = 0;
+    this->rxDataLost = false;
+
+    this->begin(0, 8);
+}
+
+
+/**
+ * Sets the resync time and frame length, and resets the current frame.
+ * maxClkTime is in whatever unit the times passed to sample() are in.
+ *
+ * @param maxClkTime time to wait for another bit before resetting the
+ *                   frame. A value of 0 disables this
+ * @param frameLength bits in each frame, from 1 to 32
+ */
+template <softspi_data_order_t Order>
+void SoftSPIReceiver<Order>::begin(uint32_t maxClkTime, uint8_t frameLength) {
+    this->maxClkTime = maxClkTime;
+    this->frameLength = frameLength;
+    this->frameTopBit = (uint32_t)1 << (frameLength - 1);
+
+    this->restartFrame();
+}
+
+
+/**
+ * Adds a bit sampled at currentTime to the current frame.
+ * If the time since the previous bit is longer than maxClkTime, the
+ * current frame is restarted first. Once the frame is full, it is added
+ * to the receive buffer.
+ * Called from interrupt context by the software SPI slaves.
+ *
+ * @param dataState state of the data line at the sampling edge
+ * @param currentTime time of the sampling edge
+ */
+template <softspi_data_order_t Order>
+inline void SoftSPIReceiver<Order>::sample(bool dataState, uint32_t currentTime) {
+    if (this->maxClkTime > 0) { // maxClkTime is enabled
+        // Reset if the time between clock pulses was too long
+        if (this->bitIndex > 0 && currentTime - this->lastClkTime > this->maxClkTime) {
+            this->restartFrame();
+            this->resyncCount++;
+            PERF_RESYNC(PERF_RESYNC_CLOCK_GAP);
+            TRACE_RESYNC(PERF_RESYNC_CLOCK_GAP);
+        }
+
+        this->lastClkTime = currentTime;
+    }
+
+    // Shift the frame along one bit, after frameLength bits the first
+    // bit received is at the correct end of the frame
+    if (Order == SSPI_MSB_FIRST) {
+        this->rxData = (this->rxData << 1) | dataState;
+
+    } else {
+        this->rxData >>= 1;
+
+        if (dataState) {
+            this->rxData |= this->frameTopBit;
+        }
+    }
+
+    this->bitIndex++;
+
+    if (this->bitIndex >= this->frameLength) {
+        // .push() returns false if the buffer was full
+        if (!this->rxBuff.push(this->rxData)) {
+            this->rxDataLost = true;
+            PERF_LOST_FRAME();
+            TRACE_LOST_FRAME();
+        }
+
+        this->restartFrame();
+    }
+}
+
+/**
+ * Discards the bits of the current frame.
+ */
+template <softspi_data_order_t Order>
+inline void SoftSPIReceiver<Order>::restartFrame() {
+    this->bitIndex = 0;
+    this->rxData = 0;
+}
+
+
+/**
+ * Returns the number of frames that can be read.
+ *
+ * @return the number of frames that can be read
+ */
+template <softspi_data_order_t Order>
+uint8_t SoftSPIReceiver<Order>::framesAvailable() {
+    return this->rxBuff.size();
+}
+
+/**
+ * Returns the remaining number of frames that can be received before
+ * data is lost.
+ *
+ * @return the remaining space in the receive buffer
+ */
+template <softspi_data_order_t Order>
+uint8_t SoftSPIReceiver<Order>::framesRemaining() {
+    return this->rxBuff.available();
+}
+
+/**
+ * Returns true if data is available to be read.
+ *
+ * @return true if data is available to be read
+ */
+template <softspi_data_order_t Order>
+bool SoftSPIReceiver<Order>::hasData() {
+    return !this->rxBuff.isEmpty();
+}
+
+/**
+ * Returns true if data has been lost since the last time this was
+ * called. Frames are only ever lost whole, so the frames that remain
+ * are still aligned.
+ *
+ * @return true if data has been lost
+ */
+template <softspi_data_order_t Order>
+bool SoftSPIReceiver<Order>::hasLostData() {
+    bool retVal = this->rxDataLost;
+
+    this->rxDataLost = false;
+
+    return retVal;
+}
+
+/**
+ * Reads a frame from the receive buffer.
+ * The first received bit is the most significant bit of the frame when
+ * MSB first, or the least significant bit when LSB first.
+ *
+ * @return a frame from the receive buffer, or 0 if it is empty
+ */
+template <softspi_data_order_t Order>
+uint32_t SoftSPIReceiver<Order>::read() {
+    uint32_t frame = 0;
+
+    this->rxBuff.pop(frame);
+
+    return frame;
+}
+
+/**
+ * Reads a frame from the receive buffer without removing it.
+ *
+ * @return a frame from the receive buffer
+ */
+template <softspi_data_order_t Order>
+uint32_t SoftSPIReceiver<Order>::peek() {
+    return this->rxBuff.peek();
+}
+
+/**
+ * Returns the count of timeouts due to maxClkTime.
+ * NOTE: the count wraps at 255.
+ *
+ * @return the count of timeouts due to maxClkTime
+ */
+template <softspi_data_order_t Order>
+uint8_t SoftSPIReceiver<Order>::getResyncCount() {
+    return this->resyncCount;
+}
@@ -0,0 +1,210 @@
+/*
+ * SoftSPISampler.h - Glitch Filtering of the Software SPI Sampling Edge
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Two optional filters for noise around the sampling edge, used by
+// StaticSoftSPISlave before a bit goes to SoftSPIReceiver:
+//   - Edge time: a sampling edge closer than minEdgeTime to the previous
+//     accepted one is a glitch pulse on the clock, and is ignored. Pick
+//     minEdgeTime well under the clock period (~400us on the calipers),
+//     half of it leaves room for jitter.
+//   - Majority vote: the data line is read Samples times and the state
+//     most reads saw is the bit, so a short pulse on the data line (like
+//     ringing through the level shifters) only flips the bit if it covers
+//     most of the reads. The caller spreads the reads out, back to back
+//     reads only span a fraction of a microsecond. Waiting before a single
+//     read instead moves it past the ringing, towards the middle of the bit.
+//
+// On the ATmega32U4 each extra read should cost about 4 cycles plus the
+// spacing (16 cycles per microsecond), and the edge time check a timer
+// read (isrMicros()) and a compare, about 30 cycles. These are estimates
+// from the instructions, not measurements: the cycles taken by the whole
+// clock ISR are only measured on the board with PERF_COUNTERS, see
+// PerfCounters.h. tools/isr-cost.cpp counts the reads and timer reads per
+// edge on the host.
+//
+// Has no pin or timer access, the caller passes in functions reading the
+// time and the pin and waiting, so the host tools run the same filtering
+// against simulated waveforms through readBit(), the same way the clock
+// ISR does.
+
+
+#pragma once
+
+#include <stdint.h>
+
+
+template <uint8_t Samples>
+class SoftSPISampler {
+    static_assert(Samples > 0 && Samples <= 15 && (Samples & 1) == 1, "Samples must be odd, up to 15");
+
+public:
+    SoftSPISampler();
+
+    void begin(uint32_t minEdgeTime); // Sets the shortest time between sampling edges, and resets the filter.
+
+    inline bool filtersEdges();                   // Returns true if the edge time filter is enabled.
+    inline bool acceptEdge(uint32_t currentTime); // Returns false for a sampling edge too close to the previous one.
+
+    template <typename Reader>
+    static inline bool vote(Reader read); // Reads the data line Samples times and returns the majority.
+
+    template <typename Clock, typename Reader, typename Delay>
+    inline bool readBit(Clock now, Reader read, Delay wait, uint8_t sampleSpacing, bool &bit); // Filters a sampling edge and reads its bit.
+
+    uint8_t getRejectedCount(); // Returns the count of sampling edges ignored for being too close.
+
+private:
+    uint32_t minEdgeTime;  // Shortest time between sampling edges, disabled when 0.
+    uint32_t lastEdgeTime; // Time of the previous accepted sampling edge.
+
+    volatile uint8_t rejectedCount;
+};
+
+
+/**
+ * Sampler constructor.
+ * Defaults to the edge time filter disabled.
+ */
+template <uint8_t Samples>
+SoftSPISampler<Samples>::SoftSPISampler() {
+    this->rejectedCount = 0;
+
+    this->begin(0);
+}
+
+
+/**
+ * Sets the shortest time between sampling edges, and resets the filter.
+ * minEdgeTime is in whatever unit the times passed to acceptEdge() are in.
+ *
+ * @param minEdgeTime sampling edges closer than this to the previous
+ *                    accepted edge are ignored. A value of 0 disables this
+ */
+template <uint8_t Samples>
+void SoftSPISampler<Samples>::begin(uint32_t minEdgeTime) {
+    this->minEdgeTime = minEdgeTime;
+    this->lastEdgeTime = 0 - minEdgeTime; // So the first edge is accepted
+}
+
+
+/**
+ * Returns true if the edge time filter is enabled, so the caller only
+ * reads the time when it is needed.
+ *
+ * @return true if minEdgeTime is not 0
+ */
+template <uint8_t Samples>
+inline bool SoftSPISampler<Samples>::filtersEdges() {
+    return this->minEdgeTime > 0;
+}
+
+/**
+ * Returns false for a sampling edge too close to the previous accepted
+ * one, which is then ignored. Ignored edges don't move the previous edge,
+ * so a burst of glitches can't hide the next real edge.
+ * Called from interrupt context.
+ *
+ * @param currentTime time of the sampling edge
+ * @return true if the edge should be sampled
+ */
+template <uint8_t Samples>
+inline bool SoftSPISampler<Samples>::acceptEdge(uint32_t currentTime) {
+    if (this->minEdgeTime > 0) {
+        if (currentTime - this->lastEdgeTime < this->minEdgeTime) {
+            this->rejectedCount++;
+            return false;
+        }
+
+        this->lastEdgeTime = currentTime;
+    }
+
+    return true;
+}
+
+
+/**
+ * Reads the data line Samples times and returns the state most of the
+ * reads saw. With one sample this is just one read.
+ * Called from interrupt context.
+ *
+ * @param read function taking the sample index (0 to Samples - 1) and
+ *             returning the state of the data line, waiting first if the
+ *             samples are spread out
+ * @return the majority state
+ */
+template <uint8_t Samples>
+template <typename Reader>
+inline bool SoftSPISampler<Samples>::vote(Reader read) {
+    if (Samples == 1) {
+        return read(0);
+    }
+
+    uint8_t highCount = 0;
+
+    for (uint8_t i = 0; i < Samples; i++) {
+        highCount += read(i);
+    }
+
+    return highCount > Samples / 2;
+}
+
+
+/**
+ * Filters a sampling edge and reads its bit: the edge time filter if it is
+ * enabled, then the majority vote with sampleSpacing waited before each
+ * read. The time is only read when the edge time filter is enabled.
+ * Called from interrupt context.
+ *
+ * @param now function returning the time of the edge, in the unit of
+ *            minEdgeTime
+ * @param read function returning the state of the data line
+ * @param wait function waiting a number of microseconds
+ * @param sampleSpacing microseconds before each read, 0 for back to back
+ * @param bit set to the majority state if the edge is accepted
+ * @return false if the edge should be ignored
+ */
+template <uint8_t Samples>
+template <typename Clock, typename Reader, typename Delay>
+inline bool SoftSPISampler<Samples>::readBit(Clock now, Reader read, Delay wait, uint8_t sampleSpacing, bool &bit) {
+    if (this->filtersEdges() && !this->acceptEdge(now())) {
+        return false;
+    }
+
+    bit = SoftSPISampler::vote([&](uint8_t) {
+        if (sampleSpacing > 0) {
+            wait(sampleSpacing);
+        }
+
+        return read();
+    });
+
+    return true;
+}
+
+
+/**
+ * Returns the count of sampling edges ignored for being too close to the
+ * previous one.
+ * NOTE: the count wraps at 255.
+ *
+ * @return the count of ignored edges
+ */
+template <uint8_t Samples>
+uint8_t SoftSPISampler<Samples>::getRejectedCount() {
+    return this->rejectedCount;
+}
@@ -16,8 +16,9 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-// WARNING: TX (MISO) functionality is currently untested, as it was only
-// implemented for completeness
+// WARNING: TX (MISO) functionality has only been tested on the simulated
+// board of tools/softspi-equivalence.cpp, as it was only implemented for
+// completeness
 
 
 #include "SoftSPISlave.h"
@@ -46,6 +47,9 @@ SoftSPISlave::SoftSPISlave(int16_t clkPin,
 
 
     this->dataIndex = 0;
+    this->lastClkTime = 0;
+    this->rxData = 0;
+    this->txData = 0;
     this->resyncCount = 0;
     this->rxDataLost = false;
 }
@@ -56,6 +60,8 @@ SoftSPISlave::SoftSPISlave(int16_t clkPin,
  * maxClkTime defines the maximum time to wait for the next clock change
  * while in the middle of a byte. If the time elapses, the current byte
  * is reset to the start for the next clock cycle.
+ * When MISO is not defined, the CLK interrupt is only attached to the
+ * sampling edge, halving the number of interrupts per byte.
  *
  * @param ssActiveHigh if true, slave select is active when high
  * @param spiMode the SPI clock polarity and phase to use
@@ -72,6 +78,12 @@ void SoftSPISlave::begin(bool ssActiveHigh = false,
     this->spiCPOL = SoftSPISlave::getBit(spiMode, 1);
     this->spiDataOrder = spiDataOrder;
     this->maxClkTime = maxClkTime;
+    this->singleEdge = this->misoPin < 0;
+
+    this->clkPinReg = SoftSPIPin::resolve(this->clkPin);
+    this->misoPinReg = SoftSPIPin::resolve(this->misoPin);
+    this->mosiPinReg = SoftSPIPin::resolve(this->mosiPin);
+    this->ssPinReg = SoftSPIPin::resolve(this->ssPin);
 
     int16_t clkIntPin = digitalPinToInterrupt(this->clkPin);
     int16_t ssIntPin = digitalPinToInterrupt(this->ssPin);
@@ -98,7 +110,14 @@ void SoftSPISlave::begin(bool ssActiveHigh = false,
         }
     }
 
-    attachInterrupt(clkIntPin, bindArgGateThisAllocate(&SoftSPISlave::clkIsr, this), CHANGE);
+    uint8_t clkIntMode = CHANGE;
+
+    if (this->singleEdge) {
+        // Nothing is shifted out, so only the sampling edge is needed
+        clkIntMode = this->spiCPHA != this->spiCPOL ? FALLING : RISING;
+    }
+
+    attachInterrupt(clkIntPin, bindArgGateThisAllocate(&SoftSPISlave::clkIsr, this), clkIntMode);
 }
 
 /**
@@ -224,47 +243,51 @@ uint8_t SoftSPISlave::getResyncCount() {
  * Interrupt Service Routine ran on either the RISING or FALLING edge of the clock.
  * Handles setting up the MISO pin on a shift out clock cycle, and reading the
  * MOSI pin on a sampling clock cycle.
+ * In single edge mode every call is a sampling clock cycle.
  */
 void SoftSPISlave::clkIsr() {
-    static uint32_t lastClkTime = 0;
-    static uint8_t rxData = 0;
-    static uint8_t txData = 0;
+    PERF_ISR_TIMER();
 
     // Return if SS is not active
-    if (this->ssPin >= 0 && digitalRead(this->ssPin) == this->ssActiveHigh) {
+    if (this->ssPin >= 0 && SoftSPIPin::read(this->ssPinReg) != this->ssActiveHigh) {
         this->dataIndex = 0;
         return;
     }
 
-    // Sampling when going LOW to HIGH (MODE0, MODE3)
-    bool clkSample = digitalRead(this->clkPin);
-    uint32_t currentTime = millis();
+    bool clkSample = true;
     uint8_t index;
 
+    if (!this->singleEdge) {
+        // Sampling when going LOW to HIGH (MODE0, MODE3)
+        clkSample = SoftSPIPin::read(this->clkPinReg);
+
+        // Figure out when we are sampling or shifting out
+        if (this->spiCPHA != this->spiCPOL) {
+            // Sampling when going HIGH to LOW (MODE1, MODE2)
+            clkSample = !clkSample;
+        }
+    }
+
     // Fill txData with something
     if (!this->txBuff.isEmpty() && this->dataIndex <= 0) {
-        txData = this->txBuff.shift();
+        this->txData = this->txBuff.shift();
 
     } else if (this->dataIndex <= 0) {
         // If buffer is empty send all zeros
-        txData = 0;
+        this->txData = 0;
     }
 
-    // Figure out when we are sampling or shifting out
-    if (this->spiCPHA != this->spiCPOL) {
-        // Sampling when going HIGH to LOW (MODE1, MODE2)
-        clkSample = !clkSample;
-    }
+    if (this->maxClkTime > 0) { // maxClkTime is enabled
+        uint32_t currentTime = SoftSPIPin::isrMillis();
 
-    // Reset if the time between clock pulses was too long
-    if (this->dataIndex > 0
-            && this->maxClkTime > 0 // maxClkTime is enabled
-            && currentTime - lastClkTime > this->maxClkTime) {
-        this->dataIndex = 0;
-        this->resyncCount++;
-    }
+        // Reset if the time between clock pulses was too long
+        if (this->dataIndex > 0 && currentTime - this->lastClkTime > this->maxClkTime) {
+            this->dataIndex = 0;
+            this->resyncCount++;
+        }
 
-    lastClkTime = currentTime;
+        this->lastClkTime = currentTime;
+    }
 
     // Send/Receive bits in the correct order
     if (this->spiDataOrder == SSPI_MSB_FIRST) {
@@ -275,9 +298,9 @@ void SoftSPISlave::clkIsr() {
 
     if (clkSample && this->mosiPin >= 0) {
         // This is a sampling clock cycle
-        bool mosiState = digitalRead(this->mosiPin);
+        bool mosiState = SoftSPIPin::read(this->mosiPinReg);
 
-        rxData = SoftSPISlave::setBitTo(rxData, index, mosiState);
+        this->rxData = SoftSPISlave::setBitTo(this->rxData, index, mosiState);
 
     } else if (!clkSample && this->misoPin >= 0) {
         // This is a shift out clock cycle
@@ -289,15 +312,16 @@ void SoftSPISlave::clkIsr() {
             index++;
         }
 
-        digitalWrite(this->misoPin, SoftSPISlave::getBit(txData, index));
+        SoftSPIPin::write(this->misoPinReg, SoftSPISlave::getBit(this->txData, index));
     }
 
-    this->dataIndex++;
+    // The skipped shift out edge still counts towards the byte
+    this->dataIndex += this->singleEdge ? 2 : 1;
 
     if (this->dataIndex > 15) {
         // Deal with buffers and reset
         // .push() returns false if an overwrite occurred
-        this->rxDataLost = !this->rxBuff.push(rxData);
+        this->rxDataLost = !this->rxBuff.push(this->rxData);
         this->dataIndex = 0;
     }
 }
@@ -308,7 +332,7 @@ void SoftSPISlave::clkIsr() {
  * Sets MISO as an input when going inactive.
  */
 void SoftSPISlave::ssIsr() {
-    bool ssActive = digitalRead(this->ssPin) == this->ssActiveHigh;
+    bool ssActive = SoftSPIPin::read(this->ssPinReg) == this->ssActiveHigh;
 
     if (ssActive) {
         // We have been select
@@ -320,10 +344,10 @@ void SoftSPISlave::ssIsr() {
         // Only set state if there is something in the buffer
         if (!this->txBuff.isEmpty()) {
             uint8_t startBit = this->spiDataOrder == SSPI_MSB_FIRST ? 7 : 0;
-            bool state = SoftSPISlave::getBit(this->txBuff.first(), startBit);
+            state = SoftSPISlave::getBit(this->txBuff.first(), startBit);
         }
 
-        digitalWrite(this->misoPin, state);
+        SoftSPIPin::write(this->misoPinReg, state);
 
         this->dataIndex = 0;
 
@@ -344,7 +368,7 @@ void SoftSPISlave::ssIsr() {
  * @param x new state of the bit
  * @return modified byte
  */
-static inline uint8_t SoftSPISlave::setBitTo(uint8_t number, uint8_t n, bool x) {
+inline uint8_t SoftSPISlave::setBitTo(uint8_t number, uint8_t n, bool x) {
     return (number & ~((uint8_t)1 << n)) | ((uint8_t)x << n);
 }
 
@@ -356,6 +380,6 @@ static inline uint8_t SoftSPISlave::setBitTo(uint8_t number, uint8_t n, bool x)
  * @param n index of the bit
  * @return state of the bit
  */
-static inline bool SoftSPISlave::getBit(uint8_t number, uint8_t n) {
+inline bool SoftSPISlave::getBit(uint8_t number, uint8_t n) {
     return (number >> n) & 1;
 }
@@ -16,8 +16,14 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-// WARNING: TX (MISO) functionality is currently untested, as it was only
-// implemented for completeness
+// The cycles taken by clkIsr() per clock edge are only measured on the
+// board, with PERF_COUNTERS (perf_isr_cycles), see PerfCounters.h. On the
+// host, tools/isr-cost.cpp counts the port register reads, timer reads and
+// Arduino calls it makes per edge, and fails when they go over budget.
+
+// WARNING: TX (MISO) functionality has only been tested on the simulated
+// board of tools/softspi-equivalence.cpp, as it was only implemented for
+// completeness
 
 
 #pragma once
@@ -28,28 +34,9 @@
 #include <Arduino.h>
 #include <BindArg.h>
 #include <CircularBuffer.hpp>
-
-
-const uint8_t RECEIVE_BUF_SIZE = 64;
-const uint8_t TRANSMIT_BUF_SIZE = 64;
-
-
-typedef enum : uint8_t {
-    SSPI_MODE0,
-    SSPI_MODE1,
-    SSPI_MODE2,
-    SSPI_MODE3
-} softspi_mode_t;
-
-typedef enum : uint8_t {
-    SSPI_MSB_FIRST,
-    SSPI_LSB_FIRST
-} softspi_data_order_t;
-
-typedef enum : uint8_t {
-    SSPI_CLK_ISR,
-    SSPI_SS_ISR
-} softspi_isr_t;
+#include "PerfCounters.h"
+#include "SoftSPIPin.h"
+#include "SoftSPITypes.h"
 
 
 class SoftSPISlave {
@@ -87,12 +74,21 @@ private:
     int16_t ssPin;   // Slave select.
     bool ssActiveHigh;
 
+    softspi_pin_t clkPinReg;  // Resolved CLK pin, set in begin().
+    softspi_pin_t misoPinReg; // Resolved MISO pin, set in begin().
+    softspi_pin_t mosiPinReg; // Resolved MOSI pin, set in begin().
+    softspi_pin_t ssPinReg;   // Resolved SS pin, set in begin().
+
     bool spiCPHA;
     bool spiCPOL;
     softspi_data_order_t spiDataOrder;
 
-    uint32_t maxClkTime; // Max time between clock pulses, disabled when 0.
-    uint8_t dataIndex;   // Increments two times each clock (one RISING, one FALLING).
+    uint32_t maxClkTime;  // Max time between clock pulses, disabled when 0.
+    uint32_t lastClkTime; // Time of the previous clock change.
+    uint8_t dataIndex;    // Twice the bit index: +1 per clock edge, or +2 per sampling edge when singleEdge.
+    uint8_t rxData;       // Byte currently being received.
+    uint8_t txData;       // Byte currently being sent.
+    bool singleEdge;      // Only the sampling edge is interrupted on, when there is no MISO.
 
     volatile CircularBuffer<uint8_t, RECEIVE_BUF_SIZE> rxBuff;
     volatile CircularBuffer<uint8_t, TRANSMIT_BUF_SIZE> txBuff;
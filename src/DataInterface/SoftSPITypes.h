@@ -0,0 +1,48 @@
+/*
+ * SoftSPITypes.h - Types and Sizes Shared by the SPI Slave Receivers
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Kept free of Arduino includes so the decoding code can also be built
+// for the host tools.
+
+
+#pragma once
+
+#include <stdint.h>
+
+
+const uint8_t RECEIVE_BUF_SIZE = 64;
+const uint8_t TRANSMIT_BUF_SIZE = 64;
+const uint8_t RECEIVE_FRAME_BUF_SIZE = 16; // Must be a power of 2
+
+
+typedef enum : uint8_t {
+    SSPI_MODE0,
+    SSPI_MODE1,
+    SSPI_MODE2,
+    SSPI_MODE3
+} softspi_mode_t;
+
+typedef enum : uint8_t {
+    SSPI_MSB_FIRST,
+    SSPI_LSB_FIRST
+} softspi_data_order_t;
+
+typedef enum : uint8_t {
+    SSPI_CLK_ISR,
+    SSPI_SS_ISR
+} softspi_isr_t;
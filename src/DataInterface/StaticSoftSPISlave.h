@@ -0,0 +1,462 @@
+/*
+ * StaticSoftSPISlave.h - SPI Slave Implemented in Software, Configured at Compile Time
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Same behavior as SoftSPISlave, but the SPI mode, data order, and which
+// of MISO, MOSI, and SS are used are template parameters. Every branch on
+// them in the ISR is resolved by the compiler, so the clock ISR only
+// contains the code for the configuration actually in use.
+// SoftSPISlave remains available when the configuration is only known at
+// runtime.
+// Received bits are grouped into frames of a configurable length (1 to 32
+// bits) inside the ISR, so a whole packet is read with a single read().
+// The framing itself is done by SoftSPIReceiver, this class only handles
+// the pins and interrupts.
+// Optionally, the data line is read DataSamples times per bit with a
+// majority vote, and sampling edges too close to the previous one are
+// ignored as glitches, see SoftSPISampler.h.
+
+// WARNING: TX (MISO) functionality has only been tested on the simulated
+// board of tools/softspi-equivalence.cpp, as it was only implemented for
+// completeness
+
+
+#pragma once
+
+#define CIRCULAR_BUFFER_INT_SAFE // Enable interrupt safety in CircularBuffer library
+
+#include <stdint.h>
+#include <Arduino.h>
+#include <BindArg.h>
+#include <CircularBuffer.hpp>
+#include "PerfCounters.h"
+#include "SoftSPIPin.h"
+#include "SoftSPIReceiver.h"
+#include "SoftSPISampler.h"
+#include "SoftSPITypes.h"
+
+
+template <softspi_mode_t Mode,
+          softspi_data_order_t Order,
+          bool HasMiso,
+          bool HasMosi,
+          bool HasSs,
+          uint8_t DataSamples = 1>
+class StaticSoftSPISlave {
+    static_assert(HasMiso || HasMosi, "At least one of MISO or MOSI must be used");
+    static_assert(!HasMiso || HasSs, "SS must be used when MISO is used");
+
+public:
+    StaticSoftSPISlave(int16_t clkPin,
+                       int16_t misoPin = -1,
+                       int16_t mosiPin = -1,
+                       int16_t ssPin = -1);
+
+    void begin(bool ssActiveHigh = false,
+               uint32_t maxClkTime = 0,
+               uint8_t frameLength = 8,
+               uint16_t minClkTime = 0,
+               uint8_t sampleSpacing = 0); // Starts sending or receiving data on the SPI bus.
+    void end();                          // Stops sending or receiving data on the SPI bus.
+
+    // RX
+    uint8_t rxFramesAvailable(); // Returns the number of frames that can be read.
+    uint8_t rxFramesRemaining(); // Returns the remaining number of frames that can be received before data is lost.
+    bool rxHasData();            // Returns true if data is available to be read.
+    bool rxHasLostData();        // Returns true if data has been lost since the last time this was called.
+    uint32_t read();             // Reads a frame from the receive buffer.
+    uint32_t peek();             // Reads a frame from the receive buffer without removing it.
+
+    // TX
+    uint8_t txBytesAvailable(); // Returns the remaining number of bytes that can be added to the transmit buffer without blocking.
+    bool txIsFull();            // Returns true if the transmit buffer is full.
+    void write(uint8_t data);   // Adds a byte to the transmit buffer.
+
+    uint8_t getResyncCount();      // Returns the count of timeouts due to maxClkTime.
+    uint8_t getFilteredEdgeCount(); // Returns the count of sampling edges ignored due to minClkTime.
+
+private:
+    static constexpr bool SPI_CPHA = (Mode & 0b01) != 0;
+    static constexpr bool SPI_CPOL = (Mode & 0b10) != 0;
+    static constexpr bool SAMPLE_FALLING = SPI_CPHA != SPI_CPOL; // Sampling when going HIGH to LOW (MODE1, MODE2)
+    static constexpr bool SINGLE_EDGE = !HasMiso;                // Only the sampling edge is interrupted on when RX only
+
+    int16_t clkPin;  // Serial clock.
+    int16_t misoPin; // Serial data slave out.
+    int16_t mosiPin; // Serial data slave in.
+    int16_t ssPin;   // Slave select.
+    bool ssActiveHigh;
+
+    softspi_pin_t clkPinReg;  // Resolved CLK pin, set in begin().
+    softspi_pin_t misoPinReg; // Resolved MISO pin, set in begin().
+    softspi_pin_t mosiPinReg; // Resolved MOSI pin, set in begin().
+    softspi_pin_t ssPinReg;   // Resolved SS pin, set in begin().
+
+    uint8_t txIndex; // Bits shifted out of the current byte.
+    uint8_t txData;  // Byte currently being sent.
+
+    uint8_t sampleSpacing; // Microseconds before each read of the data line.
+
+    SoftSPIReceiver<Order> receiver;
+    SoftSPISampler<DataSamples> sampler;
+    volatile CircularBuffer<uint8_t, TRANSMIT_BUF_SIZE> txBuff;
+
+    void clkIsr(); // Interrupt Service Routine ran on the sampling edge, or both edges of the clock when MISO is used.
+    void ssIsr();  // Interrupt Service Routine ran on either the RISING or FALLING edge of slave select.
+
+    static inline bool getBit(uint8_t number, uint8_t n); // Get bin at index n.
+};
+
+
+/**
+ * Compile time configured software SPI slave constructor.
+ * The CLK pin must be an interrupt capable pin. The MISO, MOSI, and SS
+ * pins only need to be given when their matching template parameter is
+ * true. If MISO is used then SS must be an interrupt capable pin.
+ *
+ * @param clkPin serial clock pin
+ * @param misoPin master in, slave out pin
+ * @param mosiPin master out, slave in pin
+ * @param ssPin slave select pin
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::StaticSoftSPISlave(int16_t clkPin,
+                                                                             int16_t misoPin,
+                                                                             int16_t mosiPin,
+                                                                             int16_t ssPin) {
+    this->clkPin = clkPin;
+    this->misoPin = misoPin;
+    this->mosiPin = mosiPin;
+    this->ssPin = ssPin;
+
+    this->txIndex = 0;
+    this->txData = 0;
+    this->sampleSpacing = 0;
+}
+
+
+/**
+ * Starts sending or receiving data on the SPI bus.
+ * maxClkTime defines the maximum time to wait for the next clock change
+ * while in the middle of a frame. If the time elapses, the current frame
+ * is reset to the start for the next clock cycle.
+ * When RX only, the CLK interrupt is only attached to the sampling edge,
+ * halving the number of interrupts per frame.
+ * Transmitting is always done a byte at a time, frameLength only applies
+ * to received data.
+ *
+ * @param ssActiveHigh if true, slave select is active when high
+ * @param maxClkTime milliseconds to wait for another clock before
+ *                   resetting. A value of 0 disables this
+ * @param frameLength bits in each received frame, from 1 to 32
+ * @param minClkTime microseconds - sampling edges closer than this to the
+ *                   previous one are ignored as glitches. A value of 0
+ *                   disables this
+ * @param sampleSpacing microseconds before each of the DataSamples reads
+ *                      of the data line, 0 for back to back reads. With
+ *                      one sample this delays the read into the bit
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+void StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::begin(bool ssActiveHigh,
+                                                                     uint32_t maxClkTime,
+                                                                     uint8_t frameLength,
+                                                                     uint16_t minClkTime,
+                                                                     uint8_t sampleSpacing) {
+    if (frameLength < 1 || frameLength > 32) {
+        return;
+    }
+
+    this->ssActiveHigh = ssActiveHigh;
+    this->receiver.begin(maxClkTime, frameLength);
+    this->sampler.begin(minClkTime);
+    this->sampleSpacing = sampleSpacing;
+
+    this->clkPinReg = SoftSPIPin::resolve(this->clkPin);
+    this->misoPinReg = SoftSPIPin::resolve(HasMiso ? this->misoPin : -1);
+    this->mosiPinReg = SoftSPIPin::resolve(HasMosi ? this->mosiPin : -1);
+    this->ssPinReg = SoftSPIPin::resolve(HasSs ? this->ssPin : -1);
+
+    int16_t clkIntPin = digitalPinToInterrupt(this->clkPin);
+    int16_t ssIntPin = digitalPinToInterrupt(this->ssPin);
+
+    if (clkIntPin < 0 // CLK pin is not set, or not an interrupt capable pin
+            || (HasMiso && ssIntPin < 0)) { // MISO is used and SS is not interrupt capable
+        return;
+    }
+
+    pinMode(this->clkPin, INPUT);
+
+    if (HasMosi) {
+        pinMode(this->mosiPin, INPUT);
+    }
+
+    if (HasSs) {
+        pinMode(this->ssPin, INPUT);
+    }
+
+    if (HasMiso) {
+        attachInterrupt(ssIntPin, bindArgGateThisAllocate(&StaticSoftSPISlave::ssIsr, this), CHANGE);
+    }
+
+    // Nothing is shifted out when RX only, so only the sampling edge is needed
+    uint8_t clkIntMode = !SINGLE_EDGE ? CHANGE : SAMPLE_FALLING ? FALLING : RISING;
+
+    attachInterrupt(clkIntPin, bindArgGateThisAllocate(&StaticSoftSPISlave::clkIsr, this), clkIntMode);
+}
+
+/**
+ * Stops sending or receiving data on the SPI bus.
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+void StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::end() {
+    detachInterrupt(digitalPinToInterrupt(this->clkPin));
+
+    if (HasMiso) {
+        // SS would have been setup with interrupts
+        detachInterrupt(digitalPinToInterrupt(this->ssPin));
+
+        // Only MISO is ever an output
+        pinMode(this->misoPin, INPUT);
+    }
+}
+
+
+/**
+ * Returns the number of frames that can be read.
+ *
+ * @return the number of frames that can be read
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+uint8_t StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::rxFramesAvailable() {
+    return this->receiver.framesAvailable();
+}
+
+/**
+ * Returns the remaining number of frames that can be received before
+ * data is lost.
+ *
+ * @return the remaining space in the RX buffer
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+uint8_t StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::rxFramesRemaining() {
+    return this->receiver.framesRemaining();
+}
+
+/**
+ * Returns true if data is available to be read.
+ *
+ * @return true if data is available to be read
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+bool StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::rxHasData() {
+    return this->receiver.hasData();
+}
+
+/**
+ * Returns true if data has been lost since the last time this was
+ * called. Frames are only ever lost whole, so the frames that remain
+ * are still aligned.
+ *
+ * @return true if data has been lost
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+bool StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::rxHasLostData() {
+    return this->receiver.hasLostData();
+}
+
+/**
+ * Reads a frame from the receive buffer.
+ * The first received bit is the most significant bit of the frame when
+ * MSB first, or the least significant bit when LSB first.
+ *
+ * @return a frame from the receive buffer, or 0 if it is empty
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+uint32_t StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::read() {
+    return this->receiver.read();
+}
+
+/**
+ * Reads a frame from the receive buffer without removing it.
+ *
+ * @return a frame from the receive buffer
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+uint32_t StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::peek() {
+    return this->receiver.peek();
+}
+
+
+/**
+ * Returns the remaining number of bytes that can be added to the transmit
+ * buffer without blocking.
+ *
+ * @return bytes available in the transmit buffer
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+uint8_t StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::txBytesAvailable() {
+    return this->txBuff.available();
+}
+
+/**
+ * Returns true if the transmit buffer is full.
+ *
+ * @return true if the transmit buffer is full
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+bool StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::txIsFull() {
+    return this->txBuff.isFull();
+}
+
+/**
+ * Adds a byte to the transmit buffer.
+ *
+ * @param data the byte to enqueue
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+void StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::write(uint8_t data) {
+    this->txBuff.push(data);
+}
+
+/**
+ * Returns the count of timeouts due to maxClkTime.
+ * NOTE: the count wraps at 255.
+ *
+ * @return the count of timeouts due to maxClkTime
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+uint8_t StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::getResyncCount() {
+    return this->receiver.getResyncCount();
+}
+
+/**
+ * Returns the count of sampling edges ignored for being closer than
+ * minClkTime to the previous one.
+ * NOTE: the count wraps at 255.
+ *
+ * @return the count of ignored sampling edges
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+uint8_t StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::getFilteredEdgeCount() {
+    return this->sampler.getRejectedCount();
+}
+
+
+/**
+ * Interrupt Service Routine ran on the sampling edge of the clock, or on
+ * both edges when MISO is used.
+ * Handles setting up the MISO pin on a shift out clock cycle, and reading the
+ * MOSI pin on a sampling clock cycle.
+ * Decodes the same as SoftSPISlave::clkIsr() given the same configuration
+ * and a frame length of 8, checked by tools/softspi-equivalence.cpp.
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+void StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::clkIsr() {
+    PERF_ISR_TIMER();
+
+    // Return if SS is not active
+    if (HasSs && SoftSPIPin::read(this->ssPinReg) != this->ssActiveHigh) {
+        this->receiver.restartFrame();
+        this->txIndex = 0;
+        return;
+    }
+
+    // Every edge is a sampling edge when RX only
+    bool clkSample = SINGLE_EDGE || SoftSPIPin::read(this->clkPinReg) != SAMPLE_FALLING;
+
+    if (HasMosi && clkSample) {
+        // This is a sampling clock cycle, unless it is a glitch
+        bool dataState;
+
+        if (!this->sampler.readBit([]() { return SoftSPIPin::isrMicros(); },
+                                   [this]() { return SoftSPIPin::read(this->mosiPinReg); },
+                                   [](uint8_t time) { delayMicroseconds(time); },
+                                   this->sampleSpacing,
+                                   dataState)) {
+            return;
+        }
+
+        this->receiver.sample(dataState, SoftSPIPin::isrMillis());
+
+    } else if (HasMiso && !clkSample) {
+        // This is a shift out clock cycle
+        // Fill txData with something, if the buffer is empty send all zeros
+        if (this->txIndex == 0) {
+            this->txData = this->txBuff.isEmpty() ? 0 : this->txBuff.shift();
+        }
+
+        uint8_t index = Order == SSPI_MSB_FIRST ? 7 - this->txIndex : this->txIndex;
+
+        if (!SPI_CPHA) { // SPI MODE0 or MODE2
+            // Need to set MISO to future bit, see SoftSPISlave::clkIsr()
+            index++;
+        }
+
+        SoftSPIPin::write(this->misoPinReg, StaticSoftSPISlave::getBit(this->txData, index));
+
+        this->txIndex = (this->txIndex + 1) & 7;
+    }
+}
+
+/**
+ * Interrupt Service Routine ran on either the RISING or FALLING edge of slave select.
+ * Sets MISO as an output and sets it up for the next clock cycle when going active.
+ * Sets MISO as an input when going inactive.
+ * Only attached when MISO is used.
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+void StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::ssIsr() {
+    bool ssActive = SoftSPIPin::read(this->ssPinReg) == this->ssActiveHigh;
+
+    if (ssActive) {
+        // We have been select
+        // Setup MISO pin for initial cycle
+        pinMode(this->misoPin, OUTPUT);
+
+        bool state = false;
+
+        // Only set state if there is something in the buffer
+        if (!this->txBuff.isEmpty()) {
+            uint8_t startBit = Order == SSPI_MSB_FIRST ? 7 : 0;
+            state = StaticSoftSPISlave::getBit(this->txBuff.first(), startBit);
+        }
+
+        SoftSPIPin::write(this->misoPinReg, state);
+
+        this->receiver.restartFrame();
+        this->txIndex = 0;
+
+    } else {
+        // We have been deselected
+        // Set back to input so other devices can use the line
+        pinMode(this->misoPin, INPUT);
+    }
+}
+
+
+/**
+ * Get bin at index n.
+ * Index 0 is the least significant bit.
+ *
+ * @param number byte to get bit
+ * @param n index of the bit
+ * @return state of the bit
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, bool HasMosi, bool HasSs, uint8_t DataSamples>
+inline bool StaticSoftSPISlave<Mode, Order, HasMiso, HasMosi, HasSs, DataSamples>::getBit(uint8_t number, uint8_t n) {
+    return (number >> n) & 1;
+}
@@ -0,0 +1,233 @@
+/*
+ * TraceRing.cpp - Deferred Binary Debug Trace
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "TraceRing.h"
+
+
+#if defined(TRACE_ENABLED)
+    TraceRing traceRing;
+#endif
+
+
+/**
+ * Writes the frame for an event.
+ *
+ * @param event event to send
+ * @param frame array of TRACE_STREAM_FRAME_SIZE bytes to fill
+ */
+void TraceRing::encode(const trace_event_t &event, uint8_t *frame) {
+    frame[0] = TRACE_STREAM_SYNC;
+    frame[1] = (event.type & 0x0F) | (event.channel << 4);
+    frame[2] = event.data;
+    frame[3] = event.data >> 8;
+    frame[4] = event.data >> 16;
+    frame[5] = event.data >> 24;
+    frame[6] = event.time;
+    frame[7] = event.time >> 8;
+    frame[8] = event.time >> 16;
+    frame[9] = event.time >> 24;
+
+    uint16_t crc = PacketStream::crc16(frame, TRACE_STREAM_FRAME_SIZE - 2);
+
+    frame[10] = crc;
+    frame[11] = crc >> 8;
+}
+
+
+/**
+ * Trace ring constructor.
+ */
+TraceRing::TraceRing() {
+    this->clear();
+}
+
+
+/**
+ * Removes every event, and clears the dropped count.
+ */
+void TraceRing::clear() {
+    #if defined(TRACE_ENABLED)
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    #endif
+    {
+        this->head = 0;
+        this->tail = 0;
+        this->dropHead = 0;
+        this->droppedCount = 0;
+    }
+}
+
+
+/**
+ * Removes the oldest event, only called from loop(). Recording only ever
+ * writes head, so this needs no lock.
+ *
+ * @param event set to the oldest event
+ * @return false if the ring was empty
+ */
+bool TraceRing::pop(trace_event_t &event) {
+    uint8_t tail = this->tail;
+
+    if (tail == this->head) {
+        return false;
+    }
+
+    const volatile trace_event_t &oldest = this->events[tail & INDEX_MASK];
+
+    event.time = oldest.time;
+    event.data = oldest.data;
+    event.type = oldest.type;
+    event.channel = oldest.channel;
+
+    this->tail = tail + 1; // Free the slot only after the event is read
+
+    return true;
+}
+
+/**
+ * Returns the number of events in the ring.
+ *
+ * @return the number of events
+ */
+uint8_t TraceRing::size() {
+    return this->head - this->tail;
+}
+
+/**
+ * Returns the number of events dropped because the ring was full, since
+ * the last call, up to 65535.
+ *
+ * @return the number of events
+ */
+uint16_t TraceRing::takeDroppedCount() {
+    uint16_t count;
+
+    #if defined(TRACE_ENABLED)
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    #endif
+    {
+        count = this->droppedCount;
+        this->droppedCount = 0;
+    }
+
+    return count;
+}
+
+
+/**
+ * Trace stream reader constructor.
+ */
+TraceStream::TraceStream() {
+    this->event = {0, 0, 0, 0};
+    this->skippedCount = 0;
+
+    this->reset();
+}
+
+
+/**
+ * Discards any partly received frame.
+ */
+void TraceStream::reset() {
+    this->length = 0;
+}
+
+
+/**
+ * Adds a received byte. Bytes before a sync byte, and frames with a bad
+ * CRC, are skipped.
+ *
+ * @param byte next byte of the stream
+ * @return true if a frame was completed, read it with getEvent()
+ */
+bool TraceStream::push(uint8_t byte) {
+    this->frame[this->length++] = byte;
+
+    if (this->frame[0] != TRACE_STREAM_SYNC) {
+        this->skip();
+        return false;
+    }
+
+    if (this->length < TRACE_STREAM_FRAME_SIZE) {
+        return false;
+    }
+
+    uint16_t crc = this->frame[10] | ((uint16_t)this->frame[11] << 8);
+
+    if (PacketStream::crc16(this->frame, TRACE_STREAM_FRAME_SIZE - 2) != crc) {
+        this->skip();
+        return false;
+    }
+
+    this->event.type = this->frame[1] & 0x0F;
+    this->event.channel = this->frame[1] >> 4;
+    this->event.data = this->frame[2]
+                     | ((uint32_t)this->frame[3] << 8)
+                     | ((uint32_t)this->frame[4] << 16)
+                     | ((uint32_t)this->frame[5] << 24);
+    this->event.time = this->frame[6]
+                     | ((uint32_t)this->frame[7] << 8)
+                     | ((uint32_t)this->frame[8] << 16)
+                     | ((uint32_t)this->frame[9] << 24);
+
+    this->length = 0;
+
+    return true;
+}
+
+/**
+ * Returns the last complete frame.
+ *
+ * @return the event of the frame
+ */
+trace_event_t TraceStream::getEvent() {
+    return this->event;
+}
+
+
+/**
+ * Returns the number of bytes skipped to find frames, from lost bytes or
+ * starting partway through a frame.
+ *
+ * @return the number of bytes
+ */
+uint32_t TraceStream::getSkippedCount() {
+    return this->skippedCount;
+}
+
+
+/**
+ * Drops the first byte of frame, and shifts the rest down to the next sync
+ * byte so a frame starting inside a bad one is still found.
+ */
+void TraceStream::skip() {
+    uint8_t start = 1;
+
+    while (start < this->length && this->frame[start] != TRACE_STREAM_SYNC) {
+        start++;
+    }
+
+    this->skippedCount += start;
+
+    for (uint8_t i = start; i < this->length; i++) {
+        this->frame[i - start] = this->frame[i];
+    }
+
+    this->length -= start;
+}
@@ -0,0 +1,236 @@
+/*
+ * TraceRing.h - Deferred Binary Debug Trace (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Debug trace that keeps the timing of a release build. Instead of printing
+// as things happen, which blocks once the USB serial buffer is full, fixed
+// size events are copied into a RAM ring, from ISRs and loop() alike, and
+// loop() only sends them when it has nothing else to do. When the ring is
+// full new events are dropped and counted, the count is sent as an event of
+// its own where the first of them was dropped.
+//
+// Each event is sent as one fixed size frame, multi-byte fields little
+// endian:
+//
+//   byte  0      sync, TRACE_STREAM_SYNC
+//   byte  1      bits 0-3 trace_event_type_t, bits 4-7 channel
+//   bytes 2-5    data, see trace_event_type_t
+//   bytes 6-9    microseconds when the event was recorded
+//   bytes 10-11  CRC-16/CCITT-FALSE of bytes 0 to 9, see PacketStream.h
+//
+// tools/trace-reader.cpp prints the frames as text.
+//
+// Only compiled in when DEBUG_TRACE is defined below (it is here rather
+// than in the sketch so the capture code sees the same setting). The
+// TRACE_* macros are empty otherwise, and in the host tools. The ring and
+// the framing have no Arduino dependency, so the host tools read the
+// frames with the same code.
+
+
+#pragma once
+
+#include <stdint.h>
+#include "PacketStream.h"
+#include "PerfCounters.h"
+
+// #define DEBUG_TRACE
+
+#if defined(DEBUG_TRACE) && defined(ARDUINO_ARCH_AVR)
+    #define TRACE_ENABLED
+    #include <Arduino.h>
+    #include <util/atomic.h>
+#endif
+
+
+const uint8_t TRACE_RING_SIZE = 32; // Events, a power of 2 up to 128
+
+const uint8_t TRACE_STREAM_SYNC = 0xC7;
+const uint8_t TRACE_STREAM_FRAME_SIZE = 12;
+
+const uint32_t TRACE_PACKET_REJECTED = 0x01000000; // TRACE_EVENT_PACKET data flag, the packet filter rejected the packet
+const uint32_t TRACE_TYPED_STALLED = 0x01000000;   // TRACE_EVENT_TYPED data flag, the rest was given up because the host stalled
+
+const uint8_t TRACE_TRIGGER_BUTTON = 0; // TRACE_EVENT_TRIGGER channel of the trigger pin
+const uint8_t TRACE_TRIGGER_AUTO = 1;   // TRACE_EVENT_TRIGGER channel of auto trigger
+
+typedef enum : uint8_t {
+    TRACE_EVENT_BOOT = 0,       // setup() finished
+    TRACE_EVENT_PACKET = 1,     // loop() read a packet. channel: caliper, data: 24-bit packet as sent, | TRACE_PACKET_REJECTED
+    TRACE_EVENT_RESYNC = 2,     // The frame being received was restarted. data: perf_resync_reason_t
+    TRACE_EVENT_LOST = 3,       // A frame was dropped because the receive queue was full
+    TRACE_EVENT_TRIGGER = 4,    // Trigger. channel: TRACE_TRIGGER_*, data: presses not yet queued, including this one
+    TRACE_EVENT_TYPING = 5,     // A sequence started being typed. data: triggers still queued behind it
+    TRACE_EVENT_TYPED = 6,      // The sequence was typed. data: bits 0-15 reports sent, | TRACE_TYPED_STALLED
+    TRACE_EVENT_AWAKE = 7,      // Since the previous one. data: bits 0-15 permille of the time awake, bits 16-31 wakes
+    TRACE_EVENT_SETTLE = 8,     // After a packet. data: milliseconds the reading has been stable
+    TRACE_EVENT_BIT_TIMING = 9, // After a packet (INPUT_CAPTURE). data: bits 0-15 bit period, bits 16-31 longest bit period, microseconds
+    TRACE_EVENT_DROPPED = 10,   // Events were dropped because the ring was full. data: count
+    TRACE_EVENT_TYPES = 11
+} trace_event_type_t;
+
+constexpr const char *TRACE_EVENT_NAMES[TRACE_EVENT_TYPES] = {
+    "boot", "packet", "resync", "lost", "trigger", "typing", "typed", "awake", "settle", "bit_timing", "dropped"
+};
+
+/**
+ * One event.
+ */
+typedef struct {
+    uint32_t time;   // Microseconds
+    uint32_t data;   // Depends on type
+    uint8_t type;    // trace_event_type_t
+    uint8_t channel; // 0 to 15
+} trace_event_t;
+
+
+class TraceRing {
+public:
+    static void encode(const trace_event_t &event,
+                       uint8_t *frame); // Writes the frame for an event.
+
+    TraceRing();
+
+    void clear(); // Removes every event.
+
+    inline void record(uint8_t type,
+                       uint8_t channel,
+                       uint32_t data,
+                       uint32_t time); // Adds an event, from interrupt or loop() context.
+
+    bool pop(trace_event_t &event); // Removes the oldest event, only called from loop().
+    uint8_t size();                 // Returns the number of events in the ring.
+    uint16_t takeDroppedCount();    // Returns the number of events dropped since the last call.
+
+    template <typename Output>
+    void drain(Output &out, uint32_t currentTime); // Sends as many events as fit without waiting.
+
+private:
+    static constexpr uint8_t INDEX_MASK = TRACE_RING_SIZE - 1;
+
+    volatile trace_event_t events[TRACE_RING_SIZE];
+    volatile uint8_t head; // Free running count of recorded events
+    volatile uint8_t tail; // Free running count of popped events
+    volatile uint8_t dropHead; // head when the first event counted in droppedCount was dropped
+    volatile uint16_t droppedCount;
+};
+
+
+class TraceStream {
+public:
+    TraceStream();
+
+    void reset();                // Discards any partly received frame.
+    bool push(uint8_t byte);     // Adds a received byte, returns true when a frame is complete.
+    trace_event_t getEvent();    // Returns the last complete frame.
+    uint32_t getSkippedCount();  // Returns the number of bytes skipped to find frames.
+
+private:
+    uint8_t frame[TRACE_STREAM_FRAME_SIZE]; // Bytes received of the current frame
+    uint8_t length;                         // Bytes in frame
+    trace_event_t event;                    // Last complete frame
+    uint32_t skippedCount;
+
+    void skip(); // Drops the first byte of frame and looks for the next sync.
+};
+
+
+static_assert(TRACE_RING_SIZE > 0 && TRACE_RING_SIZE <= 128 && (TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0,
+              "TRACE_RING_SIZE must be a power of 2, up to 128");
+
+
+/**
+ * Adds an event, dropping it if the ring is full. Interrupts are disabled
+ * while it is written, so ISRs and loop() can both record.
+ *
+ * @param type trace_event_type_t
+ * @param channel caliper or other detail of the event, 0 to 15
+ * @param data depends on type
+ * @param time microseconds
+ */
+inline void TraceRing::record(uint8_t type, uint8_t channel, uint32_t data, uint32_t time) {
+    #if defined(TRACE_ENABLED)
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    #endif
+    {
+        uint8_t head = this->head;
+
+        if ((uint8_t)(head - this->tail) >= TRACE_RING_SIZE) {
+            if (this->droppedCount == 0) {
+                this->dropHead = head;
+            }
+
+            if (this->droppedCount < 0xFFFF) {
+                this->droppedCount++;
+            }
+
+        } else {
+            volatile trace_event_t &event = this->events[head & INDEX_MASK];
+
+            event.time = time;
+            event.data = data;
+            event.type = type;
+            event.channel = channel;
+
+            this->head = head + 1; // Publish only after the event is written
+        }
+    }
+}
+
+
+/**
+ * Sends as many events as fit in out without waiting, oldest first, one
+ * frame each. The count of dropped events is sent after the events that
+ * were in the ring when the first of them was dropped.
+ * Call from loop() when there is nothing else to do.
+ *
+ * @param out anything with availableForWrite() and write(buffer, size),
+ *            such as Serial
+ * @param currentTime microseconds, the time of a dropped count event
+ */
+template <typename Output>
+void TraceRing::drain(Output &out, uint32_t currentTime) {
+    trace_event_t event;
+    uint8_t frame[TRACE_STREAM_FRAME_SIZE];
+
+    while (out.availableForWrite() >= TRACE_STREAM_FRAME_SIZE) {
+        if (this->droppedCount > 0 && this->tail == this->dropHead) {
+            event.time = currentTime;
+            event.data = this->takeDroppedCount();
+            event.type = TRACE_EVENT_DROPPED;
+            event.channel = 0;
+
+        } else if (!this->pop(event)) {
+            break;
+        }
+
+        TraceRing::encode(event, frame);
+        out.write(frame, TRACE_STREAM_FRAME_SIZE);
+    }
+}
+
+
+#if defined(TRACE_ENABLED)
+    extern TraceRing traceRing;
+
+    #define TRACE_EVENT(type, channel, data) traceRing.record(type, channel, data, micros())
+    #define TRACE_RESYNC(reason) TRACE_EVENT(TRACE_EVENT_RESYNC, 0, reason)
+    #define TRACE_LOST_FRAME() TRACE_EVENT(TRACE_EVENT_LOST, 0, 0)
+#else
+    #define TRACE_EVENT(type, channel, data)
+    #define TRACE_RESYNC(reason)
+    #define TRACE_LOST_FRAME()
+#endif
@@ -0,0 +1,218 @@
+/*
+ * BulkPacketDecoder.h - SIMD Decoding of Recorded Caliper Packets, Header Only
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Decodes a buffer of packed 3-byte packets (least significant byte first,
+// like caliper_data_t) into structure of arrays outputs for post
+// processing logs:
+//   - values: signed measurements in tenths of a micrometer. A step is
+//     10 um in millimeters and 12.7 um in inches, so tenths are the
+//     smallest unit both convert to exactly.
+//   - unitMask: bit i % 8 of byte i / 8 set when packet i is in inches.
+//   - signMask: the same for the sign bit, as sent (a negative 0 keeps it).
+//
+// There is a scalar version using CaliperPacket.h, the same decoding as
+// ClockwiseCaliper, and SSE2 and AVX2 versions on x86 that give the exact
+// same output. decodeCaliperPackets() picks the fastest one the CPU
+// supports when it is first called.
+//
+// The SIMD versions decode 8 packets per step, so one byte of each mask,
+// and leave the last few packets to the scalar version so they never read
+// past the end of the buffer.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "CaliperPacket.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define BULK_PACKET_DECODER_X86
+    #include <immintrin.h>
+#endif
+
+
+const uint8_t BULK_PACKET_SIZE = 3;                    // Bytes per packet in the input
+const int32_t TENTH_MICROMETERS_PER_STEP[] = {100, 127}; // Indexed by caliper_unit_t
+
+typedef void (*bulk_packet_decoder_t)(const uint8_t *, size_t, int32_t *, uint8_t *, uint8_t *);
+
+
+/**
+ * Decodes packets one at a time with CaliperPacket.h.
+ *
+ * @param bytes count packets of BULK_PACKET_SIZE bytes
+ * @param count number of packets
+ * @param values array of count values to fill, tenths of a micrometer
+ * @param unitMask array of (count + 7) / 8 bytes to fill
+ * @param signMask array of (count + 7) / 8 bytes to fill
+ */
+inline void decodeCaliperPacketsScalar(const uint8_t *bytes, size_t count,
+                                       int32_t *values, uint8_t *unitMask, uint8_t *signMask) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *packetBytes = bytes + i * BULK_PACKET_SIZE;
+        uint32_t packet = caliperPacketFromBytes(packetBytes[0], packetBytes[1], packetBytes[2]);
+        uint8_t bit = 1 << (i & 7);
+
+        if ((i & 7) == 0) {
+            unitMask[i / 8] = 0;
+            signMask[i / 8] = 0;
+        }
+
+        values[i] = caliperPacketValue(packet) * TENTH_MICROMETERS_PER_STEP[caliperPacketUnit(packet)];
+        unitMask[i / 8] |= caliperPacketUnit(packet) == INCHES ? bit : 0;
+        signMask[i / 8] |= caliperPacketSign(packet) == NEGATIVE ? bit : 0;
+    }
+}
+
+
+#ifdef BULK_PACKET_DECODER_X86
+
+/**
+ * Converts 4 packets, one per 32-bit lane, to values. SSE2 has no 32-bit
+ * multiply, so x100 and x127 are shifts and adds, picked per lane with
+ * the unit bit.
+ *
+ * @param packets 4 packets, bits above 23 clear
+ * @return 4 values, tenths of a micrometer
+ */
+__attribute__((target("sse2")))
+inline __m128i bulkPacketValuesSse2(__m128i packets) {
+    __m128i measurement = _mm_and_si128(packets, _mm_set1_epi32(CALIPER_PACKET_MEASUREMENT_MASK));
+    __m128i negative = _mm_srai_epi32(_mm_slli_epi32(packets, 31 - CALIPER_PACKET_SIGN_BIT), 31); // All ones when negative
+    __m128i inches = _mm_srai_epi32(_mm_slli_epi32(packets, 31 - CALIPER_PACKET_UNIT_BIT), 31);   // All ones in inches
+
+    __m128i times100 = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(measurement, 6), _mm_slli_epi32(measurement, 5)),
+                                     _mm_slli_epi32(measurement, 2));
+    __m128i times127 = _mm_sub_epi32(_mm_slli_epi32(measurement, 7), measurement);
+    __m128i value = _mm_or_si128(_mm_andnot_si128(inches, times100), _mm_and_si128(inches, times127));
+
+    // x ^ -1 - -1 negates x, x ^ 0 - 0 leaves it
+    return _mm_sub_epi32(_mm_xor_si128(value, negative), negative);
+}
+
+/**
+ * Decodes packets with SSE2, see decodeCaliperPacketsScalar().
+ */
+__attribute__((target("sse2")))
+inline void decodeCaliperPacketsSse2(const uint8_t *bytes, size_t count,
+                                     int32_t *values, uint8_t *unitMask, uint8_t *signMask) {
+    const __m128i packetMask = _mm_set1_epi32(CALIPER_PACKET_MASK);
+    size_t i = 0;
+
+    // Each packet is read with a 4-byte load, so stop before the last byte
+    for (; i + 9 <= count; i += 8) {
+        const uint8_t *block = bytes + i * BULK_PACKET_SIZE;
+        uint32_t words[8];
+
+        for (uint8_t j = 0; j < 8; j++) {
+            memcpy(&words[j], block + j * BULK_PACKET_SIZE, 4);
+        }
+
+        __m128i low = _mm_and_si128(_mm_loadu_si128((const __m128i *)words), packetMask);
+        __m128i high = _mm_and_si128(_mm_loadu_si128((const __m128i *)(words + 4)), packetMask);
+
+        _mm_storeu_si128((__m128i *)(values + i), bulkPacketValuesSse2(low));
+        _mm_storeu_si128((__m128i *)(values + i + 4), bulkPacketValuesSse2(high));
+
+        // Move the unit and sign bits to the top of each lane for movemask
+        unitMask[i / 8] = _mm_movemask_ps(_mm_castsi128_ps(_mm_slli_epi32(low, 31 - CALIPER_PACKET_UNIT_BIT)))
+                        | (_mm_movemask_ps(_mm_castsi128_ps(_mm_slli_epi32(high, 31 - CALIPER_PACKET_UNIT_BIT))) << 4);
+        signMask[i / 8] = _mm_movemask_ps(_mm_castsi128_ps(_mm_slli_epi32(low, 31 - CALIPER_PACKET_SIGN_BIT)))
+                        | (_mm_movemask_ps(_mm_castsi128_ps(_mm_slli_epi32(high, 31 - CALIPER_PACKET_SIGN_BIT))) << 4);
+    }
+
+    decodeCaliperPacketsScalar(bytes + i * BULK_PACKET_SIZE, count - i, values + i, unitMask + i / 8, signMask + i / 8);
+}
+
+/**
+ * Decodes packets with AVX2, see decodeCaliperPacketsScalar(). Each step
+ * loads 32 bytes, moves the 12 bytes of packets 4 to 7 into the upper
+ * lane, and spreads every packet to its own 32-bit lane with a byte
+ * shuffle.
+ */
+__attribute__((target("avx2")))
+inline void decodeCaliperPacketsAvx2(const uint8_t *bytes, size_t count,
+                                     int32_t *values, uint8_t *unitMask, uint8_t *signMask) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+    const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i measurementMask = _mm256_set1_epi32(CALIPER_PACKET_MEASUREMENT_MASK);
+    const __m256i step = _mm256_set1_epi32(TENTH_MICROMETERS_PER_STEP[MILLIMETERS]);
+    const __m256i inchStep = _mm256_set1_epi32(TENTH_MICROMETERS_PER_STEP[INCHES] - TENTH_MICROMETERS_PER_STEP[MILLIMETERS]);
+    size_t i = 0;
+
+    // 24 bytes are used of each 32 byte load, so stop 8 bytes (3 packets) early
+    for (; i + 11 <= count; i += 8) {
+        __m256i raw = _mm256_loadu_si256((const __m256i *)(bytes + i * BULK_PACKET_SIZE));
+        __m256i packets = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(raw, lanes), spread);
+
+        __m256i measurement = _mm256_and_si256(packets, measurementMask);
+        __m256i negative = _mm256_srai_epi32(_mm256_slli_epi32(packets, 31 - CALIPER_PACKET_SIGN_BIT), 31);
+        __m256i inches = _mm256_srai_epi32(_mm256_slli_epi32(packets, 31 - CALIPER_PACKET_UNIT_BIT), 31);
+        __m256i scale = _mm256_add_epi32(step, _mm256_and_si256(inches, inchStep));
+        __m256i value = _mm256_mullo_epi32(measurement, scale);
+
+        _mm256_storeu_si256((__m256i *)(values + i), _mm256_sub_epi32(_mm256_xor_si256(value, negative), negative));
+
+        unitMask[i / 8] = _mm256_movemask_ps(_mm256_castsi256_ps(inches));
+        signMask[i / 8] = _mm256_movemask_ps(_mm256_castsi256_ps(negative));
+    }
+
+    decodeCaliperPacketsScalar(bytes + i * BULK_PACKET_SIZE, count - i, values + i, unitMask + i / 8, signMask + i / 8);
+}
+
+#endif
+
+
+/**
+ * Returns the fastest decoder the CPU supports.
+ *
+ * @return the decoder
+ */
+inline bulk_packet_decoder_t bestCaliperPacketDecoder() {
+    #ifdef BULK_PACKET_DECODER_X86
+        if (__builtin_cpu_supports("avx2")) {
+            return decodeCaliperPacketsAvx2;
+        }
+
+        if (__builtin_cpu_supports("sse2")) {
+            return decodeCaliperPacketsSse2;
+        }
+    #endif
+
+    return decodeCaliperPacketsScalar;
+}
+
+/**
+ * Decodes packets with the fastest decoder the CPU supports, see
+ * decodeCaliperPacketsScalar().
+ *
+ * @param bytes count packets of BULK_PACKET_SIZE bytes
+ * @param count number of packets
+ * @param values array of count values to fill, tenths of a micrometer
+ * @param unitMask array of (count + 7) / 8 bytes to fill
+ * @param signMask array of (count + 7) / 8 bytes to fill
+ */
+inline void decodeCaliperPackets(const uint8_t *bytes, size_t count,
+                                 int32_t *values, uint8_t *unitMask, uint8_t *signMask) {
+    static const bulk_packet_decoder_t decoder = bestCaliperPacketDecoder();
+
+    decoder(bytes, count, values, unitMask, signMask);
+}
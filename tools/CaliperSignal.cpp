@@ -0,0 +1,183 @@
+/*
+ * CaliperSignal.cpp - Deterministic Caliper Waveform Generator
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "CaliperSignal.h"
+#include "HostHarness.h"
+
+
+/**
+ * Caliper waveform generator constructor.
+ *
+ * @param config waveform timing and noise settings
+ * @param seed seed for the random generator, the same seed always gives
+ *             the same waveform
+ */
+CaliperSignalGenerator::CaliperSignalGenerator(const caliper_signal_config_t &config,
+                                               uint32_t seed) {
+    this->config = config;
+    this->time = config.packetInterval;
+    this->randomState = seed != 0 ? seed : 1; // xorshift gets stuck on 0
+}
+
+
+/**
+ * Generates the edges of one packet and advances to the next.
+ * The packet is sent LSB first with both lines inverted, like the pins
+ * see it. The clock idles LOW, rises to shift out each bit, and falls to
+ * sample it. The first edge is at getTime(), edges are in time order.
+ *
+ * @param packet 24-bit packet to send, as the calipers send it
+ * @param edges array of at least CALIPER_SIGNAL_MAX_EDGES edges to fill
+ * @return the number of edges written to edges
+ */
+uint8_t CaliperSignalGenerator::generatePacket(uint32_t packet,
+                                               caliper_signal_edge_t *edges) {
+    uint32_t halfPeriod = this->config.clkPeriod / 2;
+    uint8_t edgeCount = 0;
+    bool dataState = false;
+
+    for (uint8_t i = 0; i < CALIPER_SIGNAL_PACKET_BITS; i++) {
+        uint32_t bitTime = this->time + i * this->config.clkPeriod;
+
+        if (this->chance(this->config.dropRate)) {
+            continue; // Clock pulse went missing, so did the bit
+        }
+
+        dataState = !((packet >> i) & 1);
+
+        // Rising edge shifts the bit out, falling edge samples it
+        edgeCount = this->addClockEdge(edges, edgeCount, bitTime, true, dataState);
+
+        uint8_t sampleEdge = edgeCount;
+
+        edgeCount = this->addClockEdge(edges, edgeCount, bitTime + halfPeriod, false, dataState);
+
+        if (this->chance(this->config.dataGlitchRate)) {
+            edgeCount = this->addDataGlitch(edges, edgeCount, sampleEdge);
+        }
+    }
+
+    this->time += this->config.packetInterval;
+
+    return edgeCount;
+}
+
+
+/**
+ * Returns the start time of the next packet.
+ *
+ * @return the start time of the next packet in microseconds
+ */
+uint32_t CaliperSignalGenerator::getTime() {
+    return this->time;
+}
+
+
+/**
+ * Returns the next value of the random generator.
+ * Can also be used to pick random packets, keeping everything
+ * reproducible from the one seed.
+ *
+ * @return a 32-bit pseudo random number
+ */
+uint32_t CaliperSignalGenerator::random() {
+    return hostRandom(this->randomState);
+}
+
+/**
+ * Adds a clock edge, jittered, and possibly followed by a glitch pulse.
+ *
+ * @param edges array of edges to add to
+ * @param edgeCount number of edges already in edges
+ * @param time time of the edge before jitter in microseconds
+ * @param clkState state of the clock after the edge
+ * @param dataState state of the data line
+ * @return the new number of edges in edges
+ */
+uint8_t CaliperSignalGenerator::addClockEdge(caliper_signal_edge_t *edges,
+                                             uint8_t edgeCount,
+                                             uint32_t time,
+                                             bool clkState,
+                                             bool dataState) {
+    uint32_t edgeTime = this->jitterTime(time);
+
+    edges[edgeCount++] = {edgeTime, clkState, dataState};
+
+    if (this->chance(this->config.glitchRate)) {
+        // Short pulse in the middle of the half period
+        uint32_t glitchTime = edgeTime + this->config.clkPeriod / 4;
+
+        edges[edgeCount++] = {glitchTime, !clkState, dataState};
+        edges[edgeCount++] = {glitchTime + this->config.glitchWidth, clkState, dataState};
+    }
+
+    return edgeCount;
+}
+
+/**
+ * Flips the data line for dataGlitchWidth from a sampling edge. The edges
+ * are put right after the sampling edge, before any clock glitch pulse
+ * following it, so edges stay in time order.
+ *
+ * @param edges array of edges to add to
+ * @param edgeCount number of edges already in edges
+ * @param sampleEdge index of the sampling edge
+ * @return the new number of edges in edges
+ */
+uint8_t CaliperSignalGenerator::addDataGlitch(caliper_signal_edge_t *edges,
+                                              uint8_t edgeCount,
+                                              uint8_t sampleEdge) {
+    caliper_signal_edge_t edge = edges[sampleEdge];
+
+    for (uint8_t i = edgeCount; i > sampleEdge + 1; i--) {
+        edges[i + 1] = edges[i - 1];
+    }
+
+    edges[sampleEdge + 1] = {edge.time, edge.clk, !edge.data};
+    edges[sampleEdge + 2] = {edge.time + this->config.dataGlitchWidth, edge.clk, edge.data};
+
+    return edgeCount + 2;
+}
+
+/**
+ * Returns true with a chance of rate out of 65536.
+ *
+ * @param rate chance out of 65536, 0 is never
+ * @return true if the event happens
+ */
+bool CaliperSignalGenerator::chance(uint16_t rate) {
+    return rate > 0 && (this->random() & 0xFFFF) < rate;
+}
+
+/**
+ * Returns time shifted by a random amount up to the jitter, in either
+ * direction.
+ *
+ * @param time time to shift in microseconds
+ * @return the shifted time in microseconds
+ */
+uint32_t CaliperSignalGenerator::jitterTime(uint32_t time) {
+    if (this->config.jitter == 0) {
+        return time;
+    }
+
+    uint32_t span = 2 * (uint32_t)this->config.jitter + 1;
+
+    return time + this->random() % span - this->config.jitter;
+}
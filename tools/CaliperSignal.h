@@ -0,0 +1,99 @@
+/*
+ * CaliperSignal.h - Deterministic Caliper Waveform Generator (Header File)
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Synthesizes the clock and data edges of caliper packets, as they appear
+// on CLK_PIN and DATA_PIN after the level shifting transistors (inverted,
+// so SPI MODE1 and LSB first). Clock jitter, glitch pulses, and missing
+// clock pulses can be added to test how the decoding recovers, and so can
+// glitch pulses on the data line right at the sampling edge, like
+// crosstalk from the clock through the level shifters.
+//
+// Without data glitches every edge changes the clock. With them, some
+// edges only change the data line, so sampling edges have to be found
+// from the clock changing from HIGH to LOW.
+//
+// The randomness comes from hostRandom() in HostHarness.h, seeded, so the
+// same configuration and seed always produce the same waveform.
+//
+// Only used by the host tools.
+
+
+#pragma once
+
+#include <stdint.h>
+
+
+const uint8_t CALIPER_SIGNAL_PACKET_BITS = 24;
+const uint8_t CALIPER_SIGNAL_MAX_EDGES = CALIPER_SIGNAL_PACKET_BITS * 2 * 3 + CALIPER_SIGNAL_PACKET_BITS * 2; // Every clock edge followed by a glitch pulse, and every sampling edge by a data glitch
+
+/**
+ * Waveform timing and noise settings.
+ * Rates are the chance out of 65536 of the event happening.
+ */
+typedef struct {
+    uint32_t clkPeriod;       // Microseconds per clock cycle (~400 for the calipers)
+    uint32_t packetInterval;  // Microseconds from the start of one packet to the next (~150000)
+    uint16_t jitter;          // Maximum shift of each clock edge in microseconds, less than clkPeriod / 4
+    uint16_t glitchRate;      // Chance of a glitch pulse on the clock after each clock edge
+    uint16_t glitchWidth;     // Width of the glitch pulses in microseconds, less than clkPeriod / 4
+    uint16_t dropRate;        // Chance of a clock pulse (and its bit) going missing
+    uint16_t dataGlitchRate;  // Chance of the data line flipping at a sampling edge
+    uint16_t dataGlitchWidth; // Microseconds the data line stays flipped, less than clkPeriod / 4
+} caliper_signal_config_t;
+
+/**
+ * A change on the clock or data line.
+ */
+typedef struct {
+    uint32_t time; // Microseconds since the generator started
+    bool clk;      // State of the clock line after the edge
+    bool data;     // State of the data line after the edge
+} caliper_signal_edge_t;
+
+
+class CaliperSignalGenerator {
+public:
+    CaliperSignalGenerator(const caliper_signal_config_t &config,
+                           uint32_t seed);
+
+    uint8_t generatePacket(uint32_t packet,
+                           caliper_signal_edge_t *edges); // Generates the edges of one packet and advances to the next.
+
+    uint32_t getTime(); // Returns the start time of the next packet in microseconds.
+
+    uint32_t random(); // Returns the next value of the random generator.
+
+private:
+    caliper_signal_config_t config;
+
+    uint32_t time;        // Start of the next packet.
+    uint32_t randomState; // xorshift32 state, never 0.
+
+    uint8_t addClockEdge(caliper_signal_edge_t *edges,
+                         uint8_t edgeCount,
+                         uint32_t time,
+                         bool clkState,
+                         bool dataState); // Adds a clock edge, jittered, and possibly followed by a glitch pulse.
+
+    uint8_t addDataGlitch(caliper_signal_edge_t *edges,
+                          uint8_t edgeCount,
+                          uint8_t sampleEdge); // Flips the data line for dataGlitchWidth from a sampling edge.
+
+    bool chance(uint16_t rate); // Returns true with a chance of rate out of 65536.
+    uint32_t jitterTime(uint32_t time); // Returns time shifted by a random amount up to the jitter.
+};
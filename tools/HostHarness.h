@@ -0,0 +1,226 @@
+/*
+ * HostHarness.h - Random Numbers, Options, and Results for the Host Tools
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// What every host tool needs besides the code under test:
+//   - hostRandom(): a seeded xorshift32 generator, so runs are repeatable
+//     everywhere. CaliperSignalGenerator uses it too.
+//   - parseHostOptions(): "-x value" options, each written straight into
+//     the variable it sets, and an optional file path.
+//   - HostChecks: prints a FAIL line for each check that failed, and gives
+//     the exit code, 1 if any did.
+//
+// Header only, so the tools still build with a single g++ line.
+
+
+#pragma once
+
+#include <initializer_list>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Returns the next number of a xorshift32 generator.
+ *
+ * @param state generator state, never 0
+ * @return the next random number
+ */
+inline uint32_t hostRandom(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return state;
+}
+
+/**
+ * Returns a random number from min to max.
+ *
+ * @param state generator state, never 0
+ * @param min smallest value
+ * @param max largest value
+ * @return the random number
+ */
+inline uint32_t hostRandomRange(uint32_t &state, uint32_t min, uint32_t max) {
+    return min + hostRandom(state) % (max - min + 1);
+}
+
+
+/**
+ * A command line option and the variable it sets.
+ */
+class HostOption {
+public:
+    HostOption(const char *name, uint8_t &value) : name(name), type(UINT8), target(&value) {}
+    HostOption(const char *name, uint16_t &value) : name(name), type(UINT16), target(&value) {}
+    HostOption(const char *name, uint32_t &value) : name(name), type(UINT32), target(&value) {}
+    HostOption(const char *name, uint64_t &value) : name(name), type(UINT64), target(&value) {}
+    HostOption(const char *name, bool &value) : name(name), type(BOOL), target(&value) {}
+    HostOption(const char *name, double &value) : name(name), type(DOUBLE), target(&value) {}
+    HostOption(const char *name, const char *&value) : name(name), type(STRING), target(&value) {}
+
+    /**
+     * Sets the variable from the text after the option.
+     * Numbers can be decimal, or hex with 0x. A bool is set by any number
+     * but 0.
+     *
+     * @param text value given on the command line
+     * @return false if it is not a number, or too large for the variable
+     */
+    bool set(const char *text) const {
+        if (this->type == STRING) {
+            *(const char **)this->target = text;
+            return true;
+        }
+
+        char *end;
+
+        if (this->type == DOUBLE) {
+            *(double *)this->target = strtod(text, &end);
+            return end != text && *end == '\0';
+        }
+
+        unsigned long long value = strtoull(text, &end, 0);
+
+        if (end == text || *end != '\0' || text[0] == '-') {
+            return false;
+        }
+
+        switch (this->type) {
+            case UINT8:
+                *(uint8_t *)this->target = value;
+                return value <= 0xFF;
+            case UINT16:
+                *(uint16_t *)this->target = value;
+                return value <= 0xFFFF;
+            case UINT32:
+                *(uint32_t *)this->target = value;
+                return value <= 0xFFFFFFFF;
+            case BOOL:
+                *(bool *)this->target = value != 0;
+                return true;
+            default:
+                *(uint64_t *)this->target = value;
+                return true;
+        }
+    }
+
+    const char *name; // Option as typed, e.g. "-n"
+
+private:
+    enum option_type_t {UINT8, UINT16, UINT32, UINT64, BOOL, DOUBLE, STRING};
+
+    option_type_t type;
+    void *target;
+};
+
+/**
+ * Sets the variables of the options given on the command line, as
+ * "-x value" pairs. An argument not starting with '-' is the path, if
+ * the tool takes one.
+ *
+ * @param argc argument count from main()
+ * @param argv arguments from main()
+ * @param options options the tool takes
+ * @param path set to the path given, nullptr if the tool takes none
+ * @return false after printing why if an argument was wrong, main()
+ *         should then return 1
+ */
+inline bool parseHostOptions(int argc, char **argv, std::initializer_list<HostOption> options,
+                             const char **path = nullptr) {
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-' && path != nullptr) {
+            *path = argv[i];
+            continue;
+        }
+
+        const HostOption *option = nullptr;
+
+        for (const HostOption &candidate : options) {
+            if (strcmp(argv[i], candidate.name) == 0) {
+                option = &candidate;
+            }
+        }
+
+        if (option == nullptr) {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return false;
+        }
+
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return false;
+        }
+
+        if (!option->set(argv[++i])) {
+            fprintf(stderr, "Bad value %s for %s\n", argv[i], argv[i - 1]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * Collects the pass/fail checks of a tool.
+ */
+class HostChecks {
+public:
+    /**
+     * Checks one condition, printing a FAIL line if it does not hold.
+     *
+     * @param passed the condition
+     * @param format printf format of what failed
+     */
+    __attribute__((format(printf, 3, 4))) void expect(bool passed, const char *format, ...) {
+        if (passed) {
+            return;
+        }
+
+        va_list args;
+
+        va_start(args, format);
+        printf("FAIL: ");
+        vprintf(format, args);
+        printf("\n");
+        va_end(args);
+
+        this->failures++;
+    }
+
+    /**
+     * Returns the exit code for main(), after printing PASS if every
+     * check passed.
+     *
+     * @return 0 if every check passed, 1 otherwise
+     */
+    int finish() {
+        if (this->failures == 0) {
+            printf("PASS\n");
+        }
+
+        return this->failures == 0 ? 0 : 1;
+    }
+
+private:
+    uint32_t failures = 0;
+};
@@ -0,0 +1,488 @@
+/*
+ * PacketLog.h - Versioned Binary Log of Caliper Packets, Header Only Host Library
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// File format for logging caliper packets on the host, so downstream
+// tools can read measurements without parsing typed text. Multi-byte
+// fields are little endian. Every field is made of bytes, so the structs
+// below have no padding and can be used straight from a memory mapped
+// file on any host.
+//
+// Header, PACKET_LOG_HEADER_SIZE bytes:
+//   bytes  0-3   "CWPL"
+//   byte   4     version, PACKET_LOG_VERSION. Readers reject other versions
+//   byte   5     header size, records start here
+//   byte   6     record size
+//   byte   7     reserved, 0
+//   bytes  8-11  milliseconds of the first record, the start of the deltas
+//   bytes 12-15  reserved, 0
+//
+// Then fixed size records, PACKET_LOG_RECORD_SIZE bytes each:
+//   byte   0     bits 0-1 channel (caliper), bits 2-6 PACKET_LOG_FLAG_*,
+//                bit 7 PACKET_LOG_FLAG_TIME
+//   bytes  1-3   24-bit packet, least significant byte first like
+//                caliper_data_t, decode it with CaliperPacket.h
+//   bytes  4-5   milliseconds since the previous record
+//   byte   6     sequence, counts every packet of the channel, gaps are
+//                packets that never made it into the log
+//   byte   7     resync count of the SPI slave (wraps at 255)
+//
+// When the time from the previous record does not fit in 16 bits (or goes
+// backwards), a time record comes first: PACKET_LOG_FLAG_TIME set, no
+// packet, and bytes 4-7 the absolute time in milliseconds.
+//
+// PacketLogWriter writes logs, PacketLogView maps one read only and walks
+// the records in place. POSIX only, for mmap().
+
+
+#pragma once
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "CaliperPacket.h"
+
+
+const uint8_t PACKET_LOG_VERSION = 1;
+const uint8_t PACKET_LOG_HEADER_SIZE = 16;
+const uint8_t PACKET_LOG_RECORD_SIZE = 8;
+
+const uint8_t PACKET_LOG_CHANNEL_MASK = 0x03;
+const uint8_t PACKET_LOG_FLAG_RESYNC = 0x04;   // The SPI slave resynced since the previous packet
+const uint8_t PACKET_LOG_FLAG_LOST = 0x08;     // The SPI slave lost packets since the previous packet
+const uint8_t PACKET_LOG_FLAG_REJECTED = 0x10; // The packet filter rejected the packet
+const uint8_t PACKET_LOG_FLAG_TIME = 0x80;     // Time record, no packet
+
+/**
+ * File header.
+ */
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t headerSize;
+    uint8_t recordSize;
+    uint8_t reserved;
+    uint8_t startTime[4];
+    uint8_t reserved2[4];
+} packet_log_header_t;
+
+/**
+ * One record, as stored in the file.
+ */
+typedef struct {
+    uint8_t flags;        // Channel and PACKET_LOG_FLAG_*
+    uint8_t packet[3];    // Least significant byte first
+    uint8_t timeDelta[2]; // Milliseconds since the previous record, the absolute time continues into the next 2 bytes in a time record
+    uint8_t sequence;
+    uint8_t resyncCount;
+} packet_log_record_t;
+
+static_assert(sizeof(packet_log_header_t) == PACKET_LOG_HEADER_SIZE, "Header must have no padding");
+static_assert(sizeof(packet_log_record_t) == PACKET_LOG_RECORD_SIZE, "Record must have no padding");
+
+/**
+ * A packet with its absolute time, as written and as read back.
+ */
+typedef struct {
+    uint32_t time;       // Milliseconds
+    uint8_t channel;     // Caliper, 0 to 3
+    uint8_t flags;       // PACKET_LOG_FLAG_*, without PACKET_LOG_FLAG_TIME
+    uint32_t packet;     // 24-bit packet
+    uint8_t sequence;
+    uint8_t resyncCount;
+} packet_log_entry_t;
+
+
+/**
+ * Returns the packet of a record.
+ *
+ * @param record record in the file
+ * @return the 24-bit packet
+ */
+inline uint32_t packetLogPacket(const packet_log_record_t &record) {
+    return caliperPacketFromBytes(record.packet[0], record.packet[1], record.packet[2]);
+}
+
+
+class PacketLogWriter {
+public:
+    PacketLogWriter();
+    ~PacketLogWriter();
+
+    bool open(const char *path, uint32_t startTime); // Creates a log and writes its header.
+    bool close();                                    // Flushes and closes the log.
+
+    bool write(const packet_log_entry_t &entry); // Appends a packet.
+
+    uint64_t getRecordCount(); // Returns the number of records written, including time records.
+
+private:
+    FILE *file;
+    uint32_t lastTime;    // Time of the previous record
+    uint64_t recordCount;
+};
+
+
+class PacketLogView {
+public:
+    PacketLogView();
+    ~PacketLogView();
+
+    bool open(const char *path); // Maps a log read only and checks its header.
+    void close();                // Unmaps the log.
+
+    const char *getError(); // Returns why open() failed.
+
+    uint64_t getRecordCount();                 // Returns the number of records, including time records.
+    const packet_log_record_t *getRecords();   // Returns the records, in place in the mapping.
+    uint32_t getStartTime();                   // Returns the time the deltas start from.
+
+    void rewind();                        // Starts next() from the first record again.
+    bool next(packet_log_entry_t &entry); // Reads the next packet, following the time records.
+
+private:
+    const uint8_t *data;  // Whole mapped file
+    size_t size;
+    const packet_log_record_t *records;
+    uint64_t recordCount;
+    uint32_t startTime;
+    const char *error;
+
+    uint64_t nextIndex; // Record next() reads
+    uint32_t time;      // Time of the previous record
+};
+
+
+/**
+ * Log writer constructor.
+ */
+inline PacketLogWriter::PacketLogWriter() {
+    this->file = nullptr;
+    this->lastTime = 0;
+    this->recordCount = 0;
+}
+
+/**
+ * Log writer destructor, closes the log.
+ */
+inline PacketLogWriter::~PacketLogWriter() {
+    this->close();
+}
+
+
+/**
+ * Creates a log, replacing any file at path, and writes its header.
+ *
+ * @param path file to write
+ * @param startTime milliseconds the first record's delta is from
+ * @return false if the file could not be written
+ */
+inline bool PacketLogWriter::open(const char *path, uint32_t startTime) {
+    packet_log_header_t header;
+
+    this->close();
+
+    this->file = fopen(path, "wb");
+
+    if (this->file == nullptr) {
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "CWPL", 4);
+    header.version = PACKET_LOG_VERSION;
+    header.headerSize = PACKET_LOG_HEADER_SIZE;
+    header.recordSize = PACKET_LOG_RECORD_SIZE;
+
+    for (uint8_t i = 0; i < 4; i++) {
+        header.startTime[i] = startTime >> (i * 8);
+    }
+
+    this->lastTime = startTime;
+    this->recordCount = 0;
+
+    return fwrite(&header, sizeof(header), 1, this->file) == 1;
+}
+
+/**
+ * Flushes and closes the log.
+ *
+ * @return false if the log could not be flushed
+ */
+inline bool PacketLogWriter::close() {
+    if (this->file == nullptr) {
+        return true;
+    }
+
+    bool success = fclose(this->file) == 0;
+
+    this->file = nullptr;
+
+    return success;
+}
+
+
+/**
+ * Appends a packet, preceded by a time record if the time since the
+ * previous record does not fit in a delta.
+ *
+ * @param entry packet and its details
+ * @return false if the log could not be written
+ */
+inline bool PacketLogWriter::write(const packet_log_entry_t &entry) {
+    packet_log_record_t record;
+    uint32_t delta = entry.time - this->lastTime;
+
+    if (this->file == nullptr) {
+        return false;
+    }
+
+    // Also catches time going backwards, which wraps to a huge delta
+    if (delta > 0xFFFF) {
+        memset(&record, 0, sizeof(record));
+        record.flags = PACKET_LOG_FLAG_TIME;
+        record.timeDelta[0] = entry.time;
+        record.timeDelta[1] = entry.time >> 8;
+        record.sequence = entry.time >> 16;
+        record.resyncCount = entry.time >> 24;
+
+        if (fwrite(&record, sizeof(record), 1, this->file) != 1) {
+            return false;
+        }
+
+        this->recordCount++;
+        delta = 0;
+    }
+
+    record.flags = (entry.channel & PACKET_LOG_CHANNEL_MASK) | (entry.flags & ~(PACKET_LOG_CHANNEL_MASK | PACKET_LOG_FLAG_TIME));
+    record.packet[0] = entry.packet;
+    record.packet[1] = entry.packet >> 8;
+    record.packet[2] = entry.packet >> 16;
+    record.timeDelta[0] = delta;
+    record.timeDelta[1] = delta >> 8;
+    record.sequence = entry.sequence;
+    record.resyncCount = entry.resyncCount;
+
+    this->lastTime = entry.time;
+    this->recordCount++;
+
+    return fwrite(&record, sizeof(record), 1, this->file) == 1;
+}
+
+
+/**
+ * Returns the number of records written, including time records.
+ *
+ * @return the number of records
+ */
+inline uint64_t PacketLogWriter::getRecordCount() {
+    return this->recordCount;
+}
+
+
+/**
+ * Log view constructor.
+ */
+inline PacketLogView::PacketLogView() {
+    this->data = nullptr;
+    this->size = 0;
+    this->records = nullptr;
+    this->recordCount = 0;
+    this->startTime = 0;
+    this->error = "Not open";
+
+    this->rewind();
+}
+
+/**
+ * Log view destructor, unmaps the log.
+ */
+inline PacketLogView::~PacketLogView() {
+    this->close();
+}
+
+
+/**
+ * Maps a log read only and checks its header. The records are read in
+ * place, nothing is copied.
+ *
+ * @param path log to read
+ * @return false if the log could not be mapped or is not a version
+ *         PACKET_LOG_VERSION log, see getError()
+ */
+inline bool PacketLogView::open(const char *path) {
+    struct stat status;
+
+    this->close();
+
+    int fd = ::open(path, O_RDONLY);
+
+    if (fd < 0) {
+        this->error = "Could not open the file";
+        return false;
+    }
+
+    if (fstat(fd, &status) != 0 || (size_t)status.st_size < PACKET_LOG_HEADER_SIZE) {
+        ::close(fd);
+        this->error = "File is too short for a header";
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    ::close(fd); // The mapping keeps the file open
+
+    if (mapping == MAP_FAILED) {
+        this->error = "Could not map the file";
+        return false;
+    }
+
+    madvise(mapping, status.st_size, MADV_SEQUENTIAL);
+
+    this->data = (const uint8_t *)mapping;
+    this->size = status.st_size;
+
+    const packet_log_header_t *header = (const packet_log_header_t *)this->data;
+
+    if (memcmp(header->magic, "CWPL", 4) != 0) {
+        this->error = "Not a packet log";
+    } else if (header->version != PACKET_LOG_VERSION) {
+        this->error = "Unsupported version";
+    } else if (header->headerSize < PACKET_LOG_HEADER_SIZE || header->headerSize > this->size
+               || header->recordSize != PACKET_LOG_RECORD_SIZE) {
+        this->error = "Bad header or record size";
+    } else {
+        this->error = nullptr;
+    }
+
+    if (this->error != nullptr) {
+        this->close();
+        return false;
+    }
+
+    // A partly written last record is ignored
+    this->records = (const packet_log_record_t *)(this->data + header->headerSize);
+    this->recordCount = (this->size - header->headerSize) / PACKET_LOG_RECORD_SIZE;
+    this->startTime = header->startTime[0]
+                    | ((uint32_t)header->startTime[1] << 8)
+                    | ((uint32_t)header->startTime[2] << 16)
+                    | ((uint32_t)header->startTime[3] << 24);
+
+    this->rewind();
+
+    return true;
+}
+
+/**
+ * Unmaps the log. Records returned by getRecords() are no longer valid.
+ */
+inline void PacketLogView::close() {
+    if (this->data != nullptr) {
+        munmap((void *)this->data, this->size);
+    }
+
+    this->data = nullptr;
+    this->size = 0;
+    this->records = nullptr;
+    this->recordCount = 0;
+    this->startTime = 0;
+}
+
+
+/**
+ * Returns why open() failed.
+ *
+ * @return the reason, or nullptr if the log is open
+ */
+inline const char *PacketLogView::getError() {
+    return this->error;
+}
+
+
+/**
+ * Returns the number of records, including time records.
+ *
+ * @return the number of records
+ */
+inline uint64_t PacketLogView::getRecordCount() {
+    return this->recordCount;
+}
+
+/**
+ * Returns the records, in place in the mapping. Times have to be summed
+ * from the start, see next().
+ *
+ * @return the first of getRecordCount() records
+ */
+inline const packet_log_record_t *PacketLogView::getRecords() {
+    return this->records;
+}
+
+/**
+ * Returns the time the deltas start from.
+ *
+ * @return milliseconds
+ */
+inline uint32_t PacketLogView::getStartTime() {
+    return this->startTime;
+}
+
+
+/**
+ * Starts next() from the first record again.
+ */
+inline void PacketLogView::rewind() {
+    this->nextIndex = 0;
+    this->time = this->startTime;
+}
+
+/**
+ * Reads the next packet, following the time records.
+ *
+ * @param entry set to the packet with its absolute time
+ * @return false at the end of the log
+ */
+inline bool PacketLogView::next(packet_log_entry_t &entry) {
+    while (this->nextIndex < this->recordCount) {
+        const packet_log_record_t &record = this->records[this->nextIndex++];
+        uint32_t delta = record.timeDelta[0] | ((uint32_t)record.timeDelta[1] << 8);
+
+        if (record.flags & PACKET_LOG_FLAG_TIME) {
+            this->time = delta
+                       | ((uint32_t)record.sequence << 16)
+                       | ((uint32_t)record.resyncCount << 24);
+            continue;
+        }
+
+        this->time += delta;
+
+        entry.time = this->time;
+        entry.channel = record.flags & PACKET_LOG_CHANNEL_MASK;
+        entry.flags = record.flags & ~PACKET_LOG_CHANNEL_MASK;
+        entry.packet = packetLogPacket(record);
+        entry.sequence = record.sequence;
+        entry.resyncCount = record.resyncCount;
+
+        return true;
+    }
+
+    return false;
+}
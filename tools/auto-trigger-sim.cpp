@@ -0,0 +1,363 @@
+/*
+ * auto-trigger-sim.cpp - Parts Per Minute With the Button and With Auto Trigger
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Simulates an operator measuring random parts, at the packet level:
+// packets every 150 ms (with some jitter), the jaws open off the last
+// part and close onto the next one, then the reading sits on the part
+// with +/- 1 count of noise. The same parts and movements are measured
+// twice:
+//   - manual: the button is pressed a random 0.5 to 1 s after the jaws
+//     reach the part, and the measurement is typed like the sketch does.
+//     The next part starts right away.
+//   - auto: AutoTrigger decides when to type, and the row is typed with
+//     the reading settled for its settle time, like the sketch does. The
+//     next part starts a random 150 to 300 ms after, when the operator
+//     hears the buzzer.
+//
+// After some parts the operator rests before the next one, for a few
+// seconds with the jaws parked open off the part or closed at zero, or
+// for longer with the caliper set down after sliding it off the part.
+// Nothing should be typed then.
+//
+// Reports parts per minute for both, not counting rests, and counts typed
+// values that were off by more than a stable run can spread (or not
+// settled, with auto trigger), parts
+// typed twice, parts never typed, and readings typed while resting. Exits
+// with 1 if any of those happened, or if auto trigger measures fewer
+// parts per minute than the button, as then there is no point to it.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o auto-trigger-sim
+//       auto-trigger-sim.cpp ../src/DataInterface/AutoTrigger.cpp
+//       ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   ./auto-trigger-sim [-n parts] [-t settleTime] [-c rearmChange] [-s seed]
+
+
+#include <stdio.h>
+#include "AutoTrigger.h"
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+
+
+// Same as the sketch
+const uint16_t STABLE_TOLERANCE = 1;
+const uint32_t STABLE_TIME = 450;
+const uint32_t AUTO_TRIGGER_SETTLE_TIME = 300;
+const uint16_t AUTO_TRIGGER_REARM_CHANGE = 10;
+
+const uint32_t PACKET_INTERVAL = 150;  // Milliseconds between packets
+const uint32_t PACKET_JITTER = 10;     // Milliseconds the interval varies by
+const uint32_t MOVE_TIME_MIN = 600;    // Milliseconds to open the jaws and close them on the next part
+const uint32_t MOVE_TIME_MAX = 1200;
+const int32_t OPEN_CLEARANCE = 300;    // Hundredths of a millimeter the jaws open past the larger part
+const uint32_t PRESS_DELAY_MIN = 500;  // Milliseconds from reaching the part to pressing the button
+const uint32_t PRESS_DELAY_MAX = 1000;
+const uint32_t BUZZER_DELAY_MIN = 150; // Milliseconds from the buzzer to moving on with auto trigger
+const uint32_t BUZZER_DELAY_MAX = 300;
+const uint32_t PART_TIMEOUT = 5000;    // Milliseconds on a part before giving up on auto trigger
+const int32_t PART_MIN = 500;          // Part sizes in hundredths of a millimeter
+const int32_t PART_MAX = 15000;
+const uint8_t REST_CHANCE = 5;         // One in this many parts is followed by a rest
+const uint32_t REST_MOVE_TIME = 400;   // Milliseconds to move the jaws to where they rest
+const uint32_t REST_TIME_MIN = 2000;   // Milliseconds parked open or closed
+const uint32_t REST_TIME_MAX = 10000;
+const uint32_t SET_DOWN_TIME_MIN = 5000; // Milliseconds set down
+const uint32_t SET_DOWN_TIME_MAX = 30000;
+const int32_t PARK_OPEN_MAX = 3000;    // Hundredths of a millimeter the jaws are parked open past the part
+const int32_t SET_DOWN_OPEN_MIN = 50;  // Hundredths of a millimeter the jaws slide open to take the caliper off the part
+const int32_t SET_DOWN_OPEN_MAX = 300;
+
+
+/**
+ * How the operator rests after a part.
+ */
+typedef enum {
+    REST_NONE,
+    REST_PARKED_OPEN, // Jaws opened off the part
+    REST_CLOSED,      // Jaws closed at zero
+    REST_SET_DOWN     // Slid off the part and set down
+} rest_t;
+
+
+/**
+ * One part, and how the operator measures it.
+ */
+typedef struct {
+    int32_t size;        // Hundredths of a millimeter
+    uint32_t moveTime;   // Milliseconds to slide the jaws onto it
+    uint32_t pressDelay; // Milliseconds after reaching it until the button is pressed
+    uint32_t leaveDelay; // Milliseconds after the buzzer until moving on with auto trigger
+    rest_t rest;         // Rest after the part
+    int32_t restPosition; // Hundredths of a millimeter the jaws rest at
+    uint32_t restTime;   // Milliseconds of rest
+    uint32_t seed;       // Seed for the noise and packet jitter
+} part_t;
+
+/**
+ * Totals for one way of triggering.
+ */
+typedef struct {
+    uint64_t time;  // Milliseconds for all parts
+    uint64_t restTime; // Milliseconds of that resting
+    uint32_t typed;
+    uint32_t wrong;
+    uint32_t repeated;
+    uint32_t missed;
+    uint32_t restTyped; // Readings typed while resting
+} sim_result_t;
+
+
+/**
+ * Builds the packet the caliper would send for a value in millimeters.
+ *
+ * @param value signed hundredths of a millimeter
+ * @return the 24-bit packet
+ */
+static uint32_t millimeterPacket(int32_t value) {
+    uint32_t packet = value < 0 ? -value : value;
+
+    return packet | (value < 0 ? (uint32_t)1 << 20 : 0);
+}
+
+
+/**
+ * Measures all the parts with one way of triggering.
+ *
+ * @param parts parts to measure
+ * @param count number of parts
+ * @param useAuto true to use AutoTrigger, false to use the button
+ * @param settleTime auto trigger settle time
+ * @param rearmChange auto trigger rearm change
+ * @return the totals
+ */
+static sim_result_t simulate(const part_t *parts, uint32_t count, bool useAuto,
+                             uint32_t settleTime, uint16_t rearmChange) {
+    ClockwiseCaliper caliper;
+    AutoTrigger autoTrigger;
+    sim_result_t result = {0, 0, 0, 0, 0, 0, 0};
+    uint32_t time = 0;
+    uint32_t nextPacket = 0;
+    int32_t position = 0; // Jaws closed
+
+    caliper.getHistory().setTolerance(STABLE_TOLERANCE);
+    autoTrigger.begin(settleTime, rearmChange);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const part_t &part = parts[i];
+        uint32_t state = part.seed;
+        uint32_t start = time;
+        uint32_t arrive = start + part.moveTime;
+        uint32_t press = arrive + part.pressDelay;
+        uint32_t leave = arrive + PART_TIMEOUT;
+        int32_t from = position;
+        int32_t open = (from > part.size ? from : part.size) + OPEN_CLEARANCE;
+        uint32_t openTime = part.moveTime / 2;
+        bool typed = false;
+
+        while (time < leave) {
+            bool trigger = false;
+
+            // Button press before the next packet
+            if (!useAuto && press <= nextPacket) {
+                time = press;
+                trigger = true;
+
+            } else {
+                time = nextPacket;
+                nextPacket += hostRandomRange(state, PACKET_INTERVAL - PACKET_JITTER, PACKET_INTERVAL + PACKET_JITTER);
+
+                int32_t value = part.size;
+
+                if (time < start + openTime) {
+                    value = from + (int64_t)(open - from) * (time - start) / openTime;
+                } else if (time < arrive) {
+                    value = open + (int64_t)(part.size - open) * (time - start - openTime) / (part.moveTime - openTime);
+                } else {
+                    value += (int32_t)hostRandomRange(state, 0, 4) / 2 - 1; // Mostly -1 and 0, sometimes +1
+                }
+
+                caliper.updatePacket(millimeterPacket(value), time);
+                caliper.refershData();
+
+                trigger = useAuto && autoTrigger.update(caliper);
+            }
+
+            if (trigger) {
+                // The button falls back to the latest reading, auto trigger must wait until it settled.
+                // An auto triggered row is typed with the trigger's settle time, see MeasurementTyping.h
+                bool settled = caliper.refreshSettledData(useAuto ? settleTime : STABLE_TIME);
+
+                int32_t error = caliper.getFixedMeasurement() - part.size;
+
+                // The last reading of the move can still join the stable run
+                if (time < arrive || error > 2 * STABLE_TOLERANCE || error < -2 * (int32_t)STABLE_TOLERANCE || (useAuto && !settled)) {
+                    result.wrong++;
+                }
+
+                if (typed) {
+                    result.repeated++;
+                } else {
+                    // The operator moves on once the measurement is typed
+                    leave = useAuto ? time + part.leaveDelay : time;
+                }
+
+                result.typed++;
+                typed = true;
+            }
+        }
+
+        time = leave;
+
+        if (!typed) {
+            result.missed++;
+        }
+
+        position = part.size;
+
+        if (part.rest == REST_NONE) {
+            continue;
+        }
+
+        uint32_t restEnd = time + part.restTime;
+        uint32_t restStart = time;
+
+        while (nextPacket < restEnd) {
+            time = nextPacket;
+            nextPacket += hostRandomRange(state, PACKET_INTERVAL - PACKET_JITTER, PACKET_INTERVAL + PACKET_JITTER);
+
+            int32_t value = part.restPosition;
+
+            if (time < restStart + REST_MOVE_TIME) {
+                value = part.size + (int64_t)(part.restPosition - part.size) * (time - restStart) / REST_MOVE_TIME;
+            } else {
+                value += (int32_t)hostRandomRange(state, 0, 4) / 2 - 1;
+            }
+
+            caliper.updatePacket(millimeterPacket(value), time);
+            caliper.refershData();
+
+            if (useAuto && autoTrigger.update(caliper)) {
+                result.restTyped++;
+            }
+        }
+
+        time = restEnd;
+        position = part.restPosition;
+        result.restTime += part.restTime;
+    }
+
+    result.time = time;
+
+    return result;
+}
+
+/**
+ * Prints the totals for one way of triggering.
+ *
+ * @param name name of the way of triggering
+ * @param result totals
+ * @param count number of parts
+ */
+static void printResult(const char *name, const sim_result_t &result, uint32_t count) {
+    printf("%-8s %8.2f parts/min  %7.0f ms/part  typed %u, wrong %u, repeated %u, missed %u, typed at rest %u\n",
+           name,
+           count * 60000.0 / (result.time - result.restTime),
+           (double)(result.time - result.restTime) / count,
+           result.typed, result.wrong, result.repeated, result.missed, result.restTyped);
+}
+
+/**
+ * Checks every part was typed once, correctly, and nothing else.
+ *
+ * @param checks checks to add to
+ * @param name name of the way of triggering
+ * @param result totals
+ */
+static void checkResult(HostChecks &checks, const char *name, const sim_result_t &result) {
+    checks.expect(result.wrong == 0, "%s typed %u wrong values", name, result.wrong);
+    checks.expect(result.repeated == 0, "%s typed %u parts twice", name, result.repeated);
+    checks.expect(result.missed == 0, "%s missed %u parts", name, result.missed);
+    checks.expect(result.restTyped == 0, "%s typed %u readings while resting", name, result.restTyped);
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t count = 10000;
+    uint32_t settleTime = AUTO_TRIGGER_SETTLE_TIME;
+    uint16_t rearmChange = AUTO_TRIGGER_REARM_CHANGE;
+    uint32_t seed = 1;
+
+    if (!parseHostOptions(argc, argv, {{"-n", count}, {"-t", settleTime}, {"-c", rearmChange}, {"-s", seed}})) {
+        return 1;
+    }
+
+    if (count == 0 || seed == 0) {
+        fprintf(stderr, "Parts and seed must not be 0\n");
+        return 1;
+    }
+
+    part_t *parts = new part_t[count];
+    uint32_t state = seed;
+
+    for (uint32_t i = 0; i < count; i++) {
+        parts[i].size = hostRandomRange(state, PART_MIN, PART_MAX);
+        parts[i].moveTime = hostRandomRange(state, MOVE_TIME_MIN, MOVE_TIME_MAX);
+        parts[i].pressDelay = hostRandomRange(state, PRESS_DELAY_MIN, PRESS_DELAY_MAX);
+        parts[i].leaveDelay = hostRandomRange(state, BUZZER_DELAY_MIN, BUZZER_DELAY_MAX);
+        parts[i].rest = REST_NONE;
+        parts[i].restPosition = parts[i].size;
+        parts[i].restTime = 0;
+
+        if (hostRandomRange(state, 1, REST_CHANCE) == 1) {
+            parts[i].rest = (rest_t)hostRandomRange(state, REST_PARKED_OPEN, REST_SET_DOWN);
+
+            if (parts[i].rest == REST_PARKED_OPEN) {
+                parts[i].restPosition += hostRandomRange(state, OPEN_CLEARANCE, PARK_OPEN_MAX);
+                parts[i].restTime = hostRandomRange(state, REST_TIME_MIN, REST_TIME_MAX);
+            } else if (parts[i].rest == REST_CLOSED) {
+                parts[i].restPosition = 0;
+                parts[i].restTime = hostRandomRange(state, REST_TIME_MIN, REST_TIME_MAX);
+            } else {
+                parts[i].restPosition += hostRandomRange(state, SET_DOWN_OPEN_MIN, SET_DOWN_OPEN_MAX);
+                parts[i].restTime = hostRandomRange(state, SET_DOWN_TIME_MIN, SET_DOWN_TIME_MAX);
+            }
+        }
+
+        parts[i].seed = hostRandom(state) | 1;
+    }
+
+    sim_result_t manual = simulate(parts, count, false, settleTime, rearmChange);
+    sim_result_t automatic = simulate(parts, count, true, settleTime, rearmChange);
+
+    printf("parts: %u, settle time: %u ms, rearm change: %u counts\n", count, settleTime, rearmChange);
+    printResult("manual", manual, count);
+    printResult("auto", automatic, count);
+
+    delete[] parts;
+
+    HostChecks checks;
+
+    checkResult(checks, "manual", manual);
+    checkResult(checks, "auto", automatic);
+    checks.expect(automatic.time - automatic.restTime < manual.time - manual.restTime,
+                  "auto trigger is not faster than the button");
+
+    return checks.finish();
+}
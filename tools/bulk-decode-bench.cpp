@@ -0,0 +1,221 @@
+/*
+ * bulk-decode-bench.cpp - Checks and Times the Bulk Packet Decoders
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Checks every decoder in BulkPacketDecoder.h the CPU supports against
+// ClockwiseCaliper one packet at a time, for all 2^24 packets, and for
+// every buffer length from 0 to 40 packets at every offset into the
+// buffer (to cover the scalar tails and unaligned starts).
+//
+// Then times decoding a buffer of random packets with ClockwiseCaliper
+// (updateDataBytes() and getFixedMeasurement(), one packet at a time) and
+// with each decoder.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o bulk-decode-bench
+//       bulk-decode-bench.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   ./bulk-decode-bench [-n packets] [-r repeats]
+
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+#include "BulkPacketDecoder.h"
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+
+
+const uint32_t ALL_PACKETS = (uint32_t)1 << 24;
+const uint8_t MAX_SHORT_LENGTH = 40; // Packets in the short buffers checked
+
+/**
+ * A decoder and its name.
+ */
+typedef struct {
+    const char *name;
+    bulk_packet_decoder_t decode;
+} named_decoder_t;
+
+
+/**
+ * Decoded packets, as the decoders output them.
+ */
+class DecodedPackets {
+public:
+    DecodedPackets(size_t count) : values(count), unitMask((count + 7) / 8), signMask((count + 7) / 8) {}
+
+    std::vector<int32_t> values;
+    std::vector<uint8_t> unitMask;
+    std::vector<uint8_t> signMask;
+
+    /**
+     * Returns true if both hold the same output.
+     *
+     * @param other output to compare to
+     * @return true if every value and mask byte matches
+     */
+    bool operator==(const DecodedPackets &other) const {
+        return this->values == other.values
+            && this->unitMask == other.unitMask
+            && this->signMask == other.signMask;
+    }
+};
+
+
+/**
+ * Decodes packets one at a time with ClockwiseCaliper, the reference.
+ *
+ * @param bytes packed 3-byte packets
+ * @param count number of packets
+ * @param out output to fill
+ */
+static void decodeWithCaliper(const uint8_t *bytes, size_t count, DecodedPackets &out) {
+    ClockwiseCaliper caliper;
+
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *packet = bytes + i * BULK_PACKET_SIZE;
+        uint8_t bit = 1 << (i & 7);
+
+        caliper.updateDataBytes(packet[2], packet[1], packet[0]);
+        caliper.refershData();
+
+        if ((i & 7) == 0) {
+            out.unitMask[i / 8] = 0;
+            out.signMask[i / 8] = 0;
+        }
+
+        out.values[i] = caliper.getFixedMeasurement() * TENTH_MICROMETERS_PER_STEP[caliper.getUnit()];
+        out.unitMask[i / 8] |= caliper.getUnit() == INCHES ? bit : 0;
+        out.signMask[i / 8] |= caliper.getSign() == NEGATIVE ? bit : 0;
+    }
+}
+
+/**
+ * Runs a decoder into an output.
+ *
+ * @param decoder decoder to run
+ * @param bytes packed 3-byte packets
+ * @param count number of packets
+ * @param out output to fill
+ */
+static void decodeWith(const named_decoder_t &decoder, const uint8_t *bytes, size_t count, DecodedPackets &out) {
+    decoder.decode(bytes, count, out.values.data(), out.unitMask.data(), out.signMask.data());
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t count = 50000000;
+    uint32_t repeats = 5;
+
+    if (!parseHostOptions(argc, argv, {{"-n", count}, {"-r", repeats}})) {
+        return 1;
+    }
+
+    if (count == 0 || repeats == 0) {
+        fprintf(stderr, "Packets and repeats must not be 0\n");
+        return 1;
+    }
+
+    std::vector<named_decoder_t> decoders = {{"scalar", decodeCaliperPacketsScalar}};
+
+    #ifdef BULK_PACKET_DECODER_X86
+        if (__builtin_cpu_supports("sse2")) {
+            decoders.push_back({"sse2", decodeCaliperPacketsSse2});
+        }
+
+        if (__builtin_cpu_supports("avx2")) {
+            decoders.push_back({"avx2", decodeCaliperPacketsAvx2});
+        }
+    #endif
+
+    // Every packet, in order
+    std::vector<uint8_t> allBytes(ALL_PACKETS * BULK_PACKET_SIZE);
+
+    for (uint32_t i = 0; i < ALL_PACKETS; i++) {
+        for (uint8_t b = 0; b < BULK_PACKET_SIZE; b++) {
+            allBytes[i * BULK_PACKET_SIZE + b] = caliperPacketByte(i, b);
+        }
+    }
+
+    DecodedPackets expectedAll(ALL_PACKETS);
+    decodeWithCaliper(allBytes.data(), ALL_PACKETS, expectedAll);
+
+    HostChecks checks;
+
+    for (const named_decoder_t &decoder : decoders) {
+        DecodedPackets all(ALL_PACKETS);
+        uint32_t shortWrong = 0;
+
+        decodeWith(decoder, allBytes.data(), ALL_PACKETS, all);
+
+        // Short buffers starting anywhere, with nothing readable past the end
+        for (uint8_t length = 0; length <= MAX_SHORT_LENGTH; length++) {
+            for (uint8_t offset = 0; offset < 16; offset++) {
+                std::vector<uint8_t> exact(allBytes.begin() + (offset * 997) * BULK_PACKET_SIZE,
+                                           allBytes.begin() + (offset * 997 + length) * BULK_PACKET_SIZE);
+                DecodedPackets expected(length);
+                DecodedPackets actual(length);
+
+                decodeWithCaliper(exact.data(), length, expected);
+                decodeWith(decoder, exact.data(), length, actual);
+
+                shortWrong += !(actual == expected);
+            }
+        }
+
+        printf("%-6s all 2^24 packets %s, short buffers wrong: %u\n", decoder.name, all == expectedAll ? "match" : "DIFFER", shortWrong);
+        checks.expect(all == expectedAll && shortWrong == 0, "%s does not decode the same as ClockwiseCaliper", decoder.name);
+    }
+
+    // Random packets
+    std::vector<uint8_t> bytes((size_t)count * BULK_PACKET_SIZE);
+    uint32_t state = 1;
+
+    for (size_t i = 0; i < bytes.size(); i++) {
+        bytes[i] = hostRandom(state);
+    }
+
+    DecodedPackets out(count);
+    double best = 1e9;
+
+    for (uint32_t r = 0; r < repeats; r++) {
+        auto start = std::chrono::steady_clock::now();
+        decodeWithCaliper(bytes.data(), count, out);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = seconds < best ? seconds : best;
+    }
+
+    printf("packets: %u (%.0f MB)\n", count, bytes.size() / (1024.0 * 1024.0));
+    printf("%-16s %8.1f M packets/s\n", "ClockwiseCaliper", count / best / 1e6);
+
+    for (const named_decoder_t &decoder : decoders) {
+        best = 1e9;
+
+        for (uint32_t r = 0; r < repeats; r++) {
+            auto start = std::chrono::steady_clock::now();
+            decodeWith(decoder, bytes.data(), count, out);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = seconds < best ? seconds : best;
+        }
+
+        printf("%-16s %8.1f M packets/s  %6.2f GB/s in\n", decoder.name, count / best / 1e6, bytes.size() / best / 1e9);
+    }
+
+    return checks.finish();
+}
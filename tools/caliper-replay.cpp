@@ -0,0 +1,684 @@
+/*
+ * caliper-replay.cpp - Replay Logic Analyzer Captures Through the Decoder
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Streams a logic analyzer capture of the CLK and DATA lines through the
+// same SoftSPIReceiver and ClockwiseCaliper code the sketch uses. Every
+// decoded packet is printed to stdout, and a summary with the resyncs,
+// the packets PacketFilter rejects and the decode rate is printed to
+// stderr. The printed packets are not filtered.
+//
+// Supported captures:
+//   .vcd  Value change dump, as exported by sigrok/PulseView.
+//   .csv  One row per sample or per change, as exported by sigrok or
+//         Saleae Logic. Comment lines start with ';'. The first row has the
+//         column names, a column starting with "Time" is the time in
+//         seconds. Without one, the sample rate must be given with -s.
+//
+// The capture is expected to be taken on CLK_PIN and DATA_PIN, after the
+// level shifting transistors. Use -r when it was taken on the caliper
+// side, so both lines are inverted first.
+//
+// The file is memory mapped and parsed in one pass, so captures of any
+// length are replayed without loading them into memory.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o caliper-replay
+//       caliper-replay.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   ./caliper-replay [-c clkName] [-d dataName] [-t maxClkTime] [-s sampleRate]
+//                    [-r] [-q] capture.vcd|capture.csv
+//
+// maxClkTime is in milliseconds like BIT_MAX_DELAY in the sketch, and
+// the names default to CLK and DATA.
+
+
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ClockwiseCaliper.h"
+#include "PacketFilter.h"
+#include "SoftSPIReceiver.h"
+
+
+const uint8_t MAX_NAME_LENGTH = 64;
+const uint8_t MAX_CSV_COLUMNS = 64;
+const uint32_t FILTER_MAX_JUMP = 2000; // Same as the sketch
+const uint8_t FILTER_MEDIAN_SIZE = 3;
+
+
+/**
+ * Replay settings from the command line.
+ */
+typedef struct {
+    const char *clkName;  // Name of the clock signal or column
+    const char *dataName; // Name of the data signal or column
+    uint32_t maxClkTime;  // Milliseconds before resyncing, 0 to disable
+    double sampleRate;    // Samples per second, for CSV files without a time column
+    bool raw;             // The capture was taken on the caliper side, invert both lines
+    bool quiet;           // Don't print every packet
+} replay_config_t;
+
+
+/**
+ * Decodes the CLK and DATA levels of a capture into packets, the same way
+ * StaticSoftSPISlave and the sketch do.
+ */
+class ReplayDecoder {
+public:
+    ReplayDecoder(const replay_config_t &config);
+
+    void update(uint64_t time, bool clkState, bool dataState); // Updates the line levels at time nanoseconds.
+
+    uint64_t getEdgeCount();     // Returns the number of clock edges.
+    uint32_t getPacketCount();   // Returns the number of decoded packets.
+    uint32_t getUnknownCount();  // Returns the number of packets with the unknown bits set.
+    uint32_t getResyncCount();   // Returns the number of resyncs due to maxClkTime.
+    uint32_t getLostCount();     // Returns the number of times frames were lost.
+
+    PacketFilter<FILTER_MEDIAN_SIZE> &getFilter(); // Returns the filter the packets also go through.
+
+private:
+    replay_config_t config;
+
+    SoftSPIReceiver<SSPI_LSB_FIRST> receiver;
+    ClockwiseCaliper caliper;
+    PacketFilter<FILTER_MEDIAN_SIZE> filter;
+
+    bool started;  // A level has been seen, so clkState is valid.
+    bool clkState; // Current clock level at the pin.
+
+    uint64_t edgeCount;
+    uint32_t packetCount;
+    uint32_t unknownCount;
+    uint32_t resyncCount;
+    uint8_t lastResyncCount; // Last value of the wrapping receiver count.
+    uint32_t lostCount;
+};
+
+
+/**
+ * Replay decoder constructor.
+ *
+ * @param config replay settings
+ */
+ReplayDecoder::ReplayDecoder(const replay_config_t &config) {
+    this->config = config;
+
+    this->started = false;
+    this->clkState = false;
+
+    this->edgeCount = 0;
+    this->packetCount = 0;
+    this->unknownCount = 0;
+    this->resyncCount = 0;
+    this->lastResyncCount = 0;
+    this->lostCount = 0;
+
+    this->receiver.begin(config.maxClkTime, this->caliper.getPacketLength() * 8);
+    this->filter.begin(FILTER_MAX_JUMP);
+}
+
+
+/**
+ * Updates the line levels at time nanoseconds.
+ * A bit is sampled on the falling clock edge (MODE1 at the pins), with
+ * the time truncated to milliseconds like millis() in the ISR.
+ *
+ * @param time time of the levels in nanoseconds
+ * @param clkState level of the clock line in the capture
+ * @param dataState level of the data line in the capture
+ */
+void ReplayDecoder::update(uint64_t time, bool clkState, bool dataState) {
+    if (this->config.raw) {
+        clkState = !clkState;
+        dataState = !dataState;
+    }
+
+    if (!this->started) {
+        this->started = true;
+        this->clkState = clkState;
+        return;
+    }
+
+    if (clkState == this->clkState) {
+        return;
+    }
+
+    this->clkState = clkState;
+    this->edgeCount++;
+
+    if (clkState) {
+        return; // Only the falling edge samples
+    }
+
+    this->receiver.sample(dataState, (uint32_t)(time / 1000000));
+
+    // Count resyncs past the 8-bit wrap
+    uint8_t resyncs = this->receiver.getResyncCount();
+
+    this->resyncCount += (uint8_t)(resyncs - this->lastResyncCount);
+    this->lastResyncCount = resyncs;
+
+    if (this->receiver.hasLostData()) {
+        this->lostCount++;
+    }
+
+    while (this->receiver.hasData()) {
+        uint32_t packet = ~this->receiver.read() & 0xFFFFFF;
+
+        this->caliper.updatePacket(packet);
+        this->caliper.refershData();
+        this->packetCount++;
+
+        if (packet & 0x600000) { // Bits 21 and 22
+            this->unknownCount++;
+        }
+
+        uint32_t filtered = packet;
+        this->filter.filter(filtered);
+
+        if (!this->config.quiet) {
+            printf("%.6f 0x%06X %.*f %s\n",
+                   time / 1e9,
+                   (unsigned)packet,
+                   this->caliper.getUnit() == INCHES ? 4 : 2,
+                   this->caliper.getMeasurement(),
+                   this->caliper.getUnitString());
+        }
+    }
+}
+
+
+/**
+ * Returns the number of clock edges.
+ *
+ * @return the number of clock edges
+ */
+uint64_t ReplayDecoder::getEdgeCount() {
+    return this->edgeCount;
+}
+
+/**
+ * Returns the number of decoded packets.
+ *
+ * @return the number of decoded packets
+ */
+uint32_t ReplayDecoder::getPacketCount() {
+    return this->packetCount;
+}
+
+/**
+ * Returns the number of packets with the unknown bits (21 and 22) set.
+ * These are always 0 from a working caliper, so this counts packets that
+ * were decoded out of alignment.
+ *
+ * @return the number of packets with the unknown bits set
+ */
+uint32_t ReplayDecoder::getUnknownCount() {
+    return this->unknownCount;
+}
+
+/**
+ * Returns the number of resyncs due to maxClkTime.
+ *
+ * @return the number of resyncs
+ */
+uint32_t ReplayDecoder::getResyncCount() {
+    return this->resyncCount;
+}
+
+/**
+ * Returns the number of times frames were lost because the receive buffer
+ * was full. The buffer is read after every bit, so this should stay 0.
+ *
+ * @return the number of times frames were lost
+ */
+uint32_t ReplayDecoder::getLostCount() {
+    return this->lostCount;
+}
+
+
+/**
+ * Returns the filter the packets also go through, for its rejection
+ * counts.
+ *
+ * @return the filter
+ */
+PacketFilter<FILTER_MEDIAN_SIZE> &ReplayDecoder::getFilter() {
+    return this->filter;
+}
+
+
+/**
+ * Returns true if c is a whitespace character.
+ */
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/**
+ * Reads the next whitespace separated token.
+ *
+ * @param p current position, moved past the token
+ * @param end end of the file
+ * @param token set to the start of the token
+ * @return the length of the token, 0 at the end of the file
+ */
+static size_t nextToken(const char *&p, const char *end, const char *&token) {
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+
+    token = p;
+
+    while (p < end && !isSpace(*p)) {
+        p++;
+    }
+
+    return p - token;
+}
+
+/**
+ * Returns true if the token equals str.
+ */
+static inline bool tokenIs(const char *token, size_t length, const char *str) {
+    return strlen(str) == length && memcmp(token, str, length) == 0;
+}
+
+/**
+ * Parses a decimal number of seconds like "0.000123" or "1.5e-3".
+ *
+ * @param p start of the number
+ * @param end end of the number
+ * @return the time in nanoseconds
+ */
+static uint64_t parseSeconds(const char *p, const char *end) {
+    char buffer[MAX_NAME_LENGTH];
+    size_t length = end - p < MAX_NAME_LENGTH - 1 ? end - p : MAX_NAME_LENGTH - 1;
+
+    // Copied since the mapped file is not NUL terminated
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+
+    return (uint64_t)(strtod(buffer, nullptr) * 1e9 + 0.5);
+}
+
+
+/**
+ * Replays a VCD capture.
+ *
+ * @param p start of the file
+ * @param end end of the file
+ * @param config replay settings
+ * @param decoder decoder to replay the capture through
+ * @return true if the signals were found
+ */
+static bool replayVcd(const char *p, const char *end,
+                      const replay_config_t &config,
+                      ReplayDecoder &decoder) {
+    char clkId[MAX_NAME_LENGTH] = "";
+    char dataId[MAX_NAME_LENGTH] = "";
+    double timescale = 1.0; // Nanoseconds per time unit
+
+    const char *token;
+    size_t length;
+
+    // Header, up to $enddefinitions
+    while ((length = nextToken(p, end, token)) > 0) {
+        if (tokenIs(token, length, "$enddefinitions")) {
+            break;
+
+        } else if (tokenIs(token, length, "$timescale")) {
+            // "1ns", "1 ns", or "10 us", up to $end
+            char scale[MAX_NAME_LENGTH] = "";
+
+            while ((length = nextToken(p, end, token)) > 0 && !tokenIs(token, length, "$end")) {
+                if (strlen(scale) + length < sizeof(scale)) {
+                    strncat(scale, token, length);
+                }
+            }
+
+            char *unit;
+            double multiplier = strtod(scale, &unit);
+
+            if (strcmp(unit, "s") == 0) {
+                timescale = multiplier * 1e9;
+            } else if (strcmp(unit, "ms") == 0) {
+                timescale = multiplier * 1e6;
+            } else if (strcmp(unit, "us") == 0) {
+                timescale = multiplier * 1e3;
+            } else if (strcmp(unit, "ns") == 0) {
+                timescale = multiplier;
+            } else if (strcmp(unit, "ps") == 0) {
+                timescale = multiplier * 1e-3;
+            } else if (strcmp(unit, "fs") == 0) {
+                timescale = multiplier * 1e-6;
+            }
+
+        } else if (tokenIs(token, length, "$var")) {
+            // $var type size id name [range] $end
+            const char *id;
+            const char *name;
+            size_t idLength;
+            size_t nameLength;
+
+            nextToken(p, end, token);
+            nextToken(p, end, token);
+            idLength = nextToken(p, end, id);
+            nameLength = nextToken(p, end, name);
+
+            if (idLength < MAX_NAME_LENGTH && nameLength == strlen(config.clkName)
+                && strncasecmp(name, config.clkName, nameLength) == 0) {
+                memcpy(clkId, id, idLength);
+                clkId[idLength] = '\0';
+
+            } else if (idLength < MAX_NAME_LENGTH && nameLength == strlen(config.dataName)
+                       && strncasecmp(name, config.dataName, nameLength) == 0) {
+                memcpy(dataId, id, idLength);
+                dataId[idLength] = '\0';
+            }
+
+            while ((length = nextToken(p, end, token)) > 0 && !tokenIs(token, length, "$end"));
+
+        } else if (token[0] == '$' && !tokenIs(token, length, "$end")) {
+            // $comment, $date, $version, $scope...
+            while ((length = nextToken(p, end, token)) > 0 && !tokenIs(token, length, "$end"));
+        }
+    }
+
+    if (clkId[0] == '\0' || dataId[0] == '\0') {
+        fprintf(stderr, "Signals %s and %s not found in the $var definitions\n",
+                config.clkName, config.dataName);
+        return false;
+    }
+
+    size_t clkIdLength = strlen(clkId);
+    size_t dataIdLength = strlen(dataId);
+
+    uint64_t time = 0;
+    bool clkState = false;
+    bool dataState = false;
+    bool changed = false;
+
+    // Value changes. All changes at a timestamp are applied before the
+    // clock is looked at, like the ISR reading DATA after the edge
+    while ((length = nextToken(p, end, token)) > 0) {
+        char c = token[0];
+
+        if (c == '#') {
+            if (changed) {
+                decoder.update(time, clkState, dataState);
+                changed = false;
+            }
+
+            uint64_t units = 0;
+
+            for (size_t i = 1; i < length; i++) {
+                units = units * 10 + (token[i] - '0');
+            }
+
+            time = (uint64_t)(units * timescale + 0.5);
+
+        } else if (c == '0' || c == '1' || c == 'x' || c == 'X' || c == 'z' || c == 'Z') {
+            bool state = c == '1';
+
+            if (length - 1 == clkIdLength && memcmp(token + 1, clkId, clkIdLength) == 0) {
+                clkState = state;
+                changed = true;
+
+            } else if (length - 1 == dataIdLength && memcmp(token + 1, dataId, dataIdLength) == 0) {
+                dataState = state;
+                changed = true;
+            }
+
+        } else if (c == 'b' || c == 'B' || c == 'r' || c == 'R') {
+            nextToken(p, end, token); // Vector or real value, skip the id
+
+        } else if (tokenIs(token, length, "$comment")) {
+            while ((length = nextToken(p, end, token)) > 0 && !tokenIs(token, length, "$end"));
+        }
+        // $dumpvars, $dumpall, $end... only wrap value changes
+    }
+
+    if (changed) {
+        decoder.update(time, clkState, dataState);
+    }
+
+    return true;
+}
+
+
+/**
+ * Replays a CSV capture.
+ *
+ * @param p start of the file
+ * @param end end of the file
+ * @param config replay settings
+ * @param decoder decoder to replay the capture through
+ * @return true if the columns were found
+ */
+static bool replayCsv(const char *p, const char *end,
+                      const replay_config_t &config,
+                      ReplayDecoder &decoder) {
+    int timeColumn = -1;
+    int clkColumn = -1;
+    int dataColumn = -1;
+    bool header = true;
+    uint64_t sampleIndex = 0;
+
+    while (p < end) {
+        const char *lineEnd = (const char *)memchr(p, '\n', end - p);
+
+        if (lineEnd == nullptr) {
+            lineEnd = end;
+        }
+
+        const char *line = p;
+
+        p = lineEnd + 1;
+
+        if (line == lineEnd || *line == ';' || *line == '\r') {
+            continue; // Empty or comment
+        }
+
+        // Split the line into columns
+        const char *columns[MAX_CSV_COLUMNS];
+        const char *columnEnds[MAX_CSV_COLUMNS];
+        int columnCount = 0;
+        const char *start = line;
+
+        for (const char *c = line; c <= lineEnd && columnCount < MAX_CSV_COLUMNS; c++) {
+            if (c == lineEnd || *c == ',' || *c == '\r') {
+                const char *columnEnd = c;
+
+                // Trim spaces and quotes
+                while (start < columnEnd && (*start == ' ' || *start == '"')) {
+                    start++;
+                }
+
+                while (columnEnd > start && (columnEnd[-1] == ' ' || columnEnd[-1] == '"')) {
+                    columnEnd--;
+                }
+
+                columns[columnCount] = start;
+                columnEnds[columnCount] = columnEnd;
+                columnCount++;
+                start = c + 1;
+
+                if (c == lineEnd || *c == '\r') {
+                    break;
+                }
+            }
+        }
+
+        if (header) {
+            for (int i = 0; i < columnCount; i++) {
+                size_t length = columnEnds[i] - columns[i];
+
+                if (length >= 4 && strncasecmp(columns[i], "time", 4) == 0) {
+                    timeColumn = i;
+                } else if (length == strlen(config.clkName)
+                           && strncasecmp(columns[i], config.clkName, length) == 0) {
+                    clkColumn = i;
+                } else if (length == strlen(config.dataName)
+                           && strncasecmp(columns[i], config.dataName, length) == 0) {
+                    dataColumn = i;
+                }
+            }
+
+            if (clkColumn < 0 || dataColumn < 0) {
+                fprintf(stderr, "Columns %s and %s not found in the header\n",
+                        config.clkName, config.dataName);
+                return false;
+            }
+
+            if (timeColumn < 0 && config.sampleRate <= 0) {
+                fprintf(stderr, "No time column, the sample rate must be given with -s\n");
+                return false;
+            }
+
+            header = false;
+            continue;
+        }
+
+        if (columnCount <= clkColumn || columnCount <= dataColumn || columnCount <= timeColumn) {
+            continue;
+        }
+
+        char clkChar = *columns[clkColumn];
+        char dataChar = *columns[dataColumn];
+
+        if ((clkChar != '0' && clkChar != '1') || (dataChar != '0' && dataChar != '1')) {
+            continue; // Not a sample row, like sigrok's "logic,logic"
+        }
+
+        uint64_t time;
+
+        if (timeColumn >= 0) {
+            time = parseSeconds(columns[timeColumn], columnEnds[timeColumn]);
+        } else {
+            time = (uint64_t)(sampleIndex * 1e9 / config.sampleRate + 0.5);
+        }
+
+        sampleIndex++;
+
+        decoder.update(time, clkChar == '1', dataChar == '1');
+    }
+
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    replay_config_t config = {"CLK", "DATA", 10, 0, false, false};
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0) {
+            config.raw = true;
+        } else if (strcmp(argv[i], "-q") == 0) {
+            config.quiet = true;
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+            config.clkName = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-d") == 0) {
+            config.dataName = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            config.maxClkTime = strtoul(argv[++i], nullptr, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            config.sampleRate = strtod(argv[++i], nullptr);
+        } else if (argv[i][0] != '-' && path == nullptr) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (path == nullptr) {
+        fprintf(stderr, "Usage: %s [-c clkName] [-d dataName] [-t maxClkTime] "
+                        "[-s sampleRate] [-r] [-q] capture.vcd|capture.csv\n", argv[0]);
+        return 1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    const char *data = "";
+
+    if (st.st_size > 0) {
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map == MAP_FAILED) {
+            perror(path);
+            return 1;
+        }
+
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+        data = (const char *)map;
+    }
+
+    size_t pathLength = strlen(path);
+    bool vcd = pathLength > 4 && strcasecmp(path + pathLength - 4, ".vcd") == 0;
+
+    ReplayDecoder decoder(config);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = vcd ? replayVcd(data, data + st.st_size, config, decoder)
+                  : replayCsv(data, data + st.st_size, config, decoder);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    if (st.st_size > 0) {
+        munmap((void *)data, st.st_size);
+    }
+
+    close(fd);
+
+    if (!ok) {
+        return 1;
+    }
+
+    fprintf(stderr, "clock edges:      %llu\n", (unsigned long long)decoder.getEdgeCount());
+    fprintf(stderr, "packets:          %u\n", decoder.getPacketCount());
+    fprintf(stderr, "unknown bits set: %u\n", decoder.getUnknownCount());
+    fprintf(stderr, "resyncs:          %u\n", decoder.getResyncCount());
+    fprintf(stderr, "frames lost:      %u\n", decoder.getLostCount());
+    fprintf(stderr, "filter rejected:  %u unknown bits, %u unit, %u spike, %u forced\n",
+            decoder.getFilter().getUnknownBitsCount(),
+            decoder.getFilter().getUnitCount(),
+            decoder.getFilter().getSpikeCount(),
+            decoder.getFilter().getForcedCount());
+    fprintf(stderr, "replay time:      %.3f s\n", seconds);
+    fprintf(stderr, "edges/sec:        %.0f\n", decoder.getEdgeCount() / seconds);
+    fprintf(stderr, "MB/sec:           %.1f\n", st.st_size / seconds / 1e6);
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * caliper-sim.cpp - Host Simulation of the Caliper Decoding Pipeline
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Feeds random packets from CaliperSignalGenerator through the same
+// SoftSPIReceiver and ClockwiseCaliper code the sketch uses, the same way
+// StaticSoftSPISlave does: a bit is sampled on every falling clock edge
+// with the time in milliseconds, and each frame is inverted before being
+// passed to the caliper.
+//
+// Every packet is checked against what was sent, and the decode rate on
+// this machine is reported. Without noise the packets are random, and it
+// exits with 1 if any packet was corrupted, missing, or decoded twice.
+//
+// With missing clock pulses (-d), a packet they hit can't be decoded, so
+// it is checked the way the sketch copes with it: the packets follow a
+// slow random walk, like a caliper being moved, and every frame goes
+// through PacketFilter as in recievePacket(). It exits with 1 if a
+// corrupted frame gets through the filter, or if a packet the noise did
+// not hit is not received and accepted, so the decoding has to recover by
+// the next packet.
+//
+// There are no glitch pulse options: a glitch shifts the bits after it,
+// and when the value is small the shifted frame is within FILTER_MAX_JUMP
+// and no filter can tell it from the caliper moving. noise-sweep reports
+// how often that happens.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o caliper-sim
+//       caliper-sim.cpp CaliperSignal.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   ./caliper-sim [-n packets] [-p clkPeriod] [-j jitter] [-d dropRate] [-s seed]
+//
+// Times are in microseconds, rates are out of 65536.
+
+
+#include <chrono>
+#include <stdio.h>
+#include "CaliperPacket.h"
+#include "CaliperSignal.h"
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+#include "PacketFilter.h"
+#include "SoftSPIReceiver.h"
+
+
+const uint32_t BIT_MAX_DELAY = 10;            // Same as the sketch, in milliseconds
+const uint32_t PACKET_INTERVAL = 150000;      // Microseconds between packets
+const uint32_t PACKET_RANDOM_MASK = 0x9FFFFF; // Measurement, sign and unit bits, the unknown bits stay 0
+const int32_t WALK_STEP = 100;                // Counts, the largest change between packets of the random walk
+const int32_t WALK_LIMIT = 200000;            // Counts, the random walk turns back beyond this
+
+// Same as the sketch
+const uint32_t FILTER_MAX_JUMP = 2000;
+const uint8_t FILTER_MEDIAN_SIZE = 3;
+
+
+/**
+ * Rebuilds the 24-bit packet from what the caliper decoded.
+ *
+ * @param caliper caliper with refreshed data
+ * @return the packet the caliper data represents
+ */
+static uint32_t caliperPacket(ClockwiseCaliper &caliper) {
+    return caliper.getRawMeasurement()
+         | ((uint32_t)caliper.getSign() << 20)
+         | ((uint32_t)caliper.getUnit() << 23);
+}
+
+
+int main(int argc, char **argv) {
+    caliper_signal_config_t config = {400, PACKET_INTERVAL, 0, 0, 20, 0, 0, 0};
+    uint32_t packetCount = 100000;
+    uint32_t seed = 1;
+
+    if (!parseHostOptions(argc, argv, {{"-n", packetCount}, {"-p", config.clkPeriod}, {"-j", config.jitter},
+                                       {"-d", config.dropRate}, {"-s", seed}})) {
+        return 1;
+    }
+
+    CaliperSignalGenerator generator(config, seed);
+    SoftSPIReceiver<SSPI_LSB_FIRST> receiver;
+    PacketFilter<FILTER_MEDIAN_SIZE> filter;
+    ClockwiseCaliper caliper;
+    caliper_signal_edge_t edges[CALIPER_SIGNAL_MAX_EDGES];
+    bool noisy = config.dropRate > 0;
+    int32_t value = 0;
+
+    uint32_t correct = 0;
+    uint32_t corrupted = 0;
+    uint32_t missing = 0;
+    uint32_t extra = 0;
+    uint32_t hit = 0;        // Packets the noise removed clock edges from
+    uint32_t rejected = 0;   // Frames the packet filter rejected
+    uint32_t undetected = 0; // Corrupted frames the packet filter accepted
+    uint32_t intactLost = 0; // Packets the noise did not hit, but were not received correctly and accepted
+    uint64_t edgeTotal = 0;
+
+    receiver.begin(BIT_MAX_DELAY, caliper.getPacketLength() * 8);
+    filter.begin(FILTER_MAX_JUMP);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < packetCount; i++) {
+        uint32_t packet = generator.random() & PACKET_RANDOM_MASK;
+
+        if (noisy) {
+            // Random walk, turning back at the limits
+            value += (int32_t)(generator.random() % (2 * WALK_STEP + 1)) - WALK_STEP;
+            value = value > WALK_LIMIT ? WALK_LIMIT : (value < -WALK_LIMIT ? -WALK_LIMIT : value);
+            packet = encodeCaliperPacket(value, MILLIMETERS);
+        }
+
+        uint8_t edgeCount = generator.generatePacket(packet, edges);
+        bool intact = edgeCount == CALIPER_SIGNAL_PACKET_BITS * 2;
+        bool received = false;
+        bool accepted = false;
+        bool extraFrame = false;
+
+        edgeTotal += edgeCount;
+        hit += intact ? 0 : 1;
+
+        for (uint8_t e = 0; e < edgeCount; e++) {
+            if (!edges[e].clk) { // Sampling edge for MODE1
+                receiver.sample(edges[e].data, edges[e].time / 1000);
+            }
+        }
+
+        while (receiver.hasData()) {
+            uint32_t frame = ~receiver.read() & CALIPER_PACKET_MASK;
+
+            if (noisy) {
+                // Same as recievePacket(), the caliper gets the filtered packet
+                uint32_t filtered = frame;
+                bool frameAccepted = filter.filter(filtered);
+
+                if (frameAccepted) {
+                    caliper.updatePacket(filtered);
+                }
+
+                rejected += frameAccepted ? 0 : 1;
+                undetected += frameAccepted && frame != packet ? 1 : 0;
+                accepted = accepted || (frameAccepted && frame == packet);
+
+            } else {
+                caliper.updatePacket(frame);
+                caliper.refershData();
+                frame = caliperPacket(caliper);
+            }
+
+            if (received) {
+                extra++;
+                extraFrame = true;
+            } else if (frame == packet) {
+                correct++;
+            } else {
+                corrupted++;
+            }
+
+            received = true;
+        }
+
+        if (!received) {
+            missing++;
+        }
+
+        if (noisy && intact && (!accepted || extraFrame)) {
+            intactLost++;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    printf("packets sent:      %u\n", packetCount);
+    printf("packets correct:   %u\n", correct);
+    printf("packets corrupted: %u\n", corrupted);
+    printf("packets missing:   %u\n", missing);
+    printf("extra frames:      %u\n", extra);
+    printf("resyncs:           %u (wraps at 255)\n", receiver.getResyncCount());
+
+    if (noisy) {
+        printf("packets hit:       %u\n", hit);
+        printf("frames rejected:   %u\n", rejected);
+        printf("corrupted let in:  %u\n", undetected);
+        printf("intact not typed:  %u\n", intactLost);
+    }
+
+    printf("decode time:       %.3f s\n", seconds);
+    printf("edges/sec:         %.0f\n", edgeTotal / seconds);
+    printf("packets/sec:       %.0f\n", packetCount / seconds);
+
+    HostChecks checks;
+
+    if (noisy) {
+        checks.expect(undetected == 0, "%u corrupted frames accepted by the packet filter", undetected);
+        checks.expect(intactLost == 0, "%u packets the noise did not hit were not received and accepted", intactLost);
+    } else {
+        checks.expect(corrupted == 0, "%u packets corrupted", corrupted);
+        checks.expect(missing == 0, "%u packets missing", missing);
+        checks.expect(extra == 0, "%u extra frames", extra);
+    }
+
+    return checks.finish();
+}
@@ -0,0 +1,196 @@
+/*
+ * format-bench.cpp - Compare Float and Fixed Point Measurement Formatting
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Formats every possible caliper measurement (all 20-bit values, both
+// units, both signs) two ways:
+//   float  getMeasurement() printed the way Arduino's Print::printFloat()
+//          does with 4 digits, using float since double is float on AVR.
+//   fixed  ClockwiseCaliper::formatMeasurement().
+//
+// The fixed output is checked against the exact decimal value, and the
+// float output is compared to it to show where float rounding types the
+// wrong last digit. The time per measurement on this machine is reported
+// for both.
+//
+// The cycle and flash cost on the board is best read from the AVR build
+// itself, e.g. with avr-size before and after, since host timings only
+// show the relative difference.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o format-bench
+//       format-bench.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+
+
+const uint32_t MEASUREMENT_COUNT = (uint32_t)1 << 20;
+
+
+/**
+ * Writes number the way Arduino's Print::printFloat() does.
+ *
+ * @param buffer buffer of at least 32 characters
+ * @param number number to write
+ * @param digits decimal places
+ * @return the length of the text written
+ */
+static uint8_t printFloat(char *buffer, float number, uint8_t digits) {
+    char *pChar = buffer;
+
+    if (number < 0.0f) {
+        *pChar++ = '-';
+        number = -number;
+    }
+
+    float rounding = 0.5f;
+
+    for (uint8_t i = 0; i < digits; i++) {
+        rounding /= 10.0f;
+    }
+
+    number += rounding;
+
+    unsigned long intPart = (unsigned long)number;
+    float remainder = number - (float)intPart;
+
+    pChar += sprintf(pChar, "%lu", intPart);
+
+    if (digits > 0) {
+        *pChar++ = '.';
+    }
+
+    while (digits-- > 0) {
+        remainder *= 10.0f;
+        unsigned int toPrint = (unsigned int)remainder;
+        *pChar++ = '0' + toPrint;
+        remainder -= toPrint;
+    }
+
+    *pChar = '\0';
+
+    return pChar - buffer;
+}
+
+/**
+ * Writes the exact value of a packet with snprintf, for checking.
+ *
+ * @param buffer buffer of at least 32 characters
+ * @param packet caliper packet
+ */
+static void printExact(char *buffer, uint32_t packet) {
+    uint32_t raw = packet & 0xFFFFF;
+    uint32_t value = raw * (packet & 0x800000 ? 5 : 100); // Ten-thousandths
+
+    sprintf(buffer, "%s%lu.%04lu",
+            (packet & 0x100000) && raw > 0 ? "-" : "",
+            (unsigned long)(value / 10000),
+            (unsigned long)(value % 10000));
+}
+
+/**
+ * Returns the packet for measurement index i.
+ * Covers both units and both signs.
+ */
+static inline uint32_t packetFor(uint32_t i, uint8_t variant) {
+    return i | ((uint32_t)(variant & 1) << 20) | ((uint32_t)(variant >> 1) << 23);
+}
+
+
+int main() {
+    ClockwiseCaliper caliper;
+    char floatStr[32];
+    char fixedStr[MEASUREMENT_STR_SIZE];
+    char exactStr[32];
+    uint32_t fixedWrong = 0;
+    uint32_t floatWrong = 0;
+    uint32_t checksum = 0;
+
+    // Correctness
+    for (uint8_t variant = 0; variant < 4; variant++) {
+        for (uint32_t i = 0; i < MEASUREMENT_COUNT; i++) {
+            uint32_t packet = packetFor(i, variant);
+
+            caliper.updatePacket(packet);
+            caliper.refershData();
+
+            caliper.formatMeasurement(fixedStr);
+            printFloat(floatStr, caliper.getMeasurement(), MEASUREMENT_DECIMALS);
+            printExact(exactStr, packet);
+
+            if (strcmp(fixedStr, exactStr) != 0) {
+                if (fixedWrong++ < 5) {
+                    printf("fixed wrong: %s, expected %s\n", fixedStr, exactStr);
+                }
+            }
+
+            if (strcmp(floatStr, exactStr) != 0) {
+                if (floatWrong++ < 5) {
+                    printf("float wrong: %s, expected %s\n", floatStr, exactStr);
+                }
+            }
+        }
+    }
+
+    // Timing, including the conversion from the caliper data
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (uint8_t variant = 0; variant < 4; variant++) {
+        for (uint32_t i = 0; i < MEASUREMENT_COUNT; i++) {
+            caliper.updatePacket(packetFor(i, variant));
+            caliper.refershData();
+
+            checksum += printFloat(floatStr, caliper.getMeasurement(), MEASUREMENT_DECIMALS);
+        }
+    }
+
+    auto midTime = std::chrono::steady_clock::now();
+
+    for (uint8_t variant = 0; variant < 4; variant++) {
+        for (uint32_t i = 0; i < MEASUREMENT_COUNT; i++) {
+            caliper.updatePacket(packetFor(i, variant));
+            caliper.refershData();
+
+            checksum += caliper.formatMeasurement(fixedStr);
+        }
+    }
+
+    auto endTime = std::chrono::steady_clock::now();
+
+    double total = 4.0 * MEASUREMENT_COUNT;
+    double floatNs = std::chrono::duration<double, std::nano>(midTime - startTime).count() / total;
+    double fixedNs = std::chrono::duration<double, std::nano>(endTime - midTime).count() / total;
+
+    printf("measurements:  %.0f\n", total);
+    printf("float wrong:   %u\n", floatWrong);
+    printf("fixed wrong:   %u\n", fixedWrong);
+    printf("float ns/each: %.1f\n", floatNs);
+    printf("fixed ns/each: %.1f\n", fixedNs);
+    printf("checksum:      %u\n", checksum);
+
+    HostChecks checks;
+
+    // The float formatting is the old way, its mistakes are only reported
+    checks.expect(fixedWrong == 0, "%u measurements formatted wrong", fixedWrong);
+
+    return checks.finish();
+}
@@ -0,0 +1,246 @@
+/*
+ * hardware-spi-sim.cpp - HardwareSPISlave Framing on a Simulated SPI Peripheral
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Builds HardwareSPISlave, unchanged, against the simulated board in mock/,
+// whose SPI peripheral shifts in the bits, and replays caliper packets from
+// CaliperSignalGenerator wired as HARDWARE_SPI_CAPTURE expects: the clock
+// to clkPin and SCK, the data to MOSI, and the SS gate to SS. The external
+// interrupt flag stays set while the clock interrupt is detached, like on
+// the AVR, so an edge during a frame can run clkIsr() the moment it is
+// attached again.
+//
+// Three runs, each checking every frame against the packet sent:
+//   - clean: every packet must be received, once.
+//   - broken: some packets lose a clock pulse or get an extra one. A
+//     broken packet may be lost or corrupted, and so may the packet right
+//     after it, whose first clock finishes the byte left over. Every other
+//     packet must be received, once, so the framing has to realign.
+//   - mid-packet start: begin() is called part way through a packet, as
+//     when the board boots with the caliper running. Every packet after
+//     that one must be received.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -Imock -I../src/DataInterface -o hardware-spi-sim
+//       hardware-spi-sim.cpp CaliperSignal.cpp
+//       ../src/DataInterface/HardwareSPISlave.cpp
+//
+// Usage:
+//   ./hardware-spi-sim [-n packets] [-b breakRate] [-s seed]
+//
+// Rates are out of 65536.
+
+
+#include <stdio.h>
+#include "CaliperPacket.h"
+#include "CaliperSignal.h"
+#include "HardwareSPISlave.h"
+#include "HostHarness.h"
+
+
+const int16_t CLK_PIN = 0;
+const uint32_t BIT_MAX_DELAY = 10;            // Same as the sketch, in milliseconds
+const uint8_t FRAME_LENGTH = 24;
+const uint32_t PACKET_RANDOM_MASK = 0x9FFFFF; // Measurement, sign and unit bits, the unknown bits stay 0
+const uint16_t GLITCH_WIDTH = 20;             // Microseconds, extra clock pulses
+
+/**
+ * Counts of one run.
+ */
+typedef struct {
+    uint32_t packets;
+    uint32_t broken;    // Packets with a clock pulse missing or added
+    uint32_t correct;
+    uint32_t missing;   // Packets that had to be received, but were not
+    uint32_t corrupted; // Frames not matching a packet that had to be received
+    uint32_t extra;     // Frames after the first one of a packet
+    uint32_t resyncs;
+} run_result_t;
+
+
+/**
+ * Sets the clock and data lines as they are wired to the board.
+ *
+ * @param edge state of the lines
+ */
+static void setLines(const caliper_signal_edge_t &edge) {
+    mockSetPin(MOSI, edge.data);
+    mockSetPin(CLK_PIN, edge.clk);
+    mockSetPin(SCK, edge.clk);
+}
+
+/**
+ * Removes a clock pulse from a packet, or adds a glitch pulse to it.
+ *
+ * @param edges edges of the packet
+ * @param edgeCount number of edges in edges, updated
+ * @param randomState random generator state
+ */
+static void breakPacket(caliper_signal_edge_t *edges, uint8_t &edgeCount, uint32_t &randomState) {
+    // A rising edge and the falling edge after it, the clock idles LOW
+    uint8_t rising = hostRandomRange(randomState, 0, edgeCount / 2 - 1) * 2;
+
+    if (hostRandom(randomState) & 1) {
+        for (uint8_t e = rising; e + 2 < edgeCount; e++) {
+            edges[e] = edges[e + 2];
+        }
+
+        edgeCount -= 2;
+
+    } else {
+        caliper_signal_edge_t high = edges[rising + 1];
+        caliper_signal_edge_t low;
+
+        high.time += GLITCH_WIDTH;
+        high.clk = true;
+        low = high;
+        low.time += GLITCH_WIDTH;
+        low.clk = false;
+
+        for (uint8_t e = edgeCount - 1; e > rising + 1; e--) {
+            edges[e + 2] = edges[e];
+        }
+
+        edges[rising + 2] = high;
+        edges[rising + 3] = low;
+        edgeCount += 2;
+    }
+}
+
+/**
+ * Replays packets to a HardwareSPISlave and counts what it receives.
+ *
+ * @param packetCount packets to send
+ * @param breakRate chance of a packet being broken, out of 65536
+ * @param startEdge edge of the first packet to call begin() at, 0 for before it
+ * @param seed random seed, not 0
+ * @return the counts
+ */
+static run_result_t runCapture(uint32_t packetCount, uint16_t breakRate, uint8_t startEdge, uint32_t seed) {
+    caliper_signal_config_t config = {400, 150000, 0, 0, 20, 0, 0, 0};
+    CaliperSignalGenerator generator(config, seed);
+    caliper_signal_edge_t edges[CALIPER_SIGNAL_MAX_EDGES + 2];
+    HardwareSPISlave slave(CLK_PIN, SS);
+    run_result_t result = {};
+    uint32_t randomState = seed;
+    uint32_t timeOffset = mockBoard().time + 1000000;
+    bool previousBroken = false;
+
+    mockSetPin(CLK_PIN, LOW);
+    mockSetPin(SCK, LOW);
+    mockClearInterruptFlags();
+    mockBoard().spiIsr = []() {
+        HardwareSPISlave::instance->spiIsr();
+    };
+
+    for (uint32_t i = 0; i < packetCount; i++) {
+        uint32_t packet = generator.random() & PACKET_RANDOM_MASK;
+        uint8_t edgeCount = generator.generatePacket(packet, edges);
+        bool broken = (hostRandom(randomState) & 0xFFFF) < breakRate;
+        bool mustReceive = !broken && !previousBroken && !(i == 0 && startEdge > 0);
+        bool received = false;
+
+        if (broken) {
+            breakPacket(edges, edgeCount, randomState);
+            result.broken++;
+        }
+
+        for (uint8_t e = 0; e < edgeCount; e++) {
+            if (i == 0 && e == startEdge) {
+                slave.begin(SSPI_MODE1, SSPI_LSB_FIRST, BIT_MAX_DELAY, FRAME_LENGTH);
+            }
+
+            mockBoard().time = timeOffset + edges[e].time;
+            setLines(edges[e]);
+        }
+
+        while (slave.rxHasData()) {
+            uint32_t frame = ~slave.read() & CALIPER_PACKET_MASK;
+
+            if (received) {
+                result.extra++;
+            } else if (frame == packet) {
+                result.correct++;
+            } else if (mustReceive) {
+                result.corrupted++;
+            }
+
+            received = true;
+        }
+
+        if (!received && mustReceive) {
+            result.missing++;
+        }
+
+        previousBroken = broken;
+    }
+
+    slave.end();
+
+    result.packets = packetCount;
+    result.resyncs = slave.getResyncCount();
+
+    return result;
+}
+
+/**
+ * Prints and checks the counts of a run.
+ *
+ * @param checks where failures are counted
+ * @param name the run
+ * @param result counts of the run
+ */
+static void checkRun(HostChecks &checks, const char *name, const run_result_t &result) {
+    printf("%-18s packets %6u, broken %5u, correct %6u, missing %5u, corrupted %5u, extra %3u, resyncs %3u\n",
+           name, result.packets, result.broken, result.correct, result.missing, result.corrupted, result.extra,
+           result.resyncs);
+
+    checks.expect(result.missing == 0, "%s: %u packets missing", name, result.missing);
+    checks.expect(result.corrupted == 0, "%s: %u packets corrupted", name, result.corrupted);
+    checks.expect(result.extra == 0, "%s: %u extra frames", name, result.extra);
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t packetCount = 20000;
+    uint16_t breakRate = 655;
+    uint32_t seed = 1;
+
+    if (!parseHostOptions(argc, argv, {{"-n", packetCount}, {"-b", breakRate}, {"-s", seed}})) {
+        return 1;
+    }
+
+    if (packetCount == 0 || seed == 0) {
+        fprintf(stderr, "Packets and seed must not be 0\n");
+        return 1;
+    }
+
+    HostChecks checks;
+
+    checkRun(checks, "clean", runCapture(packetCount, 0, 0, seed));
+    checkRun(checks, "broken", runCapture(packetCount, breakRate, 0, seed));
+
+    // Starting after each bit of the first byte, the second, and the last
+    for (uint8_t startEdge : {1, 2, 5, 16, 17, 30, 47}) {
+        char name[32];
+
+        snprintf(name, sizeof(name), "start at edge %u", startEdge);
+        checkRun(checks, name, runCapture(packetCount / 10, 0, startEdge, seed));
+    }
+
+    return checks.finish();
+}
@@ -0,0 +1,341 @@
+/*
+ * history-check.cpp - Checks MeasurementHistory Against a Brute Force Model
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Feeds random readings to the history of a ClockwiseCaliper, through
+// updatePacket() like the sketch, and to a MeasurementHistory<4>, and
+// after every packet checks everything they return against a model that
+// keeps every packet since the last unit change and recomputes it all
+// with a pass over them:
+//   - the packets kept and their times, newest first, across many
+//     wraparounds of the ring.
+//   - min, max, sum, mean and variance of the packets kept.
+//   - the stable run: its length, count and rounded mean, restarted
+//     whenever its values spread more than 2 * tolerance.
+//   - the history starting over when the unit changes.
+// The readings wander with some noise, jump now and then, cross zero,
+// reach the largest measurement, and change unit, with a random tolerance
+// for each run.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o history-check
+//       history-check.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   ./history-check [-n packets] [-r runs] [-s seed]
+
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "CaliperPacket.h"
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+#include "MeasurementHistory.h"
+
+
+const int32_t VALUE_MAX = CALIPER_PACKET_MEASUREMENT_MASK; // Largest measurement
+const uint16_t TOLERANCE_MAX = 3;   // Counts
+const uint8_t UNIT_CHANGE_RATE = 2; // Percent of packets
+const uint8_t JUMP_RATE = 5;        // Percent of packets
+const uint8_t EXTREME_RATE = 2;     // Percent of jumps that go to the largest measurement
+
+
+/**
+ * Every packet since the last unit change, and what the history should
+ * return for them.
+ */
+class HistoryModel {
+public:
+    std::vector<measurement_record_t> records; // Oldest first
+    size_t stableFirst = 0;                    // Index of the first packet of the stable run
+    uint16_t tolerance = 0;
+
+    /**
+     * Adds a packet, starting over on a unit change.
+     *
+     * @param packet 24-bit packet
+     * @param time milliseconds
+     */
+    void add(uint32_t packet, uint32_t time) {
+        if (!this->records.empty() && caliperPacketUnit(packet) != caliperPacketUnit(this->records.back().packet)) {
+            this->records.clear();
+        }
+
+        this->records.push_back({time, packet});
+
+        // The new packet joins the run if the whole run still fits, or starts a new one
+        if (this->records.size() == 1 || this->spread(this->stableFirst) > 2 * (int64_t)this->tolerance) {
+            this->stableFirst = this->records.size() - 1;
+        }
+    }
+
+    /**
+     * Returns the packets kept by a history of a size.
+     *
+     * @param size history size
+     * @return the number kept
+     */
+    size_t kept(size_t size) const {
+        return this->records.size() < size ? this->records.size() : size;
+    }
+
+    /**
+     * Returns a kept packet.
+     *
+     * @param index 0 for the newest
+     * @return the packet
+     */
+    const measurement_record_t &record(size_t index) const {
+        return this->records[this->records.size() - 1 - index];
+    }
+
+    /**
+     * Returns the value of a kept packet.
+     *
+     * @param index 0 for the newest
+     * @return the signed value
+     */
+    int32_t value(size_t index) const {
+        return caliperPacketValue(this->record(index).packet);
+    }
+
+    /**
+     * Returns the largest minus the smallest value from a packet on.
+     *
+     * @param first index of the first packet, oldest first
+     * @return the spread
+     */
+    int64_t spread(size_t first) const {
+        int32_t min = caliperPacketValue(this->records[first].packet);
+        int32_t max = min;
+
+        for (size_t i = first; i < this->records.size(); i++) {
+            int32_t value = caliperPacketValue(this->records[i].packet);
+
+            min = value < min ? value : min;
+            max = value > max ? value : max;
+        }
+
+        return (int64_t)max - min;
+    }
+};
+
+
+/**
+ * Counts failed checks of a history, printing the first.
+ */
+class Mismatches {
+public:
+    uint32_t count = 0;
+
+    /**
+     * Records a check.
+     *
+     * @param ok result of the check
+     * @param name history and what was checked
+     * @param packetIndex packet the check was made after
+     */
+    void expect(bool ok, const char *name, uint32_t packetIndex) {
+        if (!ok) {
+            if (this->count == 0) {
+                printf("first mismatch: %s, after packet %u\n", name, packetIndex);
+            }
+
+            this->count++;
+        }
+    }
+};
+
+/**
+ * Returns true if two floating point results are the same within the
+ * rounding of a float.
+ *
+ * @param actual returned by the history
+ * @param expected computed by the model
+ * @return true if they are close
+ */
+static bool close(float actual, double expected) {
+    return fabs(actual - expected) <= 1e-3 + fabs(expected) * 1e-5;
+}
+
+/**
+ * Checks everything a history returns against the model.
+ *
+ * @param history history to check
+ * @param model model of it
+ * @param mismatches where failed checks are counted
+ * @param packetIndex packet just added
+ */
+template <uint8_t Size>
+static void checkHistory(MeasurementHistory<Size> &history, const HistoryModel &model,
+                         Mismatches &mismatches, uint32_t packetIndex) {
+    size_t kept = model.kept(Size);
+    bool recordsMatch = history.getCount() == kept;
+    int32_t min = kept > 0 ? model.value(0) : 0;
+    int32_t max = min;
+    int64_t sum = 0;
+
+    for (size_t i = 0; i < kept && recordsMatch; i++) {
+        measurement_record_t record = history.getRecord(i);
+
+        recordsMatch = record.packet == model.record(i).packet && record.time == model.record(i).time;
+        min = model.value(i) < min ? model.value(i) : min;
+        max = model.value(i) > max ? model.value(i) : max;
+        sum += model.value(i);
+    }
+
+    mismatches.expect(recordsMatch, "packets kept", packetIndex);
+
+    if (!recordsMatch) {
+        return;
+    }
+
+    double mean = kept > 0 ? (double)sum / kept : 0;
+    double variance = 0;
+
+    for (size_t i = 0; i < kept; i++) {
+        variance += (model.value(i) - mean) * (model.value(i) - mean);
+    }
+
+    variance = kept > 0 ? variance / kept : 0;
+
+    mismatches.expect(history.getMin() == min, "min", packetIndex);
+    mismatches.expect(history.getMax() == max, "max", packetIndex);
+    mismatches.expect(history.getSum() == sum, "sum", packetIndex);
+    mismatches.expect(close(history.getMean(), mean), "mean", packetIndex);
+    mismatches.expect(close(history.getVariance(), variance), "variance", packetIndex);
+
+    // Stable run, not limited to the packets kept
+    size_t stableCount = model.records.size() - model.stableFirst;
+    int64_t stableSum = 0;
+
+    for (size_t i = model.stableFirst; i < model.records.size(); i++) {
+        stableSum += caliperPacketValue(model.records[i].packet);
+    }
+
+    int32_t stableValue = stableCount > 0 ? llround((double)stableSum / stableCount) : 0;
+    uint32_t stableTime = stableCount > 0 ? model.records.back().time - model.records[model.stableFirst].time : 0;
+
+    mismatches.expect(history.getStableCount() == stableCount, "stable count", packetIndex);
+    mismatches.expect(history.getStableTime() == stableTime, "stable time", packetIndex);
+    mismatches.expect(history.getStableValue() == stableValue, "stable value", packetIndex);
+}
+
+
+/**
+ * Returns the next reading: noise around the last one, a jump now and
+ * then, and a unit change now and then.
+ *
+ * @param state random generator state
+ * @param value last value, updated
+ * @param unit last unit, updated
+ * @return the packet
+ */
+static uint32_t nextPacket(uint32_t &state, int32_t &value, caliper_unit_t &unit) {
+    if (hostRandomRange(state, 1, 100) <= UNIT_CHANGE_RATE) {
+        unit = unit == MILLIMETERS ? INCHES : MILLIMETERS;
+    }
+
+    if (hostRandomRange(state, 1, 100) <= JUMP_RATE) {
+        if (hostRandomRange(state, 1, 100) <= EXTREME_RATE) {
+            value = hostRandom(state) & 1 ? VALUE_MAX : -VALUE_MAX;
+        } else {
+            value = (int32_t)hostRandomRange(state, 0, 4000) - 2000; // Often crossing zero
+        }
+    } else {
+        value += (int32_t)hostRandomRange(state, 0, 2 * (TOLERANCE_MAX + 1)) - (TOLERANCE_MAX + 1);
+        value = value > VALUE_MAX ? VALUE_MAX : (value < -VALUE_MAX ? -VALUE_MAX : value);
+    }
+
+    return encodeCaliperPacket(value, unit);
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t packetCount = 2000;
+    uint32_t runCount = 200;
+    uint32_t seed = 1;
+
+    if (!parseHostOptions(argc, argv, {{"-n", packetCount}, {"-r", runCount}, {"-s", seed}})) {
+        return 1;
+    }
+
+    if (seed == 0) {
+        fprintf(stderr, "Seed must not be 0\n");
+        return 1;
+    }
+
+    uint32_t state = seed;
+    uint32_t unitChanges = 0;
+    uint32_t longestRun = 0;
+    Mismatches caliperMismatches;
+    Mismatches smallMismatches;
+
+    for (uint32_t run = 0; run < runCount; run++) {
+        ClockwiseCaliper caliper;
+        MeasurementHistory<4> small;
+        HistoryModel model;
+        int32_t value = 0;
+        caliper_unit_t unit = MILLIMETERS;
+        uint32_t time = hostRandom(state); // Wraps around during some runs
+
+        model.tolerance = hostRandomRange(state, 0, TOLERANCE_MAX);
+        caliper.getHistory().setTolerance(model.tolerance);
+        small.setTolerance(model.tolerance);
+
+        // A caliper starts in millimeters, the first packet in inches is a unit change
+        model.add(encodeCaliperPacket(0, MILLIMETERS), time);
+        caliper.updatePacket(encodeCaliperPacket(0, MILLIMETERS), time);
+        small.add(encodeCaliperPacket(0, MILLIMETERS), time);
+
+        for (uint32_t i = 0; i < packetCount; i++) {
+            caliper_unit_t lastUnit = unit;
+            uint32_t packet = nextPacket(state, value, unit);
+
+            time += hostRandomRange(state, 140, 160);
+
+            if (unit != lastUnit) {
+                small.clear(); // As ClockwiseCaliper::updatePacket() does
+                unitChanges++;
+            }
+
+            model.add(packet, time);
+            caliper.updatePacket(packet, time);
+            small.add(packet, time);
+
+            checkHistory(caliper.getHistory(), model, caliperMismatches, i);
+            checkHistory(small, model, smallMismatches, i);
+
+            longestRun = model.records.size() - model.stableFirst > longestRun
+                       ? model.records.size() - model.stableFirst : longestRun;
+        }
+    }
+
+    printf("runs: %u, packets per run: %u, unit changes: %u, longest stable run: %u packets\n",
+           runCount, packetCount, unitChanges, longestRun);
+    printf("ClockwiseCaliper history (%u packets): %u mismatches\n", HISTORY_SIZE, caliperMismatches.count);
+    printf("MeasurementHistory<4>: %u mismatches\n", smallMismatches.count);
+
+    HostChecks checks;
+
+    checks.expect(caliperMismatches.count == 0, "ClockwiseCaliper history: %u mismatches", caliperMismatches.count);
+    checks.expect(smallMismatches.count == 0, "MeasurementHistory<4>: %u mismatches", smallMismatches.count);
+    checks.expect(unitChanges > 0 && longestRun > HISTORY_SIZE, "the readings never changed unit or stayed stable");
+
+    return checks.finish();
+}
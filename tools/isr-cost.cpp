@@ -0,0 +1,301 @@
+/*
+ * isr-cost.cpp - Board Accesses per Clock Edge of the Software SPI Slaves
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Builds SoftSPISlave and StaticSoftSPISlave, unchanged, against the
+// simulated board in mock/, clocks random bytes into them, and counts what
+// clkIsr() does on the board for each clock edge: port register reads and
+// writes, timer reads, and other Arduino calls (digitalRead(), pinMode(),
+// delays...). The AVR cycles are not counted, the counts stand in for
+// them: a port register read is a single instruction, an Arduino call is
+// tens to hundreds of cycles.
+//
+// Each configuration has a budget, the most of each an edge may take:
+//   - a port read for each of SS, CLK (only when both edges interrupt),
+//     and each sample of the data line, or the read of the
+//     read-modify-write of MISO.
+//   - a port write for MISO, when used.
+//   - a timer read for maxClkTime, and one for the edge time filter.
+//   - no other Arduino call, but the delays between data samples.
+// The bytes received are checked too, so the edges counted are the ones
+// decoding them.
+//
+// Exits with 1 if an edge goes over its budget, or a byte is wrong.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -Imock -I../src/DataInterface -o isr-cost
+//       isr-cost.cpp ../src/DataInterface/SoftSPISlave.cpp
+//
+// Usage:
+//   ./isr-cost [-n bytes] [-s seed]
+
+
+#include <stdio.h>
+#include "HostHarness.h"
+#include "SoftSPISlave.h"
+#include "StaticSoftSPISlave.h"
+
+
+const int16_t CLK_PIN = 0;
+const int16_t MISO_PIN = 1;
+const int16_t MOSI_PIN = 2;
+const int16_t SS_PIN = 3;
+
+const uint32_t HALF_PERIOD = 200;  // Microseconds between clock edges
+const uint32_t MAX_CLK_TIME = 10;  // Milliseconds, same as the sketch's BIT_MAX_DELAY
+const uint16_t MIN_CLK_TIME = 100; // Microseconds, edge time filter when enabled
+const uint8_t SAMPLE_SPACING = 2;  // Microseconds, between data samples when enabled
+
+/**
+ * Counts of one configuration.
+ */
+typedef struct {
+    uint32_t edges;      // Clock edges that ran clkIsr()
+    mock_counts_t total; // Over all edges
+    mock_counts_t max;   // Most in one edge
+    uint32_t wrongBytes; // Bytes received that were not the ones sent
+} isr_cost_t;
+
+
+/**
+ * Sets the clock, and adds what the ISRs it ran did to cost.
+ *
+ * @param cost counts to add to
+ * @param level new clock level
+ */
+static void clockEdge(isr_cost_t &cost, bool level) {
+    mockClearCounts();
+    mockSetPin(CLK_PIN, level);
+
+    const mock_counts_t &counts = mockBoard().counts;
+
+    if (counts.isrRuns == 0) {
+        return;
+    }
+
+    cost.edges++;
+    cost.total.portReads += counts.portReads;
+    cost.total.portWrites += counts.portWrites;
+    cost.total.timerReads += counts.timerReads;
+    cost.total.halCalls += counts.halCalls;
+    cost.max.isrRuns = counts.isrRuns > cost.max.isrRuns ? counts.isrRuns : cost.max.isrRuns;
+    cost.max.portReads = counts.portReads > cost.max.portReads ? counts.portReads : cost.max.portReads;
+    cost.max.portWrites = counts.portWrites > cost.max.portWrites ? counts.portWrites : cost.max.portWrites;
+    cost.max.timerReads = counts.timerReads > cost.max.timerReads ? counts.timerReads : cost.max.timerReads;
+    cost.max.halCalls = counts.halCalls > cost.max.halCalls ? counts.halCalls : cost.max.halCalls;
+}
+
+/**
+ * Clocks random bytes into a started slave the way a master in mode does,
+ * and counts what its clock ISR does.
+ *
+ * @param slave slave on CLK_PIN, MOSI_PIN, and SS_PIN when hasSs
+ * @param mode SPI mode it was started in
+ * @param order bit order it was started in
+ * @param hasSs true to select it with SS_PIN, active LOW
+ * @param byteCount bytes to send
+ * @param seed random seed, not 0
+ * @return the counts
+ */
+template <typename Slave>
+static isr_cost_t measure(Slave &slave, softspi_mode_t mode, softspi_data_order_t order, bool hasSs,
+                          uint32_t byteCount, uint32_t seed) {
+    bool cpha = mode & 0b01;
+    bool cpol = mode & 0b10;
+    isr_cost_t cost = {};
+    uint32_t state = seed;
+
+    if (hasSs) {
+        mockSetPin(SS_PIN, LOW);
+    }
+
+    for (uint32_t i = 0; i < byteCount; i++) {
+        uint8_t data = hostRandom(state);
+
+        for (uint8_t b = 0; b < 8; b++) {
+            bool bit = (data >> (order == SSPI_MSB_FIRST ? 7 - b : b)) & 1;
+
+            if (!cpha) {
+                mockSetPin(MOSI_PIN, bit);
+                mockBoard().time += HALF_PERIOD;
+                clockEdge(cost, !cpol); // Sampling edge
+                mockBoard().time += HALF_PERIOD;
+                clockEdge(cost, cpol);
+
+            } else {
+                clockEdge(cost, !cpol);
+                mockSetPin(MOSI_PIN, bit);
+                mockBoard().time += HALF_PERIOD;
+                clockEdge(cost, cpol); // Sampling edge
+                mockBoard().time += HALF_PERIOD;
+            }
+        }
+
+        if (!slave.rxHasData() || slave.read() != data || slave.rxHasData()) {
+            cost.wrongBytes++;
+        }
+    }
+
+    if (hasSs) {
+        mockSetPin(SS_PIN, HIGH);
+    }
+
+    slave.end();
+
+    return cost;
+}
+
+/**
+ * Idles the lines for mode, before a slave is started.
+ *
+ * @param mode SPI mode
+ */
+static void idleLines(softspi_mode_t mode) {
+    mockSetPin(CLK_PIN, (mode & 0b10) != 0);
+    mockSetPin(MOSI_PIN, LOW);
+    mockSetPin(SS_PIN, HIGH);
+    mockClearInterruptFlags(); // Left over from the previous configuration
+}
+
+/**
+ * Prints the counts of a configuration and checks them against its
+ * budget.
+ *
+ * @param checks where failures are counted
+ * @param name the configuration
+ * @param cost counts of the configuration
+ * @param budget most of each an edge may take
+ */
+static void checkCost(HostChecks &checks, const char *name, const isr_cost_t &cost, const mock_counts_t &budget) {
+    double edges = cost.edges > 0 ? cost.edges : 1;
+
+    printf("%-38s edges %7u  port reads %.2f (max %u/%u), port writes %.2f (max %u/%u), "
+           "timer reads %.2f (max %u/%u), Arduino calls %.2f (max %u/%u)\n",
+           name, cost.edges,
+           cost.total.portReads / edges, cost.max.portReads, budget.portReads,
+           cost.total.portWrites / edges, cost.max.portWrites, budget.portWrites,
+           cost.total.timerReads / edges, cost.max.timerReads, budget.timerReads,
+           cost.total.halCalls / edges, cost.max.halCalls, budget.halCalls);
+
+    checks.expect(cost.edges > 0, "%s: clkIsr() never ran", name);
+    checks.expect(cost.max.isrRuns <= 1, "%s: %u ISRs ran on one edge", name, cost.max.isrRuns);
+    checks.expect(cost.wrongBytes == 0, "%s: %u bytes received wrong", name, cost.wrongBytes);
+    checks.expect(cost.max.portReads <= budget.portReads, "%s: %u port reads on an edge, budget %u",
+                  name, cost.max.portReads, budget.portReads);
+    checks.expect(cost.max.portWrites <= budget.portWrites, "%s: %u port writes on an edge, budget %u",
+                  name, cost.max.portWrites, budget.portWrites);
+    checks.expect(cost.max.timerReads <= budget.timerReads, "%s: %u timer reads on an edge, budget %u",
+                  name, cost.max.timerReads, budget.timerReads);
+    checks.expect(cost.max.halCalls <= budget.halCalls, "%s: %u Arduino calls on an edge, budget %u",
+                  name, cost.max.halCalls, budget.halCalls);
+}
+
+
+/**
+ * Measures a SoftSPISlave configuration.
+ *
+ * @param checks where failures are counted
+ * @param name the configuration
+ * @param mode SPI mode
+ * @param order bit order
+ * @param hasMiso true to use MISO and SS, so both edges interrupt
+ * @param byteCount bytes to send
+ * @param seed random seed, not 0
+ */
+static void runSoftSPISlave(HostChecks &checks, const char *name, softspi_mode_t mode, softspi_data_order_t order,
+                            bool hasMiso, uint32_t byteCount, uint32_t seed) {
+    SoftSPISlave slave(CLK_PIN, hasMiso ? MISO_PIN : -1, MOSI_PIN, hasMiso ? SS_PIN : -1);
+    mock_counts_t budget = {};
+
+    idleLines(mode);
+    slave.begin(false, mode, order, MAX_CLK_TIME);
+
+    budget.portReads = hasMiso ? 3 : 1; // SS, CLK, and MOSI or MISO, or only MOSI
+    budget.portWrites = hasMiso ? 1 : 0;
+    budget.timerReads = 1;
+
+    checkCost(checks, name, measure(slave, mode, order, hasMiso, byteCount, seed), budget);
+}
+
+/**
+ * Measures a StaticSoftSPISlave configuration.
+ *
+ * @param checks where failures are counted
+ * @param name the configuration
+ * @param minClkTime edge time filter, 0 to disable
+ * @param sampleSpacing wait before each data sample
+ * @param byteCount bytes to send
+ * @param seed random seed, not 0
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso, uint8_t DataSamples>
+static void runStaticSoftSPISlave(HostChecks &checks, const char *name, uint16_t minClkTime, uint8_t sampleSpacing,
+                                  uint32_t byteCount, uint32_t seed) {
+    StaticSoftSPISlave<Mode, Order, HasMiso, true, HasMiso, DataSamples> slave(CLK_PIN, MISO_PIN, MOSI_PIN, SS_PIN);
+    mock_counts_t budget = {};
+
+    idleLines(Mode);
+    slave.begin(false, MAX_CLK_TIME, 8, minClkTime, sampleSpacing);
+
+    // SS and CLK, and the data samples or MISO, or only the data samples
+    budget.portReads = HasMiso ? 2 + DataSamples : DataSamples;
+    budget.portWrites = HasMiso ? 1 : 0;
+    budget.timerReads = minClkTime > 0 ? 2 : 1;
+    budget.halCalls = sampleSpacing > 0 ? DataSamples : 0;
+
+    checkCost(checks, name, measure(slave, Mode, Order, HasMiso, byteCount, seed), budget);
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t byteCount = 2000;
+    uint32_t seed = 1;
+
+    if (!parseHostOptions(argc, argv, {{"-n", byteCount}, {"-s", seed}})) {
+        return 1;
+    }
+
+    if (byteCount == 0 || seed == 0) {
+        fprintf(stderr, "Bytes and seed must not be 0\n");
+        return 1;
+    }
+
+    HostChecks checks;
+
+    for (uint8_t mode = SSPI_MODE0; mode <= SSPI_MODE3; mode++) {
+        char name[40];
+
+        snprintf(name, sizeof(name), "SoftSPISlave MODE%u RX", mode);
+        runSoftSPISlave(checks, name, (softspi_mode_t)mode, SSPI_LSB_FIRST, false, byteCount, seed);
+
+        snprintf(name, sizeof(name), "SoftSPISlave MODE%u MISO", mode);
+        runSoftSPISlave(checks, name, (softspi_mode_t)mode, SSPI_MSB_FIRST, true, byteCount, seed);
+    }
+
+    // The sketch's configuration first
+    runStaticSoftSPISlave<SSPI_MODE1, SSPI_LSB_FIRST, false, 1>(checks, "StaticSoftSPISlave MODE1 RX", 0, 0,
+                                                                 byteCount, seed);
+    runStaticSoftSPISlave<SSPI_MODE1, SSPI_LSB_FIRST, false, 1>(checks, "StaticSoftSPISlave MODE1 RX filter",
+                                                                 MIN_CLK_TIME, 0, byteCount, seed);
+    runStaticSoftSPISlave<SSPI_MODE1, SSPI_LSB_FIRST, false, 3>(checks, "StaticSoftSPISlave MODE1 RX 3 samples",
+                                                                 0, SAMPLE_SPACING, byteCount, seed);
+    runStaticSoftSPISlave<SSPI_MODE0, SSPI_MSB_FIRST, true, 1>(checks, "StaticSoftSPISlave MODE0 MISO", 0, 0,
+                                                                byteCount, seed);
+    runStaticSoftSPISlave<SSPI_MODE3, SSPI_MSB_FIRST, true, 1>(checks, "StaticSoftSPISlave MODE3 MISO", 0, 0,
+                                                                byteCount, seed);
+
+    return checks.finish();
+}
@@ -0,0 +1,238 @@
+/*
+ * key-report-count.cpp - Count Keyboard Reports Per Typed Measurement
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Builds the KeySequence with buildMeasurementSequence(), the same code the
+// sketch types with, for every possible measurement and every DIP switch
+// setting, then:
+//   - replays the reports like a host would (a key is typed when it shows
+//     up in a report it wasn't in before) and checks the keys come out in
+//     the same order they were added.
+//   - counts the reports, compared to typing each key with its own press
+//     and release (and CTRL+A with three reports) like before.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o key-report-count
+//       key-report-count.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+//       ../src/DataInterface/KeySequence.cpp
+//       ../src/DataInterface/MeasurementTyping.cpp
+//       ../src/DataInterface/OutputScheduler.cpp
+
+
+#include <stdio.h>
+#include <string.h>
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+#include "KeySequence.h"
+#include "MeasurementTyping.h"
+
+
+const uint32_t MEASUREMENT_COUNT = (uint32_t)1 << 20;
+
+
+static uint8_t dipOptions; // DIP switch setting being checked
+
+
+/**
+ * Returns the DIP switch setting being checked, as the sketch reads the
+ * switches.
+ *
+ * @return the TYPING_* options
+ */
+static uint8_t readDipOptions() {
+    return dipOptions;
+}
+
+
+/**
+ * Returns the character a usage ID types, for checking the replay.
+ *
+ * @param key usage ID
+ * @return the character, or '?' if it is not one addText() uses
+ */
+static char keyToChar(uint8_t key) {
+    if (key >= KEY_USAGE_A && key < KEY_USAGE_A + 26) {
+        return 'a' + (key - KEY_USAGE_A);
+    }
+
+    if (key >= KEY_USAGE_1 && key < KEY_USAGE_1 + 9) {
+        return '1' + (key - KEY_USAGE_1);
+    }
+
+    switch (key) {
+        case KEY_USAGE_0:      return '0';
+        case KEY_USAGE_ENTER:  return '\n';
+        case KEY_USAGE_TAB:    return '\t';
+        case KEY_USAGE_SPACE:  return ' ';
+        case KEY_USAGE_MINUS:  return '-';
+        case KEY_USAGE_COMMA:  return ',';
+        case KEY_USAGE_PERIOD: return '.';
+        default:               return '?';
+    }
+}
+
+/**
+ * Builds the sequence with buildMeasurementSequence(), and the text it
+ * should type.
+ *
+ * @param sequence sequence to build
+ * @param expected set to the text that should be typed, CTRL+A as "^a"
+ * @param caliper caliper with refreshed data
+ * @param dip TYPING_* options of the DIP switches that are on
+ * @return the number of reports the old typeMeasurement() sent
+ */
+static uint32_t buildSequence(KeySequence &sequence, char *expected,
+                              ClockwiseCaliper &caliper, uint8_t dip) {
+    const measurement_format_t format = {&caliper, 1, 0, 0, KEY_USAGE_TAB, readDipOptions};
+    const uint8_t suffixOptions[] = {TYPING_NEWLINE, TYPING_TAB, TYPING_COMMA, TYPING_SPACE};
+    const char *suffixText[] = {"\n", "\t", ",", " "};
+
+    char measurementStr[MEASUREMENT_STR_SIZE];
+    uint32_t oldReports = 0;
+
+    dipOptions = dip;
+    sequence.clear();
+    buildMeasurementSequence(sequence, format, false);
+
+    expected[0] = '\0';
+
+    if (dip & TYPING_CTRL_A) {
+        strcat(expected, "^a");
+        oldReports += 3; // Press CTRL, press A, release all
+    }
+
+    caliper.formatMeasurement(measurementStr);
+    strcat(expected, measurementStr);
+    oldReports += 2 * strlen(measurementStr);
+
+    if (dip & TYPING_UNITS) {
+        strcat(expected, caliper.getUnitString());
+        oldReports += 2 * strlen(caliper.getUnitString());
+    }
+
+    for (uint8_t i = 0; i < 4; i++) {
+        if (dip & suffixOptions[i]) {
+            strcat(expected, suffixText[i]);
+            oldReports += 2;
+        }
+    }
+
+    return oldReports;
+}
+
+/**
+ * Replays the reports of a sequence like a host would.
+ *
+ * @param sequence sequence to replay
+ * @param typed set to the text typed, CTRL+A as "^a"
+ * @return the number of reports, or 0 if a report was invalid
+ */
+static uint32_t replaySequence(KeySequence &sequence, char *typed) {
+    key_report_t previous = {0, {0}, 0};
+    key_report_t report;
+    uint32_t reports = 0;
+    char *pChar = typed;
+
+    while (sequence.nextReport(report)) {
+        reports++;
+
+        if (report.keyCount > KEY_REPORT_KEYS) {
+            return 0;
+        }
+
+        // Keys in this report that were not held in the previous one
+        for (uint8_t i = 0; i < report.keyCount; i++) {
+            bool held = false;
+
+            for (uint8_t j = 0; j < previous.keyCount; j++) {
+                held = held || previous.keys[j] == report.keys[i];
+            }
+
+            if (!held) {
+                if (report.modifier == KEY_USAGE_LEFT_CTRL) {
+                    *pChar++ = '^';
+                }
+
+                *pChar++ = keyToChar(report.keys[i]);
+            }
+        }
+
+        previous = report;
+    }
+
+    *pChar = '\0';
+
+    // Everything has to be released at the end
+    return previous.keyCount == 0 ? reports : 0;
+}
+
+
+int main() {
+    ClockwiseCaliper caliper;
+    KeySequence sequence;
+    char expected[64];
+    char typed[64];
+    uint64_t oldTotal = 0;
+    uint64_t newTotal = 0;
+    uint32_t oldMax = 0;
+    uint32_t newMax = 0;
+    uint32_t wrong = 0;
+    uint64_t count = 0;
+
+    for (uint8_t variant = 0; variant < 4; variant++) {
+        for (uint32_t i = 0; i < MEASUREMENT_COUNT; i++) {
+            caliper.updatePacket(i | ((uint32_t)(variant & 1) << 20) | ((uint32_t)(variant >> 1) << 23));
+            caliper.refershData();
+
+            for (uint8_t dip = 0; dip < TYPING_OPTIONS; dip++) {
+                uint32_t oldReports = buildSequence(sequence, expected, caliper, dip);
+                uint32_t newReports = replaySequence(sequence, typed);
+
+                if (newReports == 0 || strcmp(typed, expected) != 0) {
+                    if (wrong++ < 5) {
+                        printf("wrong: typed \"%s\", expected \"%s\"\n", typed, expected);
+                    }
+                }
+
+                oldTotal += oldReports;
+                newTotal += newReports;
+                oldMax = oldReports > oldMax ? oldReports : oldMax;
+                newMax = newReports > newMax ? newReports : newMax;
+                count++;
+            }
+        }
+    }
+
+    // A typical measurement with every DIP switch on
+    caliper.updatePacket(0x112345); // -745.33 mm
+    caliper.refershData();
+
+    uint32_t exampleOld = buildSequence(sequence, expected, caliper, TYPING_OPTIONS - 1);
+    uint32_t exampleNew = replaySequence(sequence, typed);
+
+    printf("sequences checked:   %llu\n", (unsigned long long)count);
+    printf("wrong:               %u\n", wrong);
+    printf("reports before:      %.2f avg, %u max\n", (double)oldTotal / count, oldMax);
+    printf("reports after:       %.2f avg, %u max\n", (double)newTotal / count, newMax);
+    printf("example (all DIPs):  %u before, %u after\n", exampleOld, exampleNew);
+
+    HostChecks checks;
+
+    checks.expect(wrong == 0, "%u sequences typed wrong", wrong);
+
+    return checks.finish();
+}
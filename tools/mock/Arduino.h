@@ -0,0 +1,531 @@
+/*
+ * Arduino.h - Simulated Board for Building the Pin and Interrupt Code on the Host
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Just enough of the Arduino core for the capture classes, and the sketch
+// itself, to build and run on the host, with -Imock before the sketch
+// folder:
+//   - every pin is its own port, bit 0 of one byte in mockBoard().ports,
+//     and every pin is interrupt capable, as interrupt number = pin. A0 to
+//     A5 are pins 18 to 23, as on the ATmega32U4 boards.
+//   - time only moves when the tool moves it, or in delay() and
+//     delayMicroseconds().
+//   - mockSetPin() changes an input pin and runs the interrupt attached
+//     to it if the edge matches, like the hardware would.
+//   - like the AVR external interrupts, an edge while the interrupt is
+//     detached, or while interrupts are off, leaves its flag set, and the
+//     interrupt runs as soon as it is attached or interrupts are back on
+//     (after the running ISR returns).
+//   - an SPI peripheral in slave mode on SCK, MOSI and SS, with SPCR and
+//     SPDR: it shifts in a bit on each sampling edge of SCK while SS is
+//     LOW, and after 8 bits sets SPDR and runs mockBoard().spiIsr if SPIE
+//     is set. SS HIGH resets its bit counter, checked after every ISR, as
+//     that is the only place the capture code moves SS.
+//   - the port registers count their reads and writes, and the Arduino
+//     calls count themselves, in mockBoard().counts, so a tool can check
+//     what an ISR costs. SoftSPIPin.h uses MockPortRegister for its
+//     register pointers, see SOFTSPI_PORT_REGISTER.
+//   - Serial keeps what is written to it and reads what the tool puts in
+//     its input, and tone() only counts the tones, in mockBoard().tones.
+//   - the pin change interrupt registers only hold their values, so
+//     PinChangeSPISlave builds, its ISR never runs.
+//
+// HID-Project.h has the keyboard the sketch types with.
+//
+// ARDUINO_ARCH_AVR is not defined, so the code takes its host paths
+// (millis() and micros() instead of the timer registers).
+//
+// Only used by the host tools.
+
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <stdint.h>
+#include <string>
+
+
+const uint8_t LOW = 0;
+const uint8_t HIGH = 1;
+
+const uint8_t INPUT = 0;
+const uint8_t OUTPUT = 1;
+const uint8_t INPUT_PULLUP = 2;
+
+const uint8_t CHANGE = 1;
+const uint8_t FALLING = 2;
+const uint8_t RISING = 3;
+
+const int8_t NOT_AN_INTERRUPT = -1;
+
+const uint8_t MOCK_PIN_COUNT = 24;
+
+const uint8_t A0 = 18;
+const uint8_t A1 = 19;
+const uint8_t A2 = 20;
+const uint8_t A3 = 21;
+const uint8_t A4 = 22;
+const uint8_t A5 = 23;
+
+// SPI peripheral pins and SPCR bits
+constexpr int16_t SCK = 12;
+constexpr int16_t MOSI = 13;
+constexpr int16_t MISO = 14;
+constexpr int16_t SS = 15;
+
+const uint8_t SPIE = 7;
+const uint8_t SPE = 6;
+const uint8_t DORD = 5;
+const uint8_t MSTR = 4;
+const uint8_t CPOL = 3;
+const uint8_t CPHA = 2;
+
+// Port B and the pin change interrupt bits
+const uint8_t PB = 2;
+const uint8_t PCIE0 = 0;
+const uint8_t PCIF0 = 0;
+
+#define _BV(bit) (1 << (bit))
+#define SPCR (mockBoard().spcr)
+#define SPDR (mockBoard().spdr)
+#define PCICR (mockBoard().pcicr)
+#define PCIFR (mockBoard().pcifr)
+#define PCMSK0 (mockBoard().pcmsk0)
+
+#define SOFTSPI_PORT_REGISTER MockPortRegister
+
+#define Serial (mockBoard().serial)
+
+
+/**
+ * A port register, counting the reads and writes of the code under test.
+ */
+class MockPortRegister {
+public:
+    volatile uint8_t value; // The pin is bit 0, the board reads and writes it without counting
+
+    operator uint8_t();
+    MockPortRegister &operator=(uint8_t value);
+    MockPortRegister &operator|=(uint8_t mask);
+    MockPortRegister &operator&=(uint8_t mask);
+};
+
+/**
+ * The USB serial port, with a host that always has it open and takes
+ * every byte.
+ */
+class MockSerial {
+public:
+    std::deque<uint8_t> input; // Bytes from the host, not read yet
+    std::string output;        // Everything written
+
+    void begin(unsigned long) {
+    }
+
+    bool dtr() {
+        return true;
+    }
+
+    int available() {
+        return this->input.size();
+    }
+
+    int availableForWrite() {
+        return 64; // Size of the USB endpoint
+    }
+
+    int read() {
+        if (this->input.empty()) {
+            return -1;
+        }
+
+        uint8_t value = this->input.front();
+
+        this->input.pop_front();
+
+        return value;
+    }
+
+    size_t write(uint8_t value) {
+        this->output += (char)value;
+
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) {
+        this->output.append((const char *)buffer, size);
+
+        return size;
+    }
+
+    size_t print(const char *text) {
+        this->output += text;
+
+        return std::string(text).size();
+    }
+
+    template <typename T>
+    size_t print(T value) {
+        return this->print(std::to_string(value).c_str());
+    }
+
+    template <typename T>
+    size_t println(T value) {
+        return this->print(value) + this->print("\r\n");
+    }
+};
+
+/**
+ * Accesses to the board, since the tool last cleared them.
+ */
+typedef struct {
+    uint32_t isrRuns;    // ISRs run
+    uint32_t portReads;  // Port register reads, a read-modify-write counts as a read and a write
+    uint32_t portWrites; // Port register writes
+    uint32_t timerReads; // millis() and micros(), SoftSPIPin::isrMillis() and isrMicros() read the timer directly on the AVR
+    uint32_t halCalls;   // Other Arduino calls: pin lookups, digitalRead(), digitalWrite(), pinMode(), interrupts, delays
+} mock_counts_t;
+
+
+/**
+ * State of the simulated board.
+ */
+typedef struct {
+    MockPortRegister ports[MOCK_PIN_COUNT];         // One port register per pin, the pin is bit 0
+    uint8_t modes[MOCK_PIN_COUNT];                  // INPUT, OUTPUT, or INPUT_PULLUP
+    std::function<void()> isrs[MOCK_PIN_COUNT];     // Attached interrupts, empty when detached
+    uint8_t isrModes[MOCK_PIN_COUNT];               // CHANGE, FALLING, or RISING, kept when detached
+    bool isrFlags[MOCK_PIN_COUNT];                  // Interrupts waiting to run
+    bool interruptsOff;                             // Between noInterrupts() and interrupts()
+    uint8_t isrDepth;                               // ISRs running
+    uint32_t time;                                  // Microseconds
+
+    volatile uint8_t spcr;       // SPI control register
+    volatile uint8_t spdr;       // SPI data register, the last byte received
+    uint8_t spiShift;            // Byte being shifted in
+    uint8_t spiBits;             // Bits shifted in, reset by SS HIGH
+    bool spiFlag;                // Transfer complete interrupt waiting to run
+    std::function<void()> spiIsr; // The SPI_STC_vect ISR
+
+    volatile uint8_t pcicr;  // Pin change interrupt control register
+    volatile uint8_t pcifr;  // Pin change interrupt flag register
+    volatile uint8_t pcmsk0; // Pin change mask of port B
+
+    MockSerial serial;
+    uint32_t tones; // Times tone() was called
+
+    mock_counts_t counts;
+} mock_board_t;
+
+
+/**
+ * Returns the simulated board, shared by every file of the tool.
+ *
+ * @return the board
+ */
+inline mock_board_t &mockBoard() {
+    static mock_board_t board = {};
+
+    return board;
+}
+
+/**
+ * Clears the counts of accesses to the board.
+ */
+inline void mockClearCounts() {
+    mockBoard().counts = {};
+}
+
+
+inline MockPortRegister::operator uint8_t() {
+    mockBoard().counts.portReads++;
+
+    return this->value;
+}
+
+inline MockPortRegister &MockPortRegister::operator=(uint8_t value) {
+    mockBoard().counts.portWrites++;
+    this->value = value;
+
+    return *this;
+}
+
+inline MockPortRegister &MockPortRegister::operator|=(uint8_t mask) {
+    mockBoard().counts.portReads++;
+    mockBoard().counts.portWrites++;
+    this->value |= mask;
+
+    return *this;
+}
+
+inline MockPortRegister &MockPortRegister::operator&=(uint8_t mask) {
+    mockBoard().counts.portReads++;
+    mockBoard().counts.portWrites++;
+    this->value &= mask;
+
+    return *this;
+}
+
+
+inline uint8_t digitalPinToPort(int16_t pin) {
+    mockBoard().counts.halCalls++;
+
+    return pin;
+}
+
+inline MockPortRegister *portInputRegister(uint8_t port) {
+    mockBoard().counts.halCalls++;
+
+    return &mockBoard().ports[port];
+}
+
+inline MockPortRegister *portOutputRegister(uint8_t port) {
+    mockBoard().counts.halCalls++;
+
+    return &mockBoard().ports[port];
+}
+
+inline uint8_t digitalPinToBitMask(int16_t) {
+    mockBoard().counts.halCalls++;
+
+    return 1;
+}
+
+inline volatile uint8_t *digitalPinToPCICR(int16_t) {
+    mockBoard().counts.halCalls++;
+
+    return &PCICR;
+}
+
+inline uint8_t digitalPinToPCICRbit(int16_t) {
+    mockBoard().counts.halCalls++;
+
+    return PCIE0;
+}
+
+inline int8_t digitalPinToInterrupt(int16_t pin) {
+    mockBoard().counts.halCalls++;
+
+    return pin >= 0 && pin < MOCK_PIN_COUNT ? pin : NOT_AN_INTERRUPT;
+}
+
+
+inline void pinMode(int16_t pin, uint8_t mode) {
+    mockBoard().counts.halCalls++;
+
+    if (pin >= 0 && pin < MOCK_PIN_COUNT) {
+        mockBoard().modes[pin] = mode;
+    }
+}
+
+inline int digitalRead(int16_t pin) {
+    mockBoard().counts.halCalls++;
+
+    return mockBoard().ports[pin].value & 1;
+}
+
+inline void digitalWrite(int16_t pin, uint8_t state) {
+    mockBoard().counts.halCalls++;
+    mockBoard().ports[pin].value = state ? 1 : 0;
+}
+
+
+inline uint32_t micros() {
+    mockBoard().counts.timerReads++;
+
+    return mockBoard().time;
+}
+
+inline uint32_t millis() {
+    mockBoard().counts.timerReads++;
+
+    return mockBoard().time / 1000;
+}
+
+inline void delayMicroseconds(unsigned int time) {
+    mockBoard().counts.halCalls++;
+    mockBoard().time += time;
+}
+
+inline void delay(unsigned long time) {
+    mockBoard().counts.halCalls++;
+    mockBoard().time += time * 1000;
+}
+
+inline void tone(uint8_t, unsigned int, unsigned long = 0) {
+    mockBoard().counts.halCalls++;
+    mockBoard().tones++;
+}
+
+
+/**
+ * Runs the SPI peripheral's part after an ISR: SS HIGH resets its bit
+ * counter.
+ */
+inline void mockSpiCheckSs() {
+    mock_board_t &board = mockBoard();
+
+    if (board.ports[SS].value & 1) {
+        board.spiBits = 0;
+    }
+}
+
+/**
+ * Runs an ISR, with interrupts off while it runs.
+ *
+ * @param isr ISR to run
+ */
+inline void mockRunIsr(const std::function<void()> &isr) {
+    mock_board_t &board = mockBoard();
+
+    board.counts.isrRuns++;
+    board.isrDepth++;
+    isr();
+    board.isrDepth--;
+
+    mockSpiCheckSs();
+}
+
+/**
+ * Runs the interrupts whose flags are set, if interrupts are on and no
+ * ISR is running.
+ */
+inline void mockServiceInterrupts() {
+    mock_board_t &board = mockBoard();
+    bool ran = true;
+
+    while (ran && !board.interruptsOff && board.isrDepth == 0) {
+        ran = false;
+
+        // External interrupts have the higher priority
+        for (uint8_t i = 0; i < MOCK_PIN_COUNT && !ran; i++) {
+            if (board.isrFlags[i] && board.isrs[i]) {
+                board.isrFlags[i] = false;
+                mockRunIsr(board.isrs[i]);
+                ran = true;
+            }
+        }
+
+        if (!ran && board.spiFlag && (board.spcr & _BV(SPIE)) && board.spiIsr) {
+            board.spiFlag = false;
+            mockRunIsr(board.spiIsr);
+            ran = true;
+        }
+    }
+}
+
+
+inline void noInterrupts() {
+    mockBoard().counts.halCalls++;
+    mockBoard().interruptsOff = true;
+}
+
+inline void interrupts() {
+    mockBoard().counts.halCalls++;
+    mockBoard().interruptsOff = false;
+    mockServiceInterrupts();
+}
+
+inline void attachInterrupt(uint8_t interrupt, std::function<void()> isr, uint8_t mode) {
+    mockBoard().counts.halCalls++;
+    mockBoard().isrs[interrupt] = isr;
+    mockBoard().isrModes[interrupt] = mode;
+    mockServiceInterrupts();
+}
+
+inline void detachInterrupt(uint8_t interrupt) {
+    mockBoard().counts.halCalls++;
+    mockBoard().isrs[interrupt] = nullptr;
+}
+
+
+/**
+ * Shifts a bit into the SPI peripheral if SCK changed to its sampling
+ * level.
+ *
+ * @param sck new level of SCK
+ */
+inline void mockSpiClock(bool sck) {
+    mock_board_t &board = mockBoard();
+    bool cpol = board.spcr & _BV(CPOL);
+    bool cpha = board.spcr & _BV(CPHA);
+
+    // Sampling on the rising edge in MODE0 and MODE3, falling in MODE1 and MODE2
+    if (!(board.spcr & _BV(SPE)) || (board.ports[SS].value & 1) || sck == (cpol != cpha)) {
+        return;
+    }
+
+    bool bit = board.ports[MOSI].value & 1;
+
+    if (board.spcr & _BV(DORD)) {
+        board.spiShift = (board.spiShift >> 1) | (bit ? 0x80 : 0);
+    } else {
+        board.spiShift = (board.spiShift << 1) | bit;
+    }
+
+    if (++board.spiBits == 8) {
+        board.spdr = board.spiShift;
+        board.spiBits = 0;
+        board.spiFlag = true;
+    }
+}
+
+/**
+ * Clears every interrupt flag, like a reset, so edges before a test
+ * starts don't run the ISRs it attaches.
+ */
+inline void mockClearInterruptFlags() {
+    mock_board_t &board = mockBoard();
+
+    for (uint8_t i = 0; i < MOCK_PIN_COUNT; i++) {
+        board.isrFlags[i] = false;
+    }
+
+    board.spiFlag = false;
+}
+
+/**
+ * Sets the level of an input pin from outside the board. Sets the flag of
+ * its interrupt if the change matches the interrupt mode, clocks the SPI
+ * peripheral if it is SCK, and runs the interrupts that are due.
+ *
+ * @param pin pin to set
+ * @param state new level
+ */
+inline void mockSetPin(int16_t pin, bool state) {
+    mock_board_t &board = mockBoard();
+    bool previous = board.ports[pin].value & 1;
+
+    board.ports[pin].value = state;
+
+    if (state == previous) {
+        return;
+    }
+
+    uint8_t mode = board.isrModes[pin];
+
+    if (mode == CHANGE || (mode == RISING && state) || (mode == FALLING && !state)) {
+        board.isrFlags[pin] = true;
+    }
+
+    if (pin == SCK) {
+        mockSpiClock(state);
+    }
+
+    mockServiceInterrupts();
+}
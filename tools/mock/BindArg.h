@@ -0,0 +1,42 @@
+/*
+ * BindArg.h - Member Function Interrupts for the Simulated Board
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Stands in for the BindArg library, see mock/Arduino.h. The gate is a
+// std::function instead of an allocated trampoline.
+//
+// Only used by the host tools.
+
+
+#pragma once
+
+#include <functional>
+
+
+/**
+ * Returns an interrupt function calling a member function of an object.
+ *
+ * @param isr member function to call
+ * @param object object to call it on
+ * @return the function to pass to attachInterrupt()
+ */
+template <typename T>
+std::function<void()> bindArgGateThisAllocate(void (T::*isr)(), T *object) {
+    return [isr, object]() {
+        (object->*isr)();
+    };
+}
@@ -0,0 +1,92 @@
+/*
+ * CircularBuffer.hpp - Circular Buffer for the Simulated Board
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Stands in for the CircularBuffer library, see mock/Arduino.h, with only
+// the methods SoftSPISlave and StaticSoftSPISlave use. They are volatile
+// qualified, as the slaves declare their buffers volatile.
+//
+// Only used by the host tools.
+
+
+#pragma once
+
+#include <stdint.h>
+
+
+template <typename T, uint16_t S>
+class CircularBuffer {
+public:
+    /**
+     * Adds a value to the end, overwriting the first one when full.
+     *
+     * @param value value to add
+     * @return false if a value was overwritten
+     */
+    bool push(T value) volatile {
+        bool overwrite = this->count == S;
+
+        this->buffer[(this->head + this->count) % S] = value;
+
+        if (overwrite) {
+            this->head = (this->head + 1) % S;
+        } else {
+            this->count++;
+        }
+
+        return !overwrite;
+    }
+
+    /**
+     * Removes and returns the first value. Must not be empty.
+     *
+     * @return the first value
+     */
+    T shift() volatile {
+        T value = this->buffer[this->head];
+
+        this->head = (this->head + 1) % S;
+        this->count--;
+
+        return value;
+    }
+
+    T first() volatile {
+        return this->buffer[this->head];
+    }
+
+    bool isEmpty() volatile {
+        return this->count == 0;
+    }
+
+    bool isFull() volatile {
+        return this->count == S;
+    }
+
+    uint16_t size() volatile {
+        return this->count;
+    }
+
+    uint16_t available() volatile {
+        return S - this->count;
+    }
+
+private:
+    T buffer[S] = {};
+    uint16_t head = 0;
+    uint16_t count = 0;
+};
@@ -0,0 +1,120 @@
+/*
+ * HID-Project.h - Simulated Boot Keyboard for Building the Sketch on the Host
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Just enough of HID-Project's BootKeyboard for the sketch to build and
+// run on the host, with -Imock: the keys added since removeAll() are held
+// in a report, and send() keeps a copy of it in BootKeyboard.reports, so
+// a tool can replay them like a host would. The host always takes the
+// report straight away.
+//
+// Only used by the host tools.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+// Usage IDs, only the ones the sketch names
+enum KeyboardKeycode : uint8_t {
+    KEY_ENTER = 0x28,
+    KEY_TAB = 0x2B,
+    KEY_SPACE = 0x2C,
+    KEY_COMMA = 0x36,
+    KEY_LEFT_CTRL = 0xE0
+};
+
+const uint8_t MOCK_KEYBOARD_KEYS = 6; // Keys in a boot keyboard report
+
+/**
+ * A boot keyboard report.
+ */
+typedef struct {
+    uint8_t modifiers;                // Bit 0 is left CTRL
+    uint8_t keys[MOCK_KEYBOARD_KEYS]; // Usage IDs in the order they were added
+    uint8_t keyCount;
+} mock_keyboard_report_t;
+
+
+class BootKeyboard_ {
+public:
+    std::vector<mock_keyboard_report_t> reports; // Every report sent
+    bool begun = false;
+
+    void begin() {
+        this->begun = true;
+    }
+
+    /**
+     * Releases every key, without sending a report.
+     */
+    void removeAll() {
+        this->report = {};
+    }
+
+    /**
+     * Holds a key, without sending a report.
+     *
+     * @param key usage ID, modifiers from KEY_LEFT_CTRL up
+     * @return 1 if the key was added, 0 if the report was full
+     */
+    size_t add(KeyboardKeycode key) {
+        if (key >= KEY_LEFT_CTRL) {
+            this->report.modifiers |= 1 << (key - KEY_LEFT_CTRL);
+            return 1;
+        }
+
+        if (this->report.keyCount == MOCK_KEYBOARD_KEYS) {
+            return 0;
+        }
+
+        this->report.keys[this->report.keyCount++] = key;
+
+        return 1;
+    }
+
+    /**
+     * Sends the report.
+     *
+     * @return the size of the report
+     */
+    int send() {
+        this->reports.push_back(this->report);
+
+        return sizeof(this->report.keys) + 2;
+    }
+
+private:
+    mock_keyboard_report_t report = {}; // Keys held
+};
+
+
+/**
+ * Returns the keyboard, shared by every file of the tool.
+ *
+ * @return the keyboard
+ */
+inline BootKeyboard_ &mockBootKeyboard() {
+    static BootKeyboard_ keyboard;
+
+    return keyboard;
+}
+
+#define BootKeyboard (mockBootKeyboard())
@@ -0,0 +1,234 @@
+/*
+ * multi-caliper-sim.cpp - Several Calipers Decoded From One Port
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Runs one CaliperSignalGenerator per caliper, each with its own clock
+// period, start offset and packets, and merges their edges onto one 8-bit
+// port the way the calipers share port B with MULTI_CALIPER. The port is
+// passed to MultiSoftSPIReceiver the way PinChangeSPISlave does.
+//
+// The pin change interrupt is modelled as taking latency microseconds:
+// changes while it runs only set the interrupt flag, and it runs again
+// afterwards with the port as it is then, so edges can be coalesced like
+// on the board.
+//
+// Every packet of every caliper is checked against what was sent. Exits
+// with 1 if any packet was corrupted, missing, or decoded twice.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o multi-caliper-sim
+//       multi-caliper-sim.cpp CaliperSignal.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   ./multi-caliper-sim [-n packets] [-c calipers] [-o offset] [-j jitter]
+//                       [-l latency] [-s seed]
+//
+// offset is the microseconds between the packets of one caliper and the
+// next, 0 sends them all at once.
+
+
+#include <algorithm>
+#include <stdio.h>
+#include <vector>
+#include "CaliperSignal.h"
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+#include "MultiSoftSPIReceiver.h"
+
+
+const uint8_t MAX_CALIPERS = 4;
+const uint32_t BIT_MAX_DELAY = 10;            // Same as the sketch, in milliseconds
+const uint32_t PACKET_INTERVAL = 150000;      // Microseconds between packets
+const uint32_t PACKET_RANDOM_MASK = 0x9FFFFF; // Measurement, sign and unit bits, the unknown bits stay 0
+const uint32_t CLK_PERIOD = 400;              // Microseconds per clock cycle of the first caliper
+const uint32_t CLK_PERIOD_STEP = 13;          // Microseconds added for each other caliper, so the clocks drift
+
+
+/**
+ * A change on one caliper's lines.
+ */
+typedef struct {
+    uint32_t time;   // Microseconds
+    uint8_t caliper;
+    bool clk;
+    bool data;
+} port_edge_t;
+
+
+/**
+ * Orders edges by time, keeping each caliper's edges in order.
+ */
+static bool edgeBefore(const port_edge_t &a, const port_edge_t &b) {
+    return a.time < b.time;
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t packetCount = 20000;
+    uint8_t caliperCount = 3;
+    uint32_t offset = 2900;
+    uint16_t jitter = 0;
+    uint32_t latency = 8;
+    uint32_t seed = 1;
+
+    if (!parseHostOptions(argc, argv, {{"-n", packetCount}, {"-c", caliperCount}, {"-o", offset},
+                                       {"-j", jitter}, {"-l", latency}, {"-s", seed}})) {
+        return 1;
+    }
+
+    if (caliperCount == 0 || caliperCount > MAX_CALIPERS) {
+        fprintf(stderr, "Calipers must be 1 to %u\n", MAX_CALIPERS);
+        return 1;
+    }
+
+    if (offset * (caliperCount - 1) + CALIPER_SIGNAL_PACKET_BITS * 2 * CLK_PERIOD > PACKET_INTERVAL) {
+        fprintf(stderr, "Offset too large, packets would overlap the next ones\n");
+        return 1;
+    }
+
+    // Clocks on bits 0 to 3, data on bits 4 to 7
+    uint8_t clkMasks[MAX_CALIPERS];
+    uint8_t dataMasks[MAX_CALIPERS];
+    std::vector<CaliperSignalGenerator> generators;
+
+    for (uint8_t i = 0; i < caliperCount; i++) {
+        caliper_signal_config_t config = {CLK_PERIOD + i * CLK_PERIOD_STEP, PACKET_INTERVAL, jitter, 0, 20, 0, 0, 0};
+
+        clkMasks[i] = 1 << i;
+        dataMasks[i] = 1 << (i + 4);
+        generators.push_back(CaliperSignalGenerator(config, seed + i * 7919));
+    }
+
+    // The receiver always has MAX_CALIPERS channels, unused ones never see an edge
+    for (uint8_t i = caliperCount; i < MAX_CALIPERS; i++) {
+        clkMasks[i] = 0;
+        dataMasks[i] = 0;
+    }
+
+    MultiSoftSPIReceiver<SSPI_LSB_FIRST, MAX_CALIPERS> receiver;
+    ClockwiseCaliper caliper;
+    caliper_signal_edge_t edges[CALIPER_SIGNAL_MAX_EDGES];
+    std::vector<port_edge_t> portEdges;
+
+    uint32_t correct[MAX_CALIPERS] = {0};
+    uint32_t corrupted[MAX_CALIPERS] = {0};
+    uint32_t missing[MAX_CALIPERS] = {0};
+    uint32_t extra[MAX_CALIPERS] = {0};
+    uint32_t updates = 0;
+    uint32_t coalesced = 0;
+
+    uint8_t port = 0; // Both lines idle LOW
+    uint32_t busyUntil = 0;
+    bool pending = false;
+
+    receiver.begin(true, clkMasks, dataMasks, BIT_MAX_DELAY, caliper.getPacketLength() * 8, port);
+
+    for (uint32_t p = 0; p < packetCount; p++) {
+        uint32_t packets[MAX_CALIPERS];
+
+        portEdges.clear();
+
+        for (uint8_t i = 0; i < caliperCount; i++) {
+            packets[i] = generators[i].random() & PACKET_RANDOM_MASK;
+            uint8_t edgeCount = generators[i].generatePacket(packets[i], edges);
+
+            for (uint8_t e = 0; e < edgeCount; e++) {
+                portEdges.push_back({edges[e].time + i * offset, i, edges[e].clk, edges[e].data});
+            }
+        }
+
+        std::stable_sort(portEdges.begin(), portEdges.end(), edgeBefore);
+
+        for (const port_edge_t &edge : portEdges) {
+            // A change while the interrupt ran makes it run again straight after
+            if (pending && busyUntil <= edge.time) {
+                receiver.update(port, busyUntil / 1000);
+                updates++;
+                busyUntil += latency;
+                pending = false;
+            }
+
+            uint8_t caliperMask = clkMasks[edge.caliper] | dataMasks[edge.caliper];
+
+            port &= ~caliperMask;
+            port |= (edge.clk ? clkMasks[edge.caliper] : 0) | (edge.data ? dataMasks[edge.caliper] : 0);
+
+            if (edge.time >= busyUntil) {
+                receiver.update(port, edge.time / 1000);
+                updates++;
+                busyUntil = edge.time + latency;
+            } else if (pending) {
+                coalesced++;
+            } else {
+                pending = true;
+            }
+        }
+
+        if (pending) {
+            receiver.update(port, busyUntil / 1000);
+            updates++;
+            pending = false;
+        }
+
+        for (uint8_t i = 0; i < caliperCount; i++) {
+            SoftSPIReceiver<SSPI_LSB_FIRST> &channel = receiver.channel(i);
+            bool received = false;
+
+            while (channel.hasData()) {
+                caliper.updatePacket(~channel.read());
+                caliper.refershData();
+
+                uint32_t decoded = caliper.getRawMeasurement()
+                                 | ((uint32_t)caliper.getSign() << 20)
+                                 | ((uint32_t)caliper.getUnit() << 23);
+
+                if (received) {
+                    extra[i]++;
+                } else if (decoded == packets[i]) {
+                    correct[i]++;
+                } else {
+                    corrupted[i]++;
+                }
+
+                received = true;
+            }
+
+            if (!received) {
+                missing[i]++;
+            }
+        }
+    }
+
+    printf("calipers: %u, packets each: %u, offset: %u us, jitter: %u us, isr latency: %u us\n",
+           caliperCount, packetCount, offset, jitter, latency);
+
+    for (uint8_t i = 0; i < caliperCount; i++) {
+        printf("caliper %u (%u us clock): correct %u, corrupted %u, missing %u, extra %u, resyncs %u\n",
+               i, CLK_PERIOD + i * CLK_PERIOD_STEP, correct[i], corrupted[i], missing[i], extra[i],
+               receiver.channel(i).getResyncCount());
+    }
+
+    printf("interrupts: %u, changes coalesced into a running interrupt: %u\n", updates, coalesced);
+
+    HostChecks checks;
+
+    for (uint8_t i = 0; i < caliperCount; i++) {
+        checks.expect(correct[i] == packetCount && extra[i] == 0, "caliper %u lost or repeated packets", i);
+    }
+
+    return checks.finish();
+}
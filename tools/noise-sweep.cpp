@@ -0,0 +1,444 @@
+/*
+ * noise-sweep.cpp - Packet Error Rates Across a Grid of Signal Noise
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Runs the decoding the sketch does with StaticSoftSPISlave against
+// waveforms from CaliperSignalGenerator, for every combination of clock
+// period, clock jitter, glitch pulse rate, missing clock pulse rate, data
+// glitch rate, BIT_MAX_DELAY, and data sampling mode in the grid below.
+// Sampling edges go through SoftSPISampler::readBit(), as in the clock ISR,
+// with the data line read at the times the ISR would read it (see the ISR
+// timing model below), bits go
+// through SoftSPIReceiver with the time in milliseconds, and each frame
+// goes through the same steps as
+// recievePacket(): inverted, checked by PacketFilter, and passed to
+// ClockwiseCaliper. The packets follow a slow random walk, like a caliper
+// being moved, so the packet filter only rejects what the noise breaks.
+//
+// Prints one CSV row per configuration, with the same columns in the same
+// order every run so results can be compared across versions:
+//   packets             packets sent
+//   frames              frames out of the receiver
+//   correct             packets whose frame matched and was accepted
+//   missing             packets with no frame at all
+//   corrupt_frames      frames that did not match the packet sent
+//   extra_frames        frames after the first one of a packet
+//   rejected            frames the packet filter rejected
+//   undetected          corrupt frames the packet filter accepted, which
+//                       would reach the typed measurement
+//   packet_error_rate   1 - correct / packets
+//   undetected_rate     undetected / packets
+//   resyncs             clock gap resyncs in SoftSPIReceiver
+//   error_bursts        runs of packets that were not correct
+//   recovery_mean_ms    from the start of the first packet of a burst to
+//   recovery_max_ms       the end of the next correct packet
+//   recovery_max_packets  most packets in a burst
+//   isr_mean_us         time in the clock ISR per clock edge, from the
+//                       timing model below, not a measurement
+//
+// Every configuration uses the same seed, so the waveform noise is the
+// same across the BIT_MAX_DELAY values and sampling modes.
+//
+// The ISR timing is a model, hand-set constants for the ATmega32U4 at
+// 16MHz: it decides when the data line is read, and adds up to
+// isr_mean_us. The real cost per edge is only known by measuring it on the
+// board with PERF_COUNTERS. A falling clock
+// edge sets the interrupt flag, which is cleared when the ISR starts, so
+// edges while the flag is still set are merged into one.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o noise-sweep
+//       noise-sweep.cpp CaliperSignal.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   ./noise-sweep [-n packets] [-s seed] > sweep.csv
+
+
+#include <chrono>
+#include <stdio.h>
+#include "CaliperPacket.h"
+#include "CaliperSignal.h"
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+#include "PacketFilter.h"
+#include "SoftSPIReceiver.h"
+#include "SoftSPISampler.h"
+
+
+const uint32_t PACKET_INTERVAL = 150000; // Microseconds between packets
+const uint16_t GLITCH_WIDTH = 20;        // Microseconds, the width of the glitch pulses
+const int32_t WALK_STEP = 100;           // Counts, the largest change between packets of the random walk
+const int32_t WALK_LIMIT = 200000;       // Counts, the random walk turns back beyond this
+const uint16_t DATA_GLITCH_WIDTH = 10;   // Microseconds, the width of the data glitch pulses
+
+// ISR timing model, estimated, not measured
+const double ISR_ENTRY_TIME = 4.0;       // Microseconds from the edge to the first instruction that can read a pin
+const double ISR_EDGE_CHECK_TIME = 2.0;  // Microseconds for isrMicros() and the compare, when the edge time filter is on
+const double ISR_READ_TIME = 0.25;       // Microseconds per read of the data line
+const double ISR_EXIT_TIME = 6.0;        // Microseconds from the last read to the end of the ISR
+
+// Same as the sketch
+const uint32_t FILTER_MAX_JUMP = 2000;
+const uint8_t FILTER_MEDIAN_SIZE = 3;
+
+// The grid
+const uint32_t CLK_PERIODS[] = {250, 400, 800};          // Microseconds, the calipers are ~400
+const uint8_t JITTER_PERCENTS[] = {0, 5, 10, 20};        // Of the clock period, up to 24
+const uint16_t GLITCH_RATES[] = {0, 66, 655, 3277};      // Out of 65536 per clock edge, 0%, 0.1%, 1%, 5%
+const uint16_t DROP_RATES[] = {0, 66, 655};              // Out of 65536 per clock pulse, 0%, 0.1%, 1%
+const uint16_t DATA_GLITCH_RATES[] = {0, 655, 3277};     // Out of 65536 per sampling edge, 0%, 1%, 5%
+const uint32_t BIT_MAX_DELAYS[] = {1, 2, 5, 10, 50, 100, 200}; // Milliseconds, the sketch uses 10
+
+/**
+ * Data sampling settings, the same as DATA_SAMPLES, DATA_SAMPLE_SPACING,
+ * and CLK_MIN_TIME in the sketch.
+ */
+typedef struct {
+    uint8_t samples;         // 1, 3, or 5
+    uint8_t sampleSpacing;   // Microseconds
+    uint8_t minEdgePercent;  // Of the clock period, 0 to disable
+} sampling_mode_t;
+
+const sampling_mode_t SAMPLING_MODES[] = {
+    {1, 0, 0},   // One read, the default
+    {1, 20, 0},  // One read, delayed
+    {3, 0, 0},   // Back to back majority vote
+    {3, 5, 0},   // Spread out majority vote
+    {1, 0, 50},  // Edge time filter
+    {3, 5, 50}   // Both
+};
+
+/**
+ * One point of the grid.
+ */
+typedef struct {
+    caliper_signal_config_t signal;
+    uint32_t bitMaxDelay;    // Milliseconds
+    uint8_t samples;
+    uint8_t sampleSpacing;   // Microseconds
+    uint32_t minEdgeTime;    // Microseconds
+} sweep_config_t;
+
+/**
+ * Counts for one point of the grid, see the columns above.
+ */
+typedef struct {
+    uint32_t packets;
+    uint32_t frames;
+    uint32_t correct;
+    uint32_t missing;
+    uint32_t corruptFrames;
+    uint32_t extraFrames;
+    uint32_t rejected;
+    uint32_t undetected;
+    uint32_t resyncs;
+    uint32_t errorBursts;
+    uint32_t recoveries;    // Bursts followed by a correct packet
+    uint64_t recoveryTotal; // Microseconds
+    uint32_t recoveryMax;   // Microseconds
+    uint32_t recoveryMaxPackets;
+    uint32_t clkEdges;
+    double isrTime;         // Microseconds
+} sweep_result_t;
+
+
+/**
+ * Returns the state of the data line at a time.
+ *
+ * @param edges edges of the packet
+ * @param edgeCount number of edges in edges
+ * @param from index of an edge at or before time
+ * @param time microseconds
+ * @return the state of the data line
+ */
+static bool dataAt(const caliper_signal_edge_t *edges, uint8_t edgeCount, uint8_t from, double time) {
+    bool state = edges[from].data;
+
+    for (uint8_t e = from + 1; e < edgeCount && edges[e].time <= time; e++) {
+        state = edges[e].data;
+    }
+
+    return state;
+}
+
+/**
+ * Runs one configuration, reading the data line Samples times per edge.
+ *
+ * @param config signal and decoding settings
+ * @param packetCount packets to send
+ * @param seed random seed, not 0
+ * @return the counts
+ */
+template <uint8_t Samples>
+static sweep_result_t runConfig(const sweep_config_t &config, uint32_t packetCount, uint32_t seed) {
+    CaliperSignalGenerator generator(config.signal, seed);
+    SoftSPIReceiver<SSPI_LSB_FIRST> receiver;
+    SoftSPISampler<Samples> sampler;
+    PacketFilter<FILTER_MEDIAN_SIZE> filter;
+    ClockwiseCaliper caliper;
+    caliper_signal_edge_t edges[CALIPER_SIGNAL_MAX_EDGES];
+    sweep_result_t result = {};
+    int32_t value = 0;
+    uint8_t lastResyncCount = 0;
+    bool inBurst = false;
+    uint32_t burstStart = 0;
+    uint32_t burstPackets = 0;
+    double isrStart = 0;
+    double isrEnd = 0;
+
+    receiver.begin(config.bitMaxDelay, caliper.getPacketLength() * 8);
+    sampler.begin(config.minEdgeTime);
+    filter.begin(FILTER_MAX_JUMP);
+
+    for (uint32_t i = 0; i < packetCount; i++) {
+        uint32_t startTime = generator.getTime();
+        uint32_t endTime = startTime;
+
+        // Random walk, turning back at the limits
+        value += (int32_t)(generator.random() % (2 * WALK_STEP + 1)) - WALK_STEP;
+        value = value > WALK_LIMIT ? WALK_LIMIT : (value < -WALK_LIMIT ? -WALK_LIMIT : value);
+
+        uint32_t packet = encodeCaliperPacket(value, MILLIMETERS);
+        uint8_t edgeCount = generator.generatePacket(packet, edges);
+        bool received = false;
+        bool correct = false;
+
+        bool clkState = false; // The clock idles LOW
+
+        for (uint8_t e = 0; e < edgeCount; e++) {
+            bool sampleEdge = clkState && !edges[e].clk; // Sampling edge for MODE1
+
+            clkState = edges[e].clk;
+
+            if (!sampleEdge) {
+                continue;
+            }
+
+            result.clkEdges++;
+            endTime = edges[e].time;
+
+            if (edges[e].time < isrStart) {
+                continue; // The flag is still set from an earlier edge
+            }
+
+            isrStart = edges[e].time + ISR_ENTRY_TIME > isrEnd ? edges[e].time + ISR_ENTRY_TIME : isrEnd;
+
+            double readTime = isrStart;
+            bool dataState;
+
+            bool accepted = sampler.readBit([&]() {
+                                                readTime += ISR_EDGE_CHECK_TIME;
+                                                return (uint32_t)isrStart;
+                                            },
+                                            [&]() {
+                                                bool state = dataAt(edges, edgeCount, e, readTime);
+
+                                                readTime += ISR_READ_TIME;
+                                                return state;
+                                            },
+                                            [&](uint8_t time) { readTime += time; },
+                                            config.sampleSpacing,
+                                            dataState);
+
+            if (accepted) {
+                receiver.sample(dataState, (uint32_t)isrStart / 1000);
+            }
+
+            isrEnd = readTime + ISR_EXIT_TIME;
+            result.isrTime += isrEnd - isrStart + ISR_ENTRY_TIME;
+        }
+
+        while (receiver.hasData()) {
+            // Same as recievePacket()
+            uint32_t frame = ~receiver.read() & 0xFFFFFF;
+            uint32_t filtered = frame;
+            bool accepted = filter.filter(filtered);
+
+            if (accepted) {
+                caliper.updatePacket(filtered, endTime / 1000);
+            }
+
+            result.frames++;
+
+            if (received) {
+                result.extraFrames++;
+            }
+
+            if (!accepted) {
+                result.rejected++;
+            }
+
+            if (frame != packet) {
+                result.corruptFrames++;
+
+                if (accepted) {
+                    result.undetected++;
+                }
+
+            } else if (!received && accepted) {
+                correct = true;
+            }
+
+            received = true;
+        }
+
+        uint8_t resyncCount = receiver.getResyncCount();
+
+        result.resyncs += (uint8_t)(resyncCount - lastResyncCount);
+        lastResyncCount = resyncCount;
+
+        if (!received) {
+            result.missing++;
+        }
+
+        if (correct) {
+            result.correct++;
+
+            if (inBurst) {
+                uint32_t recovery = endTime - burstStart;
+
+                result.recoveries++;
+                result.recoveryTotal += recovery;
+                result.recoveryMax = recovery > result.recoveryMax ? recovery : result.recoveryMax;
+                result.recoveryMaxPackets = burstPackets > result.recoveryMaxPackets ? burstPackets : result.recoveryMaxPackets;
+                inBurst = false;
+            }
+
+        } else if (inBurst) {
+            burstPackets++;
+
+        } else {
+            inBurst = true;
+            burstStart = startTime;
+            burstPackets = 1;
+            result.errorBursts++;
+        }
+    }
+
+    result.packets = packetCount;
+
+    return result;
+}
+
+
+/**
+ * Prints the CSV header.
+ */
+static void printHeader() {
+    printf("clk_period_us,jitter_us,glitch_rate,glitch_width_us,drop_rate,"
+           "data_glitch_rate,data_glitch_width_us,bit_max_delay_ms,samples,sample_spacing_us,min_edge_us,"
+           "packets,frames,correct,missing,corrupt_frames,extra_frames,rejected,undetected,"
+           "packet_error_rate,undetected_rate,resyncs,error_bursts,"
+           "recovery_mean_ms,recovery_max_ms,recovery_max_packets,isr_mean_us\n");
+}
+
+/**
+ * Prints one configuration as a CSV row.
+ *
+ * @param config signal and decoding settings
+ * @param result counts of the run
+ */
+static void printRow(const sweep_config_t &config, const sweep_result_t &result) {
+    printf("%u,%u,%u,%u,%u,", config.signal.clkPeriod, config.signal.jitter, config.signal.glitchRate,
+           config.signal.glitchWidth, config.signal.dropRate);
+    printf("%u,%u,%u,%u,%u,%u,", config.signal.dataGlitchRate, config.signal.dataGlitchWidth, config.bitMaxDelay,
+           config.samples, config.sampleSpacing, config.minEdgeTime);
+    printf("%u,%u,%u,%u,%u,%u,%u,%u,", result.packets, result.frames, result.correct, result.missing,
+           result.corruptFrames, result.extraFrames, result.rejected, result.undetected);
+    printf("%.6f,%.6f,%u,%u,", 1.0 - (double)result.correct / result.packets,
+           (double)result.undetected / result.packets, result.resyncs, result.errorBursts);
+    printf("%.1f,%.1f,%u,", result.recoveries > 0 ? result.recoveryTotal / 1000.0 / result.recoveries : 0.0,
+           result.recoveryMax / 1000.0, result.recoveryMaxPackets);
+    printf("%.2f\n", result.clkEdges > 0 ? result.isrTime / result.clkEdges : 0.0);
+}
+
+/**
+ * Runs one configuration with its number of samples.
+ *
+ * @param config signal and decoding settings
+ * @param packetCount packets to send
+ * @param seed random seed, not 0
+ * @return the counts
+ */
+static sweep_result_t runConfig(const sweep_config_t &config, uint32_t packetCount, uint32_t seed) {
+    switch (config.samples) {
+        case 3:
+            return runConfig<3>(config, packetCount, seed);
+        case 5:
+            return runConfig<5>(config, packetCount, seed);
+        default:
+            return runConfig<1>(config, packetCount, seed);
+    }
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t packetCount = 2000;
+    uint32_t seed = 1;
+
+    if (!parseHostOptions(argc, argv, {{"-n", packetCount}, {"-s", seed}})) {
+        return 1;
+    }
+
+    if (packetCount == 0 || seed == 0) {
+        fprintf(stderr, "Packets and seed must not be 0\n");
+        return 1;
+    }
+
+    uint32_t configCount = 0;
+    auto startTime = std::chrono::steady_clock::now();
+
+    printHeader();
+
+    for (uint32_t clkPeriod : CLK_PERIODS) {
+        for (uint8_t jitterPercent : JITTER_PERCENTS) {
+            for (uint16_t glitchRate : GLITCH_RATES) {
+                for (uint16_t dropRate : DROP_RATES) {
+                    for (uint16_t dataGlitchRate : DATA_GLITCH_RATES) {
+                        for (uint32_t bitMaxDelay : BIT_MAX_DELAYS) {
+                            for (const sampling_mode_t &mode : SAMPLING_MODES) {
+                                sweep_config_t config;
+
+                                config.signal.clkPeriod = clkPeriod;
+                                config.signal.packetInterval = PACKET_INTERVAL;
+                                config.signal.jitter = clkPeriod * jitterPercent / 100;
+                                config.signal.glitchRate = glitchRate;
+                                config.signal.glitchWidth = GLITCH_WIDTH;
+                                config.signal.dropRate = dropRate;
+                                config.signal.dataGlitchRate = dataGlitchRate;
+                                config.signal.dataGlitchWidth = DATA_GLITCH_WIDTH;
+                                config.bitMaxDelay = bitMaxDelay;
+                                config.samples = mode.samples;
+                                config.sampleSpacing = mode.sampleSpacing;
+                                config.minEdgeTime = clkPeriod * mode.minEdgePercent / 100;
+
+                                printRow(config, runConfig(config, packetCount, seed));
+                                configCount++;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    fprintf(stderr, "configurations: %u, packets each: %u, time: %.1f s\n", configCount, packetCount, seconds);
+
+    return 0;
+}
@@ -0,0 +1,579 @@
+/*
+ * output-scheduler-sim.cpp - Packet Capture While Typing, Blocking and Scheduled
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Simulates the sketch, to the microsecond, while the trigger is pressed
+// at a sustained rate:
+//   - the caliper signal is decoded by SoftSPIReceiver as the clock edges
+//     come in, like the interrupt does, whatever loop() is doing.
+//   - the trigger interrupt fires on every press.
+//   - the USB host polls the keyboard endpoint every millisecond, and
+//     now and then stops polling for a while (a busy or suspending host).
+//
+// The same presses, packets and host are run twice:
+//   - blocking: loop() as it was, a single trigger flag, and every report
+//     sent with BootKeyboard.send(), which waits up to 250 ms for the
+//     endpoint and then drops the report (USB_Send() in the Arduino core).
+//   - scheduled: triggers counted and queued in OutputScheduler, and a
+//     report only sent when the endpoint is free, one per loop() pass,
+//     with typeMeasurementStep() as the sketch calls it.
+//
+// Reports the triggers typed intact, typed with lost reports, and dropped,
+// the packets lost and resyncs, and the worst packet and trigger delays.
+// Exits with 1 if the scheduled run drops a trigger or a packet, or
+// resyncs, or if OutputScheduler starts a sequence for a button press as
+// auto triggered or the other way round, with both queued in random order.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o output-scheduler-sim
+//       output-scheduler-sim.cpp CaliperSignal.cpp
+//       ../src/DataInterface/ClockwiseCaliper.cpp
+//       ../src/DataInterface/KeySequence.cpp
+//       ../src/DataInterface/MeasurementTyping.cpp
+//       ../src/DataInterface/OutputScheduler.cpp
+//
+// Usage:
+//   ./output-scheduler-sim [-d seconds] [-p pressesPerSecond]
+//                          [-h stallMs] [-e stallEveryMs] [-s seed]
+
+
+#include <deque>
+#include <stdio.h>
+#include <vector>
+#include "CaliperSignal.h"
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+#include "KeySequence.h"
+#include "MeasurementTyping.h"
+#include "OutputScheduler.h"
+#include "SoftSPIReceiver.h"
+
+
+// Same as the sketch
+const uint32_t BIT_MAX_DELAY = 10;
+const uint32_t OUTPUT_STALL_TIMEOUT = 1000;
+
+const uint32_t LOOP_TIME = 100;          // Microseconds per loop() pass
+const uint32_t HOST_POLL_INTERVAL = 1000; // Microseconds between endpoint polls (bInterval 1)
+const uint16_t USB_SEND_TIMEOUT = 250;    // Milliseconds USB_Send() waits for the endpoint
+const uint32_t PACKET_RANDOM_MASK = 0x80FFFF; // Up to 655.35 mm or 32.7675 in, positive
+const uint32_t MAX_DURATION = 3600;       // Seconds, so microsecond times fit in 32 bits
+const int32_t NO_SEQUENCE = -1;           // Report not part of a typed trigger
+
+
+/**
+ * A time the host stops polling.
+ */
+typedef struct {
+    uint32_t start; // Microseconds
+    uint32_t end;
+} host_stall_t;
+
+/**
+ * Simulation settings.
+ */
+typedef struct {
+    uint32_t duration;     // Seconds
+    uint32_t pressRate;    // Presses per second
+    uint32_t stallTime;    // Milliseconds the host stops polling for
+    uint32_t stallEvery;   // Average milliseconds between stalls, 0 for none
+    uint32_t seed;
+} sim_config_t;
+
+/**
+ * What happened in one run.
+ */
+typedef struct {
+    uint32_t presses;
+    uint32_t typedIntact;   // Every report of the sequence reached the host
+    uint32_t typedDamaged;  // Some reports were dropped
+    uint32_t dropped;       // Presses that were never typed
+    uint32_t packetsSent;
+    uint32_t packetsRead;
+    uint32_t packetsLost;
+    uint32_t resyncs;
+    uint32_t maxPacketWait; // Microseconds from a packet finishing to loop() reading it
+    uint32_t maxTriggerWait; // Microseconds from a press to its first report being sent
+    uint8_t maxQueued;      // Most triggers queued at once
+    uint16_t stalls;        // Sequences OutputScheduler gave up on
+} sim_result_t;
+
+
+/**
+ * The USB host and the keyboard endpoint's single bank.
+ */
+class Host {
+public:
+    Host(const std::vector<host_stall_t> &stalls) : stalls(stalls) {}
+
+    /**
+     * Takes the report in the bank if the host polled since it was written.
+     *
+     * @param now current time in microseconds
+     * @return true if the bank is free
+     */
+    bool isFree(uint32_t now) {
+        if (this->full) {
+            uint32_t poll = this->nextPoll(this->writtenAt);
+
+            if (poll <= now) {
+                this->full = false;
+
+                if (this->sequence != NO_SEQUENCE) {
+                    this->delivered[this->sequence]++;
+                }
+            }
+        }
+
+        return !this->full;
+    }
+
+    /**
+     * Writes a report into the bank, which must be free.
+     *
+     * @param now current time in microseconds
+     * @param sequence sequence the report belongs to
+     */
+    void write(uint32_t now, int32_t sequence) {
+        this->full = true;
+        this->writtenAt = now;
+        this->sequence = sequence;
+    }
+
+    std::vector<uint32_t> delivered; // Reports the host got of each sequence
+
+private:
+    const std::vector<host_stall_t> &stalls;
+    bool full = false;
+    uint32_t writtenAt = 0;
+    int32_t sequence = NO_SEQUENCE;
+    size_t stallIndex = 0;
+
+    /**
+     * Returns the first poll after a time, skipping stalls.
+     */
+    uint32_t nextPoll(uint32_t time) {
+        uint32_t poll = (time / HOST_POLL_INTERVAL + 1) * HOST_POLL_INTERVAL;
+
+        while (this->stallIndex < this->stalls.size() && this->stalls[this->stallIndex].end <= poll) {
+            this->stallIndex++;
+        }
+
+        if (this->stallIndex < this->stalls.size() && this->stalls[this->stallIndex].start <= poll) {
+            uint32_t end = this->stalls[this->stallIndex].end;
+            poll = (end + HOST_POLL_INTERVAL - 1) / HOST_POLL_INTERVAL * HOST_POLL_INTERVAL;
+        }
+
+        return poll;
+    }
+};
+
+
+/**
+ * Returns the default DIP switches, only NEWLINE on.
+ *
+ * @return the TYPING_* options
+ */
+static uint8_t readDefaultOptions() {
+    return TYPING_NEWLINE;
+}
+
+
+/**
+ * The board: the caliper and trigger interrupts, and what loop() reads.
+ */
+class Board {
+public:
+    Board(const sim_config_t &config, const std::vector<uint32_t> &pressTimes)
+        : generator({400, 150000, 0, 0, 20, 0, 0, 0}, config.seed), pressTimes(pressTimes) {
+        this->receiver.begin(BIT_MAX_DELAY, this->caliper.getPacketLength() * 8);
+    }
+
+    /**
+     * Runs the interrupts up to a time.
+     *
+     * @param time microseconds
+     */
+    void advance(uint32_t time) {
+        while (true) {
+            if (this->edgeIndex == this->edgeCount) {
+                this->edgeCount = this->generator.generatePacket(this->generator.random() & PACKET_RANDOM_MASK, this->edges);
+                this->edgeIndex = 0;
+            }
+
+            uint32_t edgeTime = this->edges[this->edgeIndex].time;
+            uint32_t pressTime = this->pressIndex < this->pressTimes.size() ? this->pressTimes[this->pressIndex] : UINT32_MAX;
+
+            if (edgeTime > time && pressTime > time) {
+                break;
+            }
+
+            if (pressTime <= edgeTime) {
+                this->pressIndex++;
+                this->pressed.push_back(pressTime);
+                this->triggerFlag = true;
+
+                if (this->triggerCount < 255) {
+                    this->triggerCount++;
+                }
+
+            } else {
+                const caliper_signal_edge_t &edge = this->edges[this->edgeIndex++];
+
+                if (!edge.clk) { // Sampling edge for MODE1
+                    uint8_t before = this->receiver.framesAvailable();
+
+                    this->receiver.sample(edge.data, edge.time / 1000);
+
+                    if (this->receiver.framesAvailable() > before) {
+                        this->frameTimes.push_back(edge.time);
+                        this->framesQueued++;
+                    }
+                }
+
+                if (this->edgeIndex == this->edgeCount) {
+                    this->result.packetsSent++;
+                }
+            }
+        }
+
+        this->now = time;
+    }
+
+    /**
+     * Reads every packet waiting, like the start of loop().
+     */
+    void drain() {
+        while (this->receiver.hasData()) {
+            uint32_t wait = this->now - this->frameTimes.front();
+
+            this->frameTimes.pop_front();
+            this->result.packetsRead++;
+            this->result.maxPacketWait = wait > this->result.maxPacketWait ? wait : this->result.maxPacketWait;
+
+            this->caliper.updatePacket(~this->receiver.read() & CALIPER_PACKET_MASK, this->now / 1000);
+            this->caliper.refershData();
+        }
+    }
+
+    /**
+     * Builds the sequence the sketch types with the default switches.
+     *
+     * @param sequence sequence to fill
+     */
+    void buildSequence(KeySequence &sequence) {
+        buildMeasurementSequence(sequence, this->format, false);
+    }
+
+    /**
+     * Counts a press as typed, from the oldest one waiting.
+     */
+    void takePress() {
+        uint32_t wait = this->now - this->pressed.front();
+
+        this->pressed.pop_front();
+        this->result.maxTriggerWait = wait > this->result.maxTriggerWait ? wait : this->result.maxTriggerWait;
+    }
+
+    CaliperSignalGenerator generator;
+    SoftSPIReceiver<SSPI_LSB_FIRST> receiver;
+    ClockwiseCaliper caliper;
+    sim_result_t result = {};
+    const measurement_format_t format = {&this->caliper, 1, 0, 0, KEY_USAGE_TAB, readDefaultOptions};
+
+    uint32_t now = 0;
+    bool triggerFlag = false;     // Blocking sketch
+    uint8_t triggerCount = 0;     // Scheduled sketch
+    std::deque<uint32_t> pressed; // Presses not typed yet
+    uint32_t framesQueued = 0;    // Frames that made it into the receive queue
+
+private:
+    const std::vector<uint32_t> &pressTimes;
+    size_t pressIndex = 0;
+
+    caliper_signal_edge_t edges[CALIPER_SIGNAL_MAX_EDGES];
+    uint8_t edgeCount = 0;
+    uint8_t edgeIndex = 0;
+    std::deque<uint32_t> frameTimes; // When each queued frame finished
+};
+
+
+/**
+ * Returns the number of reports it takes to type a sequence.
+ */
+static uint32_t countReports(KeySequence sequence) {
+    key_report_t report;
+    uint32_t count = 0;
+
+    sequence.rewind();
+
+    while (sequence.nextReport(report)) {
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * Counts the sequences that reached the host whole, once it has had time
+ * to take the last report.
+ */
+static void countTyped(Board &board, Host &host, const std::vector<uint32_t> &expected) {
+    board.advance(board.now + USB_SEND_TIMEOUT * 1000);
+    host.isFree(board.now);
+
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (host.delivered[i] == expected[i]) {
+            board.result.typedIntact++;
+        } else {
+            board.result.typedDamaged++;
+        }
+    }
+}
+
+
+/**
+ * Runs the sketch as it was: typing blocks loop().
+ */
+static sim_result_t runBlocking(const sim_config_t &config, const std::vector<uint32_t> &pressTimes,
+                                const std::vector<host_stall_t> &stalls) {
+    Board board(config, pressTimes);
+    Host host(stalls);
+    std::vector<uint32_t> expected;
+    uint32_t end = config.duration * 1000000;
+
+    while (board.now < end) {
+        board.advance(board.now + LOOP_TIME);
+        board.drain();
+
+        if (!board.triggerFlag) {
+            continue;
+        }
+
+        // Every press so far is typed once
+        board.triggerFlag = false;
+        board.takePress();
+        board.result.dropped += board.pressed.size();
+        board.pressed.clear();
+
+        KeySequence sequence;
+        key_report_t report;
+        int32_t id = host.delivered.size();
+
+        board.buildSequence(sequence);
+        host.delivered.push_back(0);
+        expected.push_back(countReports(sequence));
+
+        while (sequence.nextReport(report)) {
+            uint16_t timeout = USB_SEND_TIMEOUT;
+            bool sent = true;
+
+            // USB_Send() checks, then waits 1 ms
+            while (!host.isFree(board.now)) {
+                if (--timeout == 0) {
+                    sent = false;
+                    break;
+                }
+
+                board.advance(board.now + 1000);
+            }
+
+            if (sent) {
+                host.write(board.now, id);
+            }
+        }
+    }
+
+    countTyped(board, host, expected);
+
+    board.result.presses = pressTimes.size();
+    board.result.dropped += board.pressed.size();
+    board.result.packetsLost = board.result.packetsSent - board.framesQueued;
+    board.result.resyncs = board.receiver.getResyncCount();
+
+    return board.result;
+}
+
+/**
+ * Runs the sketch with OutputScheduler.
+ */
+static sim_result_t runScheduled(const sim_config_t &config, const std::vector<uint32_t> &pressTimes,
+                                 const std::vector<host_stall_t> &stalls) {
+    Board board(config, pressTimes);
+    Host host(stalls);
+    OutputScheduler scheduler;
+    std::vector<uint32_t> expected;
+    uint32_t end = config.duration * 1000000;
+    int32_t id = NO_SEQUENCE;
+    uint16_t stallsAtStart = 0;
+
+    scheduler.begin(OUTPUT_STALL_TIMEOUT);
+
+    // Finish typing after the last press
+    while (board.now < end || scheduler.isBusy()) {
+        board.advance(board.now + LOOP_TIME);
+        board.drain();
+
+        scheduler.addTriggers(board.triggerCount, false);
+        board.triggerCount = 0;
+        board.result.maxQueued = scheduler.getQueuedTriggers() > board.result.maxQueued ? scheduler.getQueuedTriggers() : board.result.maxQueued;
+
+        key_report_t report;
+        uint8_t typing = typeMeasurementStep(scheduler, board.format, host.isFree(board.now), board.now / 1000, report);
+
+        if (typing & TYPING_STARTED) {
+            board.takePress();
+
+            id = host.delivered.size();
+            stallsAtStart = scheduler.getStallCount();
+            host.delivered.push_back(0);
+            expected.push_back(countReports(scheduler.getSequence()));
+        }
+
+        if (typing & TYPING_REPORT) {
+            // The release after giving up is not part of the sequence
+            host.write(board.now, scheduler.getStallCount() == stallsAtStart ? id : NO_SEQUENCE);
+        }
+    }
+
+    countTyped(board, host, expected);
+
+    board.result.presses = pressTimes.size();
+    board.result.dropped = scheduler.getDroppedTriggers() + board.pressed.size();
+    board.result.packetsLost = board.result.packetsSent - board.framesQueued;
+    board.result.resyncs = board.receiver.getResyncCount();
+    board.result.stalls = scheduler.getStallCount();
+
+    return board.result;
+}
+
+
+/**
+ * Queues random batches of button presses and auto triggers, and starts
+ * the sequences in between, checking each one is for the kind of trigger
+ * queued in that place.
+ *
+ * @param seed random seed, not 0
+ * @return the number of sequences started for the wrong kind of trigger
+ */
+static uint32_t checkAutoTriggerOrder(uint32_t seed) {
+    OutputScheduler scheduler;
+    std::deque<bool> queued; // Kind of each trigger queued, oldest first
+    uint32_t state = seed;
+    uint32_t wrong = 0;
+    key_report_t report;
+
+    for (uint32_t i = 0; i < 100000; i++) {
+        uint8_t count = hostRandomRange(state, 0, 3);
+        bool autoTriggered = hostRandom(state) & 1;
+
+        count = queued.size() + count > OUTPUT_MAX_TRIGGERS ? OUTPUT_MAX_TRIGGERS - queued.size() : count;
+        scheduler.addTriggers(count, autoTriggered);
+        queued.insert(queued.end(), count, autoTriggered);
+
+        // An empty sequence, typing ends on the next report
+        while (hostRandom(state) & 1 && scheduler.startSequence(0)) {
+            wrong += scheduler.isAutoTriggered() != queued.front();
+            queued.pop_front();
+            scheduler.nextReport(true, 0, report);
+        }
+    }
+
+    return wrong;
+}
+
+
+/**
+ * Prints the results of a run.
+ */
+static void printResult(const char *name, const sim_result_t &result) {
+    printf("%-9s presses %u, typed %u, typed with lost reports %u, dropped %u, "
+           "packets %u, lost %u, resyncs %u, max packet wait %.1f ms, max trigger wait %.1f ms, "
+           "max queued %u, given up %u\n",
+           name, result.presses, result.typedIntact, result.typedDamaged, result.dropped,
+           result.packetsSent, result.packetsLost, result.resyncs,
+           result.maxPacketWait / 1000.0, result.maxTriggerWait / 1000.0,
+           result.maxQueued, result.stalls);
+}
+
+
+int main(int argc, char **argv) {
+    sim_config_t config = {600, 5, 300, 5000, 1};
+
+    if (!parseHostOptions(argc, argv, {{"-d", config.duration}, {"-p", config.pressRate}, {"-h", config.stallTime},
+                                       {"-e", config.stallEvery}, {"-s", config.seed}})) {
+        return 1;
+    }
+
+    if (config.duration == 0 || config.duration > MAX_DURATION) {
+        fprintf(stderr, "Duration must be 1 to %u seconds\n", MAX_DURATION);
+        return 1;
+    }
+
+    if (config.pressRate == 0 || config.pressRate > 100) {
+        fprintf(stderr, "Presses per second must be 1 to 100\n");
+        return 1;
+    }
+
+    uint32_t state = config.seed != 0 ? config.seed : 1;
+    uint32_t pressInterval = 1000000 / config.pressRate;
+    uint32_t end = config.duration * 1000000;
+    std::vector<uint32_t> pressTimes;
+    std::vector<host_stall_t> stalls;
+
+    // The same presses and stalls for both runs
+    // Presses +/- half an interval from evenly spaced, so some come close together
+    for (uint32_t time = pressInterval; time < end; time += pressInterval) {
+        pressTimes.push_back(time - pressInterval / 2 + hostRandom(state) % pressInterval);
+    }
+
+    if (config.stallEvery > 0) {
+        uint32_t time = 0;
+
+        while (true) {
+            time += (config.stallEvery / 2 + hostRandom(state) % config.stallEvery) * 1000;
+
+            if (time >= end) {
+                break;
+            }
+
+            stalls.push_back({time, time + config.stallTime * 1000});
+            time += config.stallTime * 1000;
+        }
+    }
+
+    printf("seconds: %u, presses per second: %u, host stalls: %zu of %u ms\n",
+           config.duration, config.pressRate, stalls.size(), config.stallTime);
+
+    sim_result_t blocking = runBlocking(config, pressTimes, stalls);
+    sim_result_t scheduled = runScheduled(config, pressTimes, stalls);
+
+    printResult("blocking", blocking);
+    printResult("scheduled", scheduled);
+
+    HostChecks checks;
+
+    checks.expect(scheduled.dropped == 0, "scheduled dropped %u triggers", scheduled.dropped);
+    checks.expect(scheduled.packetsLost == 0, "scheduled lost %u packets", scheduled.packetsLost);
+    checks.expect(scheduled.resyncs == 0, "scheduled resynced %u times", scheduled.resyncs);
+
+    uint32_t wrongKind = checkAutoTriggerOrder(state);
+
+    checks.expect(wrongKind == 0, "%u sequences started for the wrong kind of trigger", wrongKind);
+
+    return checks.finish();
+}
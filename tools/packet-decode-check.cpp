@@ -0,0 +1,278 @@
+/*
+ * packet-decode-check.cpp - Exhaustive Check and Benchmark of CaliperPacket.h
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Checks the decoding in CaliperPacket.h for all 2^24 packets against:
+//   - a reference written with division and remainder instead of bit
+//     operations.
+//   - the bitfield union ClockwiseCaliper used before, on little endian
+//     hosts where its layout is known.
+//   - ClockwiseCaliper, which decodes with CaliperPacket.h.
+//   - encoding the decoded fields, and splitting into bytes, back again.
+// A few packets are also checked at compile time.
+//
+// Then times decoding the signed measurement of every packet, in random
+// order, with the old union, with ClockwiseCaliper one packet at a time,
+// and with decodeCaliperPacketValues().
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o packet-decode-check
+//       packet-decode-check.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   ./packet-decode-check [-r repeats]
+
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+#include "CaliperPacket.h"
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+
+
+const uint32_t PACKET_COUNT = (uint32_t)1 << 24;
+
+// Decoded at compile time
+static_assert(caliperPacketValue(0x000000) == 0, "Zero");
+static_assert(caliperPacketValue(0x0004D2) == 1234, "Positive");
+static_assert(caliperPacketValue(0x1004D2) == -1234, "Negative");
+static_assert(caliperPacketValue(0x100000) == 0, "Negative zero");
+static_assert(caliperPacketValue(0x9FFFFF) == -0xFFFFF, "Largest, inches");
+static_assert(caliperPacketUnit(0x800000) == INCHES, "Unit");
+static_assert(caliperPacketUnknownBits(0x600000) == 3, "Unknown bits");
+static_assert(decodeCaliperPacket(0xB00001).unknown == 1, "Fields");
+static_assert(encodeCaliperPacket(-1234, INCHES) == 0x9004D2, "Encode");
+static_assert(caliperDataToPacket(caliperPacketToData(0xABCDEF)) == 0xABCDEF, "Bytes");
+
+
+/**
+ * The packet representation ClockwiseCaliper used before CaliperPacket.h.
+ * Only matches the packet on little endian hosts with GCC's bitfield
+ * layout.
+ */
+typedef union {
+    uint32_t integer;
+
+    struct {
+        uint32_t measurement:20;
+        uint8_t sign:1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t unit:1;
+    } data;
+} legacy_caliper_data_t;
+
+
+/**
+ * Returns the fields of a packet without any bit operations.
+ *
+ * @param packet 24-bit packet
+ * @return the fields
+ */
+static caliper_packet_fields_t referenceDecode(uint32_t packet) {
+    caliper_packet_fields_t fields;
+
+    fields.measurement = packet % 1048576;
+    fields.sign = (caliper_sign_t)(packet / 1048576 % 2);
+    fields.unknown = packet / 2097152 % 4;
+    fields.unit = (caliper_unit_t)(packet / 8388608 % 2);
+
+    return fields;
+}
+
+/**
+ * Returns the signed measurement of a packet with the old union.
+ *
+ * @param packet 24-bit packet
+ * @return the signed measurement
+ */
+static int32_t legacyValue(uint32_t packet) {
+    legacy_caliper_data_t data;
+    int32_t value;
+
+    data.integer = packet;
+    value = data.data.measurement;
+
+    if (data.data.sign == NEGATIVE) {
+        value = -value;
+    }
+
+    return value;
+}
+
+
+/**
+ * Checks every packet, printing the first few mismatches.
+ *
+ * @return the number of mismatches
+ */
+static uint32_t checkAll() {
+    bool littleEndian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+    ClockwiseCaliper caliper;
+    uint32_t wrong = 0;
+
+    for (uint32_t packet = 0; packet < PACKET_COUNT; packet++) {
+        caliper_packet_fields_t fields = decodeCaliperPacket(packet);
+        caliper_packet_fields_t reference = referenceDecode(packet);
+        int32_t referenceValue = reference.sign == NEGATIVE ? -(int32_t)reference.measurement : reference.measurement;
+        uint32_t encoded = encodeCaliperPacket(caliperPacketValue(packet), caliperPacketUnit(packet));
+        uint32_t expectedEncoded = packet & ~((uint32_t)3 << CALIPER_PACKET_UNKNOWN_SHIFT);
+
+        // -0 encodes as +0
+        if (caliperPacketMeasurement(packet) == 0) {
+            expectedEncoded &= ~((uint32_t)1 << CALIPER_PACKET_SIGN_BIT);
+        }
+
+        caliper.updatePacket(packet);
+        caliper.refershData();
+
+        bool matches = fields.measurement == reference.measurement
+                    && fields.sign == reference.sign
+                    && fields.unknown == reference.unknown
+                    && fields.unit == reference.unit
+                    && caliperPacketValue(packet) == referenceValue
+                    && (!littleEndian || legacyValue(packet) == referenceValue)
+                    && encoded == expectedEncoded
+                    && caliperDataToPacket(caliperPacketToData(packet)) == packet
+                    && caliper.getPacket() == packet
+                    && caliper.getRawMeasurement() == reference.measurement
+                    && caliper.getSign() == reference.sign
+                    && caliper.getUnit() == reference.unit
+                    && caliper.getFixedMeasurement() == referenceValue;
+
+        if (!matches && wrong++ < 5) {
+            printf("wrong: 0x%06X\n", packet);
+        }
+    }
+
+    return wrong;
+}
+
+
+/**
+ * Returns the fastest of several runs of a decoder.
+ *
+ * @param decode function decoding all packets to values
+ * @param packets packets to decode
+ * @param values values to fill
+ * @param repeats number of runs
+ * @return the fastest run in seconds
+ */
+template <typename Decoder>
+static double bestTime(Decoder decode, const std::vector<uint32_t> &packets, std::vector<int32_t> &values, uint32_t repeats) {
+    double best = 1e9;
+
+    for (uint32_t r = 0; r < repeats; r++) {
+        auto start = std::chrono::steady_clock::now();
+
+        decode(packets.data(), values.data(), packets.size());
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (seconds < best) {
+            best = seconds;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Returns the sum of the values, so the runs can be compared.
+ *
+ * @param values decoded values
+ * @return the sum
+ */
+static int64_t sum(const std::vector<int32_t> &values) {
+    int64_t total = 0;
+
+    for (int32_t value : values) {
+        total += value;
+    }
+
+    return total;
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t repeats = 5;
+
+    if (!parseHostOptions(argc, argv, {{"-r", repeats}})) {
+        return 1;
+    }
+
+    if (repeats == 0) {
+        fprintf(stderr, "Repeats must not be 0\n");
+        return 1;
+    }
+
+    uint32_t wrong = checkAll();
+
+    printf("packets checked: %u, wrong: %u%s\n", PACKET_COUNT, wrong,
+           __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? "" : " (big endian host, union not checked)");
+
+    // Every packet in random order (Fisher-Yates)
+    std::vector<uint32_t> packets(PACKET_COUNT);
+    std::vector<int32_t> values(PACKET_COUNT);
+    uint32_t state = 1;
+
+    for (uint32_t i = 0; i < PACKET_COUNT; i++) {
+        packets[i] = i;
+    }
+
+    for (uint32_t i = PACKET_COUNT - 1; i > 0; i--) {
+        uint32_t j = hostRandom(state) % (i + 1);
+        uint32_t swap = packets[i];
+
+        packets[i] = packets[j];
+        packets[j] = swap;
+    }
+
+    double legacySeconds = bestTime([](const uint32_t *in, int32_t *out, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = legacyValue(in[i]);
+        }
+    }, packets, values, repeats);
+    int64_t legacySum = sum(values);
+
+    double caliperSeconds = bestTime([](const uint32_t *in, int32_t *out, size_t count) {
+        ClockwiseCaliper caliper;
+
+        for (size_t i = 0; i < count; i++) {
+            caliper.updatePacket(in[i]);
+            caliper.refershData();
+            out[i] = caliper.getFixedMeasurement();
+        }
+    }, packets, values, repeats);
+    int64_t caliperSum = sum(values);
+
+    double bulkSeconds = bestTime(decodeCaliperPacketValues, packets, values, repeats);
+    int64_t bulkSum = sum(values);
+
+    printf("sums %s\n", (legacySum == caliperSum && caliperSum == bulkSum) ? "match" : "DIFFER");
+    printf("union:                      %8.1f M packets/s\n", PACKET_COUNT / legacySeconds / 1e6);
+    printf("ClockwiseCaliper:           %8.1f M packets/s\n", PACKET_COUNT / caliperSeconds / 1e6);
+    printf("decodeCaliperPacketValues:  %8.1f M packets/s\n", PACKET_COUNT / bulkSeconds / 1e6);
+
+    HostChecks checks;
+
+    checks.expect(wrong == 0, "%u packets decoded wrong", wrong);
+    checks.expect(legacySum == caliperSum && caliperSum == bulkSum, "the decoders' sums differ");
+
+    return checks.finish();
+}
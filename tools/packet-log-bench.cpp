@@ -0,0 +1,283 @@
+/*
+ * packet-log-bench.cpp - Packet Log Round Trip and Decode Throughput
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Writes a log of random packets from 4 calipers with PacketLogWriter,
+// including gaps long enough to need time records, then maps it with
+// PacketLogView and:
+//   - checks every entry read back against what was written, and the
+//     measurement of the first million against ClockwiseCaliper.
+//   - times decoding every entry with next() (times, channels, flags and
+//     signed measurements), and summing the measurements straight from
+//     getRecords().
+//
+// The log is read right after it is written, so it comes from the page
+// cache. Drop the caches (or use -k and run again after a reboot) to time
+// reading from disk.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o packet-log-bench
+//       packet-log-bench.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   ./packet-log-bench [-m megabytes] [-f path] [-s seed] [-k 1]
+//
+// -k 1 keeps the log instead of deleting it.
+
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+#include "PacketLog.h"
+
+
+const uint32_t PACKET_RANDOM_MASK = 0x9FFFFF; // Measurement, sign and unit bits, the unknown bits stay 0
+const uint8_t CHANNELS = 4;
+const uint32_t PACKET_INTERVAL = 150;          // Milliseconds between packets of each caliper
+const uint32_t LONG_GAP_EVERY = 100000;        // Packets between gaps that need a time record
+const uint32_t LONG_GAP = 100000;              // Milliseconds
+const uint32_t VERIFY_CALIPER_COUNT = 1000000; // Entries also checked against ClockwiseCaliper
+
+
+/**
+ * Generates the same entries for writing and for checking.
+ */
+class EntryGenerator {
+public:
+    EntryGenerator(uint32_t seed) {
+        this->state = seed;
+        this->time = 1000;
+        this->count = 0;
+        memset(this->sequence, 0, sizeof(this->sequence));
+        memset(this->resyncCount, 0, sizeof(this->resyncCount));
+    }
+
+    /**
+     * Returns the next entry.
+     *
+     * @return the entry
+     */
+    packet_log_entry_t next() {
+        packet_log_entry_t entry;
+        uint32_t random = this->random();
+        uint8_t channel = this->count % CHANNELS;
+
+        this->time += (this->count % LONG_GAP_EVERY == LONG_GAP_EVERY - 1) ? LONG_GAP : PACKET_INTERVAL / CHANNELS + (random & 3);
+        this->count++;
+
+        entry.time = this->time;
+        entry.channel = channel;
+        entry.flags = 0;
+        entry.packet = this->random() & PACKET_RANDOM_MASK;
+
+        // Now and then resync, lose a packet, or reject one
+        if ((random & 0xFF00) == 0) {
+            entry.flags |= PACKET_LOG_FLAG_RESYNC;
+            this->resyncCount[channel]++;
+        }
+
+        if ((random & 0xFF0000) == 0) {
+            entry.flags |= PACKET_LOG_FLAG_LOST;
+            this->sequence[channel]++;
+        }
+
+        if ((random & 0xF000000) == 0) {
+            entry.flags |= PACKET_LOG_FLAG_REJECTED;
+        }
+
+        entry.sequence = this->sequence[channel]++;
+        entry.resyncCount = this->resyncCount[channel];
+
+        return entry;
+    }
+
+private:
+    uint32_t state;
+    uint32_t time;
+    uint64_t count;
+    uint8_t sequence[CHANNELS];
+    uint8_t resyncCount[CHANNELS];
+
+    /**
+     * Returns the next random number.
+     *
+     * @return the next random number
+     */
+    uint32_t random() {
+        return hostRandom(this->state);
+    }
+};
+
+
+/**
+ * Returns the seconds since start.
+ *
+ * @param start time to measure from
+ * @return the seconds
+ */
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char **argv) {
+    uint64_t megabytes = 2048;
+    const char *path = "/tmp/packet-log-bench.cwpl";
+    uint32_t seed = 1;
+    bool keep = false;
+
+    if (!parseHostOptions(argc, argv, {{"-m", megabytes}, {"-f", path}, {"-s", seed}, {"-k", keep}})) {
+        return 1;
+    }
+
+    if (megabytes == 0 || seed == 0) {
+        fprintf(stderr, "Size and seed must not be 0\n");
+        return 1;
+    }
+
+    // Time records take a little of the size, so this ends up slightly over
+    uint64_t entryCount = megabytes * 1024 * 1024 / PACKET_LOG_RECORD_SIZE;
+
+    // Write
+    PacketLogWriter writer;
+    EntryGenerator writeGenerator(seed);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    if (!writer.open(path, 1000)) {
+        fprintf(stderr, "Could not create %s\n", path);
+        return 1;
+    }
+
+    for (uint64_t i = 0; i < entryCount; i++) {
+        if (!writer.write(writeGenerator.next())) {
+            fprintf(stderr, "Could not write %s\n", path);
+            return 1;
+        }
+    }
+
+    uint64_t recordCount = writer.getRecordCount();
+
+    if (!writer.close()) {
+        fprintf(stderr, "Could not write %s\n", path);
+        return 1;
+    }
+
+    double writeSeconds = secondsSince(startTime);
+    double fileMegabytes = (PACKET_LOG_HEADER_SIZE + recordCount * PACKET_LOG_RECORD_SIZE) / (1024.0 * 1024.0);
+
+    PacketLogView view;
+
+    if (!view.open(path)) {
+        fprintf(stderr, "Could not read %s: %s\n", path, view.getError());
+        return 1;
+    }
+
+    // Check
+    EntryGenerator checkGenerator(seed);
+    ClockwiseCaliper caliper;
+    packet_log_entry_t entry;
+    uint64_t checked = 0;
+    uint64_t mismatched = 0;
+
+    while (view.next(entry)) {
+        packet_log_entry_t expected = checkGenerator.next();
+
+        if (entry.time != expected.time
+            || entry.channel != expected.channel
+            || entry.flags != expected.flags
+            || entry.packet != expected.packet
+            || entry.sequence != expected.sequence
+            || entry.resyncCount != expected.resyncCount) {
+            mismatched++;
+        } else if (checked < VERIFY_CALIPER_COUNT) {
+            caliper.updatePacket(entry.packet);
+            caliper.refershData();
+
+            if (caliper.getFixedMeasurement() != caliperPacketValue(entry.packet)
+                || caliper.getUnit() != caliperPacketUnit(entry.packet)) {
+                mismatched++;
+            }
+        }
+
+        checked++;
+    }
+
+    // Decode with next()
+    int64_t sum = 0;
+    uint64_t counts[CHANNELS] = {0};
+    uint64_t flagged = 0;
+    uint32_t lastTime = 0;
+
+    view.rewind();
+    startTime = std::chrono::steady_clock::now();
+
+    while (view.next(entry)) {
+        sum += caliperPacketValue(entry.packet);
+        counts[entry.channel]++;
+        flagged += entry.flags != 0;
+        lastTime = entry.time;
+    }
+
+    double nextSeconds = secondsSince(startTime);
+
+    // Sum straight from the records
+    const packet_log_record_t *records = view.getRecords();
+    int64_t rawSum = 0;
+
+    startTime = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < recordCount; i++) {
+        int32_t isPacket = !(records[i].flags & PACKET_LOG_FLAG_TIME);
+
+        rawSum += caliperPacketValue(packetLogPacket(records[i])) * isPacket; // Branch free, time records add 0
+    }
+
+    double rawSeconds = secondsSince(startTime);
+
+    view.close();
+
+    if (!keep) {
+        remove(path);
+    }
+
+    printf("log: %.0f MB, %llu entries, %llu records, %llu entries/channel, %llu flagged, last time %u ms\n",
+           fileMegabytes,
+           (unsigned long long)entryCount,
+           (unsigned long long)recordCount,
+           (unsigned long long)counts[0],
+           (unsigned long long)flagged,
+           lastTime);
+    printf("checked: %llu, mismatched: %llu, sums %s\n",
+           (unsigned long long)checked,
+           (unsigned long long)mismatched,
+           sum == rawSum ? "match" : "DIFFER");
+    printf("write:     %6.2f s  %8.0f MB/s  %6.1f M entries/s\n", writeSeconds, fileMegabytes / writeSeconds, entryCount / writeSeconds / 1e6);
+    printf("next():    %6.2f s  %8.0f MB/s  %6.1f M entries/s\n", nextSeconds, fileMegabytes / nextSeconds, entryCount / nextSeconds / 1e6);
+    printf("records:   %6.2f s  %8.0f MB/s  %6.1f M entries/s\n", rawSeconds, fileMegabytes / rawSeconds, entryCount / rawSeconds / 1e6);
+
+    HostChecks checks;
+
+    checks.expect(checked == entryCount, "%llu of %llu entries read back",
+                  (unsigned long long)checked, (unsigned long long)entryCount);
+    checks.expect(mismatched == 0, "%llu entries read back different", (unsigned long long)mismatched);
+    checks.expect(sum == rawSum, "the record sum differs from next()");
+
+    return checks.finish();
+}
@@ -0,0 +1,270 @@
+/*
+ * publish-stress.cpp - Stress Test for Publishing Caliper Data Across Threads
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Publishes packets into a ClockwiseCaliper byte by byte with
+// updateByte() and setNewData(), as the capture interrupt would, and reads
+// them back with refershData(), like loop().
+//
+// By default it runs on one thread and simulates the interrupt: the
+// ClockwiseCaliper read hook publishes at random points between the byte
+// loads of refershData(), which is exactly where the interrupt can land on
+// the board. This forces the reader to retry however many cores the host
+// has. With -t a second thread publishes instead, which also exercises the
+// memory ordering, but needs more than one core to overlap reads often.
+//
+// Every packet has a 20-bit count in the measurement, and a 2-bit check
+// of it in the sign and unit bits, so most packets mixed from two
+// publishes are caught. The reader also checks the count is one that was
+// published between starting and finishing the read, so it is never older
+// than a packet published before refershData() was called. Reads that a
+// publish overlapped are counted, and the test fails if there were none,
+// since then it checked nothing.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -pthread -DCLOCKWISE_CALIPER_TEST_HOOKS -I../src/DataInterface -o publish-stress
+//       publish-stress.cpp ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   ./publish-stress [-n packets] [-t 1] [-s seed]
+
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+
+
+#if !defined(CLOCKWISE_CALIPER_TEST_HOOKS)
+    #error "Build with -DCLOCKWISE_CALIPER_TEST_HOOKS, for ClockwiseCaliper::readHook"
+#endif
+
+
+const uint32_t COUNT_MASK = 0xFFFFF; // Measurement bits
+const uint8_t PUBLISH_CHANCE = 64;   // Chance out of 256 the simulated interrupt publishes after each byte load
+
+
+/**
+ * Returns the 2-bit check of a count.
+ *
+ * @param count packet count
+ * @return the check bits
+ */
+static uint8_t countCheck(uint32_t count) {
+    return ((count & 0xFF) + (count >> 8 & 0xFF) * 3 + (count >> 16 & 0x0F) * 5) & 3;
+}
+
+/**
+ * Returns the packet for a count.
+ *
+ * @param count packet count
+ * @return the 24-bit packet
+ */
+static uint32_t countPacket(uint32_t count) {
+    uint8_t check = countCheck(count);
+
+    return (count & COUNT_MASK)
+         | ((uint32_t)(check & 1) << 20)  // Sign
+         | ((uint32_t)(check >> 1) << 23); // Unit
+}
+
+
+/**
+ * What the reader saw.
+ */
+typedef struct {
+    uint64_t reads;      // Packets read
+    uint64_t overlapped; // Reads a publish happened during
+    uint64_t torn;       // Reads mixing two packets
+    uint64_t stale;      // Reads older than the read
+} stress_result_t;
+
+/**
+ * Checks one packet read back, and counts it in result.
+ *
+ * @param caliper caliper just read with refershData()
+ * @param first count published before the read started
+ * @param last newest count that may have been read
+ * @param result counts to update
+ */
+static void checkRead(ClockwiseCaliper &caliper, uint32_t first, uint32_t last, stress_result_t &result) {
+    uint32_t count = caliper.getRawMeasurement();
+    uint8_t check = caliper.getSign() | (caliper.getUnit() << 1);
+
+    result.reads++;
+
+    if (check != countCheck(count)) {
+        result.torn++;
+    } else if (last - first <= COUNT_MASK && ((count - first) & COUNT_MASK) > last - first) {
+        result.stale++;
+    }
+}
+
+/**
+ * Publishes a count as the capture interrupt would.
+ *
+ * @param caliper caliper to publish into
+ * @param count packet count
+ */
+static void publishCount(ClockwiseCaliper &caliper, uint32_t count) {
+    uint32_t packet = countPacket(count);
+
+    caliper.updateByte(packet, 0);
+    caliper.updateByte(packet >> 8, 1);
+    caliper.updateByte(packet >> 16, 2);
+    caliper.setNewData();
+}
+
+
+static ClockwiseCaliper *hookCaliper; // Caliper the simulated interrupt publishes into
+static uint32_t hookPublished;        // Last count the simulated interrupt published
+static uint32_t hookLimit;            // Last count to publish
+static uint32_t hookRandom;           // Generator state of the simulated interrupt
+
+/**
+ * Read hook that stands in for the capture interrupt, publishing the next
+ * count at random points of refershData().
+ *
+ * @param index byte just loaded
+ */
+static void interruptHook(uint8_t index) {
+    (void)index;
+
+    if (hookPublished < hookLimit && (hostRandom(hookRandom) & 0xFF) < PUBLISH_CHANCE) {
+        publishCount(*hookCaliper, ++hookPublished);
+    }
+}
+
+/**
+ * Publishes and reads on one thread, publishing from the read hook.
+ *
+ * @param caliper caliper to test
+ * @param packetCount number of packets to publish
+ * @param seed generator seed
+ * @return the counts
+ */
+static stress_result_t runInterrupt(ClockwiseCaliper &caliper, uint32_t packetCount, uint32_t seed) {
+    stress_result_t result = {};
+
+    hookCaliper = &caliper;
+    hookPublished = 0;
+    hookLimit = packetCount;
+    hookRandom = seed != 0 ? seed : 1;
+    ClockwiseCaliper::readHook = interruptHook;
+
+    while (hookPublished < packetCount) {
+        // Sometimes publish outside the read as well, like a quiet loop()
+        if ((hostRandom(hookRandom) & 0xFF) < PUBLISH_CHANCE) {
+            publishCount(caliper, ++hookPublished);
+        }
+
+        if (!caliper.isNewData()) {
+            continue;
+        }
+
+        uint32_t first = hookPublished;
+        caliper.refershData();
+        uint32_t last = hookPublished; // The interrupt always finishes publishing
+
+        if (last != first) {
+            result.overlapped++;
+        }
+
+        checkRead(caliper, first, last, result);
+    }
+
+    ClockwiseCaliper::readHook = nullptr;
+
+    return result;
+}
+
+/**
+ * Publishes on one thread and reads on another.
+ *
+ * @param caliper caliper to test
+ * @param packetCount number of packets to publish
+ * @return the counts
+ */
+static stress_result_t runThreads(ClockwiseCaliper &caliper, uint32_t packetCount) {
+    stress_result_t result = {};
+    std::atomic<uint32_t> published(0);
+    std::atomic<bool> done(false);
+
+    std::thread reader([&]() {
+        while (!done.load(std::memory_order_relaxed)) {
+            if (!caliper.isNewData()) {
+                continue;
+            }
+
+            uint32_t first = published.load(std::memory_order_acquire);
+            caliper.refershData();
+            uint32_t after = published.load(std::memory_order_acquire);
+            uint32_t last = after + 1; // The next may be partly published
+
+            if (after != first) {
+                result.overlapped++;
+            }
+
+            checkRead(caliper, first, last, result);
+        }
+    });
+
+    for (uint32_t i = 1; i <= packetCount; i++) {
+        publishCount(caliper, i);
+        published.store(i, std::memory_order_release);
+    }
+
+    done.store(true, std::memory_order_relaxed);
+    reader.join();
+
+    return result;
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t packetCount = 50000000;
+    bool threads = false;
+    uint32_t seed = 1;
+
+    if (!parseHostOptions(argc, argv, {{"-n", packetCount}, {"-t", threads}, {"-s", seed}})) {
+        return 1;
+    }
+
+    ClockwiseCaliper caliper;
+
+    auto startTime = std::chrono::steady_clock::now();
+    stress_result_t result = threads ? runThreads(caliper, packetCount) : runInterrupt(caliper, packetCount, seed);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    printf("mode:              %s\n", threads ? "threads" : "simulated interrupt");
+    printf("packets published: %u\n", packetCount);
+    printf("packets read:      %llu\n", (unsigned long long)result.reads);
+    printf("overlapped reads:  %llu\n", (unsigned long long)result.overlapped);
+    printf("torn packets:      %llu\n", (unsigned long long)result.torn);
+    printf("stale packets:     %llu\n", (unsigned long long)result.stale);
+    printf("time:              %.3f s\n", seconds);
+
+    HostChecks checks;
+
+    checks.expect(result.overlapped > 0, "no read overlapped a publish");
+    checks.expect(result.torn == 0, "%llu torn packets", (unsigned long long)result.torn);
+    checks.expect(result.stale == 0, "%llu stale packets", (unsigned long long)result.stale);
+
+    return checks.finish();
+}
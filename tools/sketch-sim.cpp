@@ -0,0 +1,299 @@
+/*
+ * sketch-sim.cpp - Runs the Sketch on the Simulated Board
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Builds DataInterface.ino, unchanged, against the simulated board and
+// keyboard in mock/, the way the Arduino IDE does: Arduino.h and the
+// function prototypes first, then the sketch. The DIP switches and the
+// trigger are wired as the sketch expects, and the caliper packets from
+// CaliperSignalGenerator go to CLK_PIN and DATA_PIN, with loop() running
+// after every edge and every millisecond between packets. Every report
+// sent is replayed like a host would, and the typed text checked:
+//   - setup() beeps twice.
+//   - a trigger press types the reading once it has settled, with the
+//     newline switch on, and beeps.
+//   - a spike packet between the readings is rejected by the packet
+//     filter and never typed.
+//   - with the auto trigger switch on, closing the jaws onto a part types
+//     it once, holding it there types nothing more, and neither does
+//     closing the jaws.
+// Built with -DSTREAM_SERIAL it also checks every packet is streamed over
+// Serial.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -Imock -I../src/DataInterface -o sketch-sim
+//       sketch-sim.cpp CaliperSignal.cpp
+//       ../src/DataInterface/AutoTrigger.cpp
+//       ../src/DataInterface/ClockwiseCaliper.cpp
+//       ../src/DataInterface/KeySequence.cpp
+//       ../src/DataInterface/MeasurementTyping.cpp
+//       ../src/DataInterface/OutputScheduler.cpp
+//       ../src/DataInterface/PacketStream.cpp
+//
+// Usage:
+//   ./sketch-sim [-s seed]
+
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string>
+#include "CaliperSignal.h"
+#include "HostHarness.h"
+
+// Added by the Arduino IDE for the functions used before they are defined
+void streamPacket(uint8_t channel, uint32_t packet, uint32_t time, bool accepted);
+
+#include "DataInterface.ino"
+
+
+const uint32_t SIM_PACKET_INTERVAL = 150000; // Microseconds
+const uint32_t SIM_LOOP_INTERVAL = 1000;     // Microseconds between loop() runs while the lines are quiet
+
+const int32_t READING = 12345;     // Counts, for the trigger
+const int32_t SPIKE = 60000;       // Counts, far beyond FILTER_MAX_JUMP
+const int32_t JAWS_OPEN = 40000;   // Counts, opened for a part
+const int32_t PART = 25000;        // Counts, the part the jaws close onto
+
+
+/**
+ * The caliper and the host around the sketch.
+ */
+class SketchBench {
+public:
+    CaliperSignalGenerator generator;
+    uint32_t timeOffset;    // Microseconds, board time of the generator's time 0
+    uint32_t packets = 0;   // Packets sent
+    size_t replayed = 0;    // Reports already replayed
+    mock_keyboard_report_t previous = {};
+
+    SketchBench(uint32_t seed)
+        : generator({400, SIM_PACKET_INTERVAL, 0, 0, 20, 0, 0, 0}, seed),
+          timeOffset(mockBoard().time) {
+    }
+
+    /**
+     * Sends packets of a reading, running loop() throughout.
+     *
+     * @param value signed counts
+     * @param count packets to send
+     */
+    void send(int32_t value, uint32_t count) {
+        caliper_signal_edge_t edges[CALIPER_SIGNAL_MAX_EDGES];
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint8_t edgeCount = this->generator.generatePacket(encodeCaliperPacket(value, MILLIMETERS), edges);
+
+            for (uint8_t e = 0; e < edgeCount; e++) {
+                mockBoard().time = this->timeOffset + edges[e].time;
+                mockSetPin(DATA_PIN, edges[e].data);
+                mockSetPin(CLK_PIN, edges[e].clk);
+                loop();
+            }
+
+            while (mockBoard().time + SIM_LOOP_INTERVAL < this->timeOffset + this->generator.getTime()) {
+                mockBoard().time += SIM_LOOP_INTERVAL;
+                loop();
+            }
+
+            this->packets++;
+        }
+    }
+
+    /**
+     * Presses and releases the trigger, between two runs of loop().
+     */
+    void pressTrigger() {
+        mockSetPin(TRIGGER_PIN, LOW);
+        loop();
+        mockSetPin(TRIGGER_PIN, HIGH);
+    }
+
+    /**
+     * Replays the reports sent since the last call like a host would: a
+     * key is typed when it shows up in a report it wasn't in before.
+     *
+     * @return the text typed, CTRL+A as "^a"
+     */
+    std::string typed() {
+        std::vector<mock_keyboard_report_t> &reports = BootKeyboard.reports;
+        std::string text;
+
+        for (; this->replayed < reports.size(); this->replayed++) {
+            const mock_keyboard_report_t &report = reports[this->replayed];
+
+            for (uint8_t i = 0; i < report.keyCount; i++) {
+                bool held = false;
+
+                for (uint8_t j = 0; j < this->previous.keyCount; j++) {
+                    held = held || this->previous.keys[j] == report.keys[i];
+                }
+
+                if (!held) {
+                    text += report.modifiers != 0 ? "^" : "";
+                    text += keyToChar(report.keys[i]);
+                }
+            }
+
+            this->previous = report;
+        }
+
+        return text;
+    }
+
+private:
+    /**
+     * Returns the character a usage ID types.
+     *
+     * @param key usage ID
+     * @return the character, or '?' if it is not one addText() uses
+     */
+    static char keyToChar(uint8_t key) {
+        if (key >= KEY_USAGE_A && key < KEY_USAGE_A + 26) {
+            return 'a' + (key - KEY_USAGE_A);
+        }
+
+        if (key >= KEY_USAGE_1 && key < KEY_USAGE_1 + 9) {
+            return '1' + (key - KEY_USAGE_1);
+        }
+
+        switch (key) {
+            case KEY_USAGE_0:      return '0';
+            case KEY_USAGE_ENTER:  return '\n';
+            case KEY_USAGE_TAB:    return '\t';
+            case KEY_USAGE_SPACE:  return ' ';
+            case KEY_USAGE_MINUS:  return '-';
+            case KEY_USAGE_COMMA:  return ',';
+            case KEY_USAGE_PERIOD: return '.';
+            default:               return '?';
+        }
+    }
+};
+
+
+/**
+ * Returns the text the sketch should type for a reading in millimeters,
+ * with only the newline switch on.
+ *
+ * @param value signed counts
+ * @return the text
+ */
+static std::string expectedText(int32_t value) {
+    ClockwiseCaliper reading;
+    char text[MEASUREMENT_STR_SIZE];
+
+    reading.updatePacket(encodeCaliperPacket(value, MILLIMETERS));
+    reading.refershData();
+    reading.formatMeasurement(text);
+
+    return std::string(text) + "\n";
+}
+
+/**
+ * Returns text with its newlines written as \n, for printing.
+ *
+ * @param text text to print
+ * @return the escaped text
+ */
+static std::string escaped(const std::string &text) {
+    std::string result;
+
+    for (char c : text) {
+        result += c == '\n' ? std::string("\\n") : std::string(1, c);
+    }
+
+    return result;
+}
+
+/**
+ * Prints and checks the text typed during a step.
+ *
+ * @param checks where failures are counted
+ * @param name the step
+ * @param typed text typed
+ * @param expected text that should have been typed
+ */
+static void checkTyped(HostChecks &checks, const char *name, const std::string &typed, const std::string &expected) {
+    printf("%-26s typed \"%s\"\n", name, escaped(typed).c_str());
+
+    checks.expect(typed == expected, "%s: typed \"%s\", expected \"%s\"", name,
+                  escaped(typed).c_str(), escaped(expected).c_str());
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t seed = 1;
+
+    if (!parseHostOptions(argc, argv, {{"-s", seed}})) {
+        return 1;
+    }
+
+    if (seed == 0) {
+        fprintf(stderr, "Seed must not be 0\n");
+        return 1;
+    }
+
+    HostChecks checks;
+
+    // Every switch off but the newline, the trigger released, the caliper lines idle
+    for (uint8_t pin : {DIP_CTRL_A_PIN, DIP_UNITS_PIN, DIP_TAB_PIN, DIP_COMMA_PIN, DIP_SPACE_PIN,
+                        DIP_AUTO_TRIGGER_PIN, TRIGGER_PIN}) {
+        mockSetPin(pin, !DIP_ON_STATE);
+    }
+
+    mockSetPin(DIP_NEWLINE_PIN, DIP_ON_STATE);
+    mockSetPin(CLK_PIN, LOW);
+
+    setup();
+
+    SketchBench bench(seed);
+
+    printf("setup: %u tones\n", mockBoard().tones);
+    checks.expect(BootKeyboard.begun && mockBoard().tones == 2, "setup(): keyboard not started, or %u tones", mockBoard().tones);
+
+    // Settled long past STABLE_TIME, then the trigger
+    bench.send(READING, 10);
+    bench.pressTrigger();
+    bench.send(READING, 10);
+    checkTyped(checks, "trigger", bench.typed(), expectedText(READING));
+    checks.expect(mockBoard().tones == 3, "trigger: %u tones in total", mockBoard().tones);
+
+    // A spike right before the trigger
+    bench.send(SPIKE, 1);
+    bench.pressTrigger();
+    bench.send(READING, 10);
+    checkTyped(checks, "trigger after a spike", bench.typed(), expectedText(READING));
+
+    // Opened, closed onto a part, held, then closed
+    mockSetPin(DIP_AUTO_TRIGGER_PIN, DIP_ON_STATE);
+    bench.send(JAWS_OPEN, 5);
+    bench.send(PART, 20);
+    checkTyped(checks, "auto trigger on a part", bench.typed(), expectedText(PART));
+    bench.send(PART, 20);
+    checkTyped(checks, "auto trigger, part held", bench.typed(), "");
+    bench.send(0, 20);
+    checkTyped(checks, "auto trigger, jaws closed", bench.typed(), "");
+
+    #ifdef STREAM_SERIAL
+        uint32_t streamed = Serial.output.size() / PACKET_STREAM_FRAME_SIZE;
+
+        printf("streamed: %u frames of %u packets\n", streamed, bench.packets);
+        checks.expect(streamed == bench.packets && Serial.output.size() % PACKET_STREAM_FRAME_SIZE == 0,
+                      "%u frames streamed for %u packets", streamed, bench.packets);
+    #endif
+
+    return checks.finish();
+}
@@ -0,0 +1,395 @@
+/*
+ * softspi-equivalence.cpp - StaticSoftSPISlave Against SoftSPISlave
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Builds SoftSPISlave and StaticSoftSPISlave, unchanged, against the
+// simulated board in mock/, wires both to the same lines, and checks they
+// decode the same bits to the same bytes (StaticSoftSPISlave with 8-bit
+// frames and the noise filters off, as its clkIsr() promises).
+//
+// For each of the 4 SPI modes and both bit orders, in single edge mode
+// (RX only, only the sampling edge interrupts) and in both edge mode (MISO
+// used, SS held active):
+//   - clean: random bytes clocked in whole. Both must receive exactly the
+//     bytes sent, and with MISO, put the same bits on MISO at every
+//     sampling edge.
+//   - noisy: random bits with glitch pulses on the clock and clock gaps
+//     longer than maxClkTime, so bytes are broken and resynced. Both must
+//     receive the same bytes, and count the same resyncs.
+// Then a caliper waveform from CaliperSignalGenerator (MODE1, LSB first),
+// with jitter, glitches, missing clock pulses and data glitches, is
+// replayed to both in single edge mode, as the sketch captures it.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -Imock -I../src/DataInterface -o softspi-equivalence
+//       softspi-equivalence.cpp CaliperSignal.cpp
+//       ../src/DataInterface/SoftSPISlave.cpp
+//
+// Usage:
+//   ./softspi-equivalence [-n bytes] [-p packets] [-s seed]
+
+
+#include <stdio.h>
+#include <vector>
+#include "CaliperSignal.h"
+#include "HostHarness.h"
+#include "SoftSPISlave.h"
+#include "StaticSoftSPISlave.h"
+
+
+const int16_t CLK_PIN = 0;
+const int16_t MISO_PIN = 1;
+const int16_t MOSI_PIN = 2;
+const int16_t SS_PIN = 3;
+const int16_t STATIC_PIN_OFFSET = 4; // StaticSoftSPISlave is on the same pins plus this
+
+const uint32_t HALF_PERIOD = 200;    // Microseconds between clock edges
+const uint32_t GLITCH_WIDTH = 2;     // Microseconds, clock glitch pulses
+const uint32_t MAX_CLK_TIME = 10;    // Milliseconds, same as the sketch's BIT_MAX_DELAY
+const uint32_t GAP_TIME = 25000;     // Microseconds, longer than MAX_CLK_TIME
+const uint16_t GLITCH_RATE = 1311;   // Out of 65536 per bit, 2%
+const uint16_t GAP_RATE = 1311;      // Out of 65536 per bit, 2%
+
+
+/**
+ * Sets a line of both slaves, running their interrupts.
+ *
+ * @param pin pin of SoftSPISlave
+ * @param state new level
+ */
+static void setLine(int16_t pin, bool state) {
+    mockSetPin(pin, state);
+    mockSetPin(pin + STATIC_PIN_OFFSET, state);
+}
+
+/**
+ * Moves the simulated time forward.
+ *
+ * @param time microseconds
+ */
+static void wait(uint32_t time) {
+    mockBoard().time += time;
+}
+
+
+/**
+ * Both slaves on the same lines, one configuration.
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso>
+class SlavePair {
+public:
+    SlavePair()
+        : runtimeSlave(CLK_PIN, HasMiso ? MISO_PIN : -1, MOSI_PIN, HasMiso ? SS_PIN : -1),
+          staticSlave(CLK_PIN + STATIC_PIN_OFFSET, MISO_PIN + STATIC_PIN_OFFSET,
+                      MOSI_PIN + STATIC_PIN_OFFSET, SS_PIN + STATIC_PIN_OFFSET) {}
+
+    /**
+     * Idles the lines, starts both slaves, and selects them when SS is used.
+     */
+    void begin() {
+        setLine(CLK_PIN, CPOL);
+        setLine(MOSI_PIN, LOW);
+        setLine(SS_PIN, HIGH);
+        mockClearInterruptFlags(); // Left over from the previous configuration
+
+        this->runtimeSlave.begin(false, Mode, Order, MAX_CLK_TIME);
+        this->staticSlave.begin(false, MAX_CLK_TIME, 8);
+
+        if (HasMiso) {
+            setLine(SS_PIN, LOW);
+        }
+    }
+
+    /**
+     * Stops both slaves.
+     */
+    void end() {
+        this->runtimeSlave.end();
+        this->staticSlave.end();
+    }
+
+    /**
+     * Adds a byte to send to the transmit buffer of both.
+     *
+     * @param data byte to send
+     */
+    void write(uint8_t data) {
+        this->runtimeSlave.write(data);
+        this->staticSlave.write(data);
+    }
+
+    /**
+     * Returns true if the transmit buffers have room.
+     *
+     * @return true if another byte can be written
+     */
+    bool canWrite() {
+        return !this->runtimeSlave.txIsFull() && !this->staticSlave.txIsFull();
+    }
+
+    /**
+     * Clocks in one bit the way a master in Mode does, and records the MISO
+     * level of both at the sampling edge.
+     *
+     * @param bit bit to send on MOSI
+     */
+    void sendBit(bool bit) {
+        if (!CPHA) {
+            setLine(MOSI_PIN, bit);
+            wait(HALF_PERIOD);
+            setLine(CLK_PIN, !CPOL); // Sampling edge
+            this->recordMiso();
+            wait(HALF_PERIOD);
+            setLine(CLK_PIN, CPOL);
+
+        } else {
+            setLine(CLK_PIN, !CPOL);
+            setLine(MOSI_PIN, bit);
+            wait(HALF_PERIOD);
+            setLine(CLK_PIN, CPOL); // Sampling edge
+            this->recordMiso();
+            wait(HALF_PERIOD);
+        }
+
+        this->drain();
+    }
+
+    /**
+     * Adds a short pulse on the clock, from its idle level.
+     */
+    void glitch() {
+        setLine(CLK_PIN, !CPOL);
+        wait(GLITCH_WIDTH);
+        setLine(CLK_PIN, CPOL);
+        wait(GLITCH_WIDTH);
+        this->drain();
+    }
+
+    /**
+     * Reads everything both slaves have received.
+     */
+    void drain() {
+        while (this->runtimeSlave.rxHasData()) {
+            this->runtimeBytes.push_back(this->runtimeSlave.read());
+        }
+
+        while (this->staticSlave.rxHasData()) {
+            this->staticBytes.push_back(this->staticSlave.read());
+        }
+    }
+
+    /**
+     * Checks both received the same, and what was expected.
+     *
+     * @param checks where failures are counted
+     * @param name configuration and run
+     * @param expected bytes sent whole, nullptr if they were broken up
+     */
+    void check(HostChecks &checks, const char *name, const std::vector<uint8_t> *expected) {
+        size_t firstDifference = 0;
+
+        while (firstDifference < this->runtimeBytes.size() && firstDifference < this->staticBytes.size()
+                && this->runtimeBytes[firstDifference] == this->staticBytes[firstDifference]) {
+            firstDifference++;
+        }
+
+        checks.expect(this->runtimeBytes.size() == this->staticBytes.size(),
+                      "%s: SoftSPISlave received %zu bytes, StaticSoftSPISlave %zu",
+                      name, this->runtimeBytes.size(), this->staticBytes.size());
+        checks.expect(firstDifference == this->runtimeBytes.size() || firstDifference == this->staticBytes.size(),
+                      "%s: first different byte is %zu", name, firstDifference);
+        checks.expect(this->runtimeSlave.getResyncCount() == this->staticSlave.getResyncCount(),
+                      "%s: SoftSPISlave resynced %u times, StaticSoftSPISlave %u", name,
+                      this->runtimeSlave.getResyncCount(), this->staticSlave.getResyncCount());
+        checks.expect(this->runtimeMiso == this->staticMiso, "%s: MISO bits differ", name);
+
+        if (expected != nullptr) {
+            checks.expect(this->runtimeBytes == *expected, "%s: SoftSPISlave did not receive the bytes sent", name);
+            checks.expect(this->staticBytes == *expected, "%s: StaticSoftSPISlave did not receive the bytes sent", name);
+        }
+
+        printf("%-24s bytes %6zu, resyncs %3u, MISO bits %6zu\n", name, this->runtimeBytes.size(),
+               this->runtimeSlave.getResyncCount(), this->runtimeMiso.size());
+    }
+
+private:
+    static constexpr bool CPHA = (Mode & 0b01) != 0;
+    static constexpr bool CPOL = (Mode & 0b10) != 0;
+
+    SoftSPISlave runtimeSlave;
+    StaticSoftSPISlave<Mode, Order, HasMiso, true, HasMiso> staticSlave;
+
+    std::vector<uint8_t> runtimeBytes;
+    std::vector<uint8_t> staticBytes;
+    std::vector<bool> runtimeMiso;
+    std::vector<bool> staticMiso;
+
+    void recordMiso() {
+        if (HasMiso) {
+            this->runtimeMiso.push_back(digitalRead(MISO_PIN));
+            this->staticMiso.push_back(digitalRead(MISO_PIN + STATIC_PIN_OFFSET));
+        }
+    }
+};
+
+
+/**
+ * Runs the clean and noisy runs of one configuration.
+ *
+ * @param checks where failures are counted
+ * @param byteCount bytes per run
+ * @param seed random seed, not 0
+ */
+template <softspi_mode_t Mode, softspi_data_order_t Order, bool HasMiso>
+static void runConfig(HostChecks &checks, uint32_t byteCount, uint32_t seed) {
+    char name[32];
+    uint32_t state = seed;
+
+    snprintf(name, sizeof(name), "MODE%u %s %s", Mode, Order == SSPI_MSB_FIRST ? "MSB" : "LSB",
+             HasMiso ? "both edges" : "single edge");
+
+    // Clean
+    {
+        SlavePair<Mode, Order, HasMiso> pair;
+        std::vector<uint8_t> sent;
+
+        pair.begin();
+
+        for (uint32_t i = 0; i < byteCount; i++) {
+            uint8_t data = hostRandom(state);
+
+            while (pair.canWrite()) {
+                pair.write(hostRandom(state));
+            }
+
+            for (uint8_t b = 0; b < 8; b++) {
+                pair.sendBit((data >> (Order == SSPI_MSB_FIRST ? 7 - b : b)) & 1);
+            }
+
+            sent.push_back(data);
+        }
+
+        pair.end();
+
+        char runName[48];
+
+        snprintf(runName, sizeof(runName), "%s clean", name);
+        pair.check(checks, runName, &sent);
+    }
+
+    // Noisy
+    {
+        SlavePair<Mode, Order, HasMiso> pair;
+
+        pair.begin();
+
+        for (uint32_t i = 0; i < byteCount * 8; i++) {
+            uint32_t random = hostRandom(state);
+
+            if ((random & 0xFFFF) < GAP_RATE) {
+                wait(GAP_TIME);
+            }
+
+            if ((random >> 16) < GLITCH_RATE) {
+                pair.glitch();
+            }
+
+            pair.sendBit(hostRandom(state) & 1);
+        }
+
+        pair.end();
+
+        char runName[48];
+
+        snprintf(runName, sizeof(runName), "%s noisy", name);
+        pair.check(checks, runName, nullptr);
+    }
+}
+
+/**
+ * Runs every configuration of one SPI mode.
+ *
+ * @param checks where failures are counted
+ * @param byteCount bytes per run
+ * @param seed random seed, not 0
+ */
+template <softspi_mode_t Mode>
+static void runMode(HostChecks &checks, uint32_t byteCount, uint32_t seed) {
+    runConfig<Mode, SSPI_MSB_FIRST, false>(checks, byteCount, seed);
+    runConfig<Mode, SSPI_LSB_FIRST, false>(checks, byteCount, seed);
+    runConfig<Mode, SSPI_MSB_FIRST, true>(checks, byteCount, seed);
+    runConfig<Mode, SSPI_LSB_FIRST, true>(checks, byteCount, seed);
+}
+
+/**
+ * Replays caliper waveforms to both slaves, as the sketch captures them.
+ *
+ * @param checks where failures are counted
+ * @param packetCount packets to replay
+ * @param seed random seed, not 0
+ */
+static void runCaliper(HostChecks &checks, uint32_t packetCount, uint32_t seed) {
+    caliper_signal_config_t config = {400, 150000, 40, 655, 20, 655, 655, 10};
+    CaliperSignalGenerator generator(config, seed);
+    caliper_signal_edge_t edges[CALIPER_SIGNAL_MAX_EDGES];
+    SlavePair<SSPI_MODE1, SSPI_LSB_FIRST, false> pair;
+    uint32_t startTime = mockBoard().time;
+
+    pair.begin();
+
+    for (uint32_t i = 0; i < packetCount; i++) {
+        uint8_t edgeCount = generator.generatePacket(generator.random() & 0xFFFFFF, edges);
+
+        for (uint8_t e = 0; e < edgeCount; e++) {
+            mockBoard().time = startTime + edges[e].time;
+
+            setLine(MOSI_PIN, edges[e].data);
+            setLine(CLK_PIN, edges[e].clk);
+        }
+
+        pair.drain();
+    }
+
+    pair.end();
+    pair.check(checks, "caliper waveform", nullptr);
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t byteCount = 2000;
+    uint32_t packetCount = 2000;
+    uint32_t seed = 1;
+
+    if (!parseHostOptions(argc, argv, {{"-n", byteCount}, {"-p", packetCount}, {"-s", seed}})) {
+        return 1;
+    }
+
+    if (seed == 0) {
+        fprintf(stderr, "Seed must not be 0\n");
+        return 1;
+    }
+
+    HostChecks checks;
+
+    runMode<SSPI_MODE0>(checks, byteCount, seed);
+    runMode<SSPI_MODE1>(checks, byteCount, seed);
+    runMode<SSPI_MODE2>(checks, byteCount, seed);
+    runMode<SSPI_MODE3>(checks, byteCount, seed);
+    runCaliper(checks, packetCount, seed);
+
+    return checks.finish();
+}
@@ -0,0 +1,313 @@
+/*
+ * stream-reader.cpp - Decodes the STREAM_SERIAL Packet Stream to CSV
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reads the frames the sketch sends with STREAM_SERIAL, see PacketStream.h,
+// and prints one CSV row per packet. Frames missing from the stream are
+// found from the sequence numbers and counted in the dropped column.
+// With -b the packets are written to a binary packet log instead, see
+// PacketLog.h.
+//
+// With -t it instead checks the reader: random frames are encoded, random
+// bytes are corrupted, and every intact frame must be read back exactly
+// with no corrupted frame read.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o stream-reader
+//       stream-reader.cpp ../src/DataInterface/PacketStream.cpp
+//       ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   stty -F /dev/ttyACM0 raw && ./stream-reader < /dev/ttyACM0 > log.csv
+//   ./stream-reader capture.bin > log.csv
+//   ./stream-reader -b log.cwpl < /dev/ttyACM0
+//   ./stream-reader -t frames [-e errorRate] [-s seed]
+//
+// errorRate is the chance out of 65536 of each byte being corrupted.
+
+
+#include <stdio.h>
+#include <vector>
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+#include "PacketLog.h"
+#include "PacketStream.h"
+
+
+const uint8_t CHANNELS = PACKET_STREAM_CHANNEL_MASK + 1;
+
+
+/**
+ * Returns true if two records have the same contents.
+ *
+ * @param a first record
+ * @param b second record
+ * @return true if every field matches
+ */
+static bool sameRecord(const packet_stream_record_t &a, const packet_stream_record_t &b) {
+    return a.channel == b.channel
+        && a.flags == b.flags
+        && a.packet == b.packet
+        && a.time == b.time
+        && a.sequence == b.sequence
+        && a.resyncCount == b.resyncCount;
+}
+
+
+/**
+ * Prints a record as a CSV row.
+ *
+ * @param record frame read from the stream
+ * @param dropped frames of the channel missing before this one
+ */
+static void printRecord(const packet_stream_record_t &record, uint8_t dropped) {
+    ClockwiseCaliper caliper;
+    char measurementStr[MEASUREMENT_STR_SIZE];
+
+    caliper.updatePacket(record.packet);
+    caliper.refershData();
+    caliper.formatMeasurement(measurementStr);
+
+    printf("%u,%u,%u,0x%06X,%s,%s,%u,%u,%u,%u\n",
+           record.time,
+           record.channel,
+           record.sequence,
+           record.packet,
+           measurementStr,
+           caliper.getUnitString(),
+           (record.flags & PACKET_STREAM_FLAG_REJECTED) ? 1 : 0,
+           (record.flags & PACKET_STREAM_FLAG_LOST) ? 1 : 0,
+           record.resyncCount,
+           dropped);
+}
+
+/**
+ * Writes a record to a packet log.
+ *
+ * @param log open log
+ * @param record frame read from the stream
+ * @param resynced true if the resync count changed since the channel's previous frame
+ * @return false if the log could not be written
+ */
+static bool logRecord(PacketLogWriter &log, const packet_stream_record_t &record, bool resynced) {
+    packet_log_entry_t entry;
+
+    entry.time = record.time;
+    entry.channel = record.channel;
+    entry.flags = ((record.flags & PACKET_STREAM_FLAG_REJECTED) ? PACKET_LOG_FLAG_REJECTED : 0)
+                | ((record.flags & PACKET_STREAM_FLAG_LOST) ? PACKET_LOG_FLAG_LOST : 0)
+                | (resynced ? PACKET_LOG_FLAG_RESYNC : 0);
+    entry.packet = record.packet;
+    entry.sequence = record.sequence;
+    entry.resyncCount = record.resyncCount;
+
+    return log.write(entry);
+}
+
+/**
+ * Reads a stream and prints it as CSV, or writes it to a packet log.
+ *
+ * @param file stream to read
+ * @param log open log to write, or nullptr to print CSV
+ * @return 0, or 1 if the log could not be written
+ */
+static int readStream(FILE *file, PacketLogWriter *log) {
+    PacketStream stream;
+    uint8_t buffer[4096];
+    bool hasSequence[CHANNELS] = {false};
+    uint8_t nextSequence[CHANNELS] = {0};
+    uint8_t lastResyncCount[CHANNELS] = {0};
+    uint32_t frames = 0;
+    uint32_t dropped = 0;
+    size_t length;
+
+    if (log == nullptr) {
+        printf("time_ms,channel,sequence,packet,measurement,unit,rejected,lost,resyncs,dropped\n");
+    }
+
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        for (size_t i = 0; i < length; i++) {
+            if (!stream.push(buffer[i])) {
+                continue;
+            }
+
+            packet_stream_record_t record = stream.getRecord();
+            uint8_t gap = hasSequence[record.channel] ? (uint8_t)(record.sequence - nextSequence[record.channel]) : 0;
+            bool resynced = hasSequence[record.channel] && record.resyncCount != lastResyncCount[record.channel];
+
+            hasSequence[record.channel] = true;
+            nextSequence[record.channel] = record.sequence + 1;
+            lastResyncCount[record.channel] = record.resyncCount;
+            frames++;
+            dropped += gap;
+
+            if (log == nullptr) {
+                printRecord(record, gap);
+            } else if (!logRecord(*log, record, resynced)) {
+                fprintf(stderr, "Could not write the log\n");
+                return 1;
+            }
+        }
+
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "frames: %u, dropped: %u, bytes skipped: %u\n", frames, dropped, stream.getSkippedCount());
+
+    return 0;
+}
+
+
+/**
+ * Encodes random frames, corrupts random bytes, and checks what is read
+ * back.
+ *
+ * @param count number of frames
+ * @param errorRate chance out of 65536 of each byte being corrupted
+ * @param seed random seed, not 0
+ * @return 0 if every intact frame was read back and nothing else was
+ */
+static int selfTest(uint32_t count, uint16_t errorRate, uint32_t seed) {
+    PacketStream stream;
+    std::vector<packet_stream_record_t> intact;
+    uint32_t state = seed;
+    uint32_t time = 0;
+    uint32_t corruptedFrames = 0;
+    uint32_t matched = 0; // Intact frames checked, read back or missed
+    uint32_t readBack = 0;
+    uint32_t missed = 0;
+    uint32_t wrong = 0;
+    uint8_t sequence[CHANNELS] = {0};
+
+    for (uint32_t i = 0; i < count; i++) {
+        packet_stream_record_t record;
+        uint8_t frame[PACKET_STREAM_FRAME_SIZE];
+        bool corrupted = false;
+
+        time += 140 + hostRandom(state) % 21;
+
+        record.channel = hostRandom(state) % CHANNELS;
+        record.flags = hostRandom(state) & (PACKET_STREAM_FLAG_REJECTED | PACKET_STREAM_FLAG_LOST);
+        record.packet = hostRandom(state) & 0xFFFFFF;
+        record.time = time;
+        record.sequence = sequence[record.channel]++;
+        record.resyncCount = hostRandom(state);
+
+        PacketStream::encode(record, frame);
+
+        for (uint8_t b = 0; b < PACKET_STREAM_FRAME_SIZE; b++) {
+            if ((hostRandom(state) & 0xFFFF) < errorRate) {
+                frame[b] ^= 1 << (hostRandom(state) % 8);
+                corrupted = true;
+            }
+        }
+
+        if (corrupted) {
+            corruptedFrames++;
+        } else {
+            intact.push_back(record);
+        }
+
+        for (uint8_t b = 0; b < PACKET_STREAM_FRAME_SIZE; b++) {
+            if (!stream.push(frame[b])) {
+                continue;
+            }
+
+            packet_stream_record_t read = stream.getRecord();
+
+            // Frames are read in order, intact frames skipped over were missed
+            uint32_t next = matched;
+
+            while (next < intact.size() && !sameRecord(read, intact[next])) {
+                next++;
+            }
+
+            if (next < intact.size()) {
+                missed += next - matched;
+                matched = next + 1;
+                readBack++;
+            } else {
+                wrong++;
+            }
+        }
+    }
+
+    missed += intact.size() - matched;
+
+    printf("frames: %u, corrupted: %u, intact read back: %u, intact missed: %u, wrong: %u, bytes skipped: %u\n",
+           count, corruptedFrames, readBack, missed, wrong, stream.getSkippedCount());
+
+    HostChecks checks;
+
+    checks.expect(missed == 0, "%u intact frames missed", missed);
+    checks.expect(wrong == 0, "%u frames read back wrong", wrong);
+
+    return checks.finish();
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t testCount = 0;
+    uint16_t errorRate = 100;
+    uint32_t seed = 1;
+    const char *path = nullptr;
+    const char *logPath = nullptr;
+
+    if (!parseHostOptions(argc, argv, {{"-t", testCount}, {"-e", errorRate}, {"-s", seed}, {"-b", logPath}}, &path)) {
+        return 1;
+    }
+
+    if (testCount > 0) {
+        if (seed == 0) {
+            fprintf(stderr, "Seed must not be 0\n");
+            return 1;
+        }
+
+        return selfTest(testCount, errorRate, seed);
+    }
+
+    FILE *file = stdin;
+
+    if (path != nullptr) {
+        file = fopen(path, "rb");
+
+        if (file == nullptr) {
+            fprintf(stderr, "Could not open %s\n", path);
+            return 1;
+        }
+    }
+
+    PacketLogWriter log;
+
+    if (logPath != nullptr && !log.open(logPath, 0)) {
+        fprintf(stderr, "Could not create %s\n", logPath);
+        return 1;
+    }
+
+    int result = readStream(file, logPath != nullptr ? &log : nullptr);
+
+    if (file != stdin) {
+        fclose(file);
+    }
+
+    if (!log.close()) {
+        fprintf(stderr, "Could not write %s\n", logPath);
+        result = 1;
+    }
+
+    return result;
+}
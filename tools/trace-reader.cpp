@@ -0,0 +1,390 @@
+/*
+ * trace-reader.cpp - Decodes the DEBUG_TRACE Event Stream to Text
+ * Copyright (C) 2025  Diesel Thomas
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reads the frames the sketch sends with DEBUG_TRACE, see TraceRing.h, and
+// prints one line per event: the time, the time since the previous event,
+// the event, and its details. Packets are decoded to the measurement and
+// unit the same way the sketch does.
+//
+// With -t it instead checks the trace: random events are recorded into a
+// TraceRing, drained now and then into a serial port with random room,
+// and random bytes are corrupted on the way. Every
+// intact frame must be read back exactly, with no corrupted frame read,
+// and every recorded event must be either read back or counted as
+// dropped.
+//
+// Build (from this directory):
+//   g++ -std=c++11 -O2 -I../src/DataInterface -o trace-reader
+//       trace-reader.cpp ../src/DataInterface/TraceRing.cpp
+//       ../src/DataInterface/PacketStream.cpp
+//       ../src/DataInterface/ClockwiseCaliper.cpp
+//
+// Usage:
+//   stty -F /dev/ttyACM0 raw && ./trace-reader < /dev/ttyACM0
+//   ./trace-reader capture.bin
+//   ./trace-reader -t events [-e errorRate] [-s seed]
+//
+// errorRate is the chance out of 65536 of each byte being corrupted.
+
+
+#include <stdio.h>
+#include <vector>
+#include "ClockwiseCaliper.h"
+#include "HostHarness.h"
+#include "TraceRing.h"
+
+
+/**
+ * Returns true if two events have the same contents.
+ *
+ * @param a first event
+ * @param b second event
+ * @return true if every field matches
+ */
+static bool sameEvent(const trace_event_t &a, const trace_event_t &b) {
+    return a.time == b.time
+        && a.data == b.data
+        && a.type == b.type
+        && a.channel == b.channel;
+}
+
+
+/**
+ * Prints the details of an event.
+ *
+ * @param event event read from the stream
+ */
+static void printDetails(const trace_event_t &event) {
+    switch (event.type) {
+        case TRACE_EVENT_PACKET: {
+            ClockwiseCaliper caliper;
+            char measurementStr[MEASUREMENT_STR_SIZE];
+
+            caliper.updatePacket(event.data & 0xFFFFFF);
+            caliper.refershData();
+            caliper.formatMeasurement(measurementStr);
+
+            printf("caliper %u, packet 0x%06X, %s %s%s",
+                   event.channel, event.data & 0xFFFFFF, measurementStr, caliper.getUnitString(),
+                   (event.data & TRACE_PACKET_REJECTED) ? ", rejected" : "");
+            break;
+        }
+
+        case TRACE_EVENT_RESYNC:
+            printf("%s", event.data < PERF_RESYNC_REASONS ? PERF_RESYNC_NAMES[event.data] : "unknown reason");
+            break;
+
+        case TRACE_EVENT_TRIGGER:
+            printf("%s, %u waiting", event.channel == TRACE_TRIGGER_AUTO ? "auto" : "button", event.data);
+            break;
+
+        case TRACE_EVENT_TYPING:
+            printf("%u queued behind", event.data);
+            break;
+
+        case TRACE_EVENT_TYPED:
+            printf("%u reports%s", event.data & 0xFFFF, (event.data & TRACE_TYPED_STALLED) ? ", host stalled" : "");
+            break;
+
+        case TRACE_EVENT_AWAKE:
+            printf("%.1f%% awake, %u wakes", (event.data & 0xFFFF) / 10.0, event.data >> 16);
+            break;
+
+        case TRACE_EVENT_SETTLE:
+            printf("stable %u ms", event.data);
+            break;
+
+        case TRACE_EVENT_BIT_TIMING:
+            printf("bit %u us, longest %u us", event.data & 0xFFFF, event.data >> 16);
+            break;
+
+        case TRACE_EVENT_DROPPED:
+            printf("%u events", event.data);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Prints an event as one line.
+ *
+ * @param event event read from the stream
+ * @param delta microseconds since the previous event
+ */
+static void printEvent(const trace_event_t &event, uint32_t delta) {
+    printf("%10u us %+9d us  %-10s ",
+           event.time, (int32_t)delta,
+           event.type < TRACE_EVENT_TYPES ? TRACE_EVENT_NAMES[event.type] : "unknown");
+    printDetails(event);
+    printf("\n");
+}
+
+/**
+ * Reads a stream and prints it as text.
+ *
+ * @param file stream to read
+ * @return 0
+ */
+static int readStream(FILE *file) {
+    TraceStream stream;
+    uint8_t buffer[4096];
+    uint32_t lastTime = 0;
+    bool hasTime = false;
+    uint32_t events = 0;
+    uint32_t dropped = 0;
+    size_t length;
+
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        for (size_t i = 0; i < length; i++) {
+            if (!stream.push(buffer[i])) {
+                continue;
+            }
+
+            trace_event_t event = stream.getEvent();
+
+            printEvent(event, hasTime ? event.time - lastTime : 0);
+
+            hasTime = true;
+            lastTime = event.time;
+            events++;
+
+            if (event.type == TRACE_EVENT_DROPPED) {
+                dropped += event.data;
+            }
+        }
+
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "events: %u, dropped: %u, bytes skipped: %u\n", events, dropped, stream.getSkippedCount());
+
+    return 0;
+}
+
+
+/**
+ * Serial port stand in for the self test, with a random amount of room,
+ * corrupting random bytes written to it.
+ */
+class TestSerial {
+public:
+    TestSerial(uint32_t &state, uint16_t errorRate) : state(state), errorRate(errorRate), room(0) {}
+
+    /**
+     * Returns the room left, picked at random for each drain.
+     *
+     * @return bytes that can be written without waiting
+     */
+    int availableForWrite() {
+        return this->room;
+    }
+
+    /**
+     * Records the frame, corrupts it, and adds it to the bytes sent.
+     *
+     * @param frame frame to write
+     * @param size bytes in frame
+     * @return size
+     */
+    size_t write(const uint8_t *frame, size_t size) {
+        TraceStream decoder;
+        bool corrupted = false;
+
+        this->room -= size;
+
+        // The event the frame was encoded from
+        for (size_t b = 0; b < size; b++) {
+            decoder.push(frame[b]);
+        }
+
+        this->sent.push_back(decoder.getEvent());
+
+        for (size_t b = 0; b < size; b++) {
+            uint8_t byte = frame[b];
+
+            if ((hostRandom(this->state) & 0xFFFF) < this->errorRate) {
+                byte ^= 1 << (hostRandom(this->state) % 8);
+                corrupted = true;
+            }
+
+            this->bytes.push_back(byte);
+        }
+
+        this->intact.push_back(!corrupted);
+
+        return size;
+    }
+
+    uint32_t &state;
+    uint16_t errorRate;
+    int room;                          // Bytes that can be written before the next drain
+    std::vector<trace_event_t> sent;   // Every frame written, before corruption
+    std::vector<bool> intact;          // The frame of sent was not corrupted
+    std::vector<uint8_t> bytes;        // Everything written, after corruption
+};
+
+/**
+ * Records random events into a ring, drains them through a corrupting
+ * serial port, and checks what is read back.
+ *
+ * @param count number of events
+ * @param errorRate chance out of 65536 of each byte being corrupted
+ * @param seed random seed, not 0
+ * @return 0 if every event was sent or counted as dropped, and every
+ *         intact frame was read back and nothing else was
+ */
+static int selfTest(uint32_t count, uint16_t errorRate, uint32_t seed) {
+    TraceRing ring;
+    TraceStream stream;
+    uint32_t state = seed;
+    TestSerial serial(state, errorRate);
+    std::vector<trace_event_t> recorded;
+    uint32_t time = 0;
+    uint32_t droppedCount = 0;
+    uint32_t readBack = 0;
+    uint32_t missed = 0;
+    uint32_t wrong = 0;
+    size_t matched = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        trace_event_t event;
+
+        time += hostRandom(state) % 2000;
+
+        event.time = time;
+        event.data = hostRandom(state);
+        event.type = hostRandom(state) % TRACE_EVENT_DROPPED; // Dropped is only made by drain()
+        event.channel = hostRandom(state) % 16;
+
+        ring.record(event.type, event.channel, event.data, event.time);
+        recorded.push_back(event);
+
+        // Sometimes loop() gets to drain, with room for anything up to a few frames
+        if (hostRandom(state) % 4 == 0) {
+            serial.room = hostRandom(state) % (4 * TRACE_STREAM_FRAME_SIZE);
+            ring.drain(serial, time);
+        }
+    }
+
+    serial.room = TRACE_RING_SIZE * TRACE_STREAM_FRAME_SIZE * 2;
+    ring.drain(serial, time);
+
+    // Every recorded event was sent in order, or counted in a dropped event
+    size_t next = 0;
+    uint32_t lost = 0;
+
+    for (size_t i = 0; i < serial.sent.size(); i++) {
+        if (serial.sent[i].type == TRACE_EVENT_DROPPED) {
+            droppedCount += serial.sent[i].data;
+            continue;
+        }
+
+        while (next < recorded.size() && !sameEvent(serial.sent[i], recorded[next])) {
+            next++;
+            lost++;
+        }
+
+        next++;
+    }
+
+    lost += recorded.size() - (next < recorded.size() ? next : recorded.size());
+
+    // Every intact frame is read back from the corrupted bytes
+    for (size_t b = 0; b < serial.bytes.size(); b++) {
+        if (!stream.push(serial.bytes[b])) {
+            continue;
+        }
+
+        trace_event_t read = stream.getEvent();
+        size_t find = matched;
+
+        while (find < serial.sent.size() && !(serial.intact[find] && sameEvent(read, serial.sent[find]))) {
+            find++;
+        }
+
+        if (find < serial.sent.size()) {
+            for (size_t f = matched; f < find; f++) {
+                missed += serial.intact[f] ? 1 : 0;
+            }
+
+            matched = find + 1;
+            readBack++;
+        } else {
+            wrong++;
+        }
+    }
+
+    for (size_t f = matched; f < serial.sent.size(); f++) {
+        missed += serial.intact[f] ? 1 : 0;
+    }
+
+    printf("events: %u, frames sent: %u, dropped: %u, not accounted for: %u, "
+           "intact read back: %u, intact missed: %u, wrong: %u, bytes skipped: %u\n",
+           count, (uint32_t)serial.sent.size(), droppedCount, lost - droppedCount,
+           readBack, missed, wrong, stream.getSkippedCount());
+
+    HostChecks checks;
+
+    checks.expect(lost == droppedCount, "%u events not accounted for", lost - droppedCount);
+    checks.expect(missed == 0, "%u intact frames missed", missed);
+    checks.expect(wrong == 0, "%u frames read back wrong", wrong);
+
+    return checks.finish();
+}
+
+
+int main(int argc, char **argv) {
+    uint32_t testCount = 0;
+    uint16_t errorRate = 100;
+    uint32_t seed = 1;
+    const char *path = nullptr;
+
+    if (!parseHostOptions(argc, argv, {{"-t", testCount}, {"-e", errorRate}, {"-s", seed}}, &path)) {
+        return 1;
+    }
+
+    if (testCount > 0) {
+        if (seed == 0) {
+            fprintf(stderr, "Seed must not be 0\n");
+            return 1;
+        }
+
+        return selfTest(testCount, errorRate, seed);
+    }
+
+    FILE *file = stdin;
+
+    if (path != nullptr) {
+        file = fopen(path, "rb");
+
+        if (file == nullptr) {
+            fprintf(stderr, "Could not open %s\n", path);
+            return 1;
+        }
+    }
+
+    int result = readStream(file);
+
+    if (file != stdin) {
+        fclose(file);
+    }
+
+    return result;
+}